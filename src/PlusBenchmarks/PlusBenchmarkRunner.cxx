@@ -0,0 +1,259 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusBenchmarkRunner.h"
+#include "PlusCommon.h"
+
+#include <vtkIGSIOAccurateTimer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  // Iterations are calibrated until one batch takes at least this long, to keep timer resolution errors low
+  const double MIN_CALIBRATION_TIME_SEC = 0.01;
+  const unsigned long long MAX_NUMBER_OF_ITERATIONS = 1000000000ULL;
+
+  //----------------------------------------------------------------------------
+  std::string EscapeJsonString(const std::string& value)
+  {
+    std::string escaped;
+    for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+    {
+      if (*it == '"' || *it == '\\')
+      {
+        escaped += '\\';
+      }
+      escaped += *it;
+    }
+    return escaped;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusBenchmarkRunner::PlusBenchmarkRunner()
+  : MinTimeSec(0.5)
+  , NumberOfRepetitions(5)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusBenchmarkRunner::~PlusBenchmarkRunner()
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusBenchmarkRunner::SetFilter(const std::string& filter)
+{
+  this->Filter = filter;
+}
+
+//----------------------------------------------------------------------------
+void PlusBenchmarkRunner::SetMinTimeSec(double minTimeSec)
+{
+  this->MinTimeSec = minTimeSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusBenchmarkRunner::SetNumberOfRepetitions(int numberOfRepetitions)
+{
+  this->NumberOfRepetitions = std::max(numberOfRepetitions, 1);
+}
+
+//----------------------------------------------------------------------------
+bool PlusBenchmarkRunner::IsSelected(const std::string& benchmarkName) const
+{
+  return this->Filter.empty() || benchmarkName.find(this->Filter) != std::string::npos;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBenchmarkRunner::MeasureIterations(BenchmarkFunctionType& function, unsigned long long numberOfIterations, double& elapsedTimeSec, double& cpuTimeSec)
+{
+  PlusStatus status = PLUS_SUCCESS;
+  std::clock_t cpuStartTime = std::clock();
+  double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  for (unsigned long long i = 0; i < numberOfIterations; ++i)
+  {
+    if (function() != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+      break;
+    }
+  }
+  elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+  cpuTimeSec = static_cast<double>(std::clock() - cpuStartTime) / CLOCKS_PER_SEC;
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBenchmarkRunner::Run(const std::string& benchmarkName, BenchmarkFunctionType function, double itemsPerIteration/*=0*/, double bytesPerIteration/*=0*/)
+{
+  if (!this->IsSelected(benchmarkName))
+  {
+    return PLUS_SUCCESS;
+  }
+  LOG_DEBUG("Running benchmark " << benchmarkName);
+
+  // Warm up and calibrate the number of iterations
+  double elapsedTimeSec = 0;
+  double cpuTimeSec = 0;
+  unsigned long long numberOfIterations = 1;
+  if (this->MeasureIterations(function, numberOfIterations, elapsedTimeSec, cpuTimeSec) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Benchmark " << benchmarkName << " failed");
+    return PLUS_FAIL;
+  }
+  while (elapsedTimeSec < MIN_CALIBRATION_TIME_SEC && elapsedTimeSec < this->MinTimeSec && numberOfIterations < MAX_NUMBER_OF_ITERATIONS)
+  {
+    numberOfIterations *= 10;
+    if (this->MeasureIterations(function, numberOfIterations, elapsedTimeSec, cpuTimeSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Benchmark " << benchmarkName << " failed");
+      return PLUS_FAIL;
+    }
+  }
+  if (elapsedTimeSec > 0 && elapsedTimeSec < this->MinTimeSec)
+  {
+    double scaledNumberOfIterations = std::ceil(numberOfIterations * this->MinTimeSec / elapsedTimeSec);
+    numberOfIterations = static_cast<unsigned long long>(std::min(scaledNumberOfIterations, static_cast<double>(MAX_NUMBER_OF_ITERATIONS)));
+  }
+
+  std::vector<double> iterationTimesNs;
+  std::vector<double> iterationCpuTimesNs;
+  for (int repetition = 0; repetition < this->NumberOfRepetitions; ++repetition)
+  {
+    if (this->MeasureIterations(function, numberOfIterations, elapsedTimeSec, cpuTimeSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Benchmark " << benchmarkName << " failed");
+      return PLUS_FAIL;
+    }
+    iterationTimesNs.push_back(elapsedTimeSec * 1e9 / numberOfIterations);
+    iterationCpuTimesNs.push_back(cpuTimeSec * 1e9 / numberOfIterations);
+  }
+
+  BenchmarkResult result;
+  result.Name = benchmarkName;
+  result.NumberOfIterations = numberOfIterations;
+  result.NumberOfRepetitions = this->NumberOfRepetitions;
+  result.ItemsPerIteration = itemsPerIteration;
+  result.BytesPerIteration = bytesPerIteration;
+
+  std::vector<double> sortedTimesNs = iterationTimesNs;
+  std::sort(sortedTimesNs.begin(), sortedTimesNs.end());
+  result.MedianTimeNs = sortedTimesNs[sortedTimesNs.size() / 2];
+  result.MinTimeNs = sortedTimesNs.front();
+  result.MaxTimeNs = sortedTimesNs.back();
+  result.CpuTimeNs = iterationCpuTimesNs[std::find(iterationTimesNs.begin(), iterationTimesNs.end(), result.MedianTimeNs) - iterationTimesNs.begin()];
+  double sum = 0;
+  double sumSquares = 0;
+  for (std::vector<double>::iterator it = iterationTimesNs.begin(); it != iterationTimesNs.end(); ++it)
+  {
+    sum += (*it);
+    sumSquares += (*it) * (*it);
+  }
+  result.MeanTimeNs = sum / iterationTimesNs.size();
+  result.StdevTimeNs = std::sqrt(std::max(0.0, sumSquares / iterationTimesNs.size() - result.MeanTimeNs * result.MeanTimeNs));
+  this->Results.push_back(result);
+
+  std::ostringstream throughput;
+  if (itemsPerIteration > 0)
+  {
+    throughput << ", " << std::setprecision(4) << itemsPerIteration * 1e9 / result.MedianTimeNs << " items/s";
+  }
+  if (bytesPerIteration > 0)
+  {
+    throughput << ", " << std::setprecision(4) << bytesPerIteration * 1e9 / result.MedianTimeNs / (1024.0 * 1024.0) << " MB/s";
+  }
+  LOG_INFO(std::left << std::setw(48) << benchmarkName << std::right << std::fixed << std::setprecision(1)
+           << std::setw(14) << result.MedianTimeNs << " ns (min " << result.MinTimeNs << ", max " << result.MaxTimeNs << ", "
+           << numberOfIterations << " iterations x " << this->NumberOfRepetitions << ")" << throughput.str());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusBenchmarkRunner::Skip(const std::string& benchmarkName, const std::string& reason)
+{
+  if (!this->IsSelected(benchmarkName))
+  {
+    return;
+  }
+  LOG_WARNING("Benchmark " << benchmarkName << " is skipped: " << reason);
+}
+
+//----------------------------------------------------------------------------
+const std::vector<PlusBenchmarkRunner::BenchmarkResult>& PlusBenchmarkRunner::GetResults() const
+{
+  return this->Results;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBenchmarkRunner::WriteResultsToJsonFile(const std::string& fileName) const
+{
+  std::ofstream outputFile(fileName.c_str());
+  if (!outputFile.is_open())
+  {
+    LOG_ERROR("Failed to open benchmark results file for writing: " << fileName);
+    return PLUS_FAIL;
+  }
+
+  outputFile << "{" << std::endl;
+  outputFile << "  \"context\": {" << std::endl;
+  outputFile << "    \"date\": \"" << EscapeJsonString(vtkIGSIOAccurateTimer::GetInstance()->GetDateAndTimeString()) << "\"," << std::endl;
+  outputFile << "    \"plus_version\": \"" << EscapeJsonString(PlusCommon::GetPlusLibVersionString()) << "\"," << std::endl;
+  outputFile << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "," << std::endl;
+#ifdef NDEBUG
+  outputFile << "    \"library_build_type\": \"release\"," << std::endl;
+#else
+  outputFile << "    \"library_build_type\": \"debug\"," << std::endl;
+#endif
+  outputFile << "    \"repetitions\": " << this->NumberOfRepetitions << "," << std::endl;
+  outputFile << "    \"min_time\": " << this->MinTimeSec << std::endl;
+  outputFile << "  }," << std::endl;
+  outputFile << "  \"benchmarks\": [";
+  outputFile << std::fixed << std::setprecision(3);
+  for (std::vector<BenchmarkResult>::const_iterator it = this->Results.begin(); it != this->Results.end(); ++it)
+  {
+    outputFile << (it == this->Results.begin() ? "" : ",") << std::endl;
+    outputFile << "    {" << std::endl;
+    outputFile << "      \"name\": \"" << EscapeJsonString(it->Name) << "\"," << std::endl;
+    outputFile << "      \"run_name\": \"" << EscapeJsonString(it->Name) << "\"," << std::endl;
+    outputFile << "      \"run_type\": \"iteration\"," << std::endl;
+    outputFile << "      \"repetitions\": " << it->NumberOfRepetitions << "," << std::endl;
+    outputFile << "      \"iterations\": " << it->NumberOfIterations << "," << std::endl;
+    outputFile << "      \"real_time\": " << it->MedianTimeNs << "," << std::endl;
+    outputFile << "      \"cpu_time\": " << it->CpuTimeNs << "," << std::endl;
+    outputFile << "      \"time_unit\": \"ns\"," << std::endl;
+    outputFile << "      \"mean_time\": " << it->MeanTimeNs << "," << std::endl;
+    outputFile << "      \"min_time\": " << it->MinTimeNs << "," << std::endl;
+    outputFile << "      \"max_time\": " << it->MaxTimeNs << "," << std::endl;
+    outputFile << "      \"stddev_time\": " << it->StdevTimeNs;
+    if (it->ItemsPerIteration > 0)
+    {
+      outputFile << "," << std::endl << "      \"items_per_second\": " << it->ItemsPerIteration * 1e9 / it->MedianTimeNs;
+    }
+    if (it->BytesPerIteration > 0)
+    {
+      outputFile << "," << std::endl << "      \"bytes_per_second\": " << it->BytesPerIteration * 1e9 / it->MedianTimeNs;
+    }
+    outputFile << std::endl << "    }";
+  }
+  outputFile << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+  if (!outputFile.good())
+  {
+    LOG_ERROR("Failed to write benchmark results file: " << fileName);
+    return PLUS_FAIL;
+  }
+  LOG_INFO("Results of " << this->Results.size() << " benchmarks are written to " << fileName);
+  return PLUS_SUCCESS;
+}
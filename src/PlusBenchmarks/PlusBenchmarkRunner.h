@@ -0,0 +1,101 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusBenchmarkRunner_h
+#define __PlusBenchmarkRunner_h
+
+#include "PlusConfigure.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusBenchmarkRunner
+  \brief Runs microbenchmarks and collects their timing results
+
+  Each benchmark is a function that performs one iteration of the measured operation. The runner calls the function
+  once to warm up caches and lazily allocated resources, then determines how many iterations fit into the minimum
+  measurement time, and measures the same number of iterations in each repetition. The median of the repetitions
+  is reported, as it is less sensitive to occasional interruptions by other processes than the mean.
+
+  Results can be written to a JSON file that follows the format of Google Benchmark (--benchmark_out_format=json),
+  so that existing tools for tracking benchmark results between releases can be used.
+
+  \ingroup PlusLibBenchmarks
+*/
+class PlusBenchmarkRunner
+{
+public:
+  /*! Performs one iteration of the measured operation */
+  typedef std::function<PlusStatus()> BenchmarkFunctionType;
+
+  struct BenchmarkResult
+  {
+    std::string Name;
+    unsigned long long NumberOfIterations;
+    int NumberOfRepetitions;
+    /*! Time of one iteration, in nanoseconds */
+    double MedianTimeNs;
+    double MeanTimeNs;
+    double MinTimeNs;
+    double MaxTimeNs;
+    double StdevTimeNs;
+    /*! Processor time (all threads) of one iteration in the median repetition, in nanoseconds */
+    double CpuTimeNs;
+    /*! Number of processed items and bytes in one iteration (0 if not applicable) */
+    double ItemsPerIteration;
+    double BytesPerIteration;
+  };
+
+  PlusBenchmarkRunner();
+  virtual ~PlusBenchmarkRunner();
+
+  /*! Only those benchmarks are run that contain this string in their name. If empty then all benchmarks are run. */
+  void SetFilter(const std::string& filter);
+
+  /*! Minimum duration of each repetition */
+  void SetMinTimeSec(double minTimeSec);
+
+  /*! Number of times the measurement is repeated */
+  void SetNumberOfRepetitions(int numberOfRepetitions);
+
+  /*! Returns true if the benchmark is selected by the filter. Allows skipping expensive setup of benchmarks that are not run. */
+  bool IsSelected(const std::string& benchmarkName) const;
+
+  /*!
+    Run a benchmark if it is selected by the filter
+    \param benchmarkName Name of the benchmark, parameters are separated by slashes (e.g., BufferAddItem/Video640x480)
+    \param function Function that performs one iteration
+    \param itemsPerIteration Number of items (frames, transforms, etc.) processed in one iteration, used for computing throughput
+    \param bytesPerIteration Number of bytes processed in one iteration, used for computing throughput
+    \return PLUS_FAIL if the function failed in any iteration
+  */
+  PlusStatus Run(const std::string& benchmarkName, BenchmarkFunctionType function, double itemsPerIteration = 0, double bytesPerIteration = 0);
+
+  /*! Record that a benchmark could not be run (e.g., because input data is not specified). It is logged but not written to the results. */
+  void Skip(const std::string& benchmarkName, const std::string& reason);
+
+  const std::vector<BenchmarkResult>& GetResults() const;
+
+  /*! Write all results to a JSON file in Google Benchmark format */
+  PlusStatus WriteResultsToJsonFile(const std::string& fileName) const;
+
+protected:
+  /*! Measure the specified number of iterations, returns PLUS_FAIL if any of them failed */
+  PlusStatus MeasureIterations(BenchmarkFunctionType& function, unsigned long long numberOfIterations, double& elapsedTimeSec, double& cpuTimeSec);
+
+  std::string Filter;
+  double MinTimeSec;
+  int NumberOfRepetitions;
+  std::vector<BenchmarkResult> Results;
+
+private:
+  PlusBenchmarkRunner(const PlusBenchmarkRunner&);
+  void operator=(const PlusBenchmarkRunner&);
+};
+
+#endif
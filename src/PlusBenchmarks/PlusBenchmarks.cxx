@@ -0,0 +1,812 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusBenchmarks.cxx
+  \brief Microbenchmarks of the performance-critical operations of data acquisition, processing and broadcasting
+
+  The benchmarks use synthetic data (except the ultrasound simulator benchmark, which requires a configuration
+  file and a transforms sequence file, and the indexed sequence file compression benchmark, which requires a recorded
+  sequence file), so that the results only depend on the hardware and the software version.
+  Results can be written to a JSON file to track performance changes between releases.
+
+  \ingroup PlusLibBenchmarks
+*/
+
+#include "PlusConfigure.h"
+#include "PlusBenchmarkRunner.h"
+#include "PlusIndexedSequenceFile.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkIGSIOTransformRepository.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusRfToBrightnessConvert.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusUsScanConvertCurvilinear.h"
+#include "vtkPlusUsSimulatorAlgo.h"
+#ifdef PLUS_USE_OpenIGTLink
+#include "vtkPlusIgtlMessageCommon.h"
+#endif
+
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+#include <vtksys/SystemTools.hxx>
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace
+{
+  const double FRAME_PERIOD_SEC = 0.01;
+  const int NUMBER_OF_TOOLS = 3;
+  const char* TOOL_NAMES[NUMBER_OF_TOOLS] = { "Probe", "Stylus", "Reference" };
+  const int TRACKER_BUFFER_SIZE = 10000;
+  const int VIDEO_BUFFER_SIZE = 100;
+  const int NUMBER_OF_FRAMES_IN_SEQUENCE_FILE = 50;
+
+  //----------------------------------------------------------------------------
+  // Fill the buffer with a pattern that is not trivially compressible, but compresses similarly to ultrasound images
+  template<class PixelType>
+  void FillImage(vtkImageData* image, unsigned int seed)
+  {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> noise(0, 15);
+    int* dims = image->GetDimensions();
+    PixelType* pixelPtr = static_cast<PixelType*>(image->GetScalarPointer());
+    for (int z = 0; z < dims[2]; ++z)
+    {
+      for (int y = 0; y < dims[1]; ++y)
+      {
+        for (int x = 0; x < dims[0] * image->GetNumberOfScalarComponents(); ++x)
+        {
+          *(pixelPtr++) = static_cast<PixelType>(((x + y) % 64) * 2 + noise(generator));
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void GetToolToTrackerMatrix(int toolIndex, double time, vtkMatrix4x4* matrix)
+  {
+    matrix->Identity();
+    matrix->SetElement(0, 3, 10.0 * toolIndex + 5.0 * sin(time));
+    matrix->SetElement(1, 3, 20.0 * cos(time));
+    matrix->SetElement(2, 3, 100.0 + time);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CreateTrackedFrame(const FrameSizeType& frameSize, double timestamp, igsioTrackedFrame& trackedFrame)
+  {
+    if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate frame of size " << frameSize[0] << "x" << frameSize[1]);
+      return PLUS_FAIL;
+    }
+    FillImage<unsigned char>(trackedFrame.GetImageData()->GetImage(), static_cast<unsigned int>(timestamp / FRAME_PERIOD_SEC));
+    trackedFrame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+    trackedFrame.GetImageData()->SetImageType(US_IMG_BRIGHTNESS);
+    trackedFrame.SetTimestamp(timestamp);
+    vtkSmartPointer<vtkMatrix4x4> toolToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int toolIndex = 0; toolIndex < NUMBER_OF_TOOLS; ++toolIndex)
+    {
+      igsioTransformName toolToTrackerName(TOOL_NAMES[toolIndex], "Tracker");
+      GetToolToTrackerMatrix(toolIndex, timestamp, toolToTracker);
+      trackedFrame.SetFrameTransform(toolToTrackerName, toolToTracker);
+      trackedFrame.SetFrameTransformStatus(toolToTrackerName, TOOL_OK);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus FillTrackerBuffer(vtkPlusBuffer* buffer, const std::string& benchmarkName)
+  {
+    buffer->SetDescriptiveName("BenchmarkTracker");
+    buffer->SetBufferSize(TRACKER_BUFFER_SIZE);
+    vtkSmartPointer<vtkMatrix4x4> toolToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int i = 0; i < TRACKER_BUFFER_SIZE; ++i)
+    {
+      // Add some jitter to the timestamps, as the lookup is not a simple index computation then
+      double timestamp = 1.0 + i * FRAME_PERIOD_SEC + ((i * 7919) % 13) * FRAME_PERIOD_SEC * 0.01;
+      GetToolToTrackerMatrix(0, timestamp, toolToTracker);
+      if (buffer->AddTimeStampedItem(toolToTracker, TOOL_OK, i, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to fill tracker buffer for " << benchmarkName);
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetFrameSizeAsString(const FrameSizeType& frameSize)
+  {
+    std::ostringstream ss;
+    ss << frameSize[0] << "x" << frameSize[1];
+    return ss.str();
+  }
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusBuffer::AddItem with video frames and tracker poses
+int BenchmarkBufferAddItem(PlusBenchmarkRunner& runner)
+{
+  int numberOfErrors = 0;
+
+  const FrameSizeType frameSizes[] = { { 640, 480, 1 }, { 1920, 1080, 1 } };
+  for (unsigned int frameSizeIndex = 0; frameSizeIndex < sizeof(frameSizes) / sizeof(frameSizes[0]); ++frameSizeIndex)
+  {
+    const FrameSizeType& frameSize = frameSizes[frameSizeIndex];
+    std::string benchmarkName = "BufferAddItem/Video" + GetFrameSizeAsString(frameSize);
+    if (!runner.IsSelected(benchmarkName))
+    {
+      continue;
+    }
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetDescriptiveName("BenchmarkVideo");
+    buffer->SetBufferSize(VIDEO_BUFFER_SIZE);
+    buffer->SetImageOrientation(US_IMG_ORIENT_MF);
+    buffer->SetImageType(US_IMG_BRIGHTNESS);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    buffer->SetFrameSize(frameSize);
+    std::vector<unsigned char> frameData(frameSize[0] * frameSize[1]);
+    const std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    long frameNumber = 0;
+    double timestamp = 1.0;
+    numberOfErrors += runner.Run(benchmarkName, [&]()
+    {
+      frameData[frameNumber % frameData.size()]++;
+      timestamp += FRAME_PERIOD_SEC;
+      return buffer->AddItem(&frameData[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber++, noClip, noClip, timestamp, timestamp);
+    }, 1, frameData.size()) == PLUS_SUCCESS ? 0 : 1;
+  }
+
+  if (runner.IsSelected("BufferAddItem/Transform"))
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetDescriptiveName("BenchmarkTracker");
+    buffer->SetBufferSize(TRACKER_BUFFER_SIZE);
+    vtkSmartPointer<vtkMatrix4x4> toolToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+    unsigned long frameNumber = 0;
+    double timestamp = 1.0;
+    numberOfErrors += runner.Run("BufferAddItem/Transform", [&]()
+    {
+      timestamp += FRAME_PERIOD_SEC;
+      toolToTracker->SetElement(0, 3, timestamp);
+      return buffer->AddTimeStampedItem(toolToTracker, TOOL_OK, frameNumber++, timestamp, timestamp);
+    }, 1) == PLUS_SUCCESS ? 0 : 1;
+  }
+
+  return numberOfErrors;
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusBuffer::GetItemUidFromTime on a full tracker buffer, with random lookup times
+int BenchmarkBufferGetItemUidFromTime(PlusBenchmarkRunner& runner)
+{
+  const std::string benchmarkName = "BufferGetItemUidFromTime/Items10000";
+  if (!runner.IsSelected(benchmarkName))
+  {
+    return 0;
+  }
+
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  if (FillTrackerBuffer(buffer, benchmarkName) != PLUS_SUCCESS)
+  {
+    return 1;
+  }
+
+  double oldestTimestamp = 0;
+  double latestTimestamp = 0;
+  if (buffer->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK || buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+  {
+    LOG_ERROR("Failed to get timestamp range of the tracker buffer for " << benchmarkName);
+    return 1;
+  }
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> lookupTime(oldestTimestamp, latestTimestamp);
+  return runner.Run(benchmarkName, [&]()
+  {
+    BufferItemUidType uid = 0;
+    return buffer->GetItemUidFromTime(lookupTime(generator), uid) == ITEM_OK ? PLUS_SUCCESS : PLUS_FAIL;
+  }, 1) == PLUS_SUCCESS ? 0 : 1;
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusBuffer::GetStreamBufferItemFromTime with pose interpolation on a full tracker buffer, with and without TransformOnly,
+// to measure the gain of not copying the (empty) video frame of tracker items
+int BenchmarkBufferGetItemFromTimeInterpolated(PlusBenchmarkRunner& runner)
+{
+  int numberOfErrors = 0;
+  for (int transformOnly = 1; transformOnly >= 0; --transformOnly)
+  {
+    const std::string benchmarkName = std::string("BufferGetItemFromTimeInterpolated/") + (transformOnly ? "TransformOnly" : "FullItem") + "/Items10000";
+    if (!runner.IsSelected(benchmarkName))
+    {
+      continue;
+    }
+
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetTransformOnly(transformOnly != 0);
+    if (FillTrackerBuffer(buffer, benchmarkName) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+      continue;
+    }
+    // The memory footprint is the same in both modes: items of tracker buffers have no frame pixel data, but still contain the empty frame and frame field map
+    LOG_INFO(benchmarkName << ": " << buffer->GetReservedMemoryBytes() / TRACKER_BUFFER_SIZE << " reserved bytes per item ("
+             << sizeof(StreamBufferItem) << " bytes item size, " << 16 * sizeof(double) << " bytes pose)");
+
+    double oldestTimestamp = 0;
+    double latestTimestamp = 0;
+    if (buffer->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK || buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+    {
+      LOG_ERROR("Failed to get timestamp range of the tracker buffer for " << benchmarkName);
+      numberOfErrors++;
+      continue;
+    }
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> lookupTime(oldestTimestamp, latestTimestamp);
+    StreamBufferItem item;
+    numberOfErrors += runner.Run(benchmarkName, [&]()
+    {
+      return buffer->GetStreamBufferItemFromTime(lookupTime(generator), &item, vtkPlusBuffer::INTERPOLATED) == ITEM_OK ? PLUS_SUCCESS : PLUS_FAIL;
+    }, 1) == PLUS_SUCCESS ? 0 : 1;
+  }
+  return numberOfErrors;
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusChannel::GetTrackedFrame from a video source and tools (with pose interpolation)
+int BenchmarkChannelGetTrackedFrame(PlusBenchmarkRunner& runner)
+{
+  const FrameSizeType frameSize = { 640, 480, 1 };
+  const std::string benchmarkName = "ChannelGetTrackedFrame/Video" + GetFrameSizeAsString(frameSize) + "Tools3";
+  if (!runner.IsSelected(benchmarkName))
+  {
+    return 0;
+  }
+
+  vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+
+  vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+  videoSource->SetId("Video");
+  videoSource->SetType(DATA_SOURCE_TYPE_VIDEO);
+  videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+  videoSource->SetImageType(US_IMG_BRIGHTNESS);
+  videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+  videoSource->SetNumberOfScalarComponents(1);
+  videoSource->SetInputFrameSize(frameSize);
+  videoSource->SetBufferSize(VIDEO_BUFFER_SIZE);
+  channel->SetVideoSource(videoSource);
+
+  std::vector<vtkSmartPointer<vtkPlusDataSource> > tools;
+  for (int toolIndex = 0; toolIndex < NUMBER_OF_TOOLS; ++toolIndex)
+  {
+    vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+    tool->SetId(std::string(TOOL_NAMES[toolIndex]) + "ToTracker");
+    tool->SetType(DATA_SOURCE_TYPE_TOOL);
+    tool->SetBufferSize(TRACKER_BUFFER_SIZE);
+    channel->AddTool(tool);
+    tools.push_back(tool);
+  }
+
+  // Tracker poses are acquired at a higher rate than the video frames, as in typical setups
+  std::vector<unsigned char> frameData(frameSize[0] * frameSize[1]);
+  vtkSmartPointer<vtkMatrix4x4> toolToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+  const int trackerFramesPerVideoFrame = 4;
+  for (int frameIndex = 0; frameIndex < VIDEO_BUFFER_SIZE; ++frameIndex)
+  {
+    double videoTimestamp = 1.0 + frameIndex * FRAME_PERIOD_SEC;
+    frameData[frameIndex] = static_cast<unsigned char>(frameIndex);
+    if (videoSource->AddItem(&frameData[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameIndex, videoTimestamp, videoTimestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to fill video buffer for " << benchmarkName);
+      return 1;
+    }
+    for (int trackerFrameIndex = 0; trackerFrameIndex < trackerFramesPerVideoFrame; ++trackerFrameIndex)
+    {
+      double trackerTimestamp = videoTimestamp + trackerFrameIndex * FRAME_PERIOD_SEC / trackerFramesPerVideoFrame;
+      for (int toolIndex = 0; toolIndex < NUMBER_OF_TOOLS; ++toolIndex)
+      {
+        GetToolToTrackerMatrix(toolIndex, trackerTimestamp, toolToTracker);
+        if (tools[toolIndex]->AddTimeStampedItem(toolToTracker, TOOL_OK, frameIndex * trackerFramesPerVideoFrame + trackerFrameIndex, trackerTimestamp, trackerTimestamp) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to fill tracker buffer for " << benchmarkName);
+          return 1;
+        }
+      }
+    }
+  }
+
+  int frameIndex = 0;
+  igsioTrackedFrame trackedFrame;
+  return runner.Run(benchmarkName, [&]()
+  {
+    // Use frames in the middle of the buffer, so that there are tracker poses before and after the frame for interpolation
+    frameIndex = (frameIndex + 1) % (VIDEO_BUFFER_SIZE - 2);
+    return channel->GetTrackedFrame(1.0 + (frameIndex + 1) * FRAME_PERIOD_SEC, trackedFrame);
+  }, 1, frameData.size()) == PLUS_SUCCESS ? 0 : 1;
+}
+
+#ifdef PLUS_USE_OpenIGTLink
+//----------------------------------------------------------------------------
+// vtkPlusIgtlMessageCommon::PackImageMessage and PackTrackingDataMessage
+int BenchmarkPackMessages(PlusBenchmarkRunner& runner)
+{
+  int numberOfErrors = 0;
+
+  const FrameSizeType frameSize = { 640, 480, 1 };
+  const std::string imageBenchmarkName = "PackImageMessage/Image" + GetFrameSizeAsString(frameSize);
+  if (runner.IsSelected(imageBenchmarkName))
+  {
+    igsioTrackedFrame trackedFrame;
+    if (CreateTrackedFrame(frameSize, 1.0, trackedFrame) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    vtkSmartPointer<vtkMatrix4x4> imageToReference = vtkSmartPointer<vtkMatrix4x4>::New();
+    numberOfErrors += runner.Run(imageBenchmarkName, [&]()
+    {
+      // The server creates a new message for each client and frame, too
+      igtl::ImageMessage::Pointer imageMessage = igtl::ImageMessage::New();
+      imageMessage->SetDeviceName("Image_Reference");
+      return vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *imageToReference);
+    }, 1, frameSize[0] * frameSize[1]) == PLUS_SUCCESS ? 0 : 1;
+  }
+
+  const std::string trackingBenchmarkName = "PackTrackingDataMessage/Tools3";
+  if (runner.IsSelected(trackingBenchmarkName))
+  {
+    vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+    vtkSmartPointer<vtkMatrix4x4> toolToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+    std::vector<igsioTransformName> transformNames;
+    for (int toolIndex = 0; toolIndex < NUMBER_OF_TOOLS; ++toolIndex)
+    {
+      igsioTransformName toolToTrackerName(TOOL_NAMES[toolIndex], "Tracker");
+      GetToolToTrackerMatrix(toolIndex, 1.0, toolToTracker);
+      if (transformRepository->SetTransform(toolToTrackerName, toolToTracker) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set transform for " << trackingBenchmarkName);
+        return numberOfErrors + 1;
+      }
+      transformNames.push_back(toolToTrackerName);
+    }
+    numberOfErrors += runner.Run(trackingBenchmarkName, [&]()
+    {
+      igtl::TrackingDataMessage::Pointer trackingDataMessage = igtl::TrackingDataMessage::New();
+      trackingDataMessage->SetDeviceName("TDATA_Tracker");
+      return vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, transformNames, *transformRepository, 1.0);
+    }, NUMBER_OF_TOOLS) == PLUS_SUCCESS ? 0 : 1;
+  }
+
+  return numberOfErrors;
+}
+#endif
+
+//----------------------------------------------------------------------------
+// vtkPlusUsScanConvertCurvilinear on synthetic scan lines
+int BenchmarkScanConvertCurvilinear(PlusBenchmarkRunner& runner)
+{
+  const int numberOfSamplesPerLine = 2048;
+  const int numberOfLines = 128;
+  const std::string benchmarkName = "ScanConvertCurvilinear/Lines128Samples2048";
+  if (!runner.IsSelected(benchmarkName))
+  {
+    return 0;
+  }
+
+  vtkSmartPointer<vtkImageData> scanLines = vtkSmartPointer<vtkImageData>::New();
+  scanLines->SetExtent(0, numberOfSamplesPerLine - 1, 0, numberOfLines - 1, 0, 0);
+  scanLines->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  FillImage<unsigned char>(scanLines, 0);
+
+  vtkSmartPointer<vtkXMLDataElement> scanConversionElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  scanConversionElement->SetName("ScanConversion");
+  scanConversionElement->SetAttribute("TransducerGeometry", "CURVILINEAR");
+  scanConversionElement->SetAttribute("RadiusStartMm", "50");
+  scanConversionElement->SetAttribute("RadiusStopMm", "150");
+  scanConversionElement->SetAttribute("ThetaStartDeg", "-30");
+  scanConversionElement->SetAttribute("ThetaStopDeg", "30");
+  scanConversionElement->SetAttribute("OutputImageSizePixel", "820 616");
+  scanConversionElement->SetAttribute("TransducerCenterPixel", "410 35");
+  scanConversionElement->SetAttribute("OutputImageSpacingMmPerPixel", "0.19 0.19");
+
+  vtkSmartPointer<vtkPlusUsScanConvertCurvilinear> scanConverter = vtkSmartPointer<vtkPlusUsScanConvertCurvilinear>::New();
+  if (scanConverter->ReadConfiguration(scanConversionElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to configure scan converter for " << benchmarkName);
+    return 1;
+  }
+  scanConverter->SetInputData(scanLines);
+
+  return runner.Run(benchmarkName, [&]()
+  {
+    // The input is modified in each iteration, as it happens for each new frame during acquisition
+    scanLines->Modified();
+    scanConverter->Update();
+    return scanConverter->GetOutput() != NULL ? PLUS_SUCCESS : PLUS_FAIL;
+  }, 1, numberOfSamplesPerLine * numberOfLines) == PLUS_SUCCESS ? 0 : 1;
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusRfToBrightnessConvert on synthetic RF scan lines
+int BenchmarkRfToBrightness(PlusBenchmarkRunner& runner)
+{
+  const int numberOfSamplesPerLine = 2048;
+  const int numberOfLines = 128;
+  const std::string benchmarkName = "RfToBrightness/Lines128Samples2048";
+  if (!runner.IsSelected(benchmarkName))
+  {
+    return 0;
+  }
+
+  vtkSmartPointer<vtkImageData> rfLines = vtkSmartPointer<vtkImageData>::New();
+  rfLines->SetExtent(0, numberOfSamplesPerLine - 1, 0, numberOfLines - 1, 0, 0);
+  rfLines->AllocateScalars(VTK_SHORT, 1);
+  std::mt19937 generator(0);
+  std::normal_distribution<double> noise(0.0, 200.0);
+  short* rfPtr = static_cast<short*>(rfLines->GetScalarPointer());
+  for (int line = 0; line < numberOfLines; ++line)
+  {
+    for (int sample = 0; sample < numberOfSamplesPerLine; ++sample)
+    {
+      // Modulated carrier signal with speckle-like noise
+      *(rfPtr++) = static_cast<short>(3000.0 * sin(sample * 0.8) * exp(-sample / 1500.0) + noise(generator));
+    }
+  }
+
+  vtkSmartPointer<vtkPlusRfToBrightnessConvert> rfToBrightness = vtkSmartPointer<vtkPlusRfToBrightnessConvert>::New();
+  rfToBrightness->SetImageType(US_IMG_RF_REAL);
+  rfToBrightness->SetInputData(rfLines);
+
+  return runner.Run(benchmarkName, [&]()
+  {
+    rfLines->Modified();
+    rfToBrightness->Update();
+    return rfToBrightness->GetOutput() != NULL ? PLUS_SUCCESS : PLUS_FAIL;
+  }, 1, numberOfSamplesPerLine * numberOfLines * sizeof(short)) == PLUS_SUCCESS ? 0 : 1;
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusUsSimulatorAlgo with the models and transforms specified in the input files
+int BenchmarkUsSimulatorAlgo(PlusBenchmarkRunner& runner, const std::string& configFileName, const std::string& transformsSeqFileName)
+{
+  const std::string benchmarkName = "UsSimulatorAlgo";
+  if (!runner.IsSelected(benchmarkName))
+  {
+    return 0;
+  }
+  if (configFileName.empty() || transformsSeqFileName.empty())
+  {
+    runner.Skip(benchmarkName, "--us-simulator-config-file and --us-simulator-transforms-seq-file are required");
+    return 0;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(transformsSeqFileName, trackedFrameList) != PLUS_SUCCESS || trackedFrameList->GetNumberOfTrackedFrames() == 0)
+  {
+    LOG_ERROR("Failed to read transforms from " << transformsSeqFileName);
+    return 1;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, configFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << configFileName);
+    return 1;
+  }
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read transforms for transform repository from " << configFileName);
+    return 1;
+  }
+  vtkSmartPointer<vtkPlusUsSimulatorAlgo> usSimulator = vtkSmartPointer<vtkPlusUsSimulatorAlgo>::New();
+  if (usSimulator->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read US simulator configuration from " << configFileName);
+    return 1;
+  }
+  usSimulator->SetTransformRepository(transformRepository);
+
+  unsigned int frameIndex = 0;
+  return runner.Run(benchmarkName, [&]()
+  {
+    igsioTrackedFrame* frame = trackedFrameList->GetTrackedFrame(frameIndex);
+    frameIndex = (frameIndex + 1) % trackedFrameList->GetNumberOfTrackedFrames();
+    if (transformRepository->SetTransforms(*frame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to update transform repository with tracked frame");
+      return PLUS_FAIL;
+    }
+    usSimulator->Modified();
+    usSimulator->Update();
+    return usSimulator->GetOutput() != NULL ? PLUS_SUCCESS : PLUS_FAIL;
+  }, 1) == PLUS_SUCCESS ? 0 : 1;
+}
+
+//----------------------------------------------------------------------------
+// vtkPlusSequenceIO::Write and Read with and without compression
+int BenchmarkSequenceFile(PlusBenchmarkRunner& runner, const std::string& outputDir)
+{
+  int numberOfErrors = 0;
+
+  const FrameSizeType frameSize = { 640, 480, 1 };
+  const double bytesPerIteration = static_cast<double>(frameSize[0]) * frameSize[1] * NUMBER_OF_FRAMES_IN_SEQUENCE_FILE;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList;
+
+  for (int useCompression = 0; useCompression <= 1; ++useCompression)
+  {
+    std::string variantName = "/Frames50Image" + GetFrameSizeAsString(frameSize) + (useCompression ? "Compressed" : "");
+    std::string writeBenchmarkName = "SequenceFileWrite" + variantName;
+    std::string readBenchmarkName = "SequenceFileRead" + variantName;
+    if (!runner.IsSelected(writeBenchmarkName) && !runner.IsSelected(readBenchmarkName))
+    {
+      continue;
+    }
+
+    if (trackedFrameList.GetPointer() == NULL)
+    {
+      trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+      for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES_IN_SEQUENCE_FILE; ++frameIndex)
+      {
+        igsioTrackedFrame trackedFrame;
+        if (CreateTrackedFrame(frameSize, 1.0 + frameIndex * FRAME_PERIOD_SEC, trackedFrame) != PLUS_SUCCESS)
+        {
+          return numberOfErrors + 1;
+        }
+        trackedFrameList->AddTrackedFrame(&trackedFrame);
+      }
+    }
+
+    std::string fileName = outputDir + "/PlusBenchmarksSequence" + (useCompression ? "Compressed" : "") + ".igs.mha";
+    numberOfErrors += runner.Run(writeBenchmarkName, [&]()
+    {
+      return vtkPlusSequenceIO::Write(fileName, trackedFrameList, US_IMG_ORIENT_MF, useCompression != 0) == PLUS_SUCCESS ? PLUS_SUCCESS : PLUS_FAIL;
+    }, NUMBER_OF_FRAMES_IN_SEQUENCE_FILE, bytesPerIteration) == PLUS_SUCCESS ? 0 : 1;
+
+    if (runner.IsSelected(readBenchmarkName))
+    {
+      // Make sure that the file exists even if only the read benchmark is selected
+      if (!vtksys::SystemTools::FileExists(fileName.c_str(), true)
+          && vtkPlusSequenceIO::Write(fileName, trackedFrameList, US_IMG_ORIENT_MF, useCompression != 0) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to write sequence file " << fileName << " for " << readBenchmarkName);
+        numberOfErrors++;
+        continue;
+      }
+      numberOfErrors += runner.Run(readBenchmarkName, [&]()
+      {
+        vtkSmartPointer<vtkIGSIOTrackedFrameList> readTrackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+        return vtkPlusSequenceIO::Read(fileName, readTrackedFrameList) == PLUS_SUCCESS ? PLUS_SUCCESS : PLUS_FAIL;
+      }, NUMBER_OF_FRAMES_IN_SEQUENCE_FILE, bytesPerIteration) == PLUS_SUCCESS ? 0 : 1;
+    }
+
+    vtksys::SystemTools::RemoveFile(fileName.c_str());
+  }
+
+  return numberOfErrors;
+}
+
+//----------------------------------------------------------------------------
+// PlusIndexedSequenceFile::Write of a recorded sequence with DELTA_ZLIB compared to ZLIB (each frame compressed independently).
+// The sequence is also converted to 12-bit values stored in 16-bit pixels, as the difference of multi-byte scalars
+// compresses well only if it is computed for each scalar. File sizes are logged, the file is read back to verify that no data is lost.
+int BenchmarkIndexedSequenceFileCompression(PlusBenchmarkRunner& runner, const std::string& recordedSeqFileName, const std::string& outputDir)
+{
+  const std::string variantNames[] = { "Recorded", "Recorded16Bit" };
+  const PlusIndexedSequenceFile::CompressionType compressions[] = { PlusIndexedSequenceFile::COMPRESSION_ZLIB, PlusIndexedSequenceFile::COMPRESSION_DELTA_ZLIB };
+  bool anySelected = false;
+  for (int variant = 0; variant < 2; ++variant)
+  {
+    for (int compression = 0; compression < 2; ++compression)
+    {
+      std::string benchmarkName = "IndexedSequenceFileWrite/" + variantNames[variant] + "/" + PlusIndexedSequenceFile::GetCompressionTypeAsString(compressions[compression]);
+      if (!runner.IsSelected(benchmarkName))
+      {
+        continue;
+      }
+      anySelected = true;
+      if (recordedSeqFileName.empty())
+      {
+        runner.Skip(benchmarkName, "--recorded-seq-file is required");
+      }
+    }
+  }
+  if (!anySelected || recordedSeqFileName.empty())
+  {
+    return 0;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameLists[2] = { vtkSmartPointer<vtkIGSIOTrackedFrameList>::New(), vtkSmartPointer<vtkIGSIOTrackedFrameList>::New() };
+  if (vtkPlusSequenceIO::Read(recordedSeqFileName, trackedFrameLists[0]) != PLUS_SUCCESS || trackedFrameLists[0]->GetNumberOfTrackedFrames() == 0)
+  {
+    LOG_ERROR("Failed to read recorded frames from " << recordedSeqFileName);
+    return 1;
+  }
+  for (unsigned int frameIndex = 0; frameIndex < trackedFrameLists[0]->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame trackedFrame(*trackedFrameLists[0]->GetTrackedFrame(frameIndex));
+    igsioVideoFrame* image = trackedFrameLists[0]->GetTrackedFrame(frameIndex)->GetImageData();
+    if (!image->IsImageValid() || image->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+    {
+      LOG_ERROR("Frame " << frameIndex << " of " << recordedSeqFileName << " is not an 8-bit image");
+      return 1;
+    }
+    FrameSizeType frameSize = image->GetFrameSize();
+    unsigned int numberOfScalarComponents(1);
+    image->GetNumberOfScalarComponents(numberOfScalarComponents);
+    if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_SHORT, numberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate 16-bit frame of size " << GetFrameSizeAsString(frameSize));
+      return 1;
+    }
+    const unsigned char* pixels = static_cast<const unsigned char*>(image->GetScalarPointer());
+    unsigned short* pixels16Bit = static_cast<unsigned short*>(trackedFrame.GetImageData()->GetScalarPointer());
+    for (unsigned long long i = 0; i < image->GetFrameSizeInBytes(); ++i)
+    {
+      pixels16Bit[i] = static_cast<unsigned short>(pixels[i] * 16);
+    }
+    trackedFrameLists[1]->AddTrackedFrame(&trackedFrame);
+  }
+
+  int numberOfErrors = 0;
+  for (int variant = 0; variant < 2; ++variant)
+  {
+    vtkIGSIOTrackedFrameList* trackedFrameList = trackedFrameLists[variant];
+    const unsigned int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+    double bytesPerIteration = 0;
+    for (unsigned int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      bytesPerIteration += trackedFrameList->GetTrackedFrame(frameIndex)->GetImageData()->GetFrameSizeInBytes();
+    }
+
+    unsigned long fileSizes[2] = { 0, 0 };
+    double medianTimesNs[2] = { 0, 0 };
+    for (int compression = 0; compression < 2; ++compression)
+    {
+      std::string compressionName = PlusIndexedSequenceFile::GetCompressionTypeAsString(compressions[compression]);
+      std::string benchmarkName = "IndexedSequenceFileWrite/" + variantNames[variant] + "/" + compressionName;
+      if (!runner.IsSelected(benchmarkName))
+      {
+        continue;
+      }
+      std::string fileName = outputDir + "/PlusBenchmarks" + variantNames[variant] + compressionName + ".pseq";
+      if (runner.Run(benchmarkName, [&]()
+      {
+        return PlusIndexedSequenceFile::Write(fileName, trackedFrameList, compressions[compression]);
+      }, numberOfFrames, bytesPerIteration) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+        continue;
+      }
+      medianTimesNs[compression] = runner.GetResults().back().MedianTimeNs;
+      fileSizes[compression] = vtksys::SystemTools::FileLength(fileName);
+
+      // The compression is lossless, the frames must be read back unchanged
+      PlusIndexedSequenceFile file;
+      if (file.Open(fileName) != PLUS_SUCCESS || file.GetNumberOfFrames() != numberOfFrames)
+      {
+        LOG_ERROR("Failed to read back " << fileName << " for " << benchmarkName);
+        numberOfErrors++;
+      }
+      std::vector<unsigned char> readPixels;
+      for (unsigned int frameIndex = 0; frameIndex < file.GetNumberOfFrames(); ++frameIndex)
+      {
+        igsioVideoFrame* image = trackedFrameList->GetTrackedFrame(frameIndex)->GetImageData();
+        if (file.ReadFramePixels(frameIndex, readPixels) != PLUS_SUCCESS || readPixels.size() != image->GetFrameSizeInBytes()
+            || memcmp(readPixels.data(), image->GetScalarPointer(), readPixels.size()) != 0)
+        {
+          LOG_ERROR("Frame " << frameIndex << " is changed by writing and reading " << fileName << " for " << benchmarkName);
+          numberOfErrors++;
+          break;
+        }
+      }
+      file.Close();
+      vtksys::SystemTools::RemoveFile(fileName.c_str());
+    }
+
+    if (fileSizes[0] > 0 && fileSizes[1] > 0)
+    {
+      LOG_INFO("IndexedSequenceFileWrite/" << variantNames[variant] << ": " << numberOfFrames << " frames, ZLIB " << fileSizes[0] << " bytes, DELTA_ZLIB "
+               << fileSizes[1] << " bytes (" << std::fixed << std::setprecision(2) << static_cast<double>(fileSizes[0]) / fileSizes[1]
+               << "x smaller), DELTA_ZLIB encode time is " << medianTimesNs[1] / medianTimesNs[0] << "x of ZLIB");
+    }
+  }
+
+  return numberOfErrors;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string filter;
+  std::string outputJsonFileName;
+  std::string outputDir = vtksys::SystemTools::GetCurrentWorkingDirectory();
+  std::string usSimulatorConfigFileName;
+  std::string usSimulatorTransformsSeqFileName;
+  std::string recordedSeqFileName;
+  double minTimeSec(0.5);
+  int numberOfRepetitions(5);
+  int verboseLevel(vtkPlusLogger::LOG_LEVEL_INFO); // results are reported at info level
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--filter", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &filter, "Run only those benchmarks that contain this string in their name (e.g., BufferAddItem).");
+  args.AddArgument("--output-json-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputJsonFileName, "Write results to this file in Google Benchmark JSON format.");
+  args.AddArgument("--output-dir", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputDir, "Directory for temporary files (default: current working directory).");
+  args.AddArgument("--min-time", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &minTimeSec, "Minimum duration of each repetition of a benchmark, in seconds (default: 0.5).");
+  args.AddArgument("--repetitions", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfRepetitions, "Number of repetitions of each benchmark, the median is reported (default: 5).");
+  args.AddArgument("--us-simulator-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &usSimulatorConfigFileName, "Device set configuration file for the ultrasound simulator benchmark.");
+  args.AddArgument("--us-simulator-transforms-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &usSimulatorTransformsSeqFileName, "Sequence file containing the transforms for the ultrasound simulator benchmark.");
+  args.AddArgument("--recorded-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &recordedSeqFileName, "Sequence file of recorded 8-bit frames for the indexed sequence file compression benchmark.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  PlusBenchmarkRunner runner;
+  runner.SetFilter(filter);
+  runner.SetMinTimeSec(minTimeSec);
+  runner.SetNumberOfRepetitions(numberOfRepetitions);
+
+  LOG_INFO("Running benchmarks of " << PlusCommon::GetPlusLibVersionString());
+
+  int numberOfErrors = 0;
+  numberOfErrors += BenchmarkBufferAddItem(runner);
+  numberOfErrors += BenchmarkBufferGetItemUidFromTime(runner);
+  numberOfErrors += BenchmarkBufferGetItemFromTimeInterpolated(runner);
+  numberOfErrors += BenchmarkChannelGetTrackedFrame(runner);
+#ifdef PLUS_USE_OpenIGTLink
+  numberOfErrors += BenchmarkPackMessages(runner);
+#endif
+  numberOfErrors += BenchmarkScanConvertCurvilinear(runner);
+  numberOfErrors += BenchmarkRfToBrightness(runner);
+  numberOfErrors += BenchmarkUsSimulatorAlgo(runner, usSimulatorConfigFileName, usSimulatorTransformsSeqFileName);
+  numberOfErrors += BenchmarkSequenceFile(runner, outputDir);
+  numberOfErrors += BenchmarkIndexedSequenceFileCompression(runner, recordedSeqFileName, outputDir);
+
+  if (runner.GetResults().empty())
+  {
+    LOG_WARNING("No benchmarks were run" << (filter.empty() ? "" : " (no benchmark name contains " + filter + ")"));
+  }
+
+  if (!outputJsonFileName.empty() && runner.WriteResultsToJsonFile(outputJsonFileName) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Benchmarks completed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
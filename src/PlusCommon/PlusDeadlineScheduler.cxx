@@ -0,0 +1,343 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusDeadlineScheduler.h"
+
+#include <vtkIGSIOAccurateTimer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <time.h>
+#endif
+
+namespace
+{
+  // Upper limits of the period error histogram bins (in seconds), the last bin collects all larger errors
+  const double PERIOD_ERROR_BIN_UPPER_LIMITS_SEC[] =
+  {
+    -0.010, -0.005, -0.002, -0.001, -0.0005, -0.0002, -0.0001,
+    0.0001, 0.0002, 0.0005, 0.001, 0.002, 0.005, 0.010
+  };
+  const int NUMBER_OF_PERIOD_ERROR_BINS = sizeof(PERIOD_ERROR_BIN_UPPER_LIMITS_SEC) / sizeof(PERIOD_ERROR_BIN_UPPER_LIMITS_SEC[0]) + 1;
+
+  // If an update starts earlier than this before the deadline (e.g., woken up by an event) then the deadline is kept
+  const double EARLY_UPDATE_TOLERANCE_SEC = 0.001;
+}
+
+const int PlusDeadlineScheduler::MAX_CATCH_UP_PERIODS = 10;
+
+//----------------------------------------------------------------------------
+PlusDeadlineScheduler::PlusDeadlineScheduler()
+  : PeriodSec(1.0 / 30.0)
+  , OverrunPolicy(OVERRUN_SKIP)
+  , NextDeadlineSec(0)
+  , UpdateStartTimeSec(0)
+  , PreviousScheduledUpdateStartTimeSec(0)
+  , EarlyUpdate(false)
+  , HistogramBinUpperLimitsSec(PERIOD_ERROR_BIN_UPPER_LIMITS_SEC, PERIOD_ERROR_BIN_UPPER_LIMITS_SEC + NUMBER_OF_PERIOD_ERROR_BINS - 1)
+  , HistogramBinCounts(new std::atomic<unsigned long long>[NUMBER_OF_PERIOD_ERROR_BINS])
+{
+  this->HistogramBinUpperLimitsSec.push_back(std::numeric_limits<double>::max());
+  this->ResetStatistics();
+}
+
+//----------------------------------------------------------------------------
+PlusDeadlineScheduler::~PlusDeadlineScheduler()
+{
+  delete[] this->HistogramBinCounts;
+  this->HistogramBinCounts = NULL;
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::SetPeriodSec(double periodSec)
+{
+  if (periodSec <= 0)
+  {
+    LOG_ERROR("PlusDeadlineScheduler::SetPeriodSec failed: invalid period " << periodSec);
+    return;
+  }
+  this->PeriodSec = periodSec;
+}
+
+//----------------------------------------------------------------------------
+double PlusDeadlineScheduler::GetPeriodSec() const
+{
+  return this->PeriodSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::SetOverrunPolicy(OverrunPolicyType policy)
+{
+  this->OverrunPolicy = policy;
+}
+
+//----------------------------------------------------------------------------
+PlusDeadlineScheduler::OverrunPolicyType PlusDeadlineScheduler::GetOverrunPolicy() const
+{
+  return this->OverrunPolicy;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusDeadlineScheduler::GetOverrunPolicyFromString(const std::string& policyName, OverrunPolicyType& policy)
+{
+  if (STRCASECMP(policyName.c_str(), "Skip") == 0)
+  {
+    policy = OVERRUN_SKIP;
+    return PLUS_SUCCESS;
+  }
+  if (STRCASECMP(policyName.c_str(), "CatchUp") == 0)
+  {
+    policy = OVERRUN_CATCH_UP;
+    return PLUS_SUCCESS;
+  }
+  LOG_ERROR("Invalid overrun policy: " << policyName << ". Valid values: Skip, CatchUp.");
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusDeadlineScheduler::GetOverrunPolicyAsString(OverrunPolicyType policy)
+{
+  return (policy == OVERRUN_CATCH_UP) ? "CatchUp" : "Skip";
+}
+
+//----------------------------------------------------------------------------
+double PlusDeadlineScheduler::GetMonotonicTimeSec()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::Start()
+{
+  this->NextDeadlineSec = GetMonotonicTimeSec();
+  this->UpdateStartTimeSec = 0;
+  this->PreviousScheduledUpdateStartTimeSec = 0;
+  this->EarlyUpdate = false;
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::BeginUpdate()
+{
+  this->UpdateStartTimeSec = GetMonotonicTimeSec();
+  ++this->NumberOfUpdates;
+  this->EarlyUpdate = (this->UpdateStartTimeSec < this->NextDeadlineSec - EARLY_UPDATE_TOLERANCE_SEC);
+  if (this->EarlyUpdate)
+  {
+    // The update was triggered before the deadline (e.g., by a new input item), it would distort the period statistics
+    ++this->NumberOfEarlyUpdates;
+    return;
+  }
+
+  double previousScheduledUpdateStartTimeSec = this->PreviousScheduledUpdateStartTimeSec;
+  this->PreviousScheduledUpdateStartTimeSec = this->UpdateStartTimeSec;
+  if (previousScheduledUpdateStartTimeSec <= 0)
+  {
+    // First update, there is no period to measure yet
+    return;
+  }
+
+  // Only the updating thread writes the statistics, so load and store do not need to be combined atomically
+  double periodSec = this->UpdateStartTimeSec - previousScheduledUpdateStartTimeSec;
+  double periodErrorSec = periodSec - this->PeriodSec;
+  ++this->NumberOfPeriods;
+  this->PeriodSumSec.store(this->PeriodSumSec.load() + periodSec);
+  this->PeriodSquareSumSec2.store(this->PeriodSquareSumSec2.load() + periodSec * periodSec);
+  if (std::fabs(periodErrorSec) > this->MaxPeriodErrorSec.load())
+  {
+    this->MaxPeriodErrorSec.store(std::fabs(periodErrorSec));
+  }
+  int binIndex = static_cast<int>(std::upper_bound(this->HistogramBinUpperLimitsSec.begin(), this->HistogramBinUpperLimitsSec.end() - 1, periodErrorSec) - this->HistogramBinUpperLimitsSec.begin());
+  ++this->HistogramBinCounts[binIndex];
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::EndUpdate()
+{
+  if (this->EarlyUpdate)
+  {
+    // The update was triggered before the deadline, the deadline is still valid
+    return;
+  }
+
+  this->NextDeadlineSec += this->PeriodSec;
+  double nowSec = GetMonotonicTimeSec();
+  if (nowSec < this->NextDeadlineSec)
+  {
+    return;
+  }
+
+  // The update finished after the next deadline
+  ++this->NumberOfOverruns;
+  unsigned long long numberOfMissedDeadlines = static_cast<unsigned long long>(std::floor((nowSec - this->NextDeadlineSec) / this->PeriodSec)) + 1;
+  if (this->OverrunPolicy == OVERRUN_CATCH_UP && numberOfMissedDeadlines <= static_cast<unsigned long long>(MAX_CATCH_UP_PERIODS))
+  {
+    // The deadline is in the past, so the next update starts without waiting
+    return;
+  }
+  this->NextDeadlineSec += numberOfMissedDeadlines * this->PeriodSec;
+  this->NumberOfSkippedDeadlines += numberOfMissedDeadlines;
+}
+
+//----------------------------------------------------------------------------
+double PlusDeadlineScheduler::GetTimeUntilNextDeadlineSec() const
+{
+  return std::max(0.0, this->NextDeadlineSec - GetMonotonicTimeSec());
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::SleepUntilNextDeadline() const
+{
+#if defined(__linux__)
+  // std::chrono::steady_clock uses CLOCK_MONOTONIC on Linux, so the deadline can be used as an absolute wakeup time
+  timespec deadline;
+  double deadlineSeconds = std::floor(this->NextDeadlineSec);
+  deadline.tv_sec = static_cast<time_t>(deadlineSeconds);
+  deadline.tv_nsec = static_cast<long>((this->NextDeadlineSec - deadlineSeconds) * 1e9);
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+  {
+    // Interrupted by a signal, continue waiting until the same deadline
+  }
+#else
+  double remainingTimeSec = this->GetTimeUntilNextDeadlineSec();
+  if (remainingTimeSec > 0)
+  {
+    vtkIGSIOAccurateTimer::Delay(remainingTimeSec);
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::ResetStatistics()
+{
+  this->NumberOfUpdates = 0;
+  this->NumberOfEarlyUpdates = 0;
+  this->NumberOfPeriods = 0;
+  this->NumberOfOverruns = 0;
+  this->NumberOfSkippedDeadlines = 0;
+  this->PeriodSumSec = 0;
+  this->PeriodSquareSumSec2 = 0;
+  this->MaxPeriodErrorSec = 0;
+  for (int i = 0; i < NUMBER_OF_PERIOD_ERROR_BINS; ++i)
+  {
+    this->HistogramBinCounts[i] = 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusDeadlineScheduler::GetNumberOfUpdates() const
+{
+  return this->NumberOfUpdates;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusDeadlineScheduler::GetNumberOfEarlyUpdates() const
+{
+  return this->NumberOfEarlyUpdates;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusDeadlineScheduler::GetNumberOfOverruns() const
+{
+  return this->NumberOfOverruns;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusDeadlineScheduler::GetNumberOfSkippedDeadlines() const
+{
+  return this->NumberOfSkippedDeadlines;
+}
+
+//----------------------------------------------------------------------------
+double PlusDeadlineScheduler::GetMeanPeriodSec() const
+{
+  unsigned long long numberOfPeriods = this->NumberOfPeriods;
+  if (numberOfPeriods == 0)
+  {
+    return 0;
+  }
+  return this->PeriodSumSec / numberOfPeriods;
+}
+
+//----------------------------------------------------------------------------
+double PlusDeadlineScheduler::GetPeriodJitterSec() const
+{
+  unsigned long long numberOfPeriods = this->NumberOfPeriods;
+  if (numberOfPeriods == 0)
+  {
+    return 0;
+  }
+  double meanPeriodSec = this->PeriodSumSec / numberOfPeriods;
+  return std::sqrt(std::max(0.0, this->PeriodSquareSumSec2 / numberOfPeriods - meanPeriodSec * meanPeriodSec));
+}
+
+//----------------------------------------------------------------------------
+double PlusDeadlineScheduler::GetMaxPeriodErrorSec() const
+{
+  return this->MaxPeriodErrorSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusDeadlineScheduler::GetPeriodErrorHistogram(std::vector<double>& binUpperLimitsSec, std::vector<unsigned long long>& binCounts) const
+{
+  binUpperLimitsSec = this->HistogramBinUpperLimitsSec;
+  binCounts.resize(NUMBER_OF_PERIOD_ERROR_BINS);
+  for (int i = 0; i < NUMBER_OF_PERIOD_ERROR_BINS; ++i)
+  {
+    binCounts[i] = this->HistogramBinCounts[i];
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string PlusDeadlineScheduler::GetStatisticsAsString() const
+{
+  std::ostringstream str;
+  double meanPeriodSec = this->GetMeanPeriodSec();
+  str << std::fixed << std::setprecision(1) << "update rate: " << (meanPeriodSec > 0 ? 1.0 / meanPeriodSec : 0.0) << " Hz (requested: " << 1.0 / this->PeriodSec << " Hz)"
+      << std::setprecision(3) << ", period jitter (std. dev.): " << this->GetPeriodJitterSec() * 1000.0 << " ms"
+      << ", max period error: " << this->GetMaxPeriodErrorSec() * 1000.0 << " ms";
+
+  // Fraction of updates where the period error was within +-0.1 ms and within +-1 ms
+  std::vector<double> binUpperLimitsSec;
+  std::vector<unsigned long long> binCounts;
+  this->GetPeriodErrorHistogram(binUpperLimitsSec, binCounts);
+  unsigned long long numberOfPeriods(0);
+  unsigned long long numberOfPeriodsWithin100us(0);
+  unsigned long long numberOfPeriodsWithin1ms(0);
+  for (size_t i = 0; i < binCounts.size(); ++i)
+  {
+    numberOfPeriods += binCounts[i];
+    double binLowerLimitSec = (i > 0) ? binUpperLimitsSec[i - 1] : -std::numeric_limits<double>::max();
+    if (binLowerLimitSec >= -0.0001 - 1e-9 && binUpperLimitsSec[i] <= 0.0001 + 1e-9)
+    {
+      numberOfPeriodsWithin100us += binCounts[i];
+    }
+    if (binLowerLimitSec >= -0.001 - 1e-9 && binUpperLimitsSec[i] <= 0.001 + 1e-9)
+    {
+      numberOfPeriodsWithin1ms += binCounts[i];
+    }
+  }
+  if (numberOfPeriods > 0)
+  {
+    str << std::setprecision(1) << ", within 0.1 ms: " << 100.0 * numberOfPeriodsWithin100us / numberOfPeriods << "%"
+        << ", within 1 ms: " << 100.0 * numberOfPeriodsWithin1ms / numberOfPeriods << "%";
+  }
+  str << ", overruns: " << this->GetNumberOfOverruns() << ", skipped deadlines: " << this->GetNumberOfSkippedDeadlines()
+      << " (" << this->GetNumberOfUpdates() << " updates, " << this->GetNumberOfEarlyUpdates() << " early updates)";
+  return str.str();
+}
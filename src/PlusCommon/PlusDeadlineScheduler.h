@@ -0,0 +1,143 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusDeadlineScheduler_h
+#define __PlusDeadlineScheduler_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusDeadlineScheduler
+  \brief Schedules periodic updates at absolute deadlines and collects statistics of the achieved update period
+
+  The deadlines are multiples of the period from the start time, so a late update does not shift the later updates
+  (as it happens if the waiting time is computed from the end of the previous update). If an update finishes after
+  the next deadline then the overrun policy determines what happens:
+  - OVERRUN_SKIP: the missed deadlines are skipped, the next update is at the next deadline in the future
+  - OVERRUN_CATCH_UP: the missed updates are performed without waiting (at most MAX_CATCH_UP_PERIODS, then the missed deadlines are skipped)
+
+  Usage: call Start() once, then in each cycle BeginUpdate(), perform the update, EndUpdate(), and SleepUntilNextDeadline()
+  (or wait for an event with GetTimeUntilNextDeadlineSec() timeout).
+
+  The difference between the measured and the requested update period is collected in a histogram.
+  Updates that start before the deadline (e.g., woken up by a new input item) are counted as early updates
+  and are not included in the period statistics, which measure the time between the deadline-driven updates.
+  The statistics are written by the updating thread only and can be read from any thread.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusDeadlineScheduler
+{
+public:
+  enum OverrunPolicyType
+  {
+    OVERRUN_SKIP,
+    OVERRUN_CATCH_UP
+  };
+
+  /*! Maximum number of missed updates that are performed without waiting in OVERRUN_CATCH_UP mode */
+  static const int MAX_CATCH_UP_PERIODS;
+
+  PlusDeadlineScheduler();
+  virtual ~PlusDeadlineScheduler();
+
+  /*! Set the requested update period in seconds */
+  void SetPeriodSec(double periodSec);
+  double GetPeriodSec() const;
+
+  void SetOverrunPolicy(OverrunPolicyType policy);
+  OverrunPolicyType GetOverrunPolicy() const;
+
+  /*! Convert policy name (Skip, CatchUp; case insensitive) to policy value */
+  static PlusStatus GetOverrunPolicyFromString(const std::string& policyName, OverrunPolicyType& policy);
+  static std::string GetOverrunPolicyAsString(OverrunPolicyType policy);
+
+  /*! Start scheduling, the first deadline is the current time */
+  void Start();
+
+  /*! Call at the beginning of each update: records the time since the previous deadline-driven update, or counts an early update */
+  void BeginUpdate();
+
+  /*! Call at the end of each update: determines the next deadline */
+  void EndUpdate();
+
+  /*! Get the time until the next deadline in seconds (0 if the deadline has already passed) */
+  double GetTimeUntilNextDeadlineSec() const;
+
+  /*! Block the calling thread until the next deadline (returns immediately if the deadline has already passed) */
+  void SleepUntilNextDeadline() const;
+
+  /*! Reset the update period statistics */
+  void ResetStatistics();
+
+  /*! Number of updates since the statistics were reset */
+  unsigned long long GetNumberOfUpdates() const;
+
+  /*! Number of updates that started before the deadline (not included in the period statistics) */
+  unsigned long long GetNumberOfEarlyUpdates() const;
+
+  /*! Number of updates that finished after the next deadline */
+  unsigned long long GetNumberOfOverruns() const;
+
+  /*! Number of deadlines that were skipped because of overruns */
+  unsigned long long GetNumberOfSkippedDeadlines() const;
+
+  /*! Mean of the measured update period in seconds (0 if there are less than two updates) */
+  double GetMeanPeriodSec() const;
+
+  /*! Standard deviation of the measured update period in seconds */
+  double GetPeriodJitterSec() const;
+
+  /*! Largest absolute difference between the measured and the requested update period in seconds */
+  double GetMaxPeriodErrorSec() const;
+
+  /*!
+    Get the histogram of the period error (measured minus requested update period)
+    \param binUpperLimitsSec Upper limit of each bin in seconds, the last bin has no upper limit (its limit is set to a very large value)
+    \param binCounts Number of updates in each bin
+  */
+  void GetPeriodErrorHistogram(std::vector<double>& binUpperLimitsSec, std::vector<unsigned long long>& binCounts) const;
+
+  /*! Get a one-line summary of the statistics that can be written to the log */
+  std::string GetStatisticsAsString() const;
+
+protected:
+  /*! Get the current time from a monotonic clock, in seconds */
+  static double GetMonotonicTimeSec();
+
+  double PeriodSec;
+  OverrunPolicyType OverrunPolicy;
+
+  /*! Times are in the monotonic clock (GetMonotonicTimeSec) */
+  double NextDeadlineSec;
+  double UpdateStartTimeSec;
+  /*! Start time of the last update that was not an early update, 0 if there was no such update yet */
+  double PreviousScheduledUpdateStartTimeSec;
+  /*! True if the current update started before the deadline */
+  bool EarlyUpdate;
+
+  std::atomic<unsigned long long> NumberOfUpdates;
+  std::atomic<unsigned long long> NumberOfEarlyUpdates;
+  std::atomic<unsigned long long> NumberOfPeriods;
+  std::atomic<unsigned long long> NumberOfOverruns;
+  std::atomic<unsigned long long> NumberOfSkippedDeadlines;
+  std::atomic<double> PeriodSumSec;
+  std::atomic<double> PeriodSquareSumSec2;
+  std::atomic<double> MaxPeriodErrorSec;
+  std::vector<double> HistogramBinUpperLimitsSec;
+  std::atomic<unsigned long long>* HistogramBinCounts;
+
+private:
+  PlusDeadlineScheduler(const PlusDeadlineScheduler&);
+  void operator=(const PlusDeadlineScheduler&);
+};
+
+#endif
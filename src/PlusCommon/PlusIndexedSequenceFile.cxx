@@ -0,0 +1,1084 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIndexedSequenceFile.h"
+#include "PlusThreadPool.h"
+
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkLZ4DataCompressor.h>
+#include <vtkSmartPointer.h>
+
+#include <vtk_zlib.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+  const char FILE_MAGIC[8] = { 'P', 'L', 'U', 'S', 'S', 'E', 'Q', '\0' };
+  const char INDEX_MAGIC[8] = { 'P', 'L', 'U', 'S', 'I', 'D', 'X', '\0' };
+  const unsigned int FORMAT_VERSION = 1;
+  // Magic string and version
+  const unsigned long long FILE_HEADER_SIZE = 8 + 4;
+  // Index offset, index size and magic string
+  const unsigned long long TRAILER_SIZE = 8 + 8 + 8;
+  const char* INDEXED_SEQUENCE_FILE_EXTENSION = ".pseq";
+  const unsigned int DEFAULT_KEY_FRAME_INTERVAL = 30;
+  const unsigned int INVALID_FRAME_INDEX = std::numeric_limits<unsigned int>::max();
+
+  //----------------------------------------------------------------------------
+  void AppendUInt32(std::vector<unsigned char>& buffer, unsigned int value)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendUInt64(std::vector<unsigned char>& buffer, unsigned long long value)
+  {
+    for (int i = 0; i < 8; ++i)
+    {
+      buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendDouble(std::vector<unsigned char>& buffer, double value)
+  {
+    unsigned long long bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    AppendUInt64(buffer, bits);
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendString(std::vector<unsigned char>& buffer, const std::string& value)
+  {
+    AppendUInt32(buffer, static_cast<unsigned int>(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+  }
+
+  //----------------------------------------------------------------------------
+  // Subtract (or add, if subtract is false) the scalars of two frames. Scalars are treated as unsigned integers of the same size,
+  // so the result is modulo 2^(number of bits) and the operation is lossless for any pixel type.
+  template<typename ScalarType>
+  void CombineScalars(unsigned char* result, const unsigned char* data, const unsigned char* referenceData, size_t sizeBytes, bool subtract)
+  {
+    for (size_t i = 0; i + sizeof(ScalarType) <= sizeBytes; i += sizeof(ScalarType))
+    {
+      // memcpy, as frame data is not necessarily aligned to the scalar size
+      ScalarType value;
+      ScalarType referenceValue;
+      memcpy(&value, data + i, sizeof(ScalarType));
+      memcpy(&referenceValue, referenceData + i, sizeof(ScalarType));
+      value = static_cast<ScalarType>(subtract ? value - referenceValue : value + referenceValue);
+      memcpy(result + i, &value, sizeof(ScalarType));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // The difference is computed for each scalar (not for each byte), because the difference of multi-byte scalars
+  // (e.g., 16-bit pixels) is small only if the carry is propagated between the bytes of the scalar.
+  void CombineFrames(unsigned char* result, const unsigned char* data, const unsigned char* referenceData, size_t sizeBytes,
+                     unsigned int bytesPerScalar, bool subtract)
+  {
+    switch (bytesPerScalar)
+    {
+      case 2:
+        CombineScalars<unsigned short>(result, data, referenceData, sizeBytes, subtract);
+        break;
+      case 4:
+        CombineScalars<unsigned int>(result, data, referenceData, sizeBytes, subtract);
+        break;
+      case 8:
+        CombineScalars<unsigned long long>(result, data, referenceData, sizeBytes, subtract);
+        break;
+      default:
+        CombineScalars<unsigned char>(result, data, referenceData, sizeBytes, subtract);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Compress frame data. Returns false if compression failed. Thread-safe.
+    \param referenceData Data of the previous frame, required for COMPRESSION_DELTA_ZLIB
+    \param bytesPerScalar Size of a pixel scalar value, the difference from the previous frame is computed for each scalar
+  */
+  bool CompressFrameData(PlusIndexedSequenceFile::CompressionType compression, const std::vector<unsigned char>& data,
+                         const std::vector<unsigned char>* referenceData, unsigned int bytesPerScalar, std::vector<unsigned char>& compressedData)
+  {
+    if (compression == PlusIndexedSequenceFile::COMPRESSION_DELTA_ZLIB)
+    {
+      if (referenceData == NULL || referenceData->size() != data.size())
+      {
+        return false;
+      }
+      std::vector<unsigned char> difference(data.size());
+      CombineFrames(difference.data(), data.data(), referenceData->data(), data.size(), bytesPerScalar, true);
+      return CompressFrameData(PlusIndexedSequenceFile::COMPRESSION_ZLIB, difference, NULL, bytesPerScalar, compressedData);
+    }
+    if (compression == PlusIndexedSequenceFile::COMPRESSION_ZLIB)
+    {
+      uLongf compressedSize = compressBound(static_cast<uLong>(data.size()));
+      compressedData.resize(compressedSize);
+      if (compress2(compressedData.data(), &compressedSize, data.data(), static_cast<uLong>(data.size()), Z_BEST_SPEED) != Z_OK)
+      {
+        return false;
+      }
+      compressedData.resize(compressedSize);
+      return true;
+    }
+    if (compression == PlusIndexedSequenceFile::COMPRESSION_LZ4)
+    {
+      // Compressor objects are not shared between threads
+      vtkSmartPointer<vtkLZ4DataCompressor> compressor = vtkSmartPointer<vtkLZ4DataCompressor>::New();
+      compressedData.resize(compressor->GetMaximumCompressionSpace(data.size()));
+      size_t compressedSize = compressor->Compress(data.data(), data.size(), compressedData.data(), compressedData.size());
+      if (compressedSize == 0)
+      {
+        return false;
+      }
+      compressedData.resize(compressedSize);
+      return true;
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned long long DecodeUInt64(const unsigned char* data)
+  {
+    unsigned long long value = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+      value = (value << 8) | data[i];
+    }
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Reads values from a serialized index. Reading past the end sets the error flag and returns zero values. */
+  class IndexDataReader
+  {
+  public:
+    IndexDataReader(const std::vector<unsigned char>& data)
+      : Data(data)
+      , Position(0)
+      , Error(false)
+    {
+    }
+
+    unsigned int ReadUInt32()
+    {
+      if (!this->CanRead(4))
+      {
+        return 0;
+      }
+      unsigned int value = 0;
+      for (int i = 3; i >= 0; --i)
+      {
+        value = (value << 8) | this->Data[this->Position + i];
+      }
+      this->Position += 4;
+      return value;
+    }
+
+    unsigned long long ReadUInt64()
+    {
+      if (!this->CanRead(8))
+      {
+        return 0;
+      }
+      unsigned long long value = DecodeUInt64(&this->Data[this->Position]);
+      this->Position += 8;
+      return value;
+    }
+
+    double ReadDouble()
+    {
+      unsigned long long bits = this->ReadUInt64();
+      double value = 0;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+
+    std::string ReadString()
+    {
+      unsigned int length = this->ReadUInt32();
+      if (!this->CanRead(length))
+      {
+        return std::string();
+      }
+      std::string value(reinterpret_cast<const char*>(&this->Data[this->Position]), length);
+      this->Position += length;
+      return value;
+    }
+
+    bool HasError() const
+    {
+      return this->Error;
+    }
+
+  protected:
+    bool CanRead(size_t numberOfBytes)
+    {
+      if (this->Error || this->Data.size() - this->Position < numberOfBytes)
+      {
+        this->Error = true;
+        return false;
+      }
+      return true;
+    }
+
+    const std::vector<unsigned char>& Data;
+    size_t Position;
+    bool Error;
+  };
+}
+
+//----------------------------------------------------------------------------
+struct PlusIndexedSequenceFile::PendingFrame
+{
+  PendingFrame()
+    : Data(std::make_shared<std::vector<unsigned char> >())
+    , Compression(COMPRESSION_NONE)
+    , Compressed(false)
+  {
+  }
+
+  FrameInfo Info;
+  /*! Uncompressed pixel data, shared with the compression task of the next frame if that is delta encoded */
+  std::shared_ptr<std::vector<unsigned char> > Data;
+  /*! Compression method of CompressedData */
+  CompressionType Compression;
+  std::vector<unsigned char> CompressedData;
+  /*! Set by the compression task if compression succeeded */
+  bool Compressed;
+  PlusThreadPool::TaskGroup CompressionTasks;
+};
+
+//----------------------------------------------------------------------------
+PlusIndexedSequenceFile::PlusIndexedSequenceFile()
+  : DecodedFrameIndex(INVALID_FRAME_INDEX)
+  , OutputCompression(COMPRESSION_NONE)
+  , OutputDataOffset(0)
+  , KeyFrameInterval(DEFAULT_KEY_FRAME_INTERVAL)
+  , NumberOfFramesSinceKeyFrame(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIndexedSequenceFile::~PlusIndexedSequenceFile()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIndexedSequenceFile::IsIndexedSequenceFileName(const std::string& fileName)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(fileName));
+  return extension == INDEXED_SEQUENCE_FILE_EXTENSION;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::GetCompressionTypeFromString(const std::string& name, CompressionType& compression)
+{
+  std::string upperCaseName = vtksys::SystemTools::UpperCase(name);
+  if (upperCaseName == "NONE")
+  {
+    compression = COMPRESSION_NONE;
+  }
+  else if (upperCaseName == "ZLIB" || upperCaseName == "GZIP")
+  {
+    compression = COMPRESSION_ZLIB;
+  }
+  else if (upperCaseName == "LZ4")
+  {
+    compression = COMPRESSION_LZ4;
+  }
+  else if (upperCaseName == "DELTA_ZLIB")
+  {
+    compression = COMPRESSION_DELTA_ZLIB;
+  }
+  else
+  {
+    LOG_ERROR("Unknown compression type: " << name << ". Valid values: NONE, ZLIB, LZ4, DELTA_ZLIB.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIndexedSequenceFile::GetCompressionTypeAsString(CompressionType compression)
+{
+  switch (compression)
+  {
+    case COMPRESSION_NONE:
+      return "NONE";
+    case COMPRESSION_ZLIB:
+      return "ZLIB";
+    case COMPRESSION_LZ4:
+      return "LZ4";
+    case COMPRESSION_DELTA_ZLIB:
+      return "DELTA_ZLIB";
+  }
+  return "UNKNOWN";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::Write(const std::string& fileName, vtkIGSIOTrackedFrameList* trackedFrameList, bool useCompression/*=true*/, bool enableImageDataWrite/*=true*/)
+{
+  return PlusIndexedSequenceFile::Write(fileName, trackedFrameList, useCompression ? COMPRESSION_ZLIB : COMPRESSION_NONE, enableImageDataWrite);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::Write(const std::string& fileName, vtkIGSIOTrackedFrameList* trackedFrameList, CompressionType compression, bool enableImageDataWrite/*=true*/)
+{
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::Write failed: invalid tracked frame list");
+    return PLUS_FAIL;
+  }
+
+  PlusIndexedSequenceFile file;
+  if (file.Create(fileName, compression) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  std::vector<std::string> customFieldNames;
+  trackedFrameList->GetCustomFieldNameList(customFieldNames);
+  for (std::vector<std::string>::iterator fieldIt = customFieldNames.begin(); fieldIt != customFieldNames.end(); ++fieldIt)
+  {
+    file.SetCustomField(*fieldIt, trackedFrameList->GetCustomString(*fieldIt));
+  }
+  if (file.AppendFrames(trackedFrameList, enableImageDataWrite) != PLUS_SUCCESS)
+  {
+    file.Discard();
+    return PLUS_FAIL;
+  }
+  return file.Finalize();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::Create(const std::string& fileName, CompressionType compression)
+{
+  this->Close();
+
+  this->OutputFile.open(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->OutputFile.is_open())
+  {
+    LOG_ERROR("Failed to open indexed sequence file for writing: " << fileName);
+    return PLUS_FAIL;
+  }
+  this->OutputFileName = fileName;
+  this->OutputCompression = compression;
+  this->ReferenceFrameData.reset();
+  this->NumberOfFramesSinceKeyFrame = 0;
+
+  std::vector<unsigned char> header(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC));
+  AppendUInt32(header, FORMAT_VERSION);
+  this->OutputFile.write(reinterpret_cast<const char*>(header.data()), header.size());
+  this->OutputDataOffset = FILE_HEADER_SIZE;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::AppendFrames(vtkIGSIOTrackedFrameList* trackedFrameList, bool enableImageDataWrite/*=true*/)
+{
+  if (!this->OutputFile.is_open())
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::AppendFrames failed: no file is being written");
+    return PLUS_FAIL;
+  }
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::AppendFrames failed: invalid tracked frame list");
+    return PLUS_FAIL;
+  }
+
+  for (unsigned int frameIndex = 0; frameIndex < trackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(frameIndex);
+    igsioVideoFrame* image = trackedFrame->GetImageData();
+
+    PendingFrame* pendingFrame = new PendingFrame;
+    FrameInfo& frameInfo = pendingFrame->Info;
+    frameInfo.DataOffset = 0;
+    frameInfo.DataSize = 0;
+    frameInfo.Timestamp = trackedFrame->GetTimestamp();
+    frameInfo.HasImage = enableImageDataWrite && image->IsImageValid();
+    frameInfo.Compression = COMPRESSION_NONE;
+    frameInfo.FrameSize[0] = frameInfo.FrameSize[1] = frameInfo.FrameSize[2] = 0;
+    frameInfo.PixelType = VTK_VOID;
+    frameInfo.NumberOfScalarComponents = 0;
+    frameInfo.ImageType = US_IMG_TYPE_XX;
+    frameInfo.ImageOrientation = US_IMG_ORIENT_XX;
+    frameInfo.Fields = trackedFrame->GetFrameFields();
+    if (frameInfo.HasImage)
+    {
+      if (image->IsFrameEncoded())
+      {
+        LOG_ERROR("Failed to write indexed sequence file " << this->OutputFileName << ": frame " << this->Frames.size() + this->PendingFrames.size()
+                  << " is encoded, only raw pixel data can be stored");
+        delete pendingFrame;
+        return PLUS_FAIL;
+      }
+      image->GetFrameSize(frameInfo.FrameSize);
+      frameInfo.PixelType = image->GetVTKScalarPixelType();
+      image->GetNumberOfScalarComponents(frameInfo.NumberOfScalarComponents);
+      frameInfo.ImageType = image->GetImageType();
+      frameInfo.ImageOrientation = image->GetImageOrientation();
+
+      const unsigned char* frameData = static_cast<const unsigned char*>(image->GetScalarPointer());
+      unsigned long long frameDataSize = image->GetFrameSizeInBytes();
+      if (this->PendingFrames.empty() && (this->OutputCompression == COMPRESSION_NONE || frameDataSize == 0))
+      {
+        // Nothing to wait for, the data can be written immediately without copying
+        PlusStatus status = this->WriteFrameData(frameInfo, frameData, frameDataSize, COMPRESSION_NONE);
+        delete pendingFrame;
+        this->ReferenceFrameData.reset();
+        if (status != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+        continue;
+      }
+
+      // The frame may be deleted before the data is written, therefore a copy is made
+      pendingFrame->Data->assign(frameData, frameData + frameDataSize);
+      pendingFrame->Compression = this->OutputCompression;
+      std::shared_ptr<const std::vector<unsigned char> > referenceData;
+      if (this->OutputCompression == COMPRESSION_DELTA_ZLIB)
+      {
+        if (this->ReferenceFrameData && this->ReferenceFrameData->size() == frameDataSize && this->NumberOfFramesSinceKeyFrame + 1 < this->KeyFrameInterval)
+        {
+          referenceData = this->ReferenceFrameData;
+          this->NumberOfFramesSinceKeyFrame++;
+        }
+        else
+        {
+          // Key frame
+          pendingFrame->Compression = COMPRESSION_ZLIB;
+          this->NumberOfFramesSinceKeyFrame = 0;
+        }
+        this->ReferenceFrameData = pendingFrame->Data;
+      }
+      if (pendingFrame->Compression != COMPRESSION_NONE && frameDataSize > 0)
+      {
+        unsigned int bytesPerScalar = igsioVideoFrame::GetNumberOfBytesPerScalar(frameInfo.PixelType);
+        pendingFrame->CompressionTasks.Submit([pendingFrame, referenceData, bytesPerScalar]()
+        {
+          pendingFrame->Compressed = CompressFrameData(pendingFrame->Compression, *pendingFrame->Data, referenceData.get(), bytesPerScalar, pendingFrame->CompressedData);
+        });
+      }
+    }
+    else
+    {
+      // The frame after a frame without image is a key frame
+      this->ReferenceFrameData.reset();
+    }
+    this->PendingFrames.push_back(pendingFrame);
+
+    if (this->WritePendingFrames(false) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::WritePendingFrames(bool waitForAll)
+{
+  // Limit the number of frames in progress, to limit the memory usage when the disk or the compression is slower than the acquisition
+  const size_t maxNumberOfFramesInProgress = 2 * PlusThreadPool::GetInstance()->GetNumberOfThreads();
+
+  PlusStatus status = PLUS_SUCCESS;
+  while (!this->PendingFrames.empty())
+  {
+    PendingFrame* pendingFrame = this->PendingFrames.front();
+    if (pendingFrame->CompressionTasks.GetNumberOfPendingTasks() > 0)
+    {
+      if (!waitForAll && this->PendingFrames.size() <= maxNumberOfFramesInProgress)
+      {
+        break;
+      }
+      pendingFrame->CompressionTasks.Wait();
+    }
+    this->PendingFrames.pop_front();
+
+    // Frames that cannot be compressed (e.g., noise) are stored uncompressed
+    if (pendingFrame->Compressed && pendingFrame->CompressedData.size() < pendingFrame->Data->size())
+    {
+      status = this->WriteFrameData(pendingFrame->Info, pendingFrame->CompressedData.data(), pendingFrame->CompressedData.size(), pendingFrame->Compression);
+    }
+    else
+    {
+      status = this->WriteFrameData(pendingFrame->Info, pendingFrame->Data->data(), pendingFrame->Data->size(), COMPRESSION_NONE);
+    }
+    delete pendingFrame;
+    if (status != PLUS_SUCCESS)
+    {
+      break;
+    }
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::WriteFrameData(FrameInfo& frameInfo, const unsigned char* data, unsigned long long dataSize, CompressionType compression)
+{
+  frameInfo.DataOffset = this->OutputDataOffset;
+  frameInfo.DataSize = dataSize;
+  frameInfo.Compression = compression;
+  if (dataSize > 0)
+  {
+    this->OutputFile.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(dataSize));
+    if (this->OutputFile.fail())
+    {
+      LOG_ERROR("Failed to write frame data to indexed sequence file " << this->OutputFileName);
+      return PLUS_FAIL;
+    }
+  }
+  this->OutputDataOffset += dataSize;
+  this->Frames.push_back(frameInfo);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIndexedSequenceFile::SetKeyFrameInterval(unsigned int interval)
+{
+  if (interval < 1)
+  {
+    LOG_WARNING("Key frame interval must be at least 1. Using 1 instead of " << interval << ".");
+    interval = 1;
+  }
+  this->KeyFrameInterval = interval;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIndexedSequenceFile::GetKeyFrameInterval() const
+{
+  return this->KeyFrameInterval;
+}
+
+//----------------------------------------------------------------------------
+void PlusIndexedSequenceFile::SetCustomField(const std::string& fieldName, const std::string& fieldValue)
+{
+  this->CustomFields[fieldName] = std::make_pair(FRAMEFIELD_NONE, fieldValue);
+}
+
+//----------------------------------------------------------------------------
+void PlusIndexedSequenceFile::SerializeIndex(std::vector<unsigned char>& index) const
+{
+  index.clear();
+  AppendUInt32(index, static_cast<unsigned int>(this->CustomFields.size()));
+  for (igsioFieldMapType::const_iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+  {
+    AppendString(index, fieldIt->first);
+    AppendString(index, fieldIt->second.second);
+  }
+
+  AppendUInt64(index, this->Frames.size());
+  for (std::vector<FrameInfo>::const_iterator frameIt = this->Frames.begin(); frameIt != this->Frames.end(); ++frameIt)
+  {
+    AppendUInt64(index, frameIt->DataOffset);
+    AppendUInt64(index, frameIt->DataSize);
+    AppendDouble(index, frameIt->Timestamp);
+    AppendUInt32(index, frameIt->HasImage ? 1 : 0);
+    AppendUInt32(index, frameIt->Compression);
+    AppendUInt32(index, frameIt->FrameSize[0]);
+    AppendUInt32(index, frameIt->FrameSize[1]);
+    AppendUInt32(index, frameIt->FrameSize[2]);
+    AppendUInt32(index, static_cast<unsigned int>(frameIt->PixelType));
+    AppendUInt32(index, frameIt->NumberOfScalarComponents);
+    AppendUInt32(index, static_cast<unsigned int>(frameIt->ImageType));
+    AppendUInt32(index, static_cast<unsigned int>(frameIt->ImageOrientation));
+    AppendUInt32(index, static_cast<unsigned int>(frameIt->Fields.size()));
+    for (igsioFieldMapType::const_iterator fieldIt = frameIt->Fields.begin(); fieldIt != frameIt->Fields.end(); ++fieldIt)
+    {
+      AppendString(index, fieldIt->first);
+      AppendString(index, fieldIt->second.second);
+      AppendUInt32(index, static_cast<unsigned int>(fieldIt->second.first));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::Finalize()
+{
+  if (!this->OutputFile.is_open())
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::Finalize failed: no file is being written");
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = this->WritePendingFrames(true);
+  if (status == PLUS_SUCCESS)
+  {
+    std::vector<unsigned char> index;
+    this->SerializeIndex(index);
+    std::vector<unsigned char> trailer;
+    AppendUInt64(trailer, this->OutputDataOffset);
+    AppendUInt64(trailer, index.size());
+    trailer.insert(trailer.end(), INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+    this->OutputFile.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size()));
+    this->OutputFile.write(reinterpret_cast<const char*>(trailer.data()), static_cast<std::streamsize>(trailer.size()));
+    this->OutputFile.close();
+    if (this->OutputFile.fail())
+    {
+      LOG_ERROR("Failed to write indexed sequence file: " << this->OutputFileName);
+      status = PLUS_FAIL;
+    }
+  }
+  else
+  {
+    this->Discard();
+  }
+
+  this->Close();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void PlusIndexedSequenceFile::Discard()
+{
+  for (std::deque<PendingFrame*>::iterator frameIt = this->PendingFrames.begin(); frameIt != this->PendingFrames.end(); ++frameIt)
+  {
+    (*frameIt)->CompressionTasks.Wait();
+    delete *frameIt;
+  }
+  this->PendingFrames.clear();
+  if (this->OutputFile.is_open())
+  {
+    this->OutputFile.close();
+    vtksys::SystemTools::RemoveFile(this->OutputFileName);
+  }
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIndexedSequenceFile::IsWriting() const
+{
+  return this->OutputFile.is_open();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::Open(const std::string& fileName)
+{
+  this->Close();
+
+  this->File.open(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!this->File.is_open())
+  {
+    LOG_ERROR("Failed to open indexed sequence file: " << fileName);
+    return PLUS_FAIL;
+  }
+
+  this->File.seekg(0, std::ios::end);
+  unsigned long long fileSize = static_cast<unsigned long long>(this->File.tellg());
+  if (fileSize < FILE_HEADER_SIZE + TRAILER_SIZE)
+  {
+    LOG_ERROR("Failed to open indexed sequence file " << fileName << ": file is too short");
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  unsigned char header[FILE_HEADER_SIZE];
+  this->File.seekg(0, std::ios::beg);
+  this->File.read(reinterpret_cast<char*>(header), FILE_HEADER_SIZE);
+  if (memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+  {
+    LOG_ERROR("Failed to open indexed sequence file " << fileName << ": not a Plus indexed sequence file");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  unsigned int version = header[8] | (header[9] << 8) | (header[10] << 16) | (header[11] << 24);
+  if (version > FORMAT_VERSION)
+  {
+    LOG_ERROR("Failed to open indexed sequence file " << fileName << ": format version " << version << " is not supported (latest supported version: " << FORMAT_VERSION << ")");
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  unsigned char trailer[TRAILER_SIZE];
+  this->File.seekg(static_cast<std::streamoff>(fileSize - TRAILER_SIZE), std::ios::beg);
+  this->File.read(reinterpret_cast<char*>(trailer), TRAILER_SIZE);
+  unsigned long long indexOffset = DecodeUInt64(trailer);
+  unsigned long long indexSize = DecodeUInt64(trailer + 8);
+  if (!this->File.good() || memcmp(trailer + 16, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+      || indexOffset < FILE_HEADER_SIZE || indexOffset + indexSize + TRAILER_SIZE != fileSize)
+  {
+    LOG_ERROR("Failed to open indexed sequence file " << fileName << ": the frame index is missing or corrupted (the file may not have been closed properly)");
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  std::vector<unsigned char> indexData(static_cast<size_t>(indexSize));
+  this->File.seekg(static_cast<std::streamoff>(indexOffset), std::ios::beg);
+  this->File.read(reinterpret_cast<char*>(indexData.data()), static_cast<std::streamsize>(indexSize));
+  if (!this->File.good() || this->ParseIndex(indexData) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open indexed sequence file " << fileName << ": the frame index is corrupted");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  for (std::vector<FrameInfo>::iterator frameIt = this->Frames.begin(); frameIt != this->Frames.end(); ++frameIt)
+  {
+    if (frameIt->DataOffset < FILE_HEADER_SIZE || frameIt->DataOffset + frameIt->DataSize > indexOffset)
+    {
+      LOG_ERROR("Failed to open indexed sequence file " << fileName << ": invalid frame data position in the index");
+      this->Close();
+      return PLUS_FAIL;
+    }
+  }
+
+  this->SortedTimestamps.reserve(this->Frames.size());
+  for (unsigned int frameIndex = 0; frameIndex < this->Frames.size(); ++frameIndex)
+  {
+    this->SortedTimestamps.push_back(std::make_pair(this->Frames[frameIndex].Timestamp, frameIndex));
+  }
+  std::stable_sort(this->SortedTimestamps.begin(), this->SortedTimestamps.end(),
+                   [](const std::pair<double, unsigned int>& a, const std::pair<double, unsigned int>& b) { return a.first < b.first; });
+
+  this->FileName = fileName;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::ParseIndex(const std::vector<unsigned char>& indexData)
+{
+  IndexDataReader reader(indexData);
+
+  unsigned int numberOfCustomFields = reader.ReadUInt32();
+  for (unsigned int i = 0; i < numberOfCustomFields && !reader.HasError(); ++i)
+  {
+    std::string name = reader.ReadString();
+    std::string value = reader.ReadString();
+    this->CustomFields[name] = std::make_pair(FRAMEFIELD_NONE, value);
+  }
+
+  unsigned long long numberOfFrames = reader.ReadUInt64();
+  // Each frame takes at least 60 bytes in the index, so a corrupted frame count is detected before allocating memory
+  if (reader.HasError() || numberOfFrames > indexData.size() / 60)
+  {
+    return PLUS_FAIL;
+  }
+  this->Frames.resize(static_cast<size_t>(numberOfFrames));
+  for (std::vector<FrameInfo>::iterator frameIt = this->Frames.begin(); frameIt != this->Frames.end() && !reader.HasError(); ++frameIt)
+  {
+    frameIt->DataOffset = reader.ReadUInt64();
+    frameIt->DataSize = reader.ReadUInt64();
+    frameIt->Timestamp = reader.ReadDouble();
+    frameIt->HasImage = (reader.ReadUInt32() != 0);
+    frameIt->Compression = static_cast<CompressionType>(reader.ReadUInt32());
+    frameIt->FrameSize[0] = reader.ReadUInt32();
+    frameIt->FrameSize[1] = reader.ReadUInt32();
+    frameIt->FrameSize[2] = reader.ReadUInt32();
+    frameIt->PixelType = static_cast<igsioCommon::VTKScalarPixelType>(reader.ReadUInt32());
+    frameIt->NumberOfScalarComponents = reader.ReadUInt32();
+    frameIt->ImageType = static_cast<US_IMAGE_TYPE>(reader.ReadUInt32());
+    frameIt->ImageOrientation = static_cast<US_IMAGE_ORIENTATION>(reader.ReadUInt32());
+    unsigned int numberOfFields = reader.ReadUInt32();
+    for (unsigned int i = 0; i < numberOfFields && !reader.HasError(); ++i)
+    {
+      std::string name = reader.ReadString();
+      std::string value = reader.ReadString();
+      igsioFrameFieldFlags flags = static_cast<igsioFrameFieldFlags>(reader.ReadUInt32());
+      frameIt->Fields[name] = std::make_pair(flags, value);
+    }
+    if (frameIt->Compression != COMPRESSION_NONE && frameIt->Compression != COMPRESSION_ZLIB && frameIt->Compression != COMPRESSION_LZ4
+        && frameIt->Compression != COMPRESSION_DELTA_ZLIB)
+    {
+      LOG_ERROR("Unknown frame compression type: " << frameIt->Compression);
+      return PLUS_FAIL;
+    }
+  }
+  return reader.HasError() ? PLUS_FAIL : PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIndexedSequenceFile::Close()
+{
+  if (this->OutputFile.is_open())
+  {
+    // Finalize() calls Close() when the output file is closed
+    this->Finalize();
+    return;
+  }
+  this->OutputFile.clear();
+  this->OutputFileName.clear();
+  this->OutputDataOffset = 0;
+  this->ReferenceFrameData.reset();
+  if (this->File.is_open())
+  {
+    this->File.close();
+  }
+  this->File.clear();
+  this->FileName.clear();
+  this->Frames.clear();
+  this->CustomFields.clear();
+  this->SortedTimestamps.clear();
+  this->DecodedFrameIndex = INVALID_FRAME_INDEX;
+  this->DecodedFrameData.clear();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIndexedSequenceFile::IsOpen() const
+{
+  return this->File.is_open();
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIndexedSequenceFile::GetNumberOfFrames() const
+{
+  return static_cast<unsigned int>(this->Frames.size());
+}
+
+//----------------------------------------------------------------------------
+const PlusIndexedSequenceFile::FrameInfo& PlusIndexedSequenceFile::GetFrameInfo(unsigned int frameIndex) const
+{
+  if (frameIndex >= this->Frames.size())
+  {
+    static FrameInfo invalidFrameInfo;
+    LOG_ERROR("PlusIndexedSequenceFile::GetFrameInfo failed: invalid frame index " << frameIndex);
+    return invalidFrameInfo;
+  }
+  return this->Frames[frameIndex];
+}
+
+//----------------------------------------------------------------------------
+const igsioFieldMapType& PlusIndexedSequenceFile::GetCustomFields() const
+{
+  return this->CustomFields;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIndexedSequenceFile::GetFrameIndexFromTime(double timestamp) const
+{
+  if (this->SortedTimestamps.empty())
+  {
+    return 0;
+  }
+  std::vector<std::pair<double, unsigned int> >::const_iterator it = std::lower_bound(this->SortedTimestamps.begin(), this->SortedTimestamps.end(), timestamp,
+      [](const std::pair<double, unsigned int>& entry, double time) { return entry.first < time; });
+  if (it == this->SortedTimestamps.end())
+  {
+    return this->SortedTimestamps.back().second;
+  }
+  if (it != this->SortedTimestamps.begin() && timestamp - (it - 1)->first < it->first - timestamp)
+  {
+    --it;
+  }
+  return it->second;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::ReadFramePixels(unsigned int frameIndex, std::vector<unsigned char>& pixelData)
+{
+  if (frameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::ReadFramePixels failed: invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  if (this->Frames[frameIndex].Compression != COMPRESSION_DELTA_ZLIB)
+  {
+    return this->ReadFrameData(frameIndex, pixelData);
+  }
+
+  // Find the closest frame before the requested one that can be decoded without reference to other frames
+  unsigned int startFrameIndex = frameIndex;
+  while (startFrameIndex != this->DecodedFrameIndex && this->Frames[startFrameIndex].Compression == COMPRESSION_DELTA_ZLIB)
+  {
+    if (startFrameIndex == 0)
+    {
+      LOG_ERROR("Failed to decode frame " << frameIndex << " of indexed sequence file " << this->FileName << ": no key frame is found");
+      return PLUS_FAIL;
+    }
+    --startFrameIndex;
+  }
+  if (startFrameIndex != this->DecodedFrameIndex)
+  {
+    this->DecodedFrameIndex = INVALID_FRAME_INDEX;
+    if (this->ReadFrameData(startFrameIndex, this->DecodedFrameData) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->DecodedFrameIndex = startFrameIndex;
+  }
+
+  // Add the differences of the following frames
+  for (unsigned int deltaFrameIndex = startFrameIndex + 1; deltaFrameIndex <= frameIndex; ++deltaFrameIndex)
+  {
+    this->DecodedFrameIndex = INVALID_FRAME_INDEX;
+    if (this->ReadFrameData(deltaFrameIndex, pixelData) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (pixelData.size() != this->DecodedFrameData.size())
+    {
+      LOG_ERROR("Failed to decode frame " << deltaFrameIndex << " of indexed sequence file " << this->FileName << ": size of the previous frame is different");
+      return PLUS_FAIL;
+    }
+    CombineFrames(this->DecodedFrameData.data(), pixelData.data(), this->DecodedFrameData.data(), pixelData.size(),
+                  igsioVideoFrame::GetNumberOfBytesPerScalar(this->Frames[deltaFrameIndex].PixelType), false);
+    this->DecodedFrameIndex = deltaFrameIndex;
+  }
+
+  pixelData = this->DecodedFrameData;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::ReadFrameData(unsigned int frameIndex, std::vector<unsigned char>& pixelData)
+{
+  const FrameInfo& frame = this->Frames[frameIndex];
+  if (!frame.HasImage)
+  {
+    pixelData.clear();
+    return PLUS_SUCCESS;
+  }
+
+  unsigned long long frameSizeBytes = static_cast<unsigned long long>(frame.FrameSize[0]) * frame.FrameSize[1] * frame.FrameSize[2]
+                                      * frame.NumberOfScalarComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(frame.PixelType);
+  pixelData.resize(static_cast<size_t>(frameSizeBytes));
+  std::vector<unsigned char>& fileData = (frame.Compression == COMPRESSION_NONE ? pixelData : this->CompressedFrameData);
+  fileData.resize(static_cast<size_t>(frame.DataSize));
+
+  this->File.clear();
+  this->File.seekg(static_cast<std::streamoff>(frame.DataOffset), std::ios::beg);
+  this->File.read(reinterpret_cast<char*>(fileData.data()), static_cast<std::streamsize>(frame.DataSize));
+  if (!this->File.good())
+  {
+    LOG_ERROR("Failed to read frame " << frameIndex << " from indexed sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  if (frame.Compression == COMPRESSION_ZLIB || frame.Compression == COMPRESSION_DELTA_ZLIB)
+  {
+    uLongf uncompressedSize = static_cast<uLongf>(frameSizeBytes);
+    if (uncompress(pixelData.data(), &uncompressedSize, fileData.data(), static_cast<uLong>(frame.DataSize)) != Z_OK || uncompressedSize != frameSizeBytes)
+    {
+      LOG_ERROR("Failed to decompress frame " << frameIndex << " of indexed sequence file " << this->FileName);
+      return PLUS_FAIL;
+    }
+  }
+  else if (frame.Compression == COMPRESSION_LZ4)
+  {
+    vtkSmartPointer<vtkLZ4DataCompressor> decompressor = vtkSmartPointer<vtkLZ4DataCompressor>::New();
+    if (decompressor->Uncompress(fileData.data(), static_cast<size_t>(frame.DataSize), pixelData.data(), static_cast<size_t>(frameSizeBytes)) != frameSizeBytes)
+    {
+      LOG_ERROR("Failed to decompress frame " << frameIndex << " of indexed sequence file " << this->FileName);
+      return PLUS_FAIL;
+    }
+  }
+  else if (frame.DataSize != frameSizeBytes)
+  {
+    LOG_ERROR("Invalid data size of frame " << frameIndex << " in indexed sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::ReadTrackedFrame(unsigned int frameIndex, igsioTrackedFrame& trackedFrame)
+{
+  if (frameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::ReadTrackedFrame failed: invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  const FrameInfo& frame = this->Frames[frameIndex];
+
+  if (frame.HasImage)
+  {
+    std::vector<unsigned char> pixelData;
+    if (this->ReadFramePixels(frameIndex, pixelData) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    igsioVideoFrame videoFrame;
+    if (videoFrame.AllocateFrame(frame.FrameSize, frame.PixelType, frame.NumberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate image for frame " << frameIndex << " of indexed sequence file " << this->FileName);
+      return PLUS_FAIL;
+    }
+    memcpy(videoFrame.GetScalarPointer(), pixelData.data(), pixelData.size());
+    videoFrame.SetImageType(frame.ImageType);
+    videoFrame.SetImageOrientation(frame.ImageOrientation);
+    trackedFrame.SetImageData(videoFrame);
+  }
+
+  for (igsioFieldMapType::const_iterator fieldIt = frame.Fields.begin(); fieldIt != frame.Fields.end(); ++fieldIt)
+  {
+    trackedFrame.SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+  }
+  trackedFrame.SetTimestamp(frame.Timestamp);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::ReadTrackedFrameList(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, unsigned int lastFrameIndex)
+{
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::ReadTrackedFrameList failed: invalid tracked frame list");
+    return PLUS_FAIL;
+  }
+  if (firstFrameIndex > lastFrameIndex || lastFrameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("PlusIndexedSequenceFile::ReadTrackedFrameList failed: invalid frame range " << firstFrameIndex << "-" << lastFrameIndex
+              << " (number of frames: " << this->Frames.size() << ")");
+    return PLUS_FAIL;
+  }
+
+  trackedFrameList->Clear();
+  for (igsioFieldMapType::const_iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+  {
+    trackedFrameList->SetCustomString(fieldIt->first, fieldIt->second.second);
+  }
+  for (unsigned int frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; ++frameIndex)
+  {
+    igsioTrackedFrame trackedFrame;
+    if (this->ReadTrackedFrame(frameIndex, trackedFrame) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // Frames without image are valid in a sequence (e.g., tracking data only)
+    if (trackedFrameList->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME) != IGSIO_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame " << frameIndex << " of indexed sequence file " << this->FileName << " to the tracked frame list");
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIndexedSequenceFile::ReadTrackedFrameList(vtkIGSIOTrackedFrameList* trackedFrameList)
+{
+  if (this->Frames.empty())
+  {
+    if (trackedFrameList == NULL)
+    {
+      LOG_ERROR("PlusIndexedSequenceFile::ReadTrackedFrameList failed: invalid tracked frame list");
+      return PLUS_FAIL;
+    }
+    trackedFrameList->Clear();
+    for (igsioFieldMapType::const_iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+    {
+      trackedFrameList->SetCustomString(fieldIt->first, fieldIt->second.second);
+    }
+    return PLUS_SUCCESS;
+  }
+  return this->ReadTrackedFrameList(trackedFrameList, 0, static_cast<unsigned int>(this->Frames.size() - 1));
+}
@@ -0,0 +1,233 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIndexedSequenceFile_h
+#define __PlusIndexedSequenceFile_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <igsioCommon.h>
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class PlusIndexedSequenceFile
+  \brief Reads and writes sequence files with a frame index that allows random access to individual frames
+
+  The Plus indexed sequence file (.pseq) consists of the following parts:
+  - File header: magic string and format version.
+  - Frame data: pixel data of each frame, one after the other. Each frame is compressed independently (zlib or LZ4),
+    so a single frame can be read without decompressing the others.
+  - Index: custom fields of the sequence and, for each frame, the position and size of the frame data,
+    the timestamp, the image properties and all the frame fields (transforms, statuses, etc.).
+  - Trailer: position and size of the index.
+
+  All numbers are stored in little endian byte order. Since the index is written after the frame data,
+  frames can be written as they are acquired, without knowing the number of frames in advance
+  (see Create(), AppendFrames() and Finalize()). Frames are compressed in parallel on the application-wide
+  thread pool and written to the file in their original order.
+
+  With COMPRESSION_DELTA_ZLIB, each frame is stored as the difference from the previous frame and the difference
+  is compressed with zlib. The difference is computed for each scalar value (modulo 2^N for N-bit scalars), so it is
+  small for multi-byte pixel types as well. Consecutive ultrasound frames are highly correlated, so this results in
+  much smaller files without any loss of information (see the IndexedSequenceFileWrite benchmarks in PlusBenchmarks). Every KeyFrameInterval-th frame is a key frame, stored without reference to other
+  frames, which limits the number of frames that have to be decoded for reading a single frame.
+
+  Open() reads only the index, so opening is fast regardless of the size of the file, and frames
+  can be looked up by timestamp in O(log n) time. The pixel data and all the fields of the frames are stored
+  exactly as they are in the tracked frame list, therefore converting between .pseq and .mha/.nrrd files
+  does not lose any information.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusIndexedSequenceFile
+{
+public:
+  /*! Compression method of the frame data */
+  enum CompressionType
+  {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_ZLIB = 1,
+    COMPRESSION_LZ4 = 2,  /*!< faster than zlib, but the compression ratio is lower */
+    COMPRESSION_DELTA_ZLIB = 3  /*!< difference from the previous frame, compressed with zlib */
+  };
+
+  /*! Properties of a frame, as stored in the index */
+  struct FrameInfo
+  {
+    /*! Position of the frame data in the file */
+    unsigned long long DataOffset;
+    /*! Size of the frame data in the file (compressed size if the frame is compressed) */
+    unsigned long long DataSize;
+    double Timestamp;
+    /*! False if the frame contains no image (e.g., only tracking data was recorded) */
+    bool HasImage;
+    CompressionType Compression;
+    FrameSizeType FrameSize;
+    igsioCommon::VTKScalarPixelType PixelType;
+    unsigned int NumberOfScalarComponents;
+    US_IMAGE_TYPE ImageType;
+    US_IMAGE_ORIENTATION ImageOrientation;
+    igsioFieldMapType Fields;
+  };
+
+  PlusIndexedSequenceFile();
+  virtual ~PlusIndexedSequenceFile();
+
+  /*! Returns true if the file name has the extension of indexed sequence files (.pseq) */
+  static bool IsIndexedSequenceFileName(const std::string& fileName);
+
+  /*! Get compression type from its name (NONE, ZLIB, LZ4, DELTA_ZLIB; case insensitive) */
+  static PlusStatus GetCompressionTypeFromString(const std::string& name, CompressionType& compression);
+
+  static std::string GetCompressionTypeAsString(CompressionType compression);
+
+  /*!
+    Write all frames of a tracked frame list into an indexed sequence file
+    \param fileName Path of the output file
+    \param trackedFrameList Frames to write
+    \param useCompression If true then the pixel data of each frame is compressed
+    \param enableImageDataWrite If false then only the frame fields are written, the frames are stored without image
+  */
+  static PlusStatus Write(const std::string& fileName, vtkIGSIOTrackedFrameList* trackedFrameList, bool useCompression = true, bool enableImageDataWrite = true);
+
+  /*! Write all frames of a tracked frame list into an indexed sequence file, using the specified compression method */
+  static PlusStatus Write(const std::string& fileName, vtkIGSIOTrackedFrameList* trackedFrameList, CompressionType compression, bool enableImageDataWrite = true);
+
+  /*!
+    Create a new file for writing frames incrementally. Frames can be added by AppendFrames(), and the file
+    must be completed by calling Finalize() (or Close()).
+  */
+  PlusStatus Create(const std::string& fileName, CompressionType compression);
+
+  /*!
+    Add frames to the file that is being written. Compression of the frames is started on the thread pool and frame data
+    is written to the file when compression is completed, so the frames can be modified or deleted after this call returns.
+    \param enableImageDataWrite If false then only the frame fields are written, the frames are stored without image
+  */
+  PlusStatus AppendFrames(vtkIGSIOTrackedFrameList* trackedFrameList, bool enableImageDataWrite = true);
+
+  /*!
+    Set the maximum number of frames between key frames when writing with COMPRESSION_DELTA_ZLIB.
+    Smaller values make reading of individual frames faster, larger values make the file smaller. Default is 30.
+  */
+  void SetKeyFrameInterval(unsigned int interval);
+  unsigned int GetKeyFrameInterval() const;
+
+  /*! Set a custom field of the sequence that is being written */
+  void SetCustomField(const std::string& fieldName, const std::string& fieldValue);
+
+  /*! Write all the remaining frames and the index, then close the file that is being written */
+  PlusStatus Finalize();
+
+  /*! Stop writing and delete the file that is being written */
+  void Discard();
+
+  /*! Returns true if a file is being written */
+  bool IsWriting() const;
+
+  /*! Read the index of the file. Frame data is not read. */
+  PlusStatus Open(const std::string& fileName);
+
+  void Close();
+
+  bool IsOpen() const;
+
+  unsigned int GetNumberOfFrames() const;
+
+  /*! Get properties of a frame (position, timestamp, image properties, frame fields) */
+  const FrameInfo& GetFrameInfo(unsigned int frameIndex) const;
+
+  /*! Custom fields of the sequence (stored in the header of .mha and .nrrd files) */
+  const igsioFieldMapType& GetCustomFields() const;
+
+  /*! Get the index of the frame that has the closest timestamp to the specified time, in O(log n) time */
+  unsigned int GetFrameIndexFromTime(double timestamp) const;
+
+  /*!
+    Read and decompress the pixel data of a frame. Empty if the frame has no image.
+    Delta encoded frames are decoded from the previous key frame, or from the last read frame if frames are read in order.
+  */
+  PlusStatus ReadFramePixels(unsigned int frameIndex, std::vector<unsigned char>& pixelData);
+
+  /*! Read a frame with all its fields and image data */
+  PlusStatus ReadTrackedFrame(unsigned int frameIndex, igsioTrackedFrame& trackedFrame);
+
+  /*!
+    Read a range of frames (inclusive) and the custom fields of the sequence into a tracked frame list.
+    Only the data of the requested frames is read from the file.
+  */
+  PlusStatus ReadTrackedFrameList(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, unsigned int lastFrameIndex);
+
+  /*! Read all frames and the custom fields of the sequence into a tracked frame list */
+  PlusStatus ReadTrackedFrameList(vtkIGSIOTrackedFrameList* trackedFrameList);
+
+protected:
+  /*! Frame that is added to the file that is being written, but its data is not written yet */
+  struct PendingFrame;
+
+  /*! Parse the serialized index */
+  PlusStatus ParseIndex(const std::vector<unsigned char>& indexData);
+
+  /*! Serialize the custom fields and the index of all frames */
+  void SerializeIndex(std::vector<unsigned char>& indexData) const;
+
+  /*!
+    Write the data of pending frames to the output file, in the order they were added.
+    \param waitForAll If false then only frames with completed compression are written (except if too many frames are in progress).
+  */
+  PlusStatus WritePendingFrames(bool waitForAll);
+
+  /*! Read and decompress the data of a frame. For delta encoded frames the difference from the previous frame is returned. */
+  PlusStatus ReadFrameData(unsigned int frameIndex, std::vector<unsigned char>& pixelData);
+
+  /*! Write the data of a frame to the output file and add the frame to the index */
+  PlusStatus WriteFrameData(FrameInfo& frameInfo, const unsigned char* data, unsigned long long dataSize, CompressionType compression);
+
+  std::string FileName;
+  std::ifstream File;
+  std::vector<FrameInfo> Frames;
+  igsioFieldMapType CustomFields;
+
+  /*! Pairs of timestamps and frame indices, sorted by timestamp */
+  std::vector<std::pair<double, unsigned int> > SortedTimestamps;
+
+  /*! Buffer for the compressed frame data, kept to avoid reallocation for each frame */
+  std::vector<unsigned char> CompressedFrameData;
+
+  /*! Index and pixel data of the last decoded delta encoded frame, which speeds up reading frames in order */
+  unsigned int DecodedFrameIndex;
+  std::vector<unsigned char> DecodedFrameData;
+
+  /*! File that is being written */
+  std::string OutputFileName;
+  std::ofstream OutputFile;
+  CompressionType OutputCompression;
+  /*! Position of the next frame data in the output file */
+  unsigned long long OutputDataOffset;
+  /*! Frames that are being compressed or wait for being written, in the order they were added */
+  std::deque<PendingFrame*> PendingFrames;
+
+  unsigned int KeyFrameInterval;
+  /*! Pixel data of the last added frame, the next frame is delta encoded with respect to this (NULL if the next frame must be a key frame) */
+  std::shared_ptr<const std::vector<unsigned char> > ReferenceFrameData;
+  unsigned int NumberOfFramesSinceKeyFrame;
+
+private:
+  PlusIndexedSequenceFile(const PlusIndexedSequenceFile&);
+  void operator=(const PlusIndexedSequenceFile&);
+};
+
+#endif
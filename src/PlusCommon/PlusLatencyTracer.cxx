@@ -0,0 +1,312 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+
+#include <vtkIGSIOAccurateTimer.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+  std::mutex InstanceCreationMutex;
+  std::atomic<PlusLatencyTracer*> Instance(NULL);
+
+  const char* STAGE_NAMES[PlusLatencyTracer::NUMBER_OF_TRACE_STAGES] =
+  {
+    "DeviceTimestamp",
+    "BufferAddItem",
+    "ChannelGetTrackedFrame",
+    "PackMessages",
+    "SocketSend"
+  };
+
+  //----------------------------------------------------------------------------
+  // Get the value at the specified percentile (0-100) of a sorted list
+  double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+  {
+    size_t index = static_cast<size_t>(percentile / 100.0 * (sortedValues.size() - 1) + 0.5);
+    return sortedValues[std::min(index, sortedValues.size() - 1)];
+  }
+}
+
+const unsigned int PlusLatencyTracer::DEFAULT_CAPACITY = 100000;
+std::atomic<bool> PlusLatencyTracer::Enabled(false);
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer* PlusLatencyTracer::GetInstance()
+{
+  PlusLatencyTracer* instance = Instance.load();
+  if (instance != NULL)
+  {
+    return instance;
+  }
+  std::lock_guard<std::mutex> lock(InstanceCreationMutex);
+  if (Instance.load() == NULL)
+  {
+    // The instance is not deleted at exit, as trace points may be recorded by threads that are still running
+    Instance = new PlusLatencyTracer;
+  }
+  return Instance.load();
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer::TraceRing::TraceRing(unsigned int capacity)
+  : TracePoints(new TracePoint[capacity])
+  , Capacity(capacity)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer::TraceRing::~TraceRing()
+{
+  delete[] this->TracePoints;
+  this->TracePoints = NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer::PlusLatencyTracer()
+  : Ring(new TraceRing(DEFAULT_CAPACITY))
+  , NextTracePointIndex(0)
+{
+  this->Clear();
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer::~PlusLatencyTracer()
+{
+  delete this->Ring.load();
+  this->Ring = NULL;
+  for (std::vector<TraceRing*>::iterator it = this->RetiredRings.begin(); it != this->RetiredRings.end(); ++it)
+  {
+    delete *it;
+  }
+  this->RetiredRings.clear();
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::SetEnabled(bool enabled)
+{
+  Enabled = enabled;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusLatencyTracer::SetCapacity(unsigned int capacity)
+{
+  if (capacity == 0)
+  {
+    LOG_ERROR("PlusLatencyTracer::SetCapacity failed: capacity must be positive");
+    return PLUS_FAIL;
+  }
+  if (IsEnabled())
+  {
+    LOG_ERROR("PlusLatencyTracer::SetCapacity failed: capacity cannot be changed while tracing is enabled");
+    return PLUS_FAIL;
+  }
+  // Record calls that started before tracing was disabled may still write the previous ring, so it is kept.
+  // The capacity is changed only when the tracing is configured, so the retired rings do not accumulate.
+  TraceRing* newRing = new TraceRing(capacity);
+  for (unsigned int i = 0; i < capacity; ++i)
+  {
+    newRing->TracePoints[i].Sequence = 0;
+  }
+  this->RetiredRings.push_back(this->Ring.exchange(newRing));
+  this->NextTracePointIndex = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusLatencyTracer::GetCapacity() const
+{
+  return this->Ring.load()->Capacity;
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::Record(TraceStageType stage, double frameTimestamp, double eventTime/*=-1*/)
+{
+  if (!IsEnabled())
+  {
+    return;
+  }
+  if (eventTime < 0)
+  {
+    eventTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+  // The ring is never deleted while the tracer exists, so it remains valid even if SetCapacity replaces it meanwhile
+  TraceRing* ring = this->Ring.load(std::memory_order_acquire);
+  unsigned long long index = this->NextTracePointIndex.fetch_add(1, std::memory_order_relaxed);
+  TracePoint& tracePoint = ring->TracePoints[index % ring->Capacity];
+  // Readers skip the trace point while the sequence number is odd. If the ring is so small that another recorder is
+  // still writing the same trace point then this trace point is dropped, as the two writes would be mixed up.
+  unsigned long long sequence = tracePoint.Sequence.load(std::memory_order_relaxed);
+  if (sequence % 2 == 1 || !tracePoint.Sequence.compare_exchange_strong(sequence, 2 * index + 1, std::memory_order_relaxed))
+  {
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  tracePoint.Stage.store(stage, std::memory_order_relaxed);
+  tracePoint.FrameTimestamp.store(frameTimestamp, std::memory_order_relaxed);
+  tracePoint.EventTime.store(eventTime, std::memory_order_relaxed);
+  tracePoint.Sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::Clear()
+{
+  TraceRing* ring = this->Ring.load();
+  for (unsigned int i = 0; i < ring->Capacity; ++i)
+  {
+    ring->TracePoints[i].Sequence = 0;
+  }
+  this->NextTracePointIndex = 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusLatencyTracer::GetNumberOfTracePoints() const
+{
+  unsigned long long numberOfRecordedTracePoints = this->NextTracePointIndex;
+  return static_cast<unsigned int>(std::min<unsigned long long>(numberOfRecordedTracePoints, this->GetCapacity()));
+}
+
+//----------------------------------------------------------------------------
+std::string PlusLatencyTracer::GetStageName(TraceStageType stage)
+{
+  if (stage < 0 || stage >= NUMBER_OF_TRACE_STAGES)
+  {
+    return "Unknown";
+  }
+  return STAGE_NAMES[stage];
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::GetTracePoints(std::vector<TracePointData>& tracePoints) const
+{
+  tracePoints.clear();
+  tracePoints.reserve(this->GetNumberOfTracePoints());
+  const TraceRing* ring = this->Ring.load();
+  for (unsigned int i = 0; i < ring->Capacity; ++i)
+  {
+    const TracePoint& tracePoint = ring->TracePoints[i];
+    unsigned long long sequenceBefore = tracePoint.Sequence.load(std::memory_order_acquire);
+    if (sequenceBefore == 0 || sequenceBefore % 2 == 1)
+    {
+      // never written or being written
+      continue;
+    }
+    TracePointData data;
+    data.Stage = tracePoint.Stage.load(std::memory_order_relaxed);
+    data.FrameTimestamp = tracePoint.FrameTimestamp.load(std::memory_order_relaxed);
+    data.EventTime = tracePoint.EventTime.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (tracePoint.Sequence.load(std::memory_order_relaxed) != sequenceBefore)
+    {
+      // overwritten while reading
+      continue;
+    }
+    tracePoints.push_back(data);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusLatencyTracer::GetStageLatencyStatistics(TraceStageType stage, unsigned int& numberOfTracePoints, double& medianSec, double& percentile99Sec, double& maxSec) const
+{
+  std::vector<TracePointData> tracePoints;
+  this->GetTracePoints(tracePoints);
+
+  std::vector<double> latenciesSec;
+  for (std::vector<TracePointData>::iterator it = tracePoints.begin(); it != tracePoints.end(); ++it)
+  {
+    if (it->Stage == stage)
+    {
+      latenciesSec.push_back(it->EventTime - it->FrameTimestamp);
+    }
+  }
+
+  numberOfTracePoints = latenciesSec.size();
+  if (latenciesSec.empty())
+  {
+    medianSec = 0;
+    percentile99Sec = 0;
+    maxSec = 0;
+    return PLUS_FAIL;
+  }
+
+  std::sort(latenciesSec.begin(), latenciesSec.end());
+  medianSec = GetPercentile(latenciesSec, 50);
+  percentile99Sec = GetPercentile(latenciesSec, 99);
+  maxSec = latenciesSec.back();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusLatencyTracer::GetStatisticsAsString() const
+{
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(3) << "Latency since frame timestamp (p50/p99/max):";
+  for (int stage = 0; stage < NUMBER_OF_TRACE_STAGES; ++stage)
+  {
+    unsigned int numberOfTracePoints = 0;
+    double medianSec = 0;
+    double percentile99Sec = 0;
+    double maxSec = 0;
+    ss << std::endl << "  " << GetStageName(static_cast<TraceStageType>(stage)) << ": ";
+    if (this->GetStageLatencyStatistics(static_cast<TraceStageType>(stage), numberOfTracePoints, medianSec, percentile99Sec, maxSec) != PLUS_SUCCESS)
+    {
+      ss << "no data";
+      continue;
+    }
+    ss << medianSec * 1000.0 << "/" << percentile99Sec * 1000.0 << "/" << maxSec * 1000.0 << " ms (" << numberOfTracePoints << " trace points)";
+  }
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusLatencyTracer::WriteChromeTrace(const std::string& fileName) const
+{
+  std::ofstream outputFile(fileName.c_str());
+  if (!outputFile.is_open())
+  {
+    LOG_ERROR("Failed to open latency trace file for writing: " << fileName);
+    return PLUS_FAIL;
+  }
+
+  std::vector<TracePointData> tracePoints;
+  this->GetTracePoints(tracePoints);
+
+  // Each stage is shown as a separate thread, each trace point is a complete event that lasts from the frame timestamp
+  // until the time when the frame reached the stage. Times are in microseconds.
+  outputFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  for (int stage = 0; stage < NUMBER_OF_TRACE_STAGES; ++stage)
+  {
+    outputFile << (stage == 0 ? "" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << stage
+               << ",\"args\":{\"name\":\"" << GetStageName(static_cast<TraceStageType>(stage)) << "\"}}";
+  }
+  outputFile << std::fixed << std::setprecision(1);
+  for (std::vector<TracePointData>::iterator it = tracePoints.begin(); it != tracePoints.end(); ++it)
+  {
+    double durationUsec = std::max(0.0, (it->EventTime - it->FrameTimestamp) * 1e6);
+    outputFile << ",\n"
+               << "{\"name\":\"" << GetStageName(static_cast<TraceStageType>(it->Stage))
+               << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << it->Stage
+               << ",\"ts\":" << it->FrameTimestamp * 1e6 << ",\"dur\":" << durationUsec
+               << ",\"args\":{\"frameTimestamp\":" << std::setprecision(6) << it->FrameTimestamp << std::setprecision(1) << "}}";
+  }
+  outputFile << std::endl << "]}" << std::endl;
+
+  if (!outputFile.good())
+  {
+    LOG_ERROR("Failed to write latency trace file: " << fileName);
+    return PLUS_FAIL;
+  }
+  LOG_INFO("Latency trace of " << tracePoints.size() << " trace points is written to " << fileName);
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusLatencyTracer_h
+#define __PlusLatencyTracer_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusLatencyTracer
+  \brief Collects per-frame trace points along the acquisition and broadcasting pipeline
+
+  Each trace point records the time when a frame (identified by its timestamp) reached a processing stage.
+  The latency of a stage is the time elapsed since the frame timestamp, so the stages show how long it takes
+  for a frame to get from the sensor to the network socket.
+
+  Trace points are stored in a fixed-size ring, which can be written from any number of threads without locking.
+  When the ring is full then the oldest trace points are overwritten. Trace points are only recorded while tracing is enabled.
+
+  Tracing is disabled by default. When disabled, recording a trace point costs only a relaxed atomic load
+  (use the PLUS_TRACE_LATENCY macro, which does not evaluate its arguments if tracing is disabled).
+
+  The collected trace points can be summarized as per-stage latency statistics (50th, 99th percentile and maximum)
+  and written to a JSON file in Chrome trace event format (can be viewed in chrome://tracing or https://ui.perfetto.dev).
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusLatencyTracer
+{
+public:
+  enum TraceStageType
+  {
+    STAGE_DEVICE_TIMESTAMP,   /*!< item is committed to the device buffer, measured from the unfiltered timestamp reported by the device */
+    STAGE_BUFFER_ADD_ITEM,    /*!< item is committed to the device buffer, measured from the filtered timestamp */
+    STAGE_CHANNEL_GET_FRAME,  /*!< tracked frame is assembled from the channel */
+    STAGE_MESSAGE_PACK,       /*!< OpenIGTLink messages of a client are packed (one trace point per client) */
+    STAGE_SOCKET_SEND,        /*!< messages are sent to a client (one trace point per client that received the messages) */
+    NUMBER_OF_TRACE_STAGES
+  };
+
+  /*! Default number of trace points that are kept */
+  static const unsigned int DEFAULT_CAPACITY;
+
+  /*! Get the application-wide tracer. It is created at the first call. */
+  static PlusLatencyTracer* GetInstance();
+
+  /*! Returns true if trace points are recorded. Can be called from any thread. */
+  static bool IsEnabled()
+  {
+    return Enabled.load(std::memory_order_relaxed);
+  }
+
+  /*! Enable or disable recording of trace points */
+  void SetEnabled(bool enabled);
+
+  /*!
+    Set the number of trace points that are kept. Removes all recorded trace points.
+    Fails if tracing is enabled. Record calls that started before tracing was disabled may still write the previous
+    trace points, so the previous ring is not deleted until the tracer is deleted.
+  */
+  PlusStatus SetCapacity(unsigned int capacity);
+  unsigned int GetCapacity() const;
+
+  /*!
+    Record a trace point if tracing is enabled. Can be called from any thread.
+    \param stage Processing stage that the frame has reached
+    \param frameTimestamp Timestamp of the frame (system time), identifies the frame
+    \param eventTime Time when the frame reached the stage (system time). If negative then the current time is used.
+  */
+  void Record(TraceStageType stage, double frameTimestamp, double eventTime = -1);
+
+  /*! Remove all recorded trace points */
+  void Clear();
+
+  /*! Number of trace points currently stored */
+  unsigned int GetNumberOfTracePoints() const;
+
+  static std::string GetStageName(TraceStageType stage);
+
+  /*!
+    Compute latency statistics of a stage from the stored trace points (latency: event time minus frame timestamp)
+    \return PLUS_FAIL if there are no trace points for the stage
+  */
+  PlusStatus GetStageLatencyStatistics(TraceStageType stage, unsigned int& numberOfTracePoints, double& medianSec, double& percentile99Sec, double& maxSec) const;
+
+  /*! Get a multi-line summary of the latency statistics of all stages that can be written to the log */
+  std::string GetStatisticsAsString() const;
+
+  /*! Write the stored trace points to a file in Chrome trace event JSON format */
+  PlusStatus WriteChromeTrace(const std::string& fileName) const;
+
+protected:
+  struct TracePoint
+  {
+    /*! Odd while the trace point is being written, even when it is complete (0: never written) */
+    std::atomic<unsigned long long> Sequence;
+    std::atomic<int> Stage;
+    std::atomic<double> FrameTimestamp;
+    std::atomic<double> EventTime;
+  };
+
+  struct TracePointData
+  {
+    int Stage;
+    double FrameTimestamp;
+    double EventTime;
+  };
+
+  PlusLatencyTracer();
+  virtual ~PlusLatencyTracer();
+
+  struct TraceRing
+  {
+    TraceRing(unsigned int capacity);
+    ~TraceRing();
+    TracePoint* TracePoints;
+    const unsigned int Capacity;
+  };
+
+  /*! Get a consistent copy of the complete trace points (skips the ones that are being written) */
+  void GetTracePoints(std::vector<TracePointData>& tracePoints) const;
+
+  static std::atomic<bool> Enabled;
+
+  /*! Trace points that are currently written. Record only loads the pointer, recorders do not have to register themselves to keep the ring alive. */
+  std::atomic<TraceRing*> Ring;
+  std::atomic<unsigned long long> NextTracePointIndex;
+
+  /*! Rings that are replaced by SetCapacity. Record calls that started before tracing was disabled may still write them. */
+  std::vector<TraceRing*> RetiredRings;
+
+private:
+  PlusLatencyTracer(const PlusLatencyTracer&);
+  void operator=(const PlusLatencyTracer&);
+};
+
+/*! Record a latency trace point if tracing is enabled. The arguments are not evaluated if tracing is disabled. */
+#define PLUS_TRACE_LATENCY(stage, frameTimestamp) \
+  do \
+  { \
+    if (PlusLatencyTracer::IsEnabled()) \
+    { \
+      PlusLatencyTracer::GetInstance()->Record(PlusLatencyTracer::stage, frameTimestamp); \
+    } \
+  } while (false)
+
+#endif
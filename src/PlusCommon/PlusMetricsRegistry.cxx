@@ -0,0 +1,267 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace
+{
+  std::mutex InstanceCreationMutex;
+  PlusMetricsRegistry* Instance = NULL;
+
+  //----------------------------------------------------------------------------
+  // Escape backslash, double quote and newline in label values
+  std::string EscapeLabelValue(const std::string& value)
+  {
+    std::string escaped;
+    for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+    {
+      switch (*it)
+      {
+        case '\\':
+          escaped += "\\\\";
+          break;
+        case '"':
+          escaped += "\\\"";
+          break;
+        case '\n':
+          escaped += "\\n";
+          break;
+        default:
+          escaped += *it;
+      }
+    }
+    return escaped;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusMetric::PlusMetric(const std::string& name, const std::string& help, MetricType type, const LabelMapType& labels)
+  : Name(name)
+  , Help(help)
+  , Type(type)
+  , Labels(labels)
+  , Value(0)
+  , Removed(false)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusMetric::~PlusMetric()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusMetricRateMeter::PlusMetricRateMeter(double windowSec/*=1.0*/)
+  : Gauge(NULL)
+  , WindowSec(windowSec)
+  , WindowStartTime(-1)
+  , WindowAmount(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusMetricRateMeter::~PlusMetricRateMeter()
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricRateMeter::SetGauge(PlusMetric* gauge)
+{
+  this->Gauge = gauge;
+  this->WindowStartTime = -1;
+  this->WindowAmount = 0;
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricRateMeter::Add(double amount, double currentTime)
+{
+  if (this->WindowStartTime < 0)
+  {
+    this->WindowStartTime = currentTime;
+  }
+  this->WindowAmount += amount;
+  double elapsedTimeSec = currentTime - this->WindowStartTime;
+  if (elapsedTimeSec < this->WindowSec)
+  {
+    return;
+  }
+  if (this->Gauge != NULL)
+  {
+    this->Gauge->Set(this->WindowAmount / elapsedTimeSec);
+  }
+  this->WindowStartTime = currentTime;
+  this->WindowAmount = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusMetricsRegistry* PlusMetricsRegistry::GetInstance()
+{
+  std::lock_guard<std::mutex> lock(InstanceCreationMutex);
+  if (Instance == NULL)
+  {
+    // The instance is not deleted at exit, as metrics may be updated by threads that are still running
+    Instance = new PlusMetricsRegistry;
+  }
+  return Instance;
+}
+
+//----------------------------------------------------------------------------
+PlusMetricsRegistry::PlusMetricsRegistry()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusMetricsRegistry::~PlusMetricsRegistry()
+{
+  for (std::vector<PlusMetric*>::iterator it = this->Metrics.begin(); it != this->Metrics.end(); ++it)
+  {
+    delete (*it);
+  }
+  this->Metrics.clear();
+}
+
+//----------------------------------------------------------------------------
+PlusMetric* PlusMetricsRegistry::GetMetric(const std::string& name, const std::string& help, PlusMetric::MetricType type, const PlusMetric::LabelMapType& labels)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::vector<PlusMetric*>::iterator it = this->Metrics.begin(); it != this->Metrics.end(); ++it)
+  {
+    if ((*it)->Name == name && (*it)->Labels == labels)
+    {
+      if ((*it)->Type != type)
+      {
+        LOG_WARNING("Metric " << name << " is requested with a different type than it was created with");
+      }
+      (*it)->Removed = false;
+      return (*it);
+    }
+  }
+  PlusMetric* metric = new PlusMetric(name, help, type, labels);
+  this->Metrics.push_back(metric);
+  return metric;
+}
+
+//----------------------------------------------------------------------------
+PlusMetric* PlusMetricsRegistry::GetMetric(const std::string& name, const std::string& help, PlusMetric::MetricType type, const std::string& labelName, const std::string& labelValue)
+{
+  PlusMetric::LabelMapType labels;
+  labels[labelName] = labelValue;
+  return this->GetMetric(name, help, type, labels);
+}
+
+//----------------------------------------------------------------------------
+void PlusMetricsRegistry::RemoveMetrics(const std::string& labelName, const std::string& labelValue)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::vector<PlusMetric*>::iterator it = this->Metrics.begin(); it != this->Metrics.end(); ++it)
+  {
+    PlusMetric::LabelMapType::const_iterator labelIt = (*it)->Labels.find(labelName);
+    if (labelIt != (*it)->Labels.end() && labelIt->second == labelValue)
+    {
+      (*it)->Removed = true;
+      (*it)->Set(0);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string PlusMetricsRegistry::GetLabelsAsString(const PlusMetric::LabelMapType& labels)
+{
+  if (labels.empty())
+  {
+    return "";
+  }
+  std::ostringstream ss;
+  ss << "{";
+  for (PlusMetric::LabelMapType::const_iterator it = labels.begin(); it != labels.end(); ++it)
+  {
+    ss << (it == labels.begin() ? "" : ",") << it->first << "=\"" << EscapeLabelValue(it->second) << "\"";
+  }
+  ss << "}";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+std::string PlusMetricsRegistry::GetMetricsAsPrometheusText(const std::string& namePrefix/*=""*/) const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+
+  // Metrics with the same name must be listed together, after a single HELP and TYPE line
+  std::vector<std::string> metricNames;
+  std::set<std::string> metricNameSet;
+  for (std::vector<PlusMetric*>::const_iterator it = this->Metrics.begin(); it != this->Metrics.end(); ++it)
+  {
+    if ((*it)->Removed || (*it)->Name.compare(0, namePrefix.size(), namePrefix) != 0)
+    {
+      continue;
+    }
+    if (metricNameSet.insert((*it)->Name).second)
+    {
+      metricNames.push_back((*it)->Name);
+    }
+  }
+
+  std::ostringstream ss;
+  ss << std::setprecision(15);
+  for (std::vector<std::string>::iterator nameIt = metricNames.begin(); nameIt != metricNames.end(); ++nameIt)
+  {
+    bool headerWritten = false;
+    for (std::vector<PlusMetric*>::const_iterator it = this->Metrics.begin(); it != this->Metrics.end(); ++it)
+    {
+      if ((*it)->Removed || (*it)->Name != (*nameIt))
+      {
+        continue;
+      }
+      if (!headerWritten)
+      {
+        ss << "# HELP " << (*it)->Name << " " << (*it)->Help << "\n";
+        ss << "# TYPE " << (*it)->Name << " " << ((*it)->Type == PlusMetric::METRIC_COUNTER ? "counter" : "gauge") << "\n";
+        headerWritten = true;
+      }
+      ss << (*it)->Name << GetLabelsAsString((*it)->Labels) << " " << (*it)->Get() << "\n";
+    }
+  }
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusMetricsRegistry::WritePrometheusTextFile(const std::string& fileName) const
+{
+  std::string temporaryFileName = fileName + ".tmp";
+  {
+    std::ofstream outputFile(temporaryFileName.c_str(), std::ios::out | std::ios::binary);
+    if (!outputFile.is_open())
+    {
+      LOG_ERROR("Failed to open metrics file for writing: " << temporaryFileName);
+      return PLUS_FAIL;
+    }
+    outputFile << this->GetMetricsAsPrometheusText();
+    if (!outputFile.good())
+    {
+      LOG_ERROR("Failed to write metrics file: " << temporaryFileName);
+      return PLUS_FAIL;
+    }
+  }
+
+  if (std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+  {
+    // Renaming to an existing file fails on Windows
+    std::remove(fileName.c_str());
+    if (std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+    {
+      LOG_ERROR("Failed to rename metrics file " << temporaryFileName << " to " << fileName);
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
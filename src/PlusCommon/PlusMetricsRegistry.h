@@ -0,0 +1,173 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusMetricsRegistry_h
+#define __PlusMetricsRegistry_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusMetric
+  \brief A single named value (counter or gauge) that can be updated from any thread without locking
+
+  Metric objects are created and owned by PlusMetricsRegistry.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetric
+{
+public:
+  enum MetricType
+  {
+    METRIC_COUNTER, /*!< monotonically increasing value, such as number of items or bytes */
+    METRIC_GAUGE    /*!< value that can go up and down, such as fill level or rate */
+  };
+
+  /*! Label name and value pairs that distinguish metrics with the same name (e.g., device="VideoDevice") */
+  typedef std::map<std::string, std::string> LabelMapType;
+
+  void Set(double value)
+  {
+    this->Value.store(value, std::memory_order_relaxed);
+  }
+
+  void Add(double increment)
+  {
+    double oldValue = this->Value.load(std::memory_order_relaxed);
+    while (!this->Value.compare_exchange_weak(oldValue, oldValue + increment, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  double Get() const
+  {
+    return this->Value.load(std::memory_order_relaxed);
+  }
+
+  const std::string& GetName() const { return this->Name; }
+  const std::string& GetHelp() const { return this->Help; }
+  const LabelMapType& GetLabels() const { return this->Labels; }
+  MetricType GetType() const { return this->Type; }
+
+protected:
+  friend class PlusMetricsRegistry;
+
+  PlusMetric(const std::string& name, const std::string& help, MetricType type, const LabelMapType& labels);
+  virtual ~PlusMetric();
+
+  std::string Name;
+  std::string Help;
+  MetricType Type;
+  LabelMapType Labels;
+  std::atomic<double> Value;
+
+  /*! Removed metrics are not exported, until they are requested again */
+  bool Removed;
+
+private:
+  PlusMetric(const PlusMetric&);
+  void operator=(const PlusMetric&);
+};
+
+/*!
+  \class PlusMetricRateMeter
+  \brief Computes the rate of a quantity (items per second, bytes per second, etc.) over a time window and stores it in a gauge
+
+  The rate is updated at the end of each window, so the cost of Add() is only an addition and a comparison.
+  Not thread-safe: each rate meter should be updated by only one thread at a time.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetricRateMeter
+{
+public:
+  PlusMetricRateMeter(double windowSec = 1.0);
+  virtual ~PlusMetricRateMeter();
+
+  /*! Set the gauge that the rate is written to. If NULL then the rate is not stored. */
+  void SetGauge(PlusMetric* gauge);
+
+  /*! Add an amount that was processed at the specified time (system time, in seconds) */
+  void Add(double amount, double currentTime);
+
+protected:
+  PlusMetric* Gauge;
+  double WindowSec;
+  double WindowStartTime;
+  double WindowAmount;
+};
+
+/*!
+  \class PlusMetricsRegistry
+  \brief Application-wide collection of metrics that describe the current state and performance of the system
+
+  Components (devices, buffers, servers) request their metrics from the registry once and keep the returned pointers,
+  then update the values with atomic operations (no locking, no memory allocation).
+  Metrics are never deleted, so the returned pointers remain valid during the lifetime of the application.
+  RemoveMetrics() hides the metrics of a component that no longer exists (e.g., a disconnected client) from the output.
+
+  The metrics can be retrieved in Prometheus text exposition format (https://prometheus.io/docs/instrumenting/exposition_formats/),
+  which is also easy to read for humans.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusMetricsRegistry
+{
+public:
+  /*! Get the application-wide registry. It is created at the first call. */
+  static PlusMetricsRegistry* GetInstance();
+
+  /*!
+    Get a metric. If the metric with the same name and labels does not exist yet then it is created with 0 value.
+    \param name Metric name, should follow Prometheus naming conventions (e.g., plus_buffer_items_total)
+    \param help Short description of the metric
+    \param type Counter or gauge
+    \param labels Label names and values that identify the measured object
+  */
+  PlusMetric* GetMetric(const std::string& name, const std::string& help, PlusMetric::MetricType type, const PlusMetric::LabelMapType& labels);
+
+  /*! Convenience method for getting a metric with a single label */
+  PlusMetric* GetMetric(const std::string& name, const std::string& help, PlusMetric::MetricType type, const std::string& labelName, const std::string& labelValue);
+
+  /*! Hide all metrics that have the specified label value from the output and reset their value */
+  void RemoveMetrics(const std::string& labelName, const std::string& labelValue);
+
+  /*!
+    Get all metrics in Prometheus text format
+    \param namePrefix If not empty then only those metrics are returned that have a name starting with this prefix
+  */
+  std::string GetMetricsAsPrometheusText(const std::string& namePrefix = "") const;
+
+  /*!
+    Write all metrics to a file in Prometheus text format. The file is written to a temporary file first
+    and then renamed, so that readers (e.g., node exporter textfile collector) never see a partially written file.
+  */
+  PlusStatus WritePrometheusTextFile(const std::string& fileName) const;
+
+protected:
+  PlusMetricsRegistry();
+  virtual ~PlusMetricsRegistry();
+
+  static std::string GetLabelsAsString(const PlusMetric::LabelMapType& labels);
+
+  mutable std::mutex Mutex;
+
+  /*! Metrics in the order of creation */
+  std::vector<PlusMetric*> Metrics;
+
+private:
+  PlusMetricsRegistry(const PlusMetricsRegistry&);
+  void operator=(const PlusMetricsRegistry&);
+};
+
+#endif
@@ -0,0 +1,813 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusSequenceStreamReader.h"
+
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+  const char* SEQUENCE_FRAME_FIELD_PREFIX = "Seq_Frame";
+  const unsigned int DEFAULT_NUMBER_OF_READ_AHEAD_FRAMES = 32;
+  // Time to wait for a frame before reporting an error (e.g., the file is on a network drive that became unavailable)
+  const int FRAME_READ_TIMEOUT_SEC = 5;
+
+  //----------------------------------------------------------------------------
+  bool IsTrue(const std::string& value)
+  {
+    return STRCASECMP(value.c_str(), "True") == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetPixelTypeFromElementType(const std::string& elementType, igsioCommon::VTKScalarPixelType& pixelType)
+  {
+    if (elementType == "MET_CHAR") { pixelType = VTK_CHAR; }
+    else if (elementType == "MET_UCHAR") { pixelType = VTK_UNSIGNED_CHAR; }
+    else if (elementType == "MET_SHORT") { pixelType = VTK_SHORT; }
+    else if (elementType == "MET_USHORT") { pixelType = VTK_UNSIGNED_SHORT; }
+    else if (elementType == "MET_INT") { pixelType = VTK_INT; }
+    else if (elementType == "MET_UINT") { pixelType = VTK_UNSIGNED_INT; }
+    else if (elementType == "MET_FLOAT") { pixelType = VTK_FLOAT; }
+    else if (elementType == "MET_DOUBLE") { pixelType = VTK_DOUBLE; }
+    else
+    {
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  US_IMAGE_TYPE GetImageTypeFromString(const std::string& imageTypeStr, unsigned int numberOfScalarComponents)
+  {
+    if (STRCASECMP(imageTypeStr.c_str(), "BRIGHTNESS") == 0) { return US_IMG_BRIGHTNESS; }
+    if (STRCASECMP(imageTypeStr.c_str(), "RGB_COLOR") == 0) { return US_IMG_RGB_COLOR; }
+    if (STRCASECMP(imageTypeStr.c_str(), "RF_I_LINE_Q_LINE") == 0) { return US_IMG_RF_I_LINE_Q_LINE; }
+    if (STRCASECMP(imageTypeStr.c_str(), "RF_IQ_LINE") == 0) { return US_IMG_RF_IQ_LINE; }
+    if (STRCASECMP(imageTypeStr.c_str(), "RF_REAL") == 0) { return US_IMG_RF_REAL; }
+    return (numberOfScalarComponents == 3 ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusSequenceStreamReader::PlusSequenceStreamReader()
+  : DataOffsetBytes(0)
+  , PixelType(VTK_UNSIGNED_CHAR)
+  , NumberOfScalarComponents(1)
+  , ImageType(US_IMG_BRIGHTNESS)
+  , ImageOrientation(US_IMG_ORIENT_MF)
+  , FrameSizeBytes(0)
+  , StopRequested(false)
+  , NumberOfReadAheadFrames(DEFAULT_NUMBER_OF_READ_AHEAD_FRAMES)
+  , ReadAheadFirstFrameIndex(0)
+  , ReadAheadLastFrameIndex(0)
+  , RequestedFrameIndex(-1)
+  , FailedFrameIndex(-1)
+  , NumberOfReadAheadMisses(0)
+{
+  this->FrameSize[0] = 0;
+  this->FrameSize[1] = 0;
+  this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusSequenceStreamReader::~PlusSequenceStreamReader()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceStreamReader::Open(const std::string& fileName, bool loadFrameFields/*=true*/)
+{
+  this->Close();
+
+  std::string errorMessage;
+  if (this->ReadHeader(fileName, loadFrameFields, errorMessage) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Cannot stream sequence file " << fileName << ": " << errorMessage);
+    this->Frames.clear();
+    this->IndexedFile.Close();
+    return PLUS_FAIL;
+  }
+  if (this->Frames.empty())
+  {
+    LOG_ERROR("Cannot stream sequence file " << fileName << ": no frames with valid timestamp were found");
+    this->IndexedFile.Close();
+    return PLUS_FAIL;
+  }
+
+  // Frame positions in indexed sequence files are validated when the index is read
+  if (!this->IndexedFile.IsOpen())
+  {
+    this->DataFile.open(this->DataFileName.c_str(), std::ios::in | std::ios::binary);
+    if (!this->DataFile.is_open())
+    {
+      LOG_ERROR("Cannot stream sequence file " << fileName << ": failed to open data file " << this->DataFileName);
+      this->Frames.clear();
+      return PLUS_FAIL;
+    }
+
+    // Make sure that all frames are present in the file, so that a truncated file is detected now and not during replay
+    unsigned int lastFileFrameNumber = this->Frames.back().FileFrameNumber;
+    unsigned long long requiredFileSize = this->DataOffsetBytes + static_cast<unsigned long long>(lastFileFrameNumber + 1) * this->FrameSizeBytes;
+    this->DataFile.seekg(0, std::ios::end);
+    unsigned long long fileSize = static_cast<unsigned long long>(this->DataFile.tellg());
+    if (fileSize < requiredFileSize)
+    {
+      LOG_ERROR("Cannot stream sequence file " << fileName << ": data file " << this->DataFileName << " is truncated (size: "
+                << fileSize << " bytes, expected at least " << requiredFileSize << " bytes)");
+      this->DataFile.close();
+      this->Frames.clear();
+      return PLUS_FAIL;
+    }
+  }
+
+  this->FileName = fileName;
+  this->ReadAheadFirstFrameIndex = 0;
+  this->ReadAheadLastFrameIndex = static_cast<unsigned int>(this->Frames.size() - 1);
+  this->RequestedFrameIndex = -1;
+  this->FailedFrameIndex = -1;
+  this->NumberOfReadAheadMisses = 0;
+  this->StartReaderThread();
+
+  LOG_DEBUG("Sequence file " << fileName << " is opened for streaming: " << this->Frames.size() << " frames, "
+            << this->FrameSizeBytes << " bytes per frame");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceStreamReader::Close()
+{
+  this->StopReaderThread();
+  if (this->DataFile.is_open())
+  {
+    this->DataFile.close();
+  }
+  this->DataFile.clear();
+  this->IndexedFile.Close();
+  this->CacheSlots.clear();
+  this->Frames.clear();
+  this->FileName.clear();
+  this->DataFileName.clear();
+}
+
+//----------------------------------------------------------------------------
+bool PlusSequenceStreamReader::IsOpen() const
+{
+  return this->DataFile.is_open() || this->IndexedFile.IsOpen();
+}
+
+//----------------------------------------------------------------------------
+bool PlusSequenceStreamReader::IsStreamingSupported(const std::string& fileName)
+{
+  PlusSequenceStreamReader reader;
+  std::string errorMessage;
+  if (reader.ReadHeader(fileName, false, errorMessage) != PLUS_SUCCESS)
+  {
+    LOG_DEBUG("Sequence file " << fileName << " cannot be streamed: " << errorMessage);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceStreamReader::ReadHeader(const std::string& fileName, bool loadFrameFields, std::string& errorMessage)
+{
+  if (PlusIndexedSequenceFile::IsIndexedSequenceFileName(fileName))
+  {
+    return this->ReadIndexedSequenceHeader(fileName, loadFrameFields, errorMessage);
+  }
+
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(fileName));
+  if (extension != ".mha" && extension != ".mhd")
+  {
+    errorMessage = "only MetaImage (.mha, .mhd) files can be streamed";
+    return PLUS_FAIL;
+  }
+
+  std::ifstream headerFile(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!headerFile.is_open())
+  {
+    errorMessage = "failed to open file";
+    return PLUS_FAIL;
+  }
+
+  std::vector<unsigned int> dimSize;
+  int numberOfDimensions = 0;
+  std::string elementType;
+  std::string imageTypeStr;
+  std::string orientationStr;
+  std::string elementDataFile;
+  bool compressed = false;
+  bool msbByteOrder = false;
+  long long headerSize = 0;
+  bool elementDataFileFound = false;
+  unsigned long long localDataOffset = 0;
+  this->NumberOfScalarComponents = 1;
+
+  // Frame fields are stored in file frame number order, frames are indexed after the whole header is read
+  std::vector<igsioFieldMapType> fileFrameFields;
+  std::vector<double> fileFrameTimestamps;
+  std::vector<bool> fileFrameHasTimestamp;
+
+  std::string line;
+  while (std::getline(headerFile, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.erase(line.size() - 1);
+    }
+    size_t separatorPos = line.find('=');
+    if (separatorPos == std::string::npos)
+    {
+      continue;
+    }
+    std::string key = igsioCommon::Trim(line.substr(0, separatorPos));
+    std::string value = igsioCommon::Trim(line.substr(separatorPos + 1));
+
+    if (key.compare(0, strlen(SEQUENCE_FRAME_FIELD_PREFIX), SEQUENCE_FRAME_FIELD_PREFIX) == 0)
+    {
+      // Seq_Frame0012_FieldName = value
+      size_t numberStartPos = strlen(SEQUENCE_FRAME_FIELD_PREFIX);
+      size_t numberEndPos = key.find('_', numberStartPos);
+      unsigned int fileFrameNumber = 0;
+      if (numberEndPos == std::string::npos
+          || igsioCommon::StringToNumber<unsigned int>(key.substr(numberStartPos, numberEndPos - numberStartPos), fileFrameNumber) != PLUS_SUCCESS)
+      {
+        continue;
+      }
+      std::string fieldName = key.substr(numberEndPos + 1);
+      if (fileFrameNumber >= fileFrameTimestamps.size())
+      {
+        fileFrameTimestamps.resize(fileFrameNumber + 1, 0.0);
+        fileFrameHasTimestamp.resize(fileFrameNumber + 1, false);
+        if (loadFrameFields)
+        {
+          fileFrameFields.resize(fileFrameNumber + 1);
+        }
+      }
+      if (fieldName == "Timestamp")
+      {
+        double timestamp = 0;
+        if (igsioCommon::StringToNumber<double>(value, timestamp) == PLUS_SUCCESS)
+        {
+          fileFrameTimestamps[fileFrameNumber] = timestamp;
+          fileFrameHasTimestamp[fileFrameNumber] = true;
+        }
+      }
+      if (loadFrameFields)
+      {
+        fileFrameFields[fileFrameNumber][fieldName] = std::make_pair(FRAMEFIELD_NONE, value);
+      }
+    }
+    else if (key == "NDims")
+    {
+      igsioCommon::StringToNumber<int>(value, numberOfDimensions);
+    }
+    else if (key == "DimSize")
+    {
+      std::istringstream dimSizeStream(value);
+      unsigned int size = 0;
+      while (dimSizeStream >> size)
+      {
+        dimSize.push_back(size);
+      }
+    }
+    else if (key == "ElementType")
+    {
+      elementType = value;
+    }
+    else if (key == "ElementNumberOfChannels")
+    {
+      igsioCommon::StringToNumber<unsigned int>(value, this->NumberOfScalarComponents);
+    }
+    else if (key == "CompressedData")
+    {
+      compressed = IsTrue(value);
+    }
+    else if (key == "BinaryDataByteOrderMSB" || key == "ElementByteOrderMSB")
+    {
+      msbByteOrder = msbByteOrder || IsTrue(value);
+    }
+    else if (key == "HeaderSize")
+    {
+      igsioCommon::StringToNumber<long long>(value, headerSize);
+    }
+    else if (key == "UltrasoundImageOrientation")
+    {
+      orientationStr = value;
+    }
+    else if (key == "UltrasoundImageType")
+    {
+      imageTypeStr = value;
+    }
+    else if (key == "ElementDataFile")
+    {
+      // ElementDataFile is always the last field of the header
+      elementDataFile = value;
+      elementDataFileFound = true;
+      localDataOffset = static_cast<unsigned long long>(headerFile.tellg());
+      break;
+    }
+  }
+
+  if (!elementDataFileFound)
+  {
+    errorMessage = "ElementDataFile field is not found in the header";
+    return PLUS_FAIL;
+  }
+  if (compressed)
+  {
+    errorMessage = "compressed files cannot be streamed";
+    return PLUS_FAIL;
+  }
+  if (GetPixelTypeFromElementType(elementType, this->PixelType) != PLUS_SUCCESS)
+  {
+    errorMessage = "unsupported element type: " + elementType;
+    return PLUS_FAIL;
+  }
+  unsigned int bytesPerScalar = igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType);
+  if (msbByteOrder && bytesPerScalar > 1)
+  {
+    errorMessage = "big endian pixel data cannot be streamed";
+    return PLUS_FAIL;
+  }
+  if (numberOfDimensions < 2 || numberOfDimensions > 4 || dimSize.size() != static_cast<size_t>(numberOfDimensions))
+  {
+    errorMessage = "invalid NDims or DimSize field";
+    return PLUS_FAIL;
+  }
+
+  // 2D: single frame, 3D: sequence of 2D frames, 4D: sequence of 3D frames
+  unsigned int numberOfFramesInFile = 1;
+  this->FrameSize[0] = dimSize[0];
+  this->FrameSize[1] = dimSize[1];
+  this->FrameSize[2] = 1;
+  if (numberOfDimensions == 3)
+  {
+    numberOfFramesInFile = dimSize[2];
+  }
+  else if (numberOfDimensions == 4)
+  {
+    this->FrameSize[2] = dimSize[2];
+    numberOfFramesInFile = dimSize[3];
+  }
+  this->FrameSizeBytes = static_cast<size_t>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2]
+                         * this->NumberOfScalarComponents * bytesPerScalar;
+
+  this->ImageType = GetImageTypeFromString(imageTypeStr, this->NumberOfScalarComponents);
+  this->ImageOrientation = US_IMG_ORIENT_MF;
+  if (!orientationStr.empty())
+  {
+    this->ImageOrientation = igsioCommon::GetUsImageOrientationFromString(orientationStr.c_str());
+    if (this->ImageOrientation == US_IMG_ORIENT_XX)
+    {
+      errorMessage = "invalid UltrasoundImageOrientation: " + orientationStr;
+      return PLUS_FAIL;
+    }
+  }
+
+  if (STRCASECMP(elementDataFile.c_str(), "LOCAL") == 0)
+  {
+    this->DataFileName = fileName;
+    this->DataOffsetBytes = localDataOffset;
+  }
+  else
+  {
+    if (STRCASECMP(elementDataFile.c_str(), "LIST") == 0 || elementDataFile.find('%') != std::string::npos)
+    {
+      errorMessage = "pixel data stored in multiple files cannot be streamed";
+      return PLUS_FAIL;
+    }
+    if (headerSize < 0)
+    {
+      errorMessage = "automatic HeaderSize is not supported";
+      return PLUS_FAIL;
+    }
+    this->DataFileName = elementDataFile;
+    if (!vtksys::SystemTools::FileIsFullPath(elementDataFile.c_str()))
+    {
+      this->DataFileName = vtksys::SystemTools::GetFilenamePath(fileName) + "/" + elementDataFile;
+    }
+    this->DataOffsetBytes = static_cast<unsigned long long>(headerSize);
+  }
+
+  // Index the frames that a buffer would accept: frames with a timestamp that is greater than the previous one
+  this->Frames.clear();
+  this->Frames.reserve(numberOfFramesInFile);
+  unsigned int numberOfSkippedFrames = 0;
+  for (unsigned int fileFrameNumber = 0; fileFrameNumber < numberOfFramesInFile; ++fileFrameNumber)
+  {
+    if (fileFrameNumber >= fileFrameHasTimestamp.size() || !fileFrameHasTimestamp[fileFrameNumber]
+        || (!this->Frames.empty() && fileFrameTimestamps[fileFrameNumber] <= this->Frames.back().Timestamp))
+    {
+      ++numberOfSkippedFrames;
+      continue;
+    }
+    FrameIndexEntry entry;
+    entry.FileFrameNumber = fileFrameNumber;
+    entry.Timestamp = fileFrameTimestamps[fileFrameNumber];
+    this->Frames.push_back(entry);
+    if (loadFrameFields)
+    {
+      this->Frames.back().Fields.swap(fileFrameFields[fileFrameNumber]);
+    }
+  }
+  if (numberOfSkippedFrames > 0)
+  {
+    LOG_WARNING(numberOfSkippedFrames << " frames are skipped in sequence file " << fileName << " because of missing or non-increasing timestamps");
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceStreamReader::ReadIndexedSequenceHeader(const std::string& fileName, bool loadFrameFields, std::string& errorMessage)
+{
+  if (this->IndexedFile.Open(fileName) != PLUS_SUCCESS)
+  {
+    errorMessage = "failed to read the frame index";
+    return PLUS_FAIL;
+  }
+
+  // Image properties are taken from the first frame that has an image
+  const PlusIndexedSequenceFile::FrameInfo* referenceFrame = NULL;
+  for (unsigned int fileFrameNumber = 0; fileFrameNumber < this->IndexedFile.GetNumberOfFrames(); ++fileFrameNumber)
+  {
+    if (this->IndexedFile.GetFrameInfo(fileFrameNumber).HasImage)
+    {
+      referenceFrame = &this->IndexedFile.GetFrameInfo(fileFrameNumber);
+      break;
+    }
+  }
+  if (referenceFrame == NULL)
+  {
+    errorMessage = "the file contains no images";
+    this->IndexedFile.Close();
+    return PLUS_FAIL;
+  }
+  this->FrameSize = referenceFrame->FrameSize;
+  this->PixelType = referenceFrame->PixelType;
+  this->NumberOfScalarComponents = referenceFrame->NumberOfScalarComponents;
+  this->ImageType = referenceFrame->ImageType;
+  this->ImageOrientation = referenceFrame->ImageOrientation;
+  this->FrameSizeBytes = static_cast<size_t>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2]
+                         * this->NumberOfScalarComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType);
+
+  this->Frames.clear();
+  this->Frames.reserve(this->IndexedFile.GetNumberOfFrames());
+  unsigned int numberOfSkippedFrames = 0;
+  for (unsigned int fileFrameNumber = 0; fileFrameNumber < this->IndexedFile.GetNumberOfFrames(); ++fileFrameNumber)
+  {
+    const PlusIndexedSequenceFile::FrameInfo& frameInfo = this->IndexedFile.GetFrameInfo(fileFrameNumber);
+    if (!frameInfo.HasImage || frameInfo.FrameSize != this->FrameSize || frameInfo.PixelType != this->PixelType
+        || frameInfo.NumberOfScalarComponents != this->NumberOfScalarComponents
+        || (!this->Frames.empty() && frameInfo.Timestamp <= this->Frames.back().Timestamp))
+    {
+      ++numberOfSkippedFrames;
+      continue;
+    }
+    FrameIndexEntry entry;
+    entry.FileFrameNumber = fileFrameNumber;
+    entry.Timestamp = frameInfo.Timestamp;
+    if (loadFrameFields)
+    {
+      entry.Fields = frameInfo.Fields;
+    }
+    this->Frames.push_back(entry);
+  }
+  if (numberOfSkippedFrames > 0)
+  {
+    LOG_WARNING(numberOfSkippedFrames << " frames are skipped in sequence file " << fileName << " because of missing image, different image properties, or non-increasing timestamps");
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceStreamReader::GetNumberOfFrames() const
+{
+  return static_cast<unsigned int>(this->Frames.size());
+}
+
+//----------------------------------------------------------------------------
+double PlusSequenceStreamReader::GetFrameTimestamp(unsigned int frameIndex) const
+{
+  if (frameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("PlusSequenceStreamReader::GetFrameTimestamp failed: invalid frame index " << frameIndex);
+    return 0;
+  }
+  return this->Frames[frameIndex].Timestamp;
+}
+
+//----------------------------------------------------------------------------
+const igsioFieldMapType& PlusSequenceStreamReader::GetFrameFields(unsigned int frameIndex) const
+{
+  static const igsioFieldMapType emptyFields;
+  if (frameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("PlusSequenceStreamReader::GetFrameFields failed: invalid frame index " << frameIndex);
+    return emptyFields;
+  }
+  return this->Frames[frameIndex].Fields;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceStreamReader::GetFrameIndexFromTime(double timestamp) const
+{
+  if (this->Frames.empty())
+  {
+    return 0;
+  }
+  // Frames are sorted by timestamp
+  std::vector<FrameIndexEntry>::const_iterator it = std::lower_bound(this->Frames.begin(), this->Frames.end(), timestamp,
+      [](const FrameIndexEntry & entry, double time) { return entry.Timestamp < time; });
+  if (it == this->Frames.end())
+  {
+    return static_cast<unsigned int>(this->Frames.size() - 1);
+  }
+  if (it != this->Frames.begin() && timestamp - (it - 1)->Timestamp < it->Timestamp - timestamp)
+  {
+    --it;
+  }
+  return static_cast<unsigned int>(it - this->Frames.begin());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceStreamReader::GetTrackedFrameListWithoutImages(vtkIGSIOTrackedFrameList* trackedFrameList) const
+{
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("PlusSequenceStreamReader::GetTrackedFrameListWithoutImages failed: invalid tracked frame list");
+    return PLUS_FAIL;
+  }
+  trackedFrameList->Clear();
+  for (std::vector<FrameIndexEntry>::const_iterator frameIt = this->Frames.begin(); frameIt != this->Frames.end(); ++frameIt)
+  {
+    igsioTrackedFrame trackedFrame;
+    for (igsioFieldMapType::const_iterator fieldIt = frameIt->Fields.begin(); fieldIt != frameIt->Fields.end(); ++fieldIt)
+    {
+      trackedFrame.SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+    }
+    trackedFrame.SetTimestamp(frameIt->Timestamp);
+    if (trackedFrameList->AddTrackedFrame(&trackedFrame) != IGSIO_SUCCESS)
+    {
+      LOG_ERROR("PlusSequenceStreamReader::GetTrackedFrameListWithoutImages failed: cannot add frame " << frameIt->FileFrameNumber);
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceStreamReader::SetNumberOfReadAheadFrames(unsigned int numberOfReadAheadFrames)
+{
+  bool restartReaderThread = this->ReaderThread.joinable();
+  // Cache slots are accessed by the reader thread, so they can be reallocated only while the thread is stopped
+  this->StopReaderThread();
+  this->NumberOfReadAheadFrames = numberOfReadAheadFrames;
+  if (restartReaderThread)
+  {
+    this->StartReaderThread();
+  }
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceStreamReader::GetNumberOfReadAheadFrames() const
+{
+  return this->NumberOfReadAheadFrames;
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceStreamReader::SetReadAheadFrameRange(unsigned int firstFrameIndex, unsigned int lastFrameIndex)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Frames.empty())
+  {
+    return;
+  }
+  unsigned int maxFrameIndex = static_cast<unsigned int>(this->Frames.size() - 1);
+  this->ReadAheadFirstFrameIndex = std::min(firstFrameIndex, maxFrameIndex);
+  this->ReadAheadLastFrameIndex = std::max(this->ReadAheadFirstFrameIndex, std::min(lastFrameIndex, maxFrameIndex));
+  this->ReadRequestedCondition.notify_one();
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusSequenceStreamReader::GetNextFrameIndex(unsigned int frameIndex) const
+{
+  if (frameIndex == this->ReadAheadLastFrameIndex || frameIndex + 1 >= this->Frames.size())
+  {
+    return this->ReadAheadFirstFrameIndex;
+  }
+  return frameIndex + 1;
+}
+
+//----------------------------------------------------------------------------
+bool PlusSequenceStreamReader::FindFrameToRead(long long& frameIndex, CacheSlot*& slot)
+{
+  if (this->Frames.empty() || this->CacheSlots.empty())
+  {
+    return false;
+  }
+
+  // Frames that should be in the cache: the requested frame and the frames that are replayed after it
+  std::vector<long long> window;
+  unsigned int windowFrameIndex = (this->RequestedFrameIndex >= 0 ? static_cast<unsigned int>(this->RequestedFrameIndex) : this->ReadAheadFirstFrameIndex);
+  while (window.size() < this->CacheSlots.size()
+         && std::find(window.begin(), window.end(), static_cast<long long>(windowFrameIndex)) == window.end())
+  {
+    window.push_back(windowFrameIndex);
+    windowFrameIndex = this->GetNextFrameIndex(windowFrameIndex);
+  }
+
+  for (std::vector<long long>::iterator frameIt = window.begin(); frameIt != window.end(); ++frameIt)
+  {
+    if ((*frameIt) == this->FailedFrameIndex)
+    {
+      continue;
+    }
+    bool alreadyCached = false;
+    CacheSlot* freeSlot = NULL;
+    for (std::vector<CacheSlot>::iterator slotIt = this->CacheSlots.begin(); slotIt != this->CacheSlots.end(); ++slotIt)
+    {
+      if (slotIt->FrameIndex == (*frameIt))
+      {
+        alreadyCached = true;
+        break;
+      }
+      if (freeSlot == NULL && !slotIt->Loading
+          && (slotIt->FrameIndex < 0 || std::find(window.begin(), window.end(), slotIt->FrameIndex) == window.end()))
+      {
+        freeSlot = &(*slotIt);
+      }
+    }
+    if (alreadyCached)
+    {
+      continue;
+    }
+    if (freeSlot == NULL)
+    {
+      return false;
+    }
+    frameIndex = (*frameIt);
+    slot = freeSlot;
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceStreamReader::ReadFramePixelData(unsigned int frameIndex, std::vector<unsigned char>& pixelData)
+{
+  if (this->IndexedFile.IsOpen())
+  {
+    return this->IndexedFile.ReadFramePixels(this->Frames[frameIndex].FileFrameNumber, pixelData);
+  }
+
+  unsigned long long offset = this->DataOffsetBytes + static_cast<unsigned long long>(this->Frames[frameIndex].FileFrameNumber) * this->FrameSizeBytes;
+  pixelData.resize(this->FrameSizeBytes);
+  this->DataFile.clear();
+  this->DataFile.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+  this->DataFile.read(reinterpret_cast<char*>(pixelData.data()), static_cast<std::streamsize>(this->FrameSizeBytes));
+  if (static_cast<size_t>(this->DataFile.gcount()) != this->FrameSizeBytes)
+  {
+    LOG_ERROR("Failed to read frame " << this->Frames[frameIndex].FileFrameNumber << " from " << this->DataFileName);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceStreamReader::ReaderThreadMain()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (!this->StopRequested)
+  {
+    long long frameIndex = -1;
+    CacheSlot* slot = NULL;
+    if (!this->FindFrameToRead(frameIndex, slot))
+    {
+      this->ReadRequestedCondition.wait(lock);
+      continue;
+    }
+
+    // The slot is not evicted or read by others while it is loading, so the file can be read without holding the lock
+    slot->FrameIndex = frameIndex;
+    slot->Loading = true;
+    lock.unlock();
+    PlusStatus status = this->ReadFramePixelData(static_cast<unsigned int>(frameIndex), slot->PixelData);
+    lock.lock();
+    slot->Loading = false;
+    if (status != PLUS_SUCCESS)
+    {
+      slot->FrameIndex = -1;
+      this->FailedFrameIndex = frameIndex;
+    }
+    this->FrameReadCondition.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceStreamReader::StartReaderThread()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  // The requested frame and the read-ahead frames are kept in memory
+  this->CacheSlots.assign(this->NumberOfReadAheadFrames + 1, CacheSlot());
+  for (std::vector<CacheSlot>::iterator slotIt = this->CacheSlots.begin(); slotIt != this->CacheSlots.end(); ++slotIt)
+  {
+    slotIt->FrameIndex = -1;
+    slotIt->Loading = false;
+  }
+  this->StopRequested = false;
+  this->ReaderThread = std::thread(&PlusSequenceStreamReader::ReaderThreadMain, this);
+}
+
+//----------------------------------------------------------------------------
+void PlusSequenceStreamReader::StopReaderThread()
+{
+  if (!this->ReaderThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->StopRequested = true;
+    this->ReadRequestedCondition.notify_all();
+  }
+  this->ReaderThread.join();
+  // Wake up a caller that may wait for a frame
+  this->FrameReadCondition.notify_all();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSequenceStreamReader::GetFramePixels(unsigned int frameIndex, const unsigned char*& pixelData)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  if (frameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("PlusSequenceStreamReader::GetFramePixels failed: invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  if (!this->ReaderThread.joinable())
+  {
+    LOG_ERROR("PlusSequenceStreamReader::GetFramePixels failed: sequence file is not opened");
+    return PLUS_FAIL;
+  }
+
+  this->RequestedFrameIndex = frameIndex;
+  if (this->FailedFrameIndex == static_cast<long long>(frameIndex))
+  {
+    // Try again, the error may have been temporary
+    this->FailedFrameIndex = -1;
+  }
+  this->ReadRequestedCondition.notify_one();
+
+  bool missCounted = false;
+  while (true)
+  {
+    for (std::vector<CacheSlot>::iterator slotIt = this->CacheSlots.begin(); slotIt != this->CacheSlots.end(); ++slotIt)
+    {
+      if (slotIt->FrameIndex == static_cast<long long>(frameIndex) && !slotIt->Loading)
+      {
+        // The slot is not evicted until another frame is requested, because the requested frame is always in the read-ahead window
+        pixelData = slotIt->PixelData.data();
+        return PLUS_SUCCESS;
+      }
+    }
+    if (this->FailedFrameIndex == static_cast<long long>(frameIndex))
+    {
+      LOG_ERROR("PlusSequenceStreamReader::GetFramePixels failed: frame " << frameIndex << " cannot be read from " << this->FileName);
+      return PLUS_FAIL;
+    }
+    if (!missCounted)
+    {
+      ++this->NumberOfReadAheadMisses;
+      missCounted = true;
+    }
+    if (this->FrameReadCondition.wait_for(lock, std::chrono::seconds(FRAME_READ_TIMEOUT_SEC)) == std::cv_status::timeout)
+    {
+      LOG_ERROR("PlusSequenceStreamReader::GetFramePixels failed: timeout while reading frame " << frameIndex << " from " << this->FileName);
+      return PLUS_FAIL;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusSequenceStreamReader::GetNumberOfReadAheadMisses() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->NumberOfReadAheadMisses;
+}
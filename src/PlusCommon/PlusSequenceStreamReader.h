@@ -0,0 +1,184 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusSequenceStreamReader_h
+#define __PlusSequenceStreamReader_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+#include "PlusIndexedSequenceFile.h"
+
+#include <igsioCommon.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class PlusSequenceStreamReader
+  \brief Reads frames of a sequence file one by one, without loading the whole file into memory
+
+  Open() only parses the header of the file: the image properties, the frame fields (timestamps, transforms, etc.)
+  and the position of the pixel data of each frame. Pixel data is read on a background thread: when a frame is requested,
+  the following frames are read ahead into a fixed number of cache slots. Therefore the memory usage depends on the
+  frame size and the number of read-ahead frames, but not on the length of the sequence.
+
+  Frames are indexed in increasing timestamp order. Frames that have no timestamp or have a timestamp that is not greater
+  than the timestamp of the previous frame are skipped (they would not be accepted by a buffer either).
+
+  Uncompressed MetaImage sequence files (.mha, .mhd with .raw data) and Plus indexed sequence files (.pseq) can be streamed,
+  as the pixel data of other formats cannot be located without decompressing the whole file. Use vtkPlusSequenceIO to read other files.
+  Frames of indexed sequence files that have no image or have different image properties than the first frame are skipped.
+
+  GetFramePixels() must be called from one thread only (typically the device update thread).
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusSequenceStreamReader
+{
+public:
+  PlusSequenceStreamReader();
+  virtual ~PlusSequenceStreamReader();
+
+  /*!
+    Parse the header and the frame index of a sequence file and start the background reading thread
+    \param fileName Path of the sequence file
+    \param loadFrameFields If false then only the timestamps of the frames are kept in memory, not the other frame fields
+  */
+  PlusStatus Open(const std::string& fileName, bool loadFrameFields = true);
+
+  /*! Stop the background reading thread and close the file */
+  void Close();
+
+  bool IsOpen() const;
+
+  /*! Returns true if the file format allows reading frames individually. Only the header of the file is read. */
+  static bool IsStreamingSupported(const std::string& fileName);
+
+  /*! Number of indexed frames */
+  unsigned int GetNumberOfFrames() const;
+
+  FrameSizeType GetFrameSize() const { return this->FrameSize; }
+  igsioCommon::VTKScalarPixelType GetPixelType() const { return this->PixelType; }
+  unsigned int GetNumberOfScalarComponents() const { return this->NumberOfScalarComponents; }
+  US_IMAGE_TYPE GetImageType() const { return this->ImageType; }
+  /*! Orientation of the pixel data in the file */
+  US_IMAGE_ORIENTATION GetImageOrientation() const { return this->ImageOrientation; }
+
+  /*! Size of the pixel data of one frame */
+  size_t GetFrameSizeBytes() const { return this->FrameSizeBytes; }
+
+  /*! Get the timestamp of a frame */
+  double GetFrameTimestamp(unsigned int frameIndex) const;
+
+  /*! Get all the frame fields of a frame (empty if frame fields are not loaded) */
+  const igsioFieldMapType& GetFrameFields(unsigned int frameIndex) const;
+
+  /*! Get the index of the frame that has the closest timestamp to the specified time */
+  unsigned int GetFrameIndexFromTime(double timestamp) const;
+
+  /*! Create tracked frames that contain the frame fields (including transforms) of all frames, without image data */
+  PlusStatus GetTrackedFrameListWithoutImages(vtkIGSIOTrackedFrameList* trackedFrameList) const;
+
+  /*! Set the number of frames that are read ahead and kept in memory. Removes all frames from the cache. */
+  void SetNumberOfReadAheadFrames(unsigned int numberOfReadAheadFrames);
+  unsigned int GetNumberOfReadAheadFrames() const;
+
+  /*!
+    Set the range of frames that are replayed. Read-ahead continues with the first frame of the range after the last one,
+    so that there is no delay when replay is started from the beginning.
+  */
+  void SetReadAheadFrameRange(unsigned int firstFrameIndex, unsigned int lastFrameIndex);
+
+  /*!
+    Get the pixel data of a frame. If the frame is not read yet then waits until the background thread reads it.
+    The returned pointer remains valid until the next call of this method.
+  */
+  PlusStatus GetFramePixels(unsigned int frameIndex, const unsigned char*& pixelData);
+
+  /*! Number of frames that were not read yet when they were requested (the read-ahead could not keep up with the replay) */
+  unsigned long long GetNumberOfReadAheadMisses() const;
+
+protected:
+  struct FrameIndexEntry
+  {
+    /*! Position of the frame in the file (frames that are not indexed are counted, too) */
+    unsigned int FileFrameNumber;
+    double Timestamp;
+    igsioFieldMapType Fields;
+  };
+
+  struct CacheSlot
+  {
+    /*! Index of the frame that is stored in this slot, -1 if the slot is empty */
+    long long FrameIndex;
+    /*! True while the background thread reads the pixel data */
+    bool Loading;
+    std::vector<unsigned char> PixelData;
+  };
+
+  /*! Parse the file header. Sets DataFileName and DataOffsetBytes for MetaImage files. */
+  PlusStatus ReadHeader(const std::string& fileName, bool loadFrameFields, std::string& errorMessage);
+
+  /*! Read the frame index of a Plus indexed sequence file */
+  PlusStatus ReadIndexedSequenceHeader(const std::string& fileName, bool loadFrameFields, std::string& errorMessage);
+
+  /*! Get the index of the frame that is replayed after the specified frame */
+  unsigned int GetNextFrameIndex(unsigned int frameIndex) const;
+
+  /*! Find a frame that should be read and a slot where it can be stored. The caller must have locked the mutex. */
+  bool FindFrameToRead(long long& frameIndex, CacheSlot*& slot);
+
+  /*! Read the pixel data of a frame from the file. Called only from the background thread. */
+  PlusStatus ReadFramePixelData(unsigned int frameIndex, std::vector<unsigned char>& pixelData);
+
+  void ReaderThreadMain();
+  void StartReaderThread();
+  void StopReaderThread();
+
+  std::string FileName;
+  std::string DataFileName;
+  unsigned long long DataOffsetBytes;
+  std::ifstream DataFile;
+  /*! Used instead of DataFile if the file is a Plus indexed sequence file */
+  PlusIndexedSequenceFile IndexedFile;
+
+  FrameSizeType FrameSize;
+  igsioCommon::VTKScalarPixelType PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+  US_IMAGE_ORIENTATION ImageOrientation;
+  size_t FrameSizeBytes;
+
+  std::vector<FrameIndexEntry> Frames;
+
+  mutable std::mutex Mutex;
+  std::condition_variable ReadRequestedCondition;
+  std::condition_variable FrameReadCondition;
+  std::thread ReaderThread;
+  bool StopRequested;
+
+  std::vector<CacheSlot> CacheSlots;
+  unsigned int NumberOfReadAheadFrames;
+  unsigned int ReadAheadFirstFrameIndex;
+  unsigned int ReadAheadLastFrameIndex;
+  /*! Index of the most recently requested frame, -1 if no frame has been requested yet */
+  long long RequestedFrameIndex;
+  /*! Index of the frame that could not be read, -1 if there was no read error. It is not read again until it is requested. */
+  long long FailedFrameIndex;
+  unsigned long long NumberOfReadAheadMisses;
+
+private:
+  PlusSequenceStreamReader(const PlusSequenceStreamReader&);
+  void operator=(const PlusSequenceStreamReader&);
+};
+
+#endif
@@ -0,0 +1,495 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusThreadPool.h"
+
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+  // Pool and worker index of the calling thread (NULL and -1 if the thread is not a worker thread)
+  thread_local PlusThreadPool* CurrentThreadPool = NULL;
+  thread_local int CurrentWorkerIndex = -1;
+
+  std::mutex InstanceCreationMutex;
+  PlusThreadPool* Instance = NULL;
+
+  //----------------------------------------------------------------------------
+  void AtomicAdd(std::atomic<double>& value, double increment)
+  {
+    double oldValue = value.load();
+    while (!value.compare_exchange_weak(oldValue, oldValue + increment))
+    {
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  template<class T>
+  void AtomicMax(std::atomic<T>& value, T candidate)
+  {
+    T oldValue = value.load();
+    while (candidate > oldValue && !value.compare_exchange_weak(oldValue, candidate))
+    {
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusThreadPool::TaskGroup::TaskGroup(PlusThreadPool* pool/*=NULL*/)
+  : Pool(pool != NULL ? pool : PlusThreadPool::GetInstance())
+  , NumberOfPendingTasks(0)
+  , NumberOfSubmittedTasks(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusThreadPool::TaskGroup::~TaskGroup()
+{
+  // Wait() returns only after the last task has released the group mutex, so no task accesses the group after this
+  this->Wait();
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::TaskGroup::Submit(const TaskType& task)
+{
+  this->NumberOfPendingTasks++;
+  this->Pool->SubmitTask([this, task]()
+  {
+    try
+    {
+      task();
+    }
+    catch (std::exception& e)
+    {
+      LOG_ERROR("Thread pool task failed with exception: " << e.what());
+    }
+    catch (...)
+    {
+      LOG_ERROR("Thread pool task failed with unknown exception");
+    }
+    // Notify while holding the mutex, as the group may be deleted as soon as Wait() observes the completion
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->NumberOfPendingTasks--;
+    this->TaskStateChanged.notify_all();
+  }, this);
+
+  // Wake up a thread that is waiting for the group, so that it can help executing the new task
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->NumberOfSubmittedTasks++;
+  this->TaskStateChanged.notify_all();
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::TaskGroup::Wait()
+{
+  while (true)
+  {
+    unsigned long long numberOfSubmittedTasks(0);
+    {
+      // The completion is checked while holding the mutex, so the last task has released the mutex when Wait() returns
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (this->NumberOfPendingTasks <= 0)
+      {
+        return;
+      }
+      numberOfSubmittedTasks = this->NumberOfSubmittedTasks;
+    }
+    // Help executing the tasks of the group instead of just blocking a thread (this also prevents deadlock if called from a worker thread).
+    // Tasks of other groups are not executed here, as they could delay the caller for an unknown time.
+    if (this->Pool->RunPendingTask(this))
+    {
+      continue;
+    }
+    // Wait until a task of the group is completed or a new task is submitted to the group (that this thread may execute)
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    this->TaskStateChanged.wait(lock, [this, numberOfSubmittedTasks]
+    {
+      return this->NumberOfPendingTasks <= 0 || this->NumberOfSubmittedTasks != numberOfSubmittedTasks;
+    });
+  }
+}
+
+//----------------------------------------------------------------------------
+int PlusThreadPool::TaskGroup::GetNumberOfPendingTasks() const
+{
+  return this->NumberOfPendingTasks;
+}
+
+//----------------------------------------------------------------------------
+PlusThreadPool* PlusThreadPool::GetInstance()
+{
+  std::lock_guard<std::mutex> lock(InstanceCreationMutex);
+  if (Instance == NULL)
+  {
+    // The instance is intentionally not deleted at exit: worker threads cannot be reliably joined
+    // during static destruction (on some platforms they are already terminated by then)
+    Instance = new PlusThreadPool;
+  }
+  return Instance;
+}
+
+//----------------------------------------------------------------------------
+PlusThreadPool::PlusThreadPool(unsigned int numberOfThreads/*=0*/)
+  : NextWorkerIndex(0)
+  , NumberOfQueuedTasks(0)
+  , StopRequested(false)
+{
+  this->ResetStatistics();
+  std::lock_guard<std::mutex> lock(this->WorkersMutex);
+  this->StartWorkers(numberOfThreads);
+}
+
+//----------------------------------------------------------------------------
+PlusThreadPool::~PlusThreadPool()
+{
+  std::lock_guard<std::mutex> lock(this->WorkersMutex);
+  this->StopWorkers();
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusThreadPool::GetDefaultNumberOfThreads()
+{
+  unsigned int numberOfCores = std::thread::hardware_concurrency();
+  return (numberOfCores < 2 ? 2 : numberOfCores);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadPool::SetNumberOfThreads(unsigned int numberOfThreads)
+{
+  if (this->IsWorkerThread())
+  {
+    LOG_ERROR("PlusThreadPool::SetNumberOfThreads failed: cannot be called from a worker thread of the pool");
+    return PLUS_FAIL;
+  }
+  if (numberOfThreads == 0)
+  {
+    numberOfThreads = GetDefaultNumberOfThreads();
+  }
+
+  std::lock_guard<std::mutex> lock(this->WorkersMutex);
+  if (numberOfThreads == this->Workers.size())
+  {
+    return PLUS_SUCCESS;
+  }
+  this->StopWorkers();
+  this->StartWorkers(numberOfThreads);
+  LOG_DEBUG("Thread pool size is set to " << numberOfThreads);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusThreadPool::GetNumberOfThreads() const
+{
+  std::lock_guard<std::mutex> lock(this->WorkersMutex);
+  return this->Workers.size();
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::StartWorkers(unsigned int numberOfThreads)
+{
+  // WorkersMutex must be locked by the caller
+  if (numberOfThreads == 0)
+  {
+    numberOfThreads = GetDefaultNumberOfThreads();
+  }
+  this->StopRequested = false;
+  for (unsigned int i = 0; i < numberOfThreads; ++i)
+  {
+    this->Workers.push_back(new Worker);
+  }
+  // Threads are started after the list of workers is complete, as workers access each other's queue
+  for (unsigned int i = 0; i < numberOfThreads; ++i)
+  {
+    this->Workers[i]->Thread = std::thread(&PlusThreadPool::WorkerThread, this, i);
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::StopWorkers()
+{
+  // WorkersMutex must be locked by the caller
+  {
+    std::lock_guard<std::mutex> lock(this->WakeUpMutex);
+    this->StopRequested = true;
+  }
+  this->WakeUp.notify_all();
+  for (std::vector<Worker*>::iterator workerIt = this->Workers.begin(); workerIt != this->Workers.end(); ++workerIt)
+  {
+    if ((*workerIt)->Thread.joinable())
+    {
+      (*workerIt)->Thread.join();
+    }
+  }
+  // Workers are deleted only after all threads are stopped, as a running worker may access any queue
+  for (std::vector<Worker*>::iterator workerIt = this->Workers.begin(); workerIt != this->Workers.end(); ++workerIt)
+  {
+    delete (*workerIt);
+  }
+  this->Workers.clear();
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::Submit(const TaskType& task)
+{
+  this->SubmitTask(task, NULL);
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::SubmitTask(const TaskType& task, const TaskGroup* group)
+{
+  QueuedTask queuedTask;
+  queuedTask.Function = task;
+  queuedTask.SubmitTimeSec = GetMonotonicTimeSec();
+  queuedTask.Group = group;
+
+  unsigned int numberOfQueuedTasks = 0;
+  if (CurrentThreadPool == this)
+  {
+    // Submitted from a worker thread: add to the worker's own queue (the list of workers cannot change while a worker is running)
+    Worker* worker = this->Workers[CurrentWorkerIndex];
+    std::lock_guard<std::mutex> queueLock(worker->QueueMutex);
+    worker->Queue.push_back(queuedTask);
+    worker->NumberOfQueuedTasks++;
+    numberOfQueuedTasks = ++this->NumberOfQueuedTasks;
+  }
+  else
+  {
+    std::lock_guard<std::mutex> lock(this->WorkersMutex);
+    Worker* worker = this->Workers[this->NextWorkerIndex++ % this->Workers.size()];
+    std::lock_guard<std::mutex> queueLock(worker->QueueMutex);
+    worker->Queue.push_back(queuedTask);
+    worker->NumberOfQueuedTasks++;
+    numberOfQueuedTasks = ++this->NumberOfQueuedTasks;
+  }
+  AtomicMax(this->MaxNumberOfQueuedTasks, numberOfQueuedTasks);
+
+  // Lock the mutex to make sure the notification is not lost if a worker is just about to start waiting
+  {
+    std::lock_guard<std::mutex> lock(this->WakeUpMutex);
+  }
+  this->WakeUp.notify_one();
+}
+
+//----------------------------------------------------------------------------
+bool PlusThreadPool::RunPendingTask(const TaskGroup* group/*=NULL*/)
+{
+  QueuedTask task;
+  if (CurrentThreadPool == this)
+  {
+    if (!this->PopTask(CurrentWorkerIndex, task, group))
+    {
+      return false;
+    }
+  }
+  else
+  {
+    std::lock_guard<std::mutex> lock(this->WorkersMutex);
+    if (this->Workers.empty() || !this->PopTask(this->NextWorkerIndex % this->Workers.size(), task, group))
+    {
+      return false;
+    }
+  }
+  this->ExecuteTask(task);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool PlusThreadPool::IsWorkerThread() const
+{
+  return CurrentThreadPool == this;
+}
+
+//----------------------------------------------------------------------------
+bool PlusThreadPool::PopTask(int workerIndex, QueuedTask& task, const TaskGroup* group/*=NULL*/)
+{
+  // Tasks are taken from the front of the queues, so they are executed approximately in the order they were submitted
+  const int numberOfWorkers = this->Workers.size();
+  for (int i = 0; i < numberOfWorkers; ++i)
+  {
+    Worker* worker = this->Workers[(workerIndex + i) % numberOfWorkers];
+    if (worker->NumberOfQueuedTasks == 0)
+    {
+      continue;
+    }
+    std::lock_guard<std::mutex> queueLock(worker->QueueMutex);
+    std::deque<QueuedTask>::iterator taskIt = worker->Queue.begin();
+    if (group != NULL)
+    {
+      while (taskIt != worker->Queue.end() && taskIt->Group != group)
+      {
+        ++taskIt;
+      }
+    }
+    if (taskIt == worker->Queue.end())
+    {
+      continue;
+    }
+    task = *taskIt;
+    worker->Queue.erase(taskIt);
+    worker->NumberOfQueuedTasks--;
+    this->NumberOfQueuedTasks--;
+    if (i > 0 && CurrentThreadPool == this)
+    {
+      this->NumberOfStolenTasks++;
+    }
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::ExecuteTask(QueuedTask& task)
+{
+  double startTimeSec = GetMonotonicTimeSec();
+  double queueLatencySec = startTimeSec - task.SubmitTimeSec;
+  AtomicAdd(this->QueueLatencySumSec, queueLatencySec);
+  AtomicMax(this->MaxQueueLatencySec, queueLatencySec);
+
+  try
+  {
+    task.Function();
+  }
+  catch (std::exception& e)
+  {
+    LOG_ERROR("Thread pool task failed with exception: " << e.what());
+  }
+  catch (...)
+  {
+    LOG_ERROR("Thread pool task failed with unknown exception");
+  }
+
+  double executionTimeSec = GetMonotonicTimeSec() - startTimeSec;
+  AtomicAdd(this->ExecutionTimeSumSec, executionTimeSec);
+  AtomicMax(this->MaxExecutionTimeSec, executionTimeSec);
+  this->NumberOfExecutedTasks++;
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::WorkerThread(PlusThreadPool* self, int workerIndex)
+{
+  CurrentThreadPool = self;
+  CurrentWorkerIndex = workerIndex;
+
+  while (true)
+  {
+    QueuedTask task;
+    if (self->PopTask(workerIndex, task))
+    {
+      self->ExecuteTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(self->WakeUpMutex);
+    if (self->StopRequested && self->NumberOfQueuedTasks == 0)
+    {
+      // all queued tasks are completed
+      break;
+    }
+    self->WakeUp.wait(lock, [self] { return self->StopRequested || self->NumberOfQueuedTasks > 0; });
+  }
+
+  CurrentThreadPool = NULL;
+  CurrentWorkerIndex = -1;
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::GetQueueDepths(std::vector<unsigned int>& queueDepths) const
+{
+  std::lock_guard<std::mutex> lock(this->WorkersMutex);
+  queueDepths.clear();
+  for (std::vector<Worker*>::const_iterator workerIt = this->Workers.begin(); workerIt != this->Workers.end(); ++workerIt)
+  {
+    queueDepths.push_back((*workerIt)->NumberOfQueuedTasks);
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadPool::ResetStatistics()
+{
+  this->NumberOfExecutedTasks = 0;
+  this->NumberOfStolenTasks = 0;
+  this->MaxNumberOfQueuedTasks = 0;
+  this->QueueLatencySumSec = 0;
+  this->MaxQueueLatencySec = 0;
+  this->ExecutionTimeSumSec = 0;
+  this->MaxExecutionTimeSec = 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusThreadPool::GetNumberOfExecutedTasks() const
+{
+  return this->NumberOfExecutedTasks;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusThreadPool::GetNumberOfStolenTasks() const
+{
+  return this->NumberOfStolenTasks;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusThreadPool::GetMaxNumberOfQueuedTasks() const
+{
+  return this->MaxNumberOfQueuedTasks;
+}
+
+//----------------------------------------------------------------------------
+double PlusThreadPool::GetMeanQueueLatencySec() const
+{
+  unsigned long long numberOfExecutedTasks = this->NumberOfExecutedTasks;
+  return (numberOfExecutedTasks > 0 ? this->QueueLatencySumSec / numberOfExecutedTasks : 0.0);
+}
+
+//----------------------------------------------------------------------------
+double PlusThreadPool::GetMaxQueueLatencySec() const
+{
+  return this->MaxQueueLatencySec;
+}
+
+//----------------------------------------------------------------------------
+double PlusThreadPool::GetMeanExecutionTimeSec() const
+{
+  unsigned long long numberOfExecutedTasks = this->NumberOfExecutedTasks;
+  return (numberOfExecutedTasks > 0 ? this->ExecutionTimeSumSec / numberOfExecutedTasks : 0.0);
+}
+
+//----------------------------------------------------------------------------
+double PlusThreadPool::GetMaxExecutionTimeSec() const
+{
+  return this->MaxExecutionTimeSec;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusThreadPool::GetStatisticsAsString() const
+{
+  std::vector<unsigned int> queueDepths;
+  this->GetQueueDepths(queueDepths);
+
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(3)
+     << "threads: " << queueDepths.size()
+     << ", executed tasks: " << this->GetNumberOfExecutedTasks()
+     << " (stolen: " << this->GetNumberOfStolenTasks() << ")"
+     << ", queue latency mean/max: " << this->GetMeanQueueLatencySec() * 1000.0 << "/" << this->GetMaxQueueLatencySec() * 1000.0 << " ms"
+     << ", execution time mean/max: " << this->GetMeanExecutionTimeSec() * 1000.0 << "/" << this->GetMaxExecutionTimeSec() * 1000.0 << " ms"
+     << ", max queued tasks: " << this->GetMaxNumberOfQueuedTasks()
+     << ", queue depths: ";
+  for (std::vector<unsigned int>::iterator depthIt = queueDepths.begin(); depthIt != queueDepths.end(); ++depthIt)
+  {
+    ss << (depthIt == queueDepths.begin() ? "" : ",") << (*depthIt);
+  }
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+double PlusThreadPool::GetMonotonicTimeSec()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
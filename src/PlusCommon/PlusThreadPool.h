@@ -0,0 +1,212 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusThreadPool_h
+#define __PlusThreadPool_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+  \class PlusThreadPool
+  \brief Fixed-size pool of worker threads that execute short background tasks
+
+  Each worker has its own task queue. Tasks submitted from a worker thread are added to the queue of that worker,
+  tasks submitted from other threads are distributed between the workers in a round-robin fashion.
+  A worker that runs out of tasks takes (steals) tasks from the queues of the other workers, so a long task does not
+  hold up the tasks that were queued behind it while other workers are idle.
+
+  Tasks should not block for a long time (e.g., waiting for a device or a network connection), as that takes
+  a worker away from all other users of the pool. Continuously running loops should stay in their own threads.
+  Work that may take long but does not wait for external events (e.g., executing commands) should be submitted
+  one task at a time, so it occupies at most one worker. Work that blocks on the network (e.g., sending to clients)
+  should be run by a small, separate pool instance that is owned by the user of that work.
+
+  The application-wide pool is accessible by GetInstance(). Its size can be set in the application configuration
+  file (ThreadPoolSize attribute of the PlusConfig element), by default it has one worker per logical CPU core.
+
+  Statistics are collected about the queue depths, the time between submitting and starting a task (queue latency)
+  and the task execution time.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusThreadPool
+{
+public:
+  typedef std::function<void()> TaskType;
+
+  /*!
+    \class TaskGroup
+    \brief Set of tasks that the caller can wait for
+
+    Wait() executes queued tasks of the group while the tasks of the group are not completed, so it can be called
+    from a worker thread, too. Tasks of other groups are not executed by Wait(), so the waiting thread is not delayed
+    by unrelated (possibly long) tasks. The waiting thread sleeps until a task of the group is completed or a new task
+    is submitted to the group. The destructor waits for the completion of all tasks of the group.
+  */
+  class vtkPlusCommonExport TaskGroup
+  {
+  public:
+    TaskGroup(PlusThreadPool* pool = NULL);
+    virtual ~TaskGroup();
+
+    /*! Add a task to the group and submit it to the pool */
+    void Submit(const TaskType& task);
+
+    /*! Wait until all submitted tasks are completed */
+    void Wait();
+
+    /*! Number of submitted tasks that are not completed yet */
+    int GetNumberOfPendingTasks() const;
+
+  protected:
+    PlusThreadPool* Pool;
+    std::atomic<int> NumberOfPendingTasks;
+    /*! Incremented when a task is submitted, so that a waiting thread can notice new tasks. Guarded by Mutex. */
+    unsigned long long NumberOfSubmittedTasks;
+    std::mutex Mutex;
+    /*! Signaled when a task of the group is completed or submitted */
+    std::condition_variable TaskStateChanged;
+
+  private:
+    TaskGroup(const TaskGroup&);
+    void operator=(const TaskGroup&);
+  };
+
+  /*! Get the application-wide thread pool. It is created at the first call. */
+  static PlusThreadPool* GetInstance();
+
+  /*!
+    Create a thread pool
+    \param numberOfThreads Number of worker threads. If 0 then GetDefaultNumberOfThreads() is used.
+  */
+  PlusThreadPool(unsigned int numberOfThreads = 0);
+
+  /*! Executes all queued tasks then stops the worker threads */
+  virtual ~PlusThreadPool();
+
+  /*! Number of logical CPU cores (at least 2) */
+  static unsigned int GetDefaultNumberOfThreads();
+
+  /*!
+    Change the number of worker threads. Queued tasks are executed by the current workers before they are stopped.
+    Cannot be called from a worker thread of this pool.
+    \param numberOfThreads Number of worker threads. If 0 then GetDefaultNumberOfThreads() is used.
+  */
+  PlusStatus SetNumberOfThreads(unsigned int numberOfThreads);
+  unsigned int GetNumberOfThreads() const;
+
+  /*! Queue a task for execution. Exceptions thrown by the task are logged and ignored. Can be called from any thread. */
+  void Submit(const TaskType& task);
+
+  /*!
+    Execute one queued task in the calling thread, if there is any
+    \param group If not NULL then only a task that was submitted to this group is executed
+    \return True if a task was executed
+  */
+  bool RunPendingTask(const TaskGroup* group = NULL);
+
+  /*! Returns true if the calling thread is a worker thread of this pool */
+  bool IsWorkerThread() const;
+
+  /*! Get the current number of queued tasks of each worker */
+  void GetQueueDepths(std::vector<unsigned int>& queueDepths) const;
+
+  /*! Reset the task statistics */
+  void ResetStatistics();
+
+  /*! Number of tasks executed since the statistics were reset */
+  unsigned long long GetNumberOfExecutedTasks() const;
+
+  /*! Number of tasks that were executed by another worker than the one they were queued for */
+  unsigned long long GetNumberOfStolenTasks() const;
+
+  /*! Largest number of tasks that were queued at the same time */
+  unsigned int GetMaxNumberOfQueuedTasks() const;
+
+  /*! Mean and maximum time between submitting and starting a task, in seconds */
+  double GetMeanQueueLatencySec() const;
+  double GetMaxQueueLatencySec() const;
+
+  /*! Mean and maximum task execution time, in seconds */
+  double GetMeanExecutionTimeSec() const;
+  double GetMaxExecutionTimeSec() const;
+
+  /*! Get a one-line summary of the statistics that can be written to the log */
+  std::string GetStatisticsAsString() const;
+
+protected:
+  struct QueuedTask
+  {
+    TaskType Function;
+    double SubmitTimeSec;
+    /*! Group that the task was submitted to, NULL if it was submitted directly to the pool */
+    const TaskGroup* Group;
+  };
+
+  struct Worker
+  {
+    Worker() : NumberOfQueuedTasks(0) {}
+    std::thread Thread;
+    mutable std::mutex QueueMutex;
+    std::deque<QueuedTask> Queue;
+    std::atomic<unsigned int> NumberOfQueuedTasks;
+  };
+
+  void StartWorkers(unsigned int numberOfThreads);
+  void StopWorkers();
+
+  /*! Queue a task for execution, see Submit() */
+  void SubmitTask(const TaskType& task, const TaskGroup* group);
+
+  /*!
+    Remove the next task from the queue of the specified worker (or from another worker's queue if it is empty)
+    \param group If not NULL then only a task of this group is removed
+  */
+  bool PopTask(int workerIndex, QueuedTask& task, const TaskGroup* group = NULL);
+
+  void ExecuteTask(QueuedTask& task);
+
+  static void WorkerThread(PlusThreadPool* self, int workerIndex);
+
+  static double GetMonotonicTimeSec();
+
+  /*!
+    Guards the list of workers against changes while tasks are submitted from non-worker threads.
+    Worker threads access the list without locking, as it is only changed when all workers are stopped.
+  */
+  mutable std::mutex WorkersMutex;
+  std::vector<Worker*> Workers;
+  std::atomic<unsigned int> NextWorkerIndex;
+
+  std::mutex WakeUpMutex;
+  std::condition_variable WakeUp;
+  std::atomic<unsigned int> NumberOfQueuedTasks;
+  bool StopRequested;
+
+  std::atomic<unsigned long long> NumberOfExecutedTasks;
+  std::atomic<unsigned long long> NumberOfStolenTasks;
+  std::atomic<unsigned int> MaxNumberOfQueuedTasks;
+  std::atomic<double> QueueLatencySumSec;
+  std::atomic<double> MaxQueueLatencySec;
+  std::atomic<double> ExecutionTimeSumSec;
+  std::atomic<double> MaxExecutionTimeSec;
+
+private:
+  PlusThreadPool(const PlusThreadPool&);
+  void operator=(const PlusThreadPool&);
+};
+
+#endif
@@ -0,0 +1,312 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusThreadScheduling.h"
+
+#include <set>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace
+{
+  struct PriorityName
+  {
+    PlusThreadScheduling::ThreadPriorityType Priority;
+    const char* Name;
+  };
+
+  const PriorityName PRIORITY_NAMES[] =
+  {
+    {PlusThreadScheduling::PRIORITY_LOWEST, "Lowest"},
+    {PlusThreadScheduling::PRIORITY_BELOW_NORMAL, "BelowNormal"},
+    {PlusThreadScheduling::PRIORITY_NORMAL, "Normal"},
+    {PlusThreadScheduling::PRIORITY_ABOVE_NORMAL, "AboveNormal"},
+    {PlusThreadScheduling::PRIORITY_HIGHEST, "Highest"},
+    {PlusThreadScheduling::PRIORITY_TIME_CRITICAL, "TimeCritical"}
+  };
+  const int NUMBER_OF_PRIORITY_NAMES = sizeof(PRIORITY_NAMES) / sizeof(PRIORITY_NAMES[0]);
+
+  //----------------------------------------------------------------------------
+  std::string TrimWhitespace(const std::string& str)
+  {
+    const char* whitespace = " \t\r\n";
+    std::string::size_type first = str.find_first_not_of(whitespace);
+    if (first == std::string::npos)
+    {
+      return "";
+    }
+    std::string::size_type last = str.find_last_not_of(whitespace);
+    return str.substr(first, last - first + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  bool ParseCpuIndex(const std::string& str, int& cpuIndex)
+  {
+    std::string trimmed = TrimWhitespace(str);
+    if (trimmed.empty())
+    {
+      return false;
+    }
+    char* end = NULL;
+    long value = strtol(trimmed.c_str(), &end, 10);
+    if (end == NULL || *end != '\0' || value < 0 || value > 4095)
+    {
+      return false;
+    }
+    cpuIndex = static_cast<int>(value);
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadScheduling::GetPriorityFromString(const std::string& priorityName, ThreadPriorityType& priority)
+{
+  for (int i = 0; i < NUMBER_OF_PRIORITY_NAMES; ++i)
+  {
+    if (STRCASECMP(priorityName.c_str(), PRIORITY_NAMES[i].Name) == 0)
+    {
+      priority = PRIORITY_NAMES[i].Priority;
+      return PLUS_SUCCESS;
+    }
+  }
+  LOG_ERROR("Invalid thread priority: " << priorityName << ". Valid values: Lowest, BelowNormal, Normal, AboveNormal, Highest, TimeCritical.");
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusThreadScheduling::GetPriorityAsString(ThreadPriorityType priority)
+{
+  for (int i = 0; i < NUMBER_OF_PRIORITY_NAMES; ++i)
+  {
+    if (PRIORITY_NAMES[i].Priority == priority)
+    {
+      return PRIORITY_NAMES[i].Name;
+    }
+  }
+  return "Normal";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadScheduling::GetCpuListFromString(const std::string& cpuListString, std::vector<int>& cpuList)
+{
+  cpuList.clear();
+  std::set<int> cpus;
+  std::istringstream cpuListStream(cpuListString);
+  std::string range;
+  while (std::getline(cpuListStream, range, ','))
+  {
+    if (TrimWhitespace(range).empty())
+    {
+      continue;
+    }
+    int firstCpu(0);
+    int lastCpu(0);
+    std::string::size_type separatorPos = range.find('-');
+    if (separatorPos == std::string::npos)
+    {
+      if (!ParseCpuIndex(range, firstCpu))
+      {
+        LOG_ERROR("Invalid CPU index '" << range << "' in CPU list: " << cpuListString);
+        return PLUS_FAIL;
+      }
+      lastCpu = firstCpu;
+    }
+    else if (!ParseCpuIndex(range.substr(0, separatorPos), firstCpu) || !ParseCpuIndex(range.substr(separatorPos + 1), lastCpu) || lastCpu < firstCpu)
+    {
+      LOG_ERROR("Invalid CPU range '" << range << "' in CPU list: " << cpuListString);
+      return PLUS_FAIL;
+    }
+    for (int cpu = firstCpu; cpu <= lastCpu; ++cpu)
+    {
+      cpus.insert(cpu);
+    }
+  }
+  cpuList.assign(cpus.begin(), cpus.end());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusThreadScheduling::GetCpuListAsString(const std::vector<int>& cpuList)
+{
+  std::ostringstream str;
+  for (std::vector<int>::size_type i = 0; i < cpuList.size();)
+  {
+    // Write consecutive CPU indices as a range
+    std::vector<int>::size_type last = i;
+    while (last + 1 < cpuList.size() && cpuList[last + 1] == cpuList[last] + 1)
+    {
+      ++last;
+    }
+    if (i > 0)
+    {
+      str << ",";
+    }
+    str << cpuList[i];
+    if (last > i)
+    {
+      str << "-" << cpuList[last];
+    }
+    i = last + 1;
+  }
+  return str.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadScheduling::SetCurrentThreadPriority(ThreadPriorityType priority, bool realTimeScheduling)
+{
+#if defined(_WIN32)
+  int windowsPriority = THREAD_PRIORITY_NORMAL;
+  switch (priority)
+  {
+    case PRIORITY_LOWEST: windowsPriority = THREAD_PRIORITY_LOWEST; break;
+    case PRIORITY_BELOW_NORMAL: windowsPriority = THREAD_PRIORITY_BELOW_NORMAL; break;
+    case PRIORITY_NORMAL: windowsPriority = THREAD_PRIORITY_NORMAL; break;
+    case PRIORITY_ABOVE_NORMAL: windowsPriority = THREAD_PRIORITY_ABOVE_NORMAL; break;
+    case PRIORITY_HIGHEST: windowsPriority = THREAD_PRIORITY_HIGHEST; break;
+    case PRIORITY_TIME_CRITICAL: windowsPriority = THREAD_PRIORITY_TIME_CRITICAL; break;
+  }
+  if (realTimeScheduling)
+  {
+    // There is no separate real-time policy for threads on Windows, the highest thread priority level is the closest equivalent
+    windowsPriority = THREAD_PRIORITY_TIME_CRITICAL;
+  }
+  if (!::SetThreadPriority(::GetCurrentThread(), windowsPriority))
+  {
+    LOG_WARNING("Failed to set thread priority to " << GetPriorityAsString(priority) << " (error code: " << ::GetLastError() << "). Default priority is used.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#else
+  PlusStatus status = PLUS_SUCCESS;
+  if (realTimeScheduling)
+  {
+    // Map the priority levels evenly to the range of SCHED_FIFO priorities
+    int minPriority = sched_get_priority_min(SCHED_FIFO);
+    int maxPriority = sched_get_priority_max(SCHED_FIFO);
+    sched_param schedulingParameters;
+    memset(&schedulingParameters, 0, sizeof(schedulingParameters));
+    schedulingParameters.sched_priority = minPriority + (maxPriority - minPriority) * static_cast<int>(priority) / static_cast<int>(PRIORITY_TIME_CRITICAL);
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedulingParameters);
+    if (result == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+    LOG_WARNING("Real-time (SCHED_FIFO) thread scheduling could not be enabled: " << strerror(result)
+                << ". It requires CAP_SYS_NICE capability or a sufficient real-time priority limit (see ulimit -r). Normal scheduling is used instead.");
+    status = PLUS_FAIL;
+  }
+
+#if defined(__linux__)
+  // On Linux each thread has its own nice value
+  int niceValue = 0;
+  switch (priority)
+  {
+    case PRIORITY_LOWEST: niceValue = 10; break;
+    case PRIORITY_BELOW_NORMAL: niceValue = 5; break;
+    case PRIORITY_NORMAL: niceValue = 0; break;
+    case PRIORITY_ABOVE_NORMAL: niceValue = -5; break;
+    case PRIORITY_HIGHEST: niceValue = -10; break;
+    case PRIORITY_TIME_CRITICAL: niceValue = -20; break;
+  }
+  if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), niceValue) != 0)
+  {
+    LOG_WARNING("Failed to set thread priority to " << GetPriorityAsString(priority) << " (nice value " << niceValue << "): " << strerror(errno)
+                << ". Raising the priority requires CAP_SYS_NICE capability or a sufficient nice limit (see ulimit -e). Default priority is used.");
+    return PLUS_FAIL;
+  }
+#else
+  if (priority != PRIORITY_NORMAL)
+  {
+    LOG_WARNING("Setting thread priority without real-time scheduling is not supported on this platform. Default priority is used.");
+    return PLUS_FAIL;
+  }
+#endif
+  return status;
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadScheduling::SetCurrentThreadAffinity(const std::vector<int>& cpuList)
+{
+#if defined(_WIN32)
+  DWORD_PTR processAffinityMask(0);
+  DWORD_PTR systemAffinityMask(0);
+  if (!::GetProcessAffinityMask(::GetCurrentProcess(), &processAffinityMask, &systemAffinityMask))
+  {
+    LOG_WARNING("Failed to get process CPU affinity (error code: " << ::GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  DWORD_PTR threadAffinityMask = processAffinityMask;
+  if (!cpuList.empty())
+  {
+    threadAffinityMask = 0;
+    for (std::vector<int>::const_iterator cpuIt = cpuList.begin(); cpuIt != cpuList.end(); ++cpuIt)
+    {
+      if (*cpuIt >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+      {
+        LOG_WARNING("CPU " << *cpuIt << " cannot be used in the thread CPU affinity. All CPUs are used.");
+        return PLUS_FAIL;
+      }
+      threadAffinityMask |= (static_cast<DWORD_PTR>(1) << *cpuIt);
+    }
+  }
+  if (::SetThreadAffinityMask(::GetCurrentThread(), threadAffinityMask) == 0)
+  {
+    LOG_WARNING("Failed to set thread CPU affinity to " << GetCpuListAsString(cpuList) << " (error code: " << ::GetLastError() << "). All CPUs are used.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#elif defined(__linux__)
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  if (cpuList.empty())
+  {
+    long numberOfCpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (long cpu = 0; cpu < numberOfCpus && cpu < CPU_SETSIZE; ++cpu)
+    {
+      CPU_SET(cpu, &cpuSet);
+    }
+  }
+  for (std::vector<int>::const_iterator cpuIt = cpuList.begin(); cpuIt != cpuList.end(); ++cpuIt)
+  {
+    if (*cpuIt < 0 || *cpuIt >= CPU_SETSIZE)
+    {
+      LOG_WARNING("CPU " << *cpuIt << " cannot be used in the thread CPU affinity. All CPUs are used.");
+      return PLUS_FAIL;
+    }
+    CPU_SET(*cpuIt, &cpuSet);
+  }
+  int result = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+  if (result != 0)
+  {
+    LOG_WARNING("Failed to set thread CPU affinity to " << GetCpuListAsString(cpuList) << ": " << strerror(result) << ". All CPUs are used.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#else
+  if (!cpuList.empty())
+  {
+    LOG_WARNING("Setting thread CPU affinity is not supported on this platform. All CPUs are used.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#endif
+}
@@ -0,0 +1,70 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusThreadScheduling_h
+#define __PlusThreadScheduling_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusThreadScheduling
+  \brief Utility functions for setting the scheduling priority and CPU affinity of the calling thread
+
+  Priorities are mapped to the thread priority levels on Windows and to nice values on Linux.
+  Real-time scheduling uses SCHED_FIFO on Linux and other POSIX systems and the time critical priority level on Windows.
+
+  Raising the priority or using real-time scheduling usually requires extra privileges (e.g., CAP_SYS_NICE
+  or a non-zero RLIMIT_RTPRIO on Linux). If the requested setting cannot be applied then a warning is logged,
+  PLUS_FAIL is returned, and the thread keeps its previous settings, so callers can continue with default scheduling.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusThreadScheduling
+{
+public:
+  enum ThreadPriorityType
+  {
+    PRIORITY_LOWEST,
+    PRIORITY_BELOW_NORMAL,
+    PRIORITY_NORMAL,
+    PRIORITY_ABOVE_NORMAL,
+    PRIORITY_HIGHEST,
+    PRIORITY_TIME_CRITICAL
+  };
+
+  /*! Convert priority name (Lowest, BelowNormal, Normal, AboveNormal, Highest, TimeCritical; case insensitive) to priority value */
+  static PlusStatus GetPriorityFromString(const std::string& priorityName, ThreadPriorityType& priority);
+
+  /*! Get the name of the priority value, as it is used in configuration files */
+  static std::string GetPriorityAsString(ThreadPriorityType priority);
+
+  /*! Parse a list of CPU indices, such as "2", "0,2" or "1-3,6" */
+  static PlusStatus GetCpuListFromString(const std::string& cpuListString, std::vector<int>& cpuList);
+
+  /*! Get the list of CPU indices as a string that GetCpuListFromString accepts */
+  static std::string GetCpuListAsString(const std::vector<int>& cpuList);
+
+  /*!
+    Set the scheduling priority of the calling thread
+    \param priority Requested priority level
+    \param realTimeScheduling If true then the thread is scheduled with a real-time (first in, first out) policy.
+      If that is not permitted then the priority is still set with the normal policy.
+  */
+  static PlusStatus SetCurrentThreadPriority(ThreadPriorityType priority, bool realTimeScheduling);
+
+  /*! Restrict the calling thread to run only on the listed CPUs. An empty list allows all CPUs. */
+  static PlusStatus SetCurrentThreadAffinity(const std::vector<int>& cpuList);
+
+private:
+  PlusThreadScheduling();
+  ~PlusThreadScheduling();
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusDeadlineSchedulerTest.cxx
+  \brief Tests the deadline scheduler: periodic updates, and updates that are triggered before the deadline
+  (e.g., by a new input item) between the periodic updates.
+
+  Early updates must be counted separately and must not be included in the period statistics,
+  so the measured mean period and the period error histogram only describe the deadline-driven updates.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusDeadlineScheduler.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  unsigned long long GetNumberOfHistogramPeriods(const PlusDeadlineScheduler& scheduler)
+  {
+    std::vector<double> binUpperLimitsSec;
+    std::vector<unsigned long long> binCounts;
+    scheduler.GetPeriodErrorHistogram(binUpperLimitsSec, binCounts);
+    unsigned long long numberOfPeriods(0);
+    for (size_t i = 0; i < binCounts.size(); ++i)
+    {
+      numberOfPeriods += binCounts[i];
+    }
+    return numberOfPeriods;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunSchedulerTest(double periodSec, int numberOfPeriodicUpdates, int numberOfEarlyUpdatesPerPeriod)
+  {
+    PlusDeadlineScheduler scheduler;
+    scheduler.SetPeriodSec(periodSec);
+    scheduler.SetOverrunPolicy(PlusDeadlineScheduler::OVERRUN_SKIP);
+    scheduler.Start();
+
+    for (int i = 0; i < numberOfPeriodicUpdates; ++i)
+    {
+      scheduler.BeginUpdate();
+      scheduler.EndUpdate();
+      // Updates that are triggered right after the periodic update, long before the next deadline
+      for (int j = 0; j < numberOfEarlyUpdatesPerPeriod; ++j)
+      {
+        scheduler.BeginUpdate();
+        scheduler.EndUpdate();
+      }
+      scheduler.SleepUntilNextDeadline();
+    }
+
+    PlusStatus status = PLUS_SUCCESS;
+    const unsigned long long expectedNumberOfEarlyUpdates = static_cast<unsigned long long>(numberOfPeriodicUpdates) * numberOfEarlyUpdatesPerPeriod;
+    if (scheduler.GetNumberOfUpdates() != numberOfPeriodicUpdates + expectedNumberOfEarlyUpdates)
+    {
+      LOG_ERROR("Unexpected number of updates: " << scheduler.GetNumberOfUpdates() << " (expected: " << numberOfPeriodicUpdates + expectedNumberOfEarlyUpdates << ")");
+      status = PLUS_FAIL;
+    }
+    if (scheduler.GetNumberOfEarlyUpdates() != expectedNumberOfEarlyUpdates)
+    {
+      LOG_ERROR("Unexpected number of early updates: " << scheduler.GetNumberOfEarlyUpdates() << " (expected: " << expectedNumberOfEarlyUpdates << ")");
+      status = PLUS_FAIL;
+    }
+
+    // Each period is measured between two consecutive deadline-driven updates
+    const unsigned long long expectedNumberOfPeriods = numberOfPeriodicUpdates - 1;
+    if (GetNumberOfHistogramPeriods(scheduler) != expectedNumberOfPeriods)
+    {
+      LOG_ERROR("Unexpected number of periods in the period error histogram: " << GetNumberOfHistogramPeriods(scheduler) << " (expected: " << expectedNumberOfPeriods << ")");
+      status = PLUS_FAIL;
+    }
+    // Early updates would reduce the mean period to a fraction of the requested period
+    const double meanPeriodSec = scheduler.GetMeanPeriodSec();
+    if (fabs(meanPeriodSec - periodSec) > periodSec * 0.25)
+    {
+      LOG_ERROR("Unexpected mean period: " << meanPeriodSec * 1000.0 << " ms (expected: " << periodSec * 1000.0 << " ms)");
+      status = PLUS_FAIL;
+    }
+    LOG_INFO(numberOfEarlyUpdatesPerPeriod << " early updates per period: " << scheduler.GetStatisticsAsString());
+
+    scheduler.ResetStatistics();
+    if (scheduler.GetNumberOfEarlyUpdates() != 0 || GetNumberOfHistogramPeriods(scheduler) != 0)
+    {
+      LOG_ERROR("Statistics are not cleared by ResetStatistics()");
+      status = PLUS_FAIL;
+    }
+    return status;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double periodSec(0.02);
+  int numberOfUpdates(50);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--period", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &periodSec, "Requested update period in sec (Default: 0.02).");
+  args.AddArgument("--number-of-updates", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfUpdates, "Number of deadline-driven updates (Default: 50).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (periodSec <= 0 || numberOfUpdates < 2)
+  {
+    std::cerr << "Invalid arguments: the period must be positive and at least 2 updates are needed" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  if (RunSchedulerTest(periodSec, numberOfUpdates, 0) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (RunSchedulerTest(periodSec, numberOfUpdates, 3) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
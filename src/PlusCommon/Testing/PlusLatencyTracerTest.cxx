@@ -0,0 +1,373 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusLatencyTracerTest.cxx
+  \brief Tests the latency tracer: overwriting of the oldest trace points when the ring is full,
+  the per-stage latency statistics (50th, 99th percentile and maximum) and the Chrome trace output.
+
+  Trace points are also recorded from several threads while the tracing is disabled and the capacity is changed,
+  to verify that recorders that are still running never write to deleted trace points.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus ResetTracer(unsigned int capacity)
+  {
+    PlusLatencyTracer* tracer = PlusLatencyTracer::GetInstance();
+    tracer->SetEnabled(false);
+    if (tracer->SetCapacity(capacity) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set the tracer capacity to " << capacity);
+      return PLUS_FAIL;
+    }
+    tracer->SetEnabled(true);
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CheckStatistics(PlusLatencyTracer::TraceStageType stage, unsigned int expectedNumberOfTracePoints,
+                             double expectedMedianSec, double expectedPercentile99Sec, double expectedMaxSec, const std::string& description)
+  {
+    unsigned int numberOfTracePoints(0);
+    double medianSec(0);
+    double percentile99Sec(0);
+    double maxSec(0);
+    if (PlusLatencyTracer::GetInstance()->GetStageLatencyStatistics(stage, numberOfTracePoints, medianSec, percentile99Sec, maxSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(description << ": no latency statistics for stage " << PlusLatencyTracer::GetStageName(stage));
+      return PLUS_FAIL;
+    }
+    const double toleranceSec = 1e-9;
+    if (numberOfTracePoints != expectedNumberOfTracePoints
+        || fabs(medianSec - expectedMedianSec) > toleranceSec
+        || fabs(percentile99Sec - expectedPercentile99Sec) > toleranceSec
+        || fabs(maxSec - expectedMaxSec) > toleranceSec)
+    {
+      LOG_ERROR(description << ": unexpected latency statistics of " << numberOfTracePoints << " trace points (p50/p99/max): "
+                << medianSec << "/" << percentile99Sec << "/" << maxSec << " sec (expected " << expectedNumberOfTracePoints << " trace points: "
+                << expectedMedianSec << "/" << expectedPercentile99Sec << "/" << expectedMaxSec << " sec)");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestRingWrapAround()
+  {
+    const unsigned int capacity = 10;
+    const int numberOfRecordedTracePoints = 25;
+    if (ResetTracer(capacity) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    PlusLatencyTracer* tracer = PlusLatencyTracer::GetInstance();
+
+    // The latency of trace point i is i ms, so the statistics show which trace points are kept
+    for (int i = 0; i < numberOfRecordedTracePoints; ++i)
+    {
+      tracer->Record(PlusLatencyTracer::STAGE_BUFFER_ADD_ITEM, 10.0 + i, 10.0 + i + i * 0.001);
+    }
+
+    int numberOfErrors(0);
+    if (tracer->GetNumberOfTracePoints() != capacity)
+    {
+      LOG_ERROR("Ring wrap-around: " << tracer->GetNumberOfTracePoints() << " trace points are stored (expected: " << capacity << ")");
+      numberOfErrors++;
+    }
+    // Only the latest 10 trace points are kept (latency 15-24 ms)
+    if (CheckStatistics(PlusLatencyTracer::STAGE_BUFFER_ADD_ITEM, capacity, 0.020, 0.024, 0.024, "Ring wrap-around") != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+    // Stages without trace points have no statistics
+    unsigned int numberOfTracePoints(0);
+    double medianSec(0);
+    double percentile99Sec(0);
+    double maxSec(0);
+    if (tracer->GetStageLatencyStatistics(PlusLatencyTracer::STAGE_SOCKET_SEND, numberOfTracePoints, medianSec, percentile99Sec, maxSec) == PLUS_SUCCESS
+        || numberOfTracePoints != 0)
+    {
+      LOG_ERROR("Ring wrap-around: statistics are returned for a stage without trace points");
+      numberOfErrors++;
+    }
+
+    tracer->Clear();
+    if (tracer->GetNumberOfTracePoints() != 0
+        || tracer->GetStageLatencyStatistics(PlusLatencyTracer::STAGE_BUFFER_ADD_ITEM, numberOfTracePoints, medianSec, percentile99Sec, maxSec) == PLUS_SUCCESS)
+    {
+      LOG_ERROR("Ring wrap-around: trace points are kept after Clear");
+      numberOfErrors++;
+    }
+
+    LOG_INFO("Ring wrap-around tested, " << numberOfErrors << " errors found");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestStatistics()
+  {
+    if (ResetTracer(1000) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    PlusLatencyTracer* tracer = PlusLatencyTracer::GetInstance();
+
+    // Latencies of 0, 1, ..., 100 ms in a shuffled order (37 and 101 are coprimes), the statistics must not depend on the recording order
+    const int numberOfTracePoints = 101;
+    for (int i = 0; i < numberOfTracePoints; ++i)
+    {
+      int latencyMs = (i * 37) % numberOfTracePoints;
+      tracer->Record(PlusLatencyTracer::STAGE_CHANNEL_GET_FRAME, 100.0 + i, 100.0 + i + latencyMs * 0.001);
+    }
+    // Trace points of other stages are not included in the statistics of the stage
+    tracer->Record(PlusLatencyTracer::STAGE_SOCKET_SEND, 100.0, 105.0);
+
+    int numberOfErrors(0);
+    if (CheckStatistics(PlusLatencyTracer::STAGE_CHANNEL_GET_FRAME, numberOfTracePoints, 0.050, 0.099, 0.100, "Statistics") != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+    if (CheckStatistics(PlusLatencyTracer::STAGE_SOCKET_SEND, 1, 5.0, 5.0, 5.0, "Statistics of a single trace point") != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+
+    const std::string statistics = tracer->GetStatisticsAsString();
+    if (statistics.find("ChannelGetTrackedFrame: 50.000/99.000/100.000 ms (101 trace points)") == std::string::npos
+        || statistics.find("PackMessages: no data") == std::string::npos)
+    {
+      LOG_ERROR("Statistics: unexpected summary:\n" << statistics);
+      numberOfErrors++;
+    }
+
+    LOG_INFO("Latency statistics tested, " << numberOfErrors << " errors found");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int CountOccurrences(const std::string& text, const std::string& pattern)
+  {
+    int count(0);
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + pattern.size()))
+    {
+      count++;
+    }
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestChromeTrace(const std::string& outputFileName)
+  {
+    if (ResetTracer(100) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    PlusLatencyTracer* tracer = PlusLatencyTracer::GetInstance();
+    tracer->Record(PlusLatencyTracer::STAGE_BUFFER_ADD_ITEM, 1.5, 1.5025);
+    tracer->Record(PlusLatencyTracer::STAGE_SOCKET_SEND, 1.5, 1.5100);
+    // Event time before the frame timestamp (e.g., clock adjustment) is written as zero duration
+    tracer->Record(PlusLatencyTracer::STAGE_MESSAGE_PACK, 2.0, 1.999);
+    tracer->SetEnabled(false);
+
+    if (tracer->WriteChromeTrace(outputFileName) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    std::ifstream inputFile(outputFileName.c_str());
+    std::stringstream contents;
+    contents << inputFile.rdbuf();
+    const std::string trace = contents.str();
+
+    int numberOfErrors(0);
+    const std::string expectedHeader = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    if (trace.compare(0, expectedHeader.size(), expectedHeader) != 0
+        || trace.find("]}") == std::string::npos || trace.find("]}") < trace.rfind("}}"))
+    {
+      LOG_ERROR("Chrome trace: unexpected file structure:\n" << trace);
+      numberOfErrors++;
+    }
+    // One thread name event for each stage
+    if (CountOccurrences(trace, "\"name\":\"thread_name\",\"ph\":\"M\"") != PlusLatencyTracer::NUMBER_OF_TRACE_STAGES)
+    {
+      LOG_ERROR("Chrome trace: a thread name is not written for each stage:\n" << trace);
+      numberOfErrors++;
+    }
+    for (int stage = 0; stage < PlusLatencyTracer::NUMBER_OF_TRACE_STAGES; ++stage)
+    {
+      std::ostringstream threadName;
+      threadName << "\"tid\":" << stage << ",\"args\":{\"name\":\"" << PlusLatencyTracer::GetStageName(static_cast<PlusLatencyTracer::TraceStageType>(stage)) << "\"}";
+      if (trace.find(threadName.str()) == std::string::npos)
+      {
+        LOG_ERROR("Chrome trace: thread name of stage " << stage << " is not found:\n" << trace);
+        numberOfErrors++;
+      }
+    }
+    // One complete event for each trace point, times are in microseconds
+    if (CountOccurrences(trace, "\"ph\":\"X\"") != 3)
+    {
+      LOG_ERROR("Chrome trace: a complete event is not written for each trace point:\n" << trace);
+      numberOfErrors++;
+    }
+    const char* expectedEvents[] =
+    {
+      "{\"name\":\"BufferAddItem\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":1500000.0,\"dur\":2500.0,\"args\":{\"frameTimestamp\":1.500000}}",
+      "{\"name\":\"SocketSend\",\"ph\":\"X\",\"pid\":1,\"tid\":4,\"ts\":1500000.0,\"dur\":10000.0,\"args\":{\"frameTimestamp\":1.500000}}",
+      "{\"name\":\"PackMessages\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":2000000.0,\"dur\":0.0,\"args\":{\"frameTimestamp\":2.000000}}"
+    };
+    for (size_t i = 0; i < sizeof(expectedEvents) / sizeof(expectedEvents[0]); ++i)
+    {
+      if (trace.find(expectedEvents[i]) == std::string::npos)
+      {
+        LOG_ERROR("Chrome trace: event is not found: " << expectedEvents[i] << "\n" << trace);
+        numberOfErrors++;
+      }
+    }
+
+    LOG_INFO("Chrome trace output tested, " << numberOfErrors << " errors found");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestCapacityChangeWhileRecording(int numberOfThreads)
+  {
+    if (ResetTracer(64) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    PlusLatencyTracer* tracer = PlusLatencyTracer::GetInstance();
+
+    // Recorders do not check whether the tracing is enabled (as PLUS_TRACE_LATENCY does), so they call Record while the capacity is changed
+    std::atomic<bool> stopRequested(false);
+    std::vector<std::thread> recorders;
+    for (int i = 0; i < numberOfThreads; ++i)
+    {
+      recorders.push_back(std::thread([tracer, i, &stopRequested]()
+      {
+        for (int j = 0; !stopRequested; ++j)
+        {
+          tracer->Record(PlusLatencyTracer::STAGE_CHANNEL_GET_FRAME, i + j * 0.001, i + j * 0.001 + 0.005);
+        }
+      }));
+    }
+
+    int numberOfErrors(0);
+    const unsigned int maxCapacity = 200;
+    for (unsigned int capacity = 1; capacity <= maxCapacity; ++capacity)
+    {
+      if (ResetTracer(capacity) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+        break;
+      }
+      std::this_thread::yield();
+      if (tracer->GetNumberOfTracePoints() > capacity)
+      {
+        LOG_ERROR("Capacity change while recording: " << tracer->GetNumberOfTracePoints() << " trace points are stored in a ring of " << capacity);
+        numberOfErrors++;
+      }
+    }
+    // Wait until the last ring is filled
+    while (numberOfErrors == 0 && tracer->GetNumberOfTracePoints() < maxCapacity)
+    {
+      std::this_thread::yield();
+    }
+    stopRequested = true;
+    for (std::vector<std::thread>::iterator it = recorders.begin(); it != recorders.end(); ++it)
+    {
+      it->join();
+    }
+    tracer->SetEnabled(false);
+
+    // Trace points that are written by several recorders at the same time are dropped, so all stored trace points must be consistent.
+    // The exact number of stored trace points is not known, as recorders that started before the last capacity change may still write.
+    unsigned int numberOfTracePoints(0);
+    double medianSec(0);
+    double percentile99Sec(0);
+    double maxSec(0);
+    if (tracer->GetStageLatencyStatistics(PlusLatencyTracer::STAGE_CHANNEL_GET_FRAME, numberOfTracePoints, medianSec, percentile99Sec, maxSec) != PLUS_SUCCESS
+        || numberOfTracePoints > maxCapacity
+        || fabs(medianSec - 0.005) > 1e-9 || fabs(percentile99Sec - 0.005) > 1e-9 || fabs(maxSec - 0.005) > 1e-9)
+    {
+      LOG_ERROR("Capacity change while recording: unexpected latency statistics of " << numberOfTracePoints << " trace points (p50/p99/max): "
+                << medianSec << "/" << percentile99Sec << "/" << maxSec << " sec (expected: 0.005 sec)");
+      numberOfErrors++;
+    }
+
+    LOG_INFO("Capacity change while recording tested, " << numberOfErrors << " errors found");
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfThreads(4);
+  std::string outputFileName("PlusLatencyTracerTest.json");
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads that record trace points while the capacity is changed (Default: 4).");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "Name of the Chrome trace file that is written (Default: PlusLatencyTracerTest.json).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfThreads < 1)
+  {
+    std::cerr << "Invalid arguments: number of threads must be at least 1" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  numberOfErrors += TestRingWrapAround();
+  numberOfErrors += TestStatistics();
+  numberOfErrors += TestChromeTrace(outputFileName);
+  numberOfErrors += TestCapacityChangeWhileRecording(numberOfThreads);
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
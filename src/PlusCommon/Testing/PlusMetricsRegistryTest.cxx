@@ -0,0 +1,269 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusMetricsRegistryTest.cxx
+  \brief Tests the metrics registry: identification of metrics by name and labels, Prometheus text output,
+  name prefix filtering, removal of metrics, rate meters and writing the metrics file.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool Contains(const std::string& text, const std::string& expected)
+  {
+    return text.find(expected) != std::string::npos;
+  }
+
+  //----------------------------------------------------------------------------
+  int CountOccurrences(const std::string& text, const std::string& expected)
+  {
+    int count(0);
+    for (size_t pos = text.find(expected); pos != std::string::npos; pos = text.find(expected, pos + expected.size()))
+    {
+      count++;
+    }
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusMetric::LabelMapType GetLabels(const std::string& deviceId, const std::string& sourceId)
+  {
+    PlusMetric::LabelMapType labels;
+    labels["device"] = deviceId;
+    labels["source"] = sourceId;
+    return labels;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestMetricIdentity()
+  {
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    PlusMetric* videoMetric = registry->GetMetric("plus_test_identity_total", "Identity test", PlusMetric::METRIC_COUNTER, GetLabels("Device", "Video"));
+    PlusMetric* videoMetricAgain = registry->GetMetric("plus_test_identity_total", "Identity test", PlusMetric::METRIC_COUNTER, GetLabels("Device", "Video"));
+    PlusMetric* trackerMetric = registry->GetMetric("plus_test_identity_total", "Identity test", PlusMetric::METRIC_COUNTER, GetLabels("Device", "Tracker"));
+    PlusMetric* otherDeviceMetric = registry->GetMetric("plus_test_identity_total", "Identity test", PlusMetric::METRIC_COUNTER, GetLabels("OtherDevice", "Video"));
+    if (videoMetric != videoMetricAgain)
+    {
+      LOG_ERROR("Metric identity: requesting a metric with the same name and labels returned a different metric");
+      return PLUS_FAIL;
+    }
+    if (videoMetric == trackerMetric || videoMetric == otherDeviceMetric || trackerMetric == otherDeviceMetric)
+    {
+      LOG_ERROR("Metric identity: metrics with different labels are not distinguished");
+      return PLUS_FAIL;
+    }
+
+    videoMetric->Add(2);
+    videoMetricAgain->Add(3);
+    trackerMetric->Set(7);
+    if (videoMetric->Get() != 5 || trackerMetric->Get() != 7 || otherDeviceMetric->Get() != 0)
+    {
+      LOG_ERROR("Metric identity: unexpected values: " << videoMetric->Get() << ", " << trackerMetric->Get() << ", " << otherDeviceMetric->Get()
+                << " (expected: 5, 7, 0)");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Metric identity: metrics are identified by name and labels");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestPrometheusText()
+  {
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    registry->GetMetric("plus_test_text_items_total", "Number of test items", PlusMetric::METRIC_COUNTER, GetLabels("Device", "Video"))->Set(3);
+    registry->GetMetric("plus_test_text_items_total", "Number of test items", PlusMetric::METRIC_COUNTER, GetLabels("Device", "Tracker"))->Set(4);
+    registry->GetMetric("plus_test_text_rate_hz", "Test rate", PlusMetric::METRIC_GAUGE, "device", "Quote\"Device")->Set(2.5);
+
+    std::string text = registry->GetMetricsAsPrometheusText("plus_test_text_");
+    if (CountOccurrences(text, "# HELP plus_test_text_items_total Number of test items\n") != 1
+        || CountOccurrences(text, "# TYPE plus_test_text_items_total counter\n") != 1
+        || !Contains(text, "# TYPE plus_test_text_rate_hz gauge\n"))
+    {
+      LOG_ERROR("Prometheus text: each metric name must have exactly one HELP and TYPE line:\n" << text);
+      return PLUS_FAIL;
+    }
+    if (!Contains(text, "plus_test_text_items_total{device=\"Device\",source=\"Video\"} 3\n")
+        || !Contains(text, "plus_test_text_items_total{device=\"Device\",source=\"Tracker\"} 4\n")
+        || !Contains(text, "plus_test_text_rate_hz{device=\"Quote\\\"Device\"} 2.5\n"))
+    {
+      LOG_ERROR("Prometheus text: unexpected metric values or labels:\n" << text);
+      return PLUS_FAIL;
+    }
+    if (Contains(text, "plus_test_identity_total"))
+    {
+      LOG_ERROR("Prometheus text: metrics that do not match the name prefix are returned:\n" << text);
+      return PLUS_FAIL;
+    }
+    if (!Contains(registry->GetMetricsAsPrometheusText(), "plus_test_identity_total"))
+    {
+      LOG_ERROR("Prometheus text: not all metrics are returned if no prefix is specified");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Prometheus text: metrics are formatted and filtered correctly");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestRemoveMetrics()
+  {
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    PlusMetric* removedMetric = registry->GetMetric("plus_test_remove_total", "Removal test", PlusMetric::METRIC_COUNTER, "client", "1");
+    PlusMetric* keptMetric = registry->GetMetric("plus_test_remove_total", "Removal test", PlusMetric::METRIC_COUNTER, "client", "2");
+    removedMetric->Set(10);
+    keptMetric->Set(20);
+
+    registry->RemoveMetrics("client", "1");
+    std::string text = registry->GetMetricsAsPrometheusText("plus_test_remove_");
+    if (Contains(text, "client=\"1\"") || !Contains(text, "plus_test_remove_total{client=\"2\"} 20\n") || removedMetric->Get() != 0)
+    {
+      LOG_ERROR("Remove metrics: the removed metric is still reported or it was not reset:\n" << text);
+      return PLUS_FAIL;
+    }
+
+    // A component with the same label value (e.g., a client that reconnects) gets the metric back
+    if (registry->GetMetric("plus_test_remove_total", "Removal test", PlusMetric::METRIC_COUNTER, "client", "1") != removedMetric)
+    {
+      LOG_ERROR("Remove metrics: a removed metric was not reused when it was requested again");
+      return PLUS_FAIL;
+    }
+    if (!Contains(registry->GetMetricsAsPrometheusText("plus_test_remove_"), "plus_test_remove_total{client=\"1\"} 0\n"))
+    {
+      LOG_ERROR("Remove metrics: a metric that is requested again after removal is not reported");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Remove metrics: removed metrics are hidden until they are requested again");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestRateMeter()
+  {
+    PlusMetric* rateMetric = PlusMetricsRegistry::GetInstance()->GetMetric("plus_test_rate_hz", "Rate meter test", PlusMetric::METRIC_GAUGE, "device", "RateDevice");
+    PlusMetricRateMeter rateMeter(1.0);
+    rateMeter.SetGauge(rateMetric);
+
+    // 10 items in every 0.1 sec, the rate is only updated when the window is complete
+    const double startTime = 100.0;
+    for (int i = 0; i < 10; ++i)
+    {
+      rateMeter.Add(10, startTime + i * 0.1);
+    }
+    if (rateMetric->Get() != 0)
+    {
+      LOG_ERROR("Rate meter: the rate was updated before the end of the window: " << rateMetric->Get());
+      return PLUS_FAIL;
+    }
+    rateMeter.Add(0, startTime + 1.0);
+    if (fabs(rateMetric->Get() - 100.0) > 1e-6)
+    {
+      LOG_ERROR("Rate meter: unexpected rate: " << rateMetric->Get() << " (expected: 100)");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Rate meter: rate is " << rateMetric->Get() << " Hz");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWriteFile(const std::string& fileName)
+  {
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    if (registry->WritePrometheusTextFile(fileName) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Write file: failed to write " << fileName);
+      return PLUS_FAIL;
+    }
+    // The existing file must be replaced
+    if (registry->WritePrometheusTextFile(fileName) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Write file: failed to overwrite " << fileName);
+      return PLUS_FAIL;
+    }
+    std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+    std::stringstream fileContent;
+    fileContent << file.rdbuf();
+    if (fileContent.str() != registry->GetMetricsAsPrometheusText())
+    {
+      LOG_ERROR("Write file: the content of " << fileName << " differs from the metrics");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Write file: metrics are written to " << fileName);
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string outputFileName("PlusMetricsRegistryTest.prom");
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "File that the metrics are written to (Default: PlusMetricsRegistryTest.prom).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  if (TestMetricIdentity() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestPrometheusText() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestRemoveMetrics() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestRateMeter() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWriteFile(outputFileName) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
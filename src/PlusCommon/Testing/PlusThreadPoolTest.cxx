@@ -0,0 +1,298 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusThreadPoolTest.cxx
+  \brief Tests the thread pool: submitting and waiting for tasks, work stealing, waiting for a task group
+  without executing unrelated tasks, executing tasks that are submitted to a group while a thread waits for it,
+  and deleting a pool that still has queued tasks.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusThreadPool.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  double GetTimeSec()
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  //----------------------------------------------------------------------------
+  void SleepMs(int milliseconds)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestSubmitAndWait(int numberOfTasks)
+  {
+    PlusThreadPool pool(4);
+    std::atomic<int> numberOfExecutedTasks(0);
+    {
+      PlusThreadPool::TaskGroup group(&pool);
+      for (int i = 0; i < numberOfTasks; ++i)
+      {
+        group.Submit([&numberOfExecutedTasks]() { numberOfExecutedTasks++; });
+      }
+      group.Wait();
+      if (group.GetNumberOfPendingTasks() != 0)
+      {
+        LOG_ERROR("Submit and wait: " << group.GetNumberOfPendingTasks() << " tasks are pending after Wait()");
+        return PLUS_FAIL;
+      }
+    }
+    if (numberOfExecutedTasks != numberOfTasks)
+    {
+      LOG_ERROR("Submit and wait: " << numberOfExecutedTasks << " tasks were executed (expected: " << numberOfTasks << ")");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Submit and wait: " << pool.GetStatisticsAsString());
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWorkStealing(int numberOfTasks)
+  {
+    PlusThreadPool pool(4);
+    std::atomic<int> numberOfExecutedTasks(0);
+    PlusThreadPool::TaskGroup outerGroup(&pool);
+    // Tasks submitted from a worker thread are queued for that worker, the idle workers have to steal them
+    outerGroup.Submit([&pool, &numberOfExecutedTasks, numberOfTasks]()
+    {
+      PlusThreadPool::TaskGroup innerGroup(&pool);
+      for (int i = 0; i < numberOfTasks; ++i)
+      {
+        innerGroup.Submit([&numberOfExecutedTasks]()
+        {
+          SleepMs(2);
+          numberOfExecutedTasks++;
+        });
+      }
+      innerGroup.Wait();
+    });
+    outerGroup.Wait();
+
+    if (numberOfExecutedTasks != numberOfTasks)
+    {
+      LOG_ERROR("Work stealing: " << numberOfExecutedTasks << " tasks were executed (expected: " << numberOfTasks << ")");
+      return PLUS_FAIL;
+    }
+    if (pool.GetNumberOfStolenTasks() == 0)
+    {
+      LOG_ERROR("Work stealing: no tasks were stolen by idle workers");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Work stealing: " << pool.GetStatisticsAsString());
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWaitRunsOnlyGroupTasks()
+  {
+    const int unrelatedTaskDurationMs = 500;
+    PlusThreadPool pool(1);
+
+    // Keep the only worker busy, so that queued tasks can only be executed by the waiting thread
+    std::atomic<bool> workerBlocked(false);
+    std::atomic<bool> releaseWorker(false);
+    PlusThreadPool::TaskGroup blockingGroup(&pool);
+    blockingGroup.Submit([&workerBlocked, &releaseWorker]()
+    {
+      workerBlocked = true;
+      while (!releaseWorker)
+      {
+        SleepMs(1);
+      }
+    });
+    while (!workerBlocked)
+    {
+      SleepMs(1);
+    }
+
+    // An unrelated long task is queued before the task of the group
+    const std::thread::id waitingThreadId = std::this_thread::get_id();
+    std::atomic<bool> unrelatedTaskRunOnWaitingThread(false);
+    pool.Submit([&unrelatedTaskRunOnWaitingThread, waitingThreadId, unrelatedTaskDurationMs]()
+    {
+      if (std::this_thread::get_id() == waitingThreadId)
+      {
+        unrelatedTaskRunOnWaitingThread = true;
+      }
+      SleepMs(unrelatedTaskDurationMs);
+    });
+    std::atomic<bool> groupTaskExecuted(false);
+    PlusThreadPool::TaskGroup group(&pool);
+    group.Submit([&groupTaskExecuted]() { groupTaskExecuted = true; });
+
+    const double startTimeSec = GetTimeSec();
+    group.Wait();
+    const double waitTimeSec = GetTimeSec() - startTimeSec;
+
+    releaseWorker = true;
+    blockingGroup.Wait();
+
+    if (!groupTaskExecuted)
+    {
+      LOG_ERROR("Group wait: the task of the group was not executed");
+      return PLUS_FAIL;
+    }
+    if (unrelatedTaskRunOnWaitingThread)
+    {
+      LOG_ERROR("Group wait: an unrelated task was executed by the thread that waited for the group");
+      return PLUS_FAIL;
+    }
+    if (waitTimeSec * 1000.0 >= unrelatedTaskDurationMs)
+    {
+      LOG_ERROR("Group wait: waiting for a short task took " << waitTimeSec * 1000.0 << " ms");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Group wait: waited " << waitTimeSec * 1000.0 << " ms for the task of the group");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWaitRunsLateSubmittedTasks()
+  {
+    const int maxWaitTimeMs = 2000;
+    PlusThreadPool pool(1);
+    PlusThreadPool::TaskGroup group(&pool);
+
+    // The only worker runs a task that submits another task of the group and waits for its completion.
+    // The new task can only be executed by the thread that waits for the group, which must be woken up by the submission.
+    const std::thread::id waitingThreadId = std::this_thread::get_id();
+    std::atomic<bool> lateTaskRunOnWaitingThread(false);
+    std::atomic<bool> lateTaskExecuted(false);
+    std::atomic<double> lateTaskWaitTimeSec(0);
+    std::atomic<bool> workerStarted(false);
+    group.Submit([&group, &workerStarted, &lateTaskRunOnWaitingThread, &lateTaskExecuted, &lateTaskWaitTimeSec, waitingThreadId, maxWaitTimeMs]()
+    {
+      workerStarted = true;
+      // Let the waiting thread go to sleep
+      SleepMs(50);
+      const double submitTimeSec = GetTimeSec();
+      group.Submit([&lateTaskRunOnWaitingThread, &lateTaskExecuted, waitingThreadId]()
+      {
+        lateTaskRunOnWaitingThread = (std::this_thread::get_id() == waitingThreadId);
+        lateTaskExecuted = true;
+      });
+      while (!lateTaskExecuted && (GetTimeSec() - submitTimeSec) * 1000.0 < maxWaitTimeMs)
+      {
+        SleepMs(1);
+      }
+      lateTaskWaitTimeSec = GetTimeSec() - submitTimeSec;
+    });
+    // Wait() must not execute the first task, so it is started by the worker first
+    while (!workerStarted)
+    {
+      SleepMs(1);
+    }
+    group.Wait();
+
+    if (!lateTaskExecuted || !lateTaskRunOnWaitingThread)
+    {
+      LOG_ERROR("Late submitted task: the task that was submitted during the wait was not executed by the waiting thread");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Late submitted task: executed by the waiting thread " << lateTaskWaitTimeSec * 1000.0 << " ms after submission");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestShutdownWithPendingTasks(int numberOfTasks)
+  {
+    std::atomic<int> numberOfExecutedTasks(0);
+    PlusThreadPool* pool = new PlusThreadPool(2);
+    for (int i = 0; i < numberOfTasks; ++i)
+    {
+      pool->Submit([&numberOfExecutedTasks]()
+      {
+        SleepMs(1);
+        numberOfExecutedTasks++;
+      });
+    }
+    // The pool executes the queued tasks before its workers are stopped
+    delete pool;
+    if (numberOfExecutedTasks != numberOfTasks)
+    {
+      LOG_ERROR("Shutdown: " << numberOfExecutedTasks << " tasks were executed before the pool was deleted (expected: " << numberOfTasks << ")");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Shutdown: all " << numberOfTasks << " queued tasks were executed");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfTasks(1000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-tasks", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfTasks, "Number of tasks submitted in the submit and wait test (Default: 1000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  if (TestSubmitAndWait(numberOfTasks) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWorkStealing(100) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWaitRunsOnlyGroupTasks() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWaitRunsLateSubmittedTasks() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestShutdownWithPendingTasks(100) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusThreadSchedulingTest.cxx
+  \brief Tests parsing of the thread scheduling settings: CPU lists (indices, ranges, invalid lists) and priority names.
+
+  Invalid settings must be rejected, so the test logs errors by design, the result is given by the return value.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusThreadScheduling.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <string>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus TestValidCpuList(const std::string& cpuListString, const std::vector<int>& expectedCpuList, const std::string& expectedCpuListString)
+  {
+    std::vector<int> cpuList;
+    if (PlusThreadScheduling::GetCpuListFromString(cpuListString, cpuList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Valid CPU list '" << cpuListString << "' is rejected");
+      return PLUS_FAIL;
+    }
+    if (cpuList != expectedCpuList)
+    {
+      LOG_ERROR("CPU list '" << cpuListString << "' is parsed as '" << PlusThreadScheduling::GetCpuListAsString(cpuList)
+                << "' (expected: '" << PlusThreadScheduling::GetCpuListAsString(expectedCpuList) << "')");
+      return PLUS_FAIL;
+    }
+    if (PlusThreadScheduling::GetCpuListAsString(cpuList) != expectedCpuListString)
+    {
+      LOG_ERROR("CPU list '" << cpuListString << "' is written as '" << PlusThreadScheduling::GetCpuListAsString(cpuList) << "' (expected: '" << expectedCpuListString << "')");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestInvalidCpuList(const std::string& cpuListString)
+  {
+    // the output list is cleared, so that an invalid setting does not leave a partially parsed list
+    std::vector<int> cpuList(1, 7);
+    if (PlusThreadScheduling::GetCpuListFromString(cpuListString, cpuList) == PLUS_SUCCESS)
+    {
+      LOG_ERROR("Invalid CPU list '" << cpuListString << "' is accepted as '" << PlusThreadScheduling::GetCpuListAsString(cpuList) << "'");
+      return PLUS_FAIL;
+    }
+    if (!cpuList.empty())
+    {
+      LOG_ERROR("Invalid CPU list '" << cpuListString << "' is partially parsed as '" << PlusThreadScheduling::GetCpuListAsString(cpuList) << "'");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestCpuLists()
+  {
+    int numberOfErrors(0);
+
+    const int singleCpu[] = { 2 };
+    const int twoCpus[] = { 0, 2 };
+    const int rangeAndCpu[] = { 1, 2, 3, 6 };
+    const int overlappingRanges[] = { 1, 2, 3, 4 };
+    numberOfErrors += TestValidCpuList("2", std::vector<int>(singleCpu, singleCpu + 1), "2") == PLUS_SUCCESS ? 0 : 1;
+    numberOfErrors += TestValidCpuList("0,2", std::vector<int>(twoCpus, twoCpus + 2), "0,2") == PLUS_SUCCESS ? 0 : 1;
+    numberOfErrors += TestValidCpuList("1-3,6", std::vector<int>(rangeAndCpu, rangeAndCpu + 4), "1-3,6") == PLUS_SUCCESS ? 0 : 1;
+    // whitespace and the order of the items do not matter, duplicates are removed
+    numberOfErrors += TestValidCpuList(" 6 , 1 - 3 ", std::vector<int>(rangeAndCpu, rangeAndCpu + 4), "1-3,6") == PLUS_SUCCESS ? 0 : 1;
+    numberOfErrors += TestValidCpuList("3-4,1-3,2", std::vector<int>(overlappingRanges, overlappingRanges + 4), "1-4") == PLUS_SUCCESS ? 0 : 1;
+    numberOfErrors += TestValidCpuList("2-2", std::vector<int>(singleCpu, singleCpu + 1), "2") == PLUS_SUCCESS ? 0 : 1;
+    // empty list allows all CPUs
+    numberOfErrors += TestValidCpuList("", std::vector<int>(), "") == PLUS_SUCCESS ? 0 : 1;
+    numberOfErrors += TestValidCpuList(" , ", std::vector<int>(), "") == PLUS_SUCCESS ? 0 : 1;
+
+    const char* invalidCpuLists[] = { "a", "1,x", "1.5", "-1", "1-", "-", "3-1", "1-2-3", "4096", "0-4096", "99999999999999999999", "2;3" };
+    for (size_t i = 0; i < sizeof(invalidCpuLists) / sizeof(invalidCpuLists[0]); ++i)
+    {
+      numberOfErrors += TestInvalidCpuList(invalidCpuLists[i]) == PLUS_SUCCESS ? 0 : 1;
+    }
+
+    LOG_INFO("CPU list parsing tested, " << numberOfErrors << " errors found");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestPriorityNames()
+  {
+    int numberOfErrors(0);
+
+    // each priority is written to a name that is parsed to the same priority
+    const PlusThreadScheduling::ThreadPriorityType priorities[] =
+    {
+      PlusThreadScheduling::PRIORITY_LOWEST,
+      PlusThreadScheduling::PRIORITY_BELOW_NORMAL,
+      PlusThreadScheduling::PRIORITY_NORMAL,
+      PlusThreadScheduling::PRIORITY_ABOVE_NORMAL,
+      PlusThreadScheduling::PRIORITY_HIGHEST,
+      PlusThreadScheduling::PRIORITY_TIME_CRITICAL
+    };
+    for (size_t i = 0; i < sizeof(priorities) / sizeof(priorities[0]); ++i)
+    {
+      const std::string priorityName = PlusThreadScheduling::GetPriorityAsString(priorities[i]);
+      PlusThreadScheduling::ThreadPriorityType priority(PlusThreadScheduling::PRIORITY_NORMAL);
+      if (PlusThreadScheduling::GetPriorityFromString(priorityName, priority) != PLUS_SUCCESS || priority != priorities[i])
+      {
+        LOG_ERROR("Priority " << priorities[i] << " is written as '" << priorityName << "', which is not parsed to the same priority");
+        numberOfErrors++;
+      }
+    }
+
+    // names are case insensitive
+    PlusThreadScheduling::ThreadPriorityType priority(PlusThreadScheduling::PRIORITY_NORMAL);
+    if (PlusThreadScheduling::GetPriorityFromString("timecritical", priority) != PLUS_SUCCESS || priority != PlusThreadScheduling::PRIORITY_TIME_CRITICAL
+        || PlusThreadScheduling::GetPriorityFromString("BELOWNORMAL", priority) != PLUS_SUCCESS || priority != PlusThreadScheduling::PRIORITY_BELOW_NORMAL)
+    {
+      LOG_ERROR("Priority names are not parsed case insensitively");
+      numberOfErrors++;
+    }
+
+    // unknown names are rejected and the priority is not changed
+    const char* unknownPriorityNames[] = { "", "High", "Realtime", "Below Normal", " Normal", "Normal ", "3" };
+    for (size_t i = 0; i < sizeof(unknownPriorityNames) / sizeof(unknownPriorityNames[0]); ++i)
+    {
+      priority = PlusThreadScheduling::PRIORITY_LOWEST;
+      if (PlusThreadScheduling::GetPriorityFromString(unknownPriorityNames[i], priority) == PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unknown priority name '" << unknownPriorityNames[i] << "' is accepted");
+        numberOfErrors++;
+      }
+      else if (priority != PlusThreadScheduling::PRIORITY_LOWEST)
+      {
+        LOG_ERROR("Priority is changed by the unknown priority name '" << unknownPriorityNames[i] << "'");
+        numberOfErrors++;
+      }
+    }
+
+    LOG_INFO("Priority name parsing tested, " << numberOfErrors << " errors found");
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  numberOfErrors += TestCpuLists();
+  numberOfErrors += TestPriorityNames();
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
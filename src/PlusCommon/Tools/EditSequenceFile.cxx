@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusIndexedSequenceFile.h"
 #include "PlusMath.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusSequenceIO.h"
@@ -21,6 +22,7 @@ See License.txt for details.
 #include <vtkXMLUtilities.h>
 #include <vtksys/CommandLineArguments.hxx>
 #include <vtksys/RegularExpression.hxx>
+#include <vtksys/SystemTools.hxx>
 
 enum OperationType
 {
@@ -67,6 +69,7 @@ public:
 };
 
 PlusStatus TrimSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, unsigned int lastFrameIndex);
+PlusStatus ReadTrimmedIndexedSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, const std::string& inputFileName, unsigned int firstFrameIndex, unsigned int lastFrameIndex);
 PlusStatus DecimateSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int decimationFactor);
 PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate);
 PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::string fieldName);
@@ -222,6 +225,7 @@ int main(int argc, char** argv)
   std::string                     strOperation;
   OperationType                   operation;
   bool                            useCompression = false;
+  std::string                     compressionTypeName; // Compression method of indexed sequence files
   bool                            incrementTimestamps = false;
 
   int                             firstFrameIndex = -1; // First frame index used for trimming the sequence file.
@@ -295,6 +299,7 @@ int main(int argc, char** argv)
   args.AddArgument("--update-reference-transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &strUpdatedReferenceTransformName, "Set the reference transform name to update old files by changing all ToolToReference transforms to ToolToTracker transform.");
 
   args.AddArgument("--use-compression", vtksys::CommandLineArguments::NO_ARGUMENT, &useCompression, "Compress sequence file images.");
+  args.AddArgument("--compression-type", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &compressionTypeName, "Compression method if the output is an indexed sequence file (.pseq) and --use-compression is specified: ZLIB (default), LZ4 (faster compression and decompression, larger file) or DELTA_ZLIB (frame differences compressed with zlib, much smaller file for slowly changing images such as ultrasound).");
   args.AddArgument("--increment-timestamps", vtksys::CommandLineArguments::NO_ARGUMENT, &incrementTimestamps, "Increment timestamps in the order of the input-file-names");
 
   args.AddArgument("--add-transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &transformNamesToAdd, "Name of the transform to add to each frame (e.g., StylusTipToTracker); multiple transforms can be added separated by a comma (e.g., StylusTipToReference,ProbeToReference)");
@@ -339,6 +344,7 @@ int main(int argc, char** argv)
 
     std::cout << "- TRIM: Trim sequence file." << std::endl;
     std::cout << "  Requires --first-frame-index and --last-frame-index." << std::endl;
+    std::cout << "  If the input is an indexed sequence file (.pseq) then only the frames in the range are read." << std::endl;
     std::cout << "- DECIMATE: Keep every N-th frame of the sequence file." << std::endl;
     std::cout << "  Requires --decimation-factor." << std::endl;
     std::cout << "- APPEND: Append multiple sequence files (one after the other)." << std::endl;
@@ -478,10 +484,17 @@ int main(int argc, char** argv)
 
   // Multiple input files are appended unless sequences are mixed
   PlusStatus status = PLUS_SUCCESS;
+  bool inputTrimmed = false;
   if (operation == MIX)
   {
     status = MixTrackedFrameLists(trackedFrameList, inputFileNames);
   }
+  else if (operation == TRIM && inputFileNames.size() == 1 && PlusIndexedSequenceFile::IsIndexedSequenceFileName(inputFileNames[0]))
+  {
+    // Frames can be read individually from indexed sequence files, so the frames that are trimmed are not read at all
+    status = ReadTrimmedIndexedSequenceFile(trackedFrameList, inputFileNames[0], std::max(firstFrameIndex, 0), std::max(lastFrameIndex, 0));
+    inputTrimmed = true;
+  }
   else
   {
     status = AppendTrackedFrameLists(trackedFrameList, inputFileNames, incrementTimestamps, customHeaderFieldsToMaintain);
@@ -515,7 +528,7 @@ int main(int argc, char** argv)
         }
         unsigned int firstFrameIndexUint = static_cast<unsigned int>(firstFrameIndex);
         unsigned int lastFrameIndexUint = static_cast<unsigned int>(lastFrameIndex);
-        if (TrimSequenceFile(trackedFrameList, firstFrameIndexUint, lastFrameIndexUint) != PLUS_SUCCESS)
+        if (!inputTrimmed && TrimSequenceFile(trackedFrameList, firstFrameIndexUint, lastFrameIndexUint) != PLUS_SUCCESS)
         {
           LOG_ERROR("Failed to trim sequence file");
           return EXIT_FAILURE;
@@ -780,7 +793,26 @@ int main(int argc, char** argv)
   // Save output file to file
 
   LOG_INFO("Save output sequence file to: " << outputFileName);
-  if (vtkPlusSequenceIO::Write(outputFileName, trackedFrameList, trackedFrameList->GetImageOrientation(), useCompression, operation != REMOVE_IMAGE_DATA) != PLUS_SUCCESS)
+  if (!compressionTypeName.empty() && !PlusIndexedSequenceFile::IsIndexedSequenceFileName(outputFileName))
+  {
+    LOG_WARNING("Compression type can only be specified for indexed sequence files (.pseq). " << outputFileName << " is written with the default compression.");
+    compressionTypeName.clear();
+  }
+  if (!compressionTypeName.empty())
+  {
+    PlusIndexedSequenceFile::CompressionType compression = PlusIndexedSequenceFile::COMPRESSION_ZLIB;
+    if (PlusIndexedSequenceFile::GetCompressionTypeFromString(compressionTypeName, compression) != PLUS_SUCCESS)
+    {
+      return EXIT_FAILURE;
+    }
+    if (PlusIndexedSequenceFile::Write(vtkPlusConfig::GetInstance()->GetOutputPath(outputFileName), trackedFrameList,
+                                       useCompression ? compression : PlusIndexedSequenceFile::COMPRESSION_NONE, operation != REMOVE_IMAGE_DATA) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't write sequence file: " << outputFileName);
+      return EXIT_FAILURE;
+    }
+  }
+  else if (vtkPlusSequenceIO::Write(outputFileName, trackedFrameList, trackedFrameList->GetImageOrientation(), useCompression, operation != REMOVE_IMAGE_DATA) != PLUS_SUCCESS)
   {
     LOG_ERROR("Couldn't write sequence file: " << outputFileName);
     return EXIT_FAILURE;
@@ -813,6 +845,30 @@ PlusStatus TrimSequenceFile(vtkIGSIOTrackedFrameList* aTrackedFrameList, unsigne
   return PLUS_SUCCESS;
 }
 
+//-------------------------------------------------------
+PlusStatus ReadTrimmedIndexedSequenceFile(vtkIGSIOTrackedFrameList* aTrackedFrameList, const std::string& aInputFileName, unsigned int aFirstFrameIndex, unsigned int aLastFrameIndex)
+{
+  std::string inputFilePath = aInputFileName;
+  if (!vtksys::SystemTools::FileExists(inputFilePath.c_str(), true))
+  {
+    vtkPlusConfig::GetInstance()->FindImagePath(aInputFileName, inputFilePath);
+  }
+
+  LOG_INFO("Read frame #" << aFirstFrameIndex << " to frame #" << aLastFrameIndex << " of indexed sequence file: " << inputFilePath);
+  PlusIndexedSequenceFile indexedFile;
+  if (indexedFile.Open(inputFilePath) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Couldn't read sequence file: " << aInputFileName);
+    return PLUS_FAIL;
+  }
+  if (aLastFrameIndex >= indexedFile.GetNumberOfFrames() || aFirstFrameIndex > aLastFrameIndex)
+  {
+    LOG_ERROR("Invalid input range: (" << aFirstFrameIndex << ", " << aLastFrameIndex << ")" << " Permitted range within (0, " << indexedFile.GetNumberOfFrames() - 1 << ")");
+    return PLUS_FAIL;
+  }
+  return indexedFile.ReadTrackedFrameList(aTrackedFrameList, aFirstFrameIndex, aLastFrameIndex);
+}
+
 //-------------------------------------------------------
 PlusStatus DecimateSequenceFile(vtkIGSIOTrackedFrameList* aTrackedFrameList, unsigned int decimationFactor)
 {
@@ -5,6 +5,7 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusThreadPool.h"
 #include "vtkDirectory.h"
 #include "vtkMatrix4x4.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
@@ -421,6 +422,18 @@ PlusStatus vtkPlusConfig::LoadApplicationConfiguration()
     saveNeeded = true;
   }
 
+  // Read thread pool size (optional, by default the pool has one thread per CPU core)
+  int threadPoolSize = 0;
+  if (applicationConfigurationRoot->GetScalarAttribute("ThreadPoolSize", threadPoolSize))
+  {
+    if (threadPoolSize < 0)
+    {
+      LOG_WARNING("Invalid ThreadPoolSize attribute value: " << threadPoolSize << " - default thread pool size will be used");
+      threadPoolSize = 0;
+    }
+    PlusThreadPool::GetInstance()->SetNumberOfThreads(threadPoolSize);
+  }
+
   if (saveNeeded)
   {
     return SaveApplicationConfigurationToFile();
@@ -5,6 +5,7 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusIndexedSequenceFile.h"
 #include "vtkPlusSequenceIO.h"
 
 #include <vtkIGSIOSequenceIO.h>
@@ -20,6 +21,12 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTracke
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (PlusIndexedSequenceFile::IsIndexedSequenceFileName(filename))
+  {
+    // Images are stored in their original orientation, as the index records the orientation of each frame
+    std::string filePath = outputDirectory.empty() ? filename : outputDirectory + "/" + filename;
+    return PlusIndexedSequenceFile::Write(filePath, frameList, useCompression, enableImageDataWrite);
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frameList, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -31,6 +38,12 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, igsioTrackedFr
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (PlusIndexedSequenceFile::IsIndexedSequenceFileName(filename))
+  {
+    vtkNew<vtkIGSIOTrackedFrameList> frameList;
+    frameList->AddTrackedFrame(frame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
+    return vtkPlusSequenceIO::Write(filename, frameList.GetPointer(), orientationInFile, useCompression, enableImageDataWrite);
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frame, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -48,5 +61,14 @@ igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileNa
       return PLUS_FAIL;
     }
   }
+  if (PlusIndexedSequenceFile::IsIndexedSequenceFileName(trackedSequenceDataFilePath))
+  {
+    PlusIndexedSequenceFile indexedFile;
+    if (indexedFile.Open(trackedSequenceDataFilePath) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return indexedFile.ReadTrackedFrameList(frameList);
+  }
   return vtkIGSIOSequenceIO::Read(trackedSequenceDataFilePath, frameList);
 }
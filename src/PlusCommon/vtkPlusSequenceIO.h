@@ -12,6 +12,8 @@
 /*!
   \class vtkPlusSequenceIO
   \brief Class to abstract away specific sequence file read/write details
+
+  Files with .pseq extension are read and written by PlusIndexedSequenceFile, all other formats by vtkIGSIOSequenceIO.
   \ingroup PlusLibCommon
 */
 class vtkPlusCommonExport vtkPlusSequenceIO : public vtkObject
@@ -0,0 +1,440 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusBufferSpillFile.h"
+
+// VTK includes
+#include <vtkImageData.h>
+
+// STL includes
+#include <cstring>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  /*! Fixed-size part of a record, followed by the serialized frame fields and the pixel data */
+  struct SpillRecordHeader
+  {
+    BufferItemUidType Uid;
+    unsigned long long Index;
+    double FilteredTimestamp;
+    double UnfilteredTimestamp;
+    double Matrix[16];
+    int Status;
+    int ValidTransformData;
+    unsigned int FrameSize[3];
+    int PixelType;
+    unsigned int NumberOfScalarComponents;
+    int ImageType;
+    int ImageOrientation;
+    unsigned int FieldsSizeBytes;
+    unsigned long long FrameSizeBytes;
+  };
+
+  // Records start at aligned addresses, so that the pixel data can be copied efficiently
+  const size_t RECORD_ALIGNMENT = 64;
+
+  //----------------------------------------------------------------------------
+  size_t RoundUp(size_t value, size_t alignment)
+  {
+    return ((value + alignment - 1) / alignment) * alignment;
+  }
+
+  //----------------------------------------------------------------------------
+  // Serialize the frame fields as a sequence of (flags, name, value) entries. Returns false if the fields do not fit.
+  bool SerializeFields(const igsioFieldMapType& fields, unsigned char* buffer, unsigned int capacity, unsigned int& sizeBytes)
+  {
+    sizeBytes = 0;
+    for (igsioFieldMapType::const_iterator it = fields.begin(); it != fields.end(); ++it)
+    {
+      const size_t entrySize = sizeof(unsigned int) + it->first.size() + 1 + it->second.second.size() + 1;
+      if (sizeBytes + entrySize > capacity)
+      {
+        return false;
+      }
+      const unsigned int flags = static_cast<unsigned int>(it->second.first);
+      memcpy(buffer + sizeBytes, &flags, sizeof(unsigned int));
+      sizeBytes += sizeof(unsigned int);
+      memcpy(buffer + sizeBytes, it->first.c_str(), it->first.size() + 1);
+      sizeBytes += static_cast<unsigned int>(it->first.size() + 1);
+      memcpy(buffer + sizeBytes, it->second.second.c_str(), it->second.second.size() + 1);
+      sizeBytes += static_cast<unsigned int>(it->second.second.size() + 1);
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void DeserializeFields(const unsigned char* buffer, unsigned int sizeBytes, StreamBufferItem* item)
+  {
+    unsigned int position = 0;
+    while (position + sizeof(unsigned int) < sizeBytes)
+    {
+      unsigned int flags = 0;
+      memcpy(&flags, buffer + position, sizeof(unsigned int));
+      position += sizeof(unsigned int);
+      std::string name(reinterpret_cast<const char*>(buffer + position));
+      position += static_cast<unsigned int>(name.size() + 1);
+      std::string value(reinterpret_cast<const char*>(buffer + position));
+      position += static_cast<unsigned int>(value.size() + 1);
+      item->SetFrameField(name, value, static_cast<igsioFrameFieldFlags>(flags));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusBufferSpillFile::PlusBufferSpillFile()
+  : Memory(NULL)
+  , FileSizeBytes(0)
+  , FrameSizeBytes(0)
+  , RecordSizeBytes(0)
+  , NumberOfRecords(0)
+  , NumberOfAppendedItems(0)
+  , OversizedItemReported(false)
+#ifdef _WIN32
+  , FileHandle(INVALID_HANDLE_VALUE)
+  , MappingHandle(NULL)
+#else
+  , FileDescriptor(-1)
+#endif
+{
+}
+
+//----------------------------------------------------------------------------
+PlusBufferSpillFile::~PlusBufferSpillFile()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBufferSpillFile::Open(const std::string& filePath, size_t frameSizeBytes, unsigned long long maximumFileSizeBytes)
+{
+  this->Close();
+  std::lock_guard<std::mutex> lock(this->Mutex);
+
+  const size_t recordSizeBytes = RoundUp(sizeof(SpillRecordHeader) + FIELDS_CAPACITY_BYTES + frameSizeBytes, RECORD_ALIGNMENT);
+  const unsigned long long numberOfRecords = maximumFileSizeBytes / recordSizeBytes;
+  if (numberOfRecords < 1)
+  {
+    LOG_ERROR("Spill file size (" << maximumFileSizeBytes << " bytes) is too small for storing items of " << recordSizeBytes << " bytes");
+    return PLUS_FAIL;
+  }
+  const unsigned long long fileSizeBytes = numberOfRecords * recordSizeBytes;
+
+#ifdef _WIN32
+  // The file is deleted automatically when the handle is closed (even if the process terminates unexpectedly)
+  HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    LOG_ERROR("Failed to create spill file: " << filePath);
+    return PLUS_FAIL;
+  }
+  HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE,
+                         static_cast<DWORD>(fileSizeBytes >> 32), static_cast<DWORD>(fileSizeBytes & 0xFFFFFFFF), NULL);
+  void* memory = (mappingHandle != NULL ? MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(fileSizeBytes)) : NULL);
+  if (memory == NULL)
+  {
+    LOG_ERROR("Failed to map spill file into memory: " << filePath << " (" << fileSizeBytes << " bytes)");
+    if (mappingHandle != NULL)
+    {
+      CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+    return PLUS_FAIL;
+  }
+  this->FileHandle = fileHandle;
+  this->MappingHandle = mappingHandle;
+#else
+  int fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fileDescriptor < 0)
+  {
+    LOG_ERROR("Failed to create spill file: " << filePath);
+    return PLUS_FAIL;
+  }
+  // The file is removed from the directory right away, its space is freed when the file is closed (even if the process terminates unexpectedly)
+  unlink(filePath.c_str());
+  void* memory = MAP_FAILED;
+  if (ftruncate(fileDescriptor, static_cast<off_t>(fileSizeBytes)) == 0)
+  {
+    memory = mmap(NULL, static_cast<size_t>(fileSizeBytes), PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+  }
+  if (memory == MAP_FAILED)
+  {
+    LOG_ERROR("Failed to map spill file into memory: " << filePath << " (" << fileSizeBytes << " bytes)");
+    close(fileDescriptor);
+    return PLUS_FAIL;
+  }
+  this->FileDescriptor = fileDescriptor;
+#endif
+
+  this->FilePath = filePath;
+  this->Memory = static_cast<unsigned char*>(memory);
+  this->FileSizeBytes = fileSizeBytes;
+  this->FrameSizeBytes = frameSizeBytes;
+  this->RecordSizeBytes = recordSizeBytes;
+  this->NumberOfRecords = static_cast<unsigned int>(numberOfRecords);
+  this->NumberOfAppendedItems = 0;
+  this->RecordTimestamps.assign(this->NumberOfRecords, 0.0);
+  this->RecordUids.assign(this->NumberOfRecords, 0);
+  this->OversizedItemReported = false;
+
+  LOG_DEBUG("Spill file created: " << filePath << " (" << this->NumberOfRecords << " items, " << fileSizeBytes << " bytes)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusBufferSpillFile::Close()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Memory == NULL)
+  {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(this->Memory);
+  CloseHandle(this->MappingHandle);
+  CloseHandle(this->FileHandle);
+  this->MappingHandle = NULL;
+  this->FileHandle = INVALID_HANDLE_VALUE;
+#else
+  munmap(this->Memory, static_cast<size_t>(this->FileSizeBytes));
+  close(this->FileDescriptor);
+  this->FileDescriptor = -1;
+#endif
+  this->Memory = NULL;
+  this->FileSizeBytes = 0;
+  this->NumberOfRecords = 0;
+  this->NumberOfAppendedItems = 0;
+  this->RecordTimestamps.clear();
+  this->RecordUids.clear();
+}
+
+//----------------------------------------------------------------------------
+bool PlusBufferSpillFile::IsOpen() const
+{
+  return this->Memory != NULL;
+}
+
+//----------------------------------------------------------------------------
+void PlusBufferSpillFile::Clear()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->NumberOfAppendedItems = 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusBufferSpillFile::GetNumberOfItems()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return static_cast<unsigned int>(this->NumberOfAppendedItems - this->GetOldestSequence());
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusBufferSpillFile::GetOldestSequence() const
+{
+  return (this->NumberOfAppendedItems > this->NumberOfRecords ? this->NumberOfAppendedItems - this->NumberOfRecords : 0);
+}
+
+//----------------------------------------------------------------------------
+unsigned char* PlusBufferSpillFile::GetRecord(unsigned long long sequence)
+{
+  return this->Memory + (sequence % this->NumberOfRecords) * this->RecordSizeBytes;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBufferSpillFile::AppendItem(StreamBufferItem& item)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Memory == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  igsioVideoFrame& frame = item.GetFrame();
+  FrameSizeType frameSize = { 0, 0, 0 };
+  unsigned int numberOfScalarComponents(0);
+  unsigned long long frameSizeBytes(0);
+  if (frame.IsImageValid() && !frame.IsFrameEncoded())
+  {
+    frame.GetFrameSize(frameSize);
+    frame.GetNumberOfScalarComponents(numberOfScalarComponents);
+    frameSizeBytes = frame.GetFrameSizeInBytes();
+  }
+
+  unsigned char* record = this->GetRecord(this->NumberOfAppendedItems);
+  SpillRecordHeader* header = reinterpret_cast<SpillRecordHeader*>(record);
+  unsigned char* fields = record + sizeof(SpillRecordHeader);
+  unsigned char* pixels = fields + FIELDS_CAPACITY_BYTES;
+
+  unsigned int fieldsSizeBytes(0);
+  if (frameSizeBytes > this->FrameSizeBytes || !SerializeFields(item.GetFrameFieldMap(), fields, FIELDS_CAPACITY_BYTES, fieldsSizeBytes))
+  {
+    if (!this->OversizedItemReported)
+    {
+      LOG_WARNING("Item " << item.GetUid() << " does not fit into the spill file record (frame: " << frameSizeBytes << " bytes, maximum: " << this->FrameSizeBytes
+                  << " bytes; frame fields maximum: " << FIELDS_CAPACITY_BYTES << " bytes). Items that do not fit are not stored.");
+      this->OversizedItemReported = true;
+    }
+    return PLUS_FAIL;
+  }
+
+  header->Uid = item.GetUid();
+  header->Index = item.GetIndex();
+  header->FilteredTimestamp = item.GetFilteredTimestamp(0);
+  header->UnfilteredTimestamp = item.GetUnfilteredTimestamp(0);
+  memcpy(header->Matrix, item.GetMatrixElements(), sizeof(header->Matrix));
+  header->Status = static_cast<int>(item.GetStatus());
+  header->ValidTransformData = item.HasValidTransformData() ? 1 : 0;
+  header->FrameSize[0] = frameSize[0];
+  header->FrameSize[1] = frameSize[1];
+  header->FrameSize[2] = frameSize[2];
+  header->PixelType = frame.GetVTKScalarPixelType();
+  header->NumberOfScalarComponents = numberOfScalarComponents;
+  header->ImageType = static_cast<int>(frame.GetImageType());
+  header->ImageOrientation = static_cast<int>(frame.GetImageOrientation());
+  header->FieldsSizeBytes = fieldsSizeBytes;
+  header->FrameSizeBytes = frameSizeBytes;
+  if (frameSizeBytes > 0)
+  {
+    memcpy(pixels, frame.GetImage()->GetScalarPointer(), static_cast<size_t>(frameSizeBytes));
+  }
+
+  const unsigned int recordIndex = static_cast<unsigned int>(this->NumberOfAppendedItems % this->NumberOfRecords);
+  this->RecordTimestamps[recordIndex] = header->FilteredTimestamp;
+  this->RecordUids[recordIndex] = header->Uid;
+  this->NumberOfAppendedItems++;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBufferSpillFile::ReadRecord(unsigned long long sequence, StreamBufferItem* item)
+{
+  const unsigned char* record = this->GetRecord(sequence);
+  const SpillRecordHeader* header = reinterpret_cast<const SpillRecordHeader*>(record);
+  const unsigned char* fields = record + sizeof(SpillRecordHeader);
+  const unsigned char* pixels = fields + FIELDS_CAPACITY_BYTES;
+
+  item->SetUid(header->Uid);
+  item->SetIndex(static_cast<unsigned long>(header->Index));
+  item->SetFilteredTimestamp(header->FilteredTimestamp);
+  item->SetUnfilteredTimestamp(header->UnfilteredTimestamp);
+  item->SetMatrixElements(header->Matrix);
+  item->SetStatus(static_cast<ToolStatus>(header->Status));
+  item->SetValidTransformData(header->ValidTransformData != 0);
+
+  // Replace the frame fields of the output item
+  igsioFieldMapType previousFields = item->GetFrameFieldMap();
+  for (igsioFieldMapType::iterator it = previousFields.begin(); it != previousFields.end(); ++it)
+  {
+    item->DeleteFrameField(it->first);
+  }
+  DeserializeFields(fields, header->FieldsSizeBytes, item);
+
+  if (header->FrameSizeBytes > 0)
+  {
+    igsioVideoFrame& frame = item->GetFrame();
+    FrameSizeType frameSize = { header->FrameSize[0], header->FrameSize[1], header->FrameSize[2] };
+    if (frame.AllocateFrame(frameSize, header->PixelType, header->NumberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate frame for spilled item " << header->Uid);
+      return PLUS_FAIL;
+    }
+    memcpy(frame.GetImage()->GetScalarPointer(), pixels, static_cast<size_t>(header->FrameSizeBytes));
+    frame.SetImageType(static_cast<US_IMAGE_TYPE>(header->ImageType));
+    frame.SetImageOrientation(static_cast<US_IMAGE_ORIENTATION>(header->ImageOrientation));
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus PlusBufferSpillFile::GetItem(BufferItemUidType uid, StreamBufferItem* item)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  const unsigned long long oldestSequence = this->GetOldestSequence();
+  if (this->Memory == NULL || this->NumberOfAppendedItems == oldestSequence)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  // UIDs are increasing, but not necessarily consecutive (e.g., if the buffer is resized), so find the UID by binary search
+  unsigned long long lo = oldestSequence;
+  unsigned long long hi = this->NumberOfAppendedItems;
+  while (hi - lo > 1)
+  {
+    const unsigned long long mid = lo + (hi - lo) / 2;
+    if (this->RecordUids[mid % this->NumberOfRecords] <= uid)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  const BufferItemUidType foundUid = this->RecordUids[lo % this->NumberOfRecords];
+  if (foundUid != uid)
+  {
+    return (uid < foundUid ? ITEM_NOT_AVAILABLE_ANYMORE : ITEM_UNKNOWN_ERROR);
+  }
+  return (this->ReadRecord(lo, item) == PLUS_SUCCESS ? ITEM_OK : ITEM_UNKNOWN_ERROR);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus PlusBufferSpillFile::GetItemFromClosestTime(double localTime, StreamBufferItem* item)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  const unsigned long long oldestSequence = this->GetOldestSequence();
+  if (this->Memory == NULL || this->NumberOfAppendedItems == oldestSequence)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  if (localTime < this->RecordTimestamps[oldestSequence % this->NumberOfRecords])
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  // Find the last record that is not newer than the requested time, then choose the closer one of that and the next record
+  unsigned long long lo = oldestSequence;
+  unsigned long long hi = this->NumberOfAppendedItems;
+  while (hi - lo > 1)
+  {
+    const unsigned long long mid = lo + (hi - lo) / 2;
+    if (this->RecordTimestamps[mid % this->NumberOfRecords] <= localTime)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  if (hi < this->NumberOfAppendedItems
+      && this->RecordTimestamps[hi % this->NumberOfRecords] - localTime < localTime - this->RecordTimestamps[lo % this->NumberOfRecords])
+  {
+    lo = hi;
+  }
+  return (this->ReadRecord(lo, item) == PLUS_SUCCESS ? ITEM_OK : ITEM_UNKNOWN_ERROR);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus PlusBufferSpillFile::GetTimeRange(double& oldestLocalTime, double& latestLocalTime)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  const unsigned long long oldestSequence = this->GetOldestSequence();
+  if (this->Memory == NULL || this->NumberOfAppendedItems == oldestSequence)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  oldestLocalTime = this->RecordTimestamps[oldestSequence % this->NumberOfRecords];
+  latestLocalTime = this->RecordTimestamps[(this->NumberOfAppendedItems - 1) % this->NumberOfRecords];
+  return ITEM_OK;
+}
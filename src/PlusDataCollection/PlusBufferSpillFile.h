@@ -0,0 +1,126 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusBufferSpillFile_h
+#define __PlusBufferSpillFile_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+#include "PlusStreamBufferItem.h"
+#include "vtkPlusTimestampedCircularBuffer.h"
+
+// STL includes
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusBufferSpillFile
+  \brief Memory-mapped file that stores the items that are removed from a buffer, to keep a long history on disk instead of in memory.
+
+  The file consists of fixed-size records, one for each item: the tracking data, the frame fields
+  (up to FIELDS_CAPACITY_BYTES) and the pixel data (up to the frame size specified in Open).
+  Records are written in a circular manner, so the file size does not grow: when the file is full
+  the oldest record is overwritten.
+
+  The UIDs and filtered timestamps of the stored items are kept in memory as well (16 bytes per item),
+  so that items can be found without reading the file.
+
+  The file is temporary, it is deleted when it is closed.
+  All methods are thread-safe.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusBufferSpillFile
+{
+public:
+  /*! Maximum size of the serialized frame fields of an item (in bytes) */
+  static const unsigned int FIELDS_CAPACITY_BYTES = 4096;
+
+  PlusBufferSpillFile();
+  virtual ~PlusBufferSpillFile();
+
+  /*!
+    Create the spill file and map it into memory. A previously opened file is closed.
+    \param filePath Path of the file to create
+    \param frameSizeBytes Maximum size of the pixel data of one item
+    \param maximumFileSizeBytes The number of records is chosen so that the file is not larger than this
+  */
+  PlusStatus Open(const std::string& filePath, size_t frameSizeBytes, unsigned long long maximumFileSizeBytes);
+
+  /*! Unmap and delete the spill file */
+  void Close();
+
+  /*! Returns true if the file is open */
+  bool IsOpen() const;
+
+  /*! Remove all items (the file remains open) */
+  void Clear();
+
+  /*! Store an item. Items must be added in increasing UID and timestamp order. */
+  PlusStatus AppendItem(StreamBufferItem& item);
+
+  /*! Get the stored item with the specified UID */
+  ItemStatus GetItem(BufferItemUidType uid, StreamBufferItem* item);
+
+  /*! Get the stored item that has the closest filtered timestamp (in local time) to the specified time */
+  ItemStatus GetItemFromClosestTime(double localTime, StreamBufferItem* item);
+
+  /*! Get the filtered timestamp (in local time) of the oldest and latest stored items */
+  ItemStatus GetTimeRange(double& oldestLocalTime, double& latestLocalTime);
+
+  /*! Get the number of stored items */
+  unsigned int GetNumberOfItems();
+
+  /*! Get the maximum number of stored items */
+  unsigned int GetNumberOfRecords() const { return this->NumberOfRecords; }
+
+  /*! Get the maximum size of the pixel data of one item */
+  size_t GetFrameSizeBytes() const { return this->FrameSizeBytes; }
+
+protected:
+  /*! Get the address of a record. The caller must have locked the mutex. */
+  unsigned char* GetRecord(unsigned long long sequence);
+
+  /*! Copy a record to an item. The caller must have locked the mutex. */
+  PlusStatus ReadRecord(unsigned long long sequence, StreamBufferItem* item);
+
+  /*! Get the sequence number of the oldest stored record. The caller must have locked the mutex. */
+  unsigned long long GetOldestSequence() const;
+
+  std::mutex Mutex;
+
+  std::string FilePath;
+  unsigned char* Memory;
+  unsigned long long FileSizeBytes;
+  size_t FrameSizeBytes;
+  size_t RecordSizeBytes;
+  unsigned int NumberOfRecords;
+
+  /*! Number of items that have been appended since the file was opened (or cleared) */
+  unsigned long long NumberOfAppendedItems;
+
+  /*! Filtered timestamp of the item in each record */
+  std::vector<double> RecordTimestamps;
+  /*! UID of the item in each record */
+  std::vector<BufferItemUidType> RecordUids;
+
+  /*! Set after the first warning about items that do not fit into a record, to avoid flooding the log */
+  bool OversizedItemReported;
+
+#ifdef _WIN32
+  void* FileHandle;
+  void* MappingHandle;
+#else
+  int FileDescriptor;
+#endif
+
+private:
+  PlusBufferSpillFile(const PlusBufferSpillFile&);
+  void operator=(const PlusBufferSpillFile&);
+};
+
+#endif
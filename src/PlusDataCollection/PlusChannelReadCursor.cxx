@@ -0,0 +1,427 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusChannelReadCursor.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+static const double DEFAULT_OVERWRITTEN_ITEMS_WARNING_PERIOD_SEC = 10.0; // minimum time between warnings about overwritten items
+
+//----------------------------------------------------------------------------
+PlusChannelReadCursor::PlusChannelReadCursor(vtkPlusChannel* channel, const std::string& consumerName)
+  : Channel(channel)
+  , ConsumerName(consumerName)
+  , MasterSource(NULL)
+  , NextUnreadUid(0)
+  , Positioned(false)
+  , SeekTimestamp(UNDEFINED_TIMESTAMP)
+  , LastReadTimestamp(UNDEFINED_TIMESTAMP)
+  , NumberOfOverwrittenItems(0)
+  , NumberOfSkippedItems(0)
+  , NumberOfReadItems(0)
+  , NumberOfOverwrittenItemsWarnings(0)
+  , OverwrittenItemsWarningPeriodSec(DEFAULT_OVERWRITTEN_ITEMS_WARNING_PERIOD_SEC)
+  , LastOverwrittenItemsWarningTime(-1)
+  , NumberOfUnreportedOverwrittenItems(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusChannelReadCursor::~PlusChannelReadCursor()
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusChannelReadCursor::Reset()
+{
+  this->Positioned = false;
+  this->SeekTimestamp = UNDEFINED_TIMESTAMP;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusChannelReadCursor::SeekToTime(double timestamp)
+{
+  if (timestamp == UNDEFINED_TIMESTAMP)
+  {
+    LOG_ERROR("PlusChannelReadCursor::SeekToTime failed for consumer " << this->ConsumerName << ": invalid timestamp");
+    return PLUS_FAIL;
+  }
+  // The item UID is looked up at the next read, when the master source of the channel is known
+  this->Positioned = false;
+  this->SeekTimestamp = timestamp;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusDataSource* PlusChannelReadCursor::GetMasterSource()
+{
+  if (this->Channel == NULL)
+  {
+    return NULL;
+  }
+
+  // Same source priority as in vtkPlusChannel::GetTrackedFrameList
+  vtkPlusDataSource* masterSource = NULL;
+  if (this->Channel->HasVideoSource())
+  {
+    this->Channel->GetVideoSource(masterSource);
+  }
+  else if (this->Channel->GetTrackingEnabled())
+  {
+    this->Channel->GetTimestampMasterTool(masterSource);
+  }
+  else if (this->Channel->GetFieldDataEnabled())
+  {
+    masterSource = this->Channel->GetFieldDataSourcesStartIterator()->second;
+  }
+
+  if (masterSource != this->MasterSource)
+  {
+    // UIDs of different sources are not related, continue from the time of the last read item
+    this->MasterSource = masterSource;
+    this->Positioned = false;
+    if (this->LastReadTimestamp != UNDEFINED_TIMESTAMP && this->SeekTimestamp == UNDEFINED_TIMESTAMP)
+    {
+      this->SeekTimestamp = this->LastReadTimestamp;
+    }
+  }
+
+  return masterSource;
+}
+
+//----------------------------------------------------------------------------
+void PlusChannelReadCursor::AddOverwrittenItems(BufferItemUidType numberOfItems)
+{
+  if (numberOfItems == 0)
+  {
+    return;
+  }
+  this->NumberOfOverwrittenItems += numberOfItems;
+  this->NumberOfUnreportedOverwrittenItems += numberOfItems;
+
+  // Warn at the first occurrence, then periodically, as a slow consumer would overwrite items at every read
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (this->LastOverwrittenItemsWarningTime >= 0 && currentTime - this->LastOverwrittenItemsWarningTime < this->OverwrittenItemsWarningPeriodSec)
+  {
+    return;
+  }
+  LOG_WARNING("Consumer " << this->ConsumerName << " of channel " << (this->Channel->GetChannelId() ? this->Channel->GetChannelId() : "(unknown)")
+              << " has not read " << this->NumberOfUnreportedOverwrittenItems << " item(s) before they were removed from the buffer"
+              << (this->LastOverwrittenItemsWarningTime >= 0 ? " since the last warning" : "") << " (total overwritten items: " << this->NumberOfOverwrittenItems
+              << "). Increase the buffer size or decrease the acquisition rate to avoid this situation.");
+  this->LastOverwrittenItemsWarningTime = currentTime;
+  this->NumberOfUnreportedOverwrittenItems = 0;
+  ++this->NumberOfOverwrittenItemsWarnings;
+}
+
+//----------------------------------------------------------------------------
+bool PlusChannelReadCursor::GetUnreadItemRange(vtkPlusDataSource* masterSource, BufferItemUidType& firstUnreadUid, BufferItemUidType& latestUid)
+{
+  if (masterSource->GetNumberOfItems() < 1)
+  {
+    return false;
+  }
+  BufferItemUidType oldestUid = masterSource->GetOldestItemUidInBuffer();
+  latestUid = masterSource->GetLatestItemUidInBuffer();
+
+  if (!this->Positioned)
+  {
+    if (this->SeekTimestamp == UNDEFINED_TIMESTAMP)
+    {
+      this->NextUnreadUid = latestUid;
+    }
+    else
+    {
+      BufferItemUidType uid(0);
+      ItemStatus status = masterSource->GetItemUidFromTime(this->SeekTimestamp, uid);
+      if (status == ITEM_NOT_AVAILABLE_YET)
+      {
+        // All the items in the buffer are older than the requested time
+        this->NextUnreadUid = latestUid + 1;
+      }
+      else if (status == ITEM_NOT_AVAILABLE_ANYMORE)
+      {
+        this->NextUnreadUid = oldestUid;
+      }
+      else if (status == ITEM_OK)
+      {
+        // The closest item may have been acquired before the requested time
+        double closestTimestamp(0);
+        if (masterSource->GetTimeStamp(uid, closestTimestamp) == ITEM_OK && closestTimestamp <= this->SeekTimestamp)
+        {
+          ++uid;
+        }
+        this->NextUnreadUid = uid;
+      }
+      else
+      {
+        LOG_WARNING("Consumer " << this->ConsumerName << " failed to find the buffer item at time " << std::fixed << this->SeekTimestamp);
+        return false;
+      }
+    }
+    this->Positioned = true;
+    this->SeekTimestamp = UNDEFINED_TIMESTAMP;
+  }
+
+  if (this->NextUnreadUid > latestUid + 1)
+  {
+    // The buffer has been cleared since the last read
+    LOG_DEBUG("Buffer of channel has been cleared, consumer " << this->ConsumerName << " continues reading at the oldest item");
+    this->NextUnreadUid = oldestUid;
+  }
+  if (this->NextUnreadUid < oldestUid)
+  {
+    this->AddOverwrittenItems(oldestUid - this->NextUnreadUid);
+    this->NextUnreadUid = oldestUid;
+  }
+
+  firstUnreadUid = this->NextUnreadUid;
+  return firstUnreadUid <= latestUid;
+}
+
+//----------------------------------------------------------------------------
+int PlusChannelReadCursor::GetNumberOfUnreadItems()
+{
+  vtkPlusDataSource* masterSource = this->GetMasterSource();
+  if (masterSource == NULL || !this->Positioned || masterSource->GetNumberOfItems() < 1)
+  {
+    return 0;
+  }
+  BufferItemUidType firstUnreadUid = std::max(this->NextUnreadUid, masterSource->GetOldestItemUidInBuffer());
+  BufferItemUidType latestUid = masterSource->GetLatestItemUidInBuffer();
+  return (firstUnreadUid <= latestUid) ? static_cast<int>(latestUid - firstUnreadUid + 1) : 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusChannelReadCursor::GetNextUnreadTimestamps(std::vector<double>& timestamps, int maxNumberOfItems/*=0*/, bool skipToLatest/*=false*/)
+{
+  timestamps.clear();
+
+  vtkPlusDataSource* masterSource = this->GetMasterSource();
+  if (masterSource == NULL)
+  {
+    LOG_ERROR("Consumer " << this->ConsumerName << " failed to read items: the channel has no data source");
+    return PLUS_FAIL;
+  }
+
+  BufferItemUidType firstUid(0);
+  BufferItemUidType latestUid(0);
+  if (!this->GetUnreadItemRange(masterSource, firstUid, latestUid))
+  {
+    // No new items
+    return PLUS_SUCCESS;
+  }
+
+  if (maxNumberOfItems > 0 && latestUid - firstUid + 1 > static_cast<BufferItemUidType>(maxNumberOfItems))
+  {
+    if (skipToLatest)
+    {
+      this->NumberOfSkippedItems += latestUid - firstUid + 1 - maxNumberOfItems;
+      firstUid = latestUid - maxNumberOfItems + 1;
+    }
+    else
+    {
+      latestUid = firstUid + maxNumberOfItems - 1;
+    }
+  }
+
+  BufferItemUidType uid = firstUid;
+  for (; uid <= latestUid; ++uid)
+  {
+    double timestamp(0);
+    ItemStatus status = masterSource->GetTimeStamp(uid, timestamp);
+    if (status == ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      // Overwritten since the range was determined
+      this->AddOverwrittenItems(1);
+      continue;
+    }
+    if (status != ITEM_OK)
+    {
+      LOG_WARNING("Consumer " << this->ConsumerName << " failed to get the timestamp of buffer item " << uid);
+      break;
+    }
+    timestamps.push_back(timestamp);
+  }
+  this->NextUnreadUid = uid;
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusChannelReadCursor::ReadNextTrackedFrames(vtkIGSIOTrackedFrameList* trackedFrameList, int maxNumberOfItems/*=0*/, bool skipToLatest/*=false*/)
+{
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("PlusChannelReadCursor::ReadNextTrackedFrames failed: output tracked frame list is NULL");
+    return PLUS_FAIL;
+  }
+
+  std::vector<double> timestamps;
+  if (this->GetNextUnreadTimestamps(timestamps, maxNumberOfItems, skipToLatest) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (std::vector<double>::iterator timestampIt = timestamps.begin(); timestampIt != timestamps.end(); ++timestampIt)
+  {
+    // Get tracked frame from buffer (actually copies pixel and field data)
+    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+    if (this->Channel->GetTrackedFrame(*timestampIt, *trackedFrame) != PLUS_SUCCESS)
+    {
+      double oldestTimestamp(0);
+      if (this->MasterSource->GetOldestTimeStamp(oldestTimestamp) == ITEM_OK && *timestampIt < oldestTimestamp)
+      {
+        this->AddOverwrittenItems(1);
+      }
+      else
+      {
+        LOG_WARNING("Consumer " << this->ConsumerName << " is unable to retrieve frame from the devices for time: " << std::fixed << *timestampIt);
+      }
+      delete trackedFrame;
+      continue;
+    }
+    this->LastReadTimestamp = trackedFrame->GetTimestamp();
+    ++this->NumberOfReadItems;
+
+    if (trackedFrameList->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("PlusChannelReadCursor::ReadNextTrackedFrames: Unable to add tracked frame to the list");
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusChannelReadCursor::ReadNextTrackedFramesSampled(vtkIGSIOTrackedFrameList* trackedFrameList, double& nextSampleTimestamp, double samplingPeriodSec, double maxTimeLimitSec/*=-1*/)
+{
+  if (trackedFrameList == NULL)
+  {
+    LOG_ERROR("PlusChannelReadCursor::ReadNextTrackedFramesSampled failed: output tracked frame list is NULL");
+    return PLUS_FAIL;
+  }
+  if (samplingPeriodSec <= 0)
+  {
+    LOG_ERROR("PlusChannelReadCursor::ReadNextTrackedFramesSampled failed: invalid sampling period " << samplingPeriodSec);
+    return PLUS_FAIL;
+  }
+
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  vtkPlusDataSource* masterSource = this->GetMasterSource();
+  if (masterSource == NULL)
+  {
+    LOG_ERROR("Consumer " << this->ConsumerName << " failed to read items: the channel has no data source");
+    return PLUS_FAIL;
+  }
+  if (masterSource->GetNumberOfItems() < 1)
+  {
+    // No frames have been acquired yet
+    return PLUS_SUCCESS;
+  }
+
+  if (!this->Positioned && this->SeekTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    // The sampling time determines the first item to read
+    this->NextUnreadUid = masterSource->GetOldestItemUidInBuffer();
+    this->Positioned = true;
+  }
+  // Items between the sampling times are not read, so they are not counted as overwritten
+  BufferItemUidType firstUid(0);
+  BufferItemUidType latestUid(0);
+  if (this->NextUnreadUid < masterSource->GetOldestItemUidInBuffer())
+  {
+    this->NextUnreadUid = masterSource->GetOldestItemUidInBuffer();
+  }
+  if (!this->GetUnreadItemRange(masterSource, firstUid, latestUid))
+  {
+    return PLUS_SUCCESS;
+  }
+
+  double oldestTimestamp(0);
+  double latestTimestamp(0);
+  if (masterSource->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK || masterSource->GetTimeStamp(latestUid, latestTimestamp) != ITEM_OK)
+  {
+    LOG_WARNING("Consumer " << this->ConsumerName << " failed to get the timestamps of the buffer items");
+    return PLUS_FAIL;
+  }
+  if (nextSampleTimestamp < oldestTimestamp)
+  {
+    // The samples were removed from the buffer before they could be read
+    BufferItemUidType numberOfLostSamples = static_cast<BufferItemUidType>(std::ceil((oldestTimestamp - nextSampleTimestamp) / samplingPeriodSec));
+    this->AddOverwrittenItems(numberOfLostSamples);
+    nextSampleTimestamp += numberOfLostSamples * samplingPeriodSec;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (; nextSampleTimestamp <= latestTimestamp; nextSampleTimestamp += samplingPeriodSec)
+  {
+    // If the time that is allowed for adding of frames is expired then stop the processing now
+    if (maxTimeLimitSec > 0 && vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec > maxTimeLimitSec)
+    {
+      LOG_DEBUG("Reached maximum time that is allowed for sampling frames");
+      break;
+    }
+
+    BufferItemUidType uid(0);
+    ItemStatus itemStatus = masterSource->GetItemUidFromTime(nextSampleTimestamp, uid);
+    if (itemStatus == ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      this->AddOverwrittenItems(1);
+      continue;
+    }
+    if (itemStatus != ITEM_OK)
+    {
+      LOG_WARNING("Consumer " << this->ConsumerName << " failed to find the buffer item at time " << std::fixed << nextSampleTimestamp);
+      break;
+    }
+    if (uid < this->NextUnreadUid)
+    {
+      // This frame has been already read. Don't spend time with retrieving this frame, just jump to the next
+      continue;
+    }
+    double itemTimestamp(0);
+    if (masterSource->GetTimeStamp(uid, itemTimestamp) != ITEM_OK)
+    {
+      this->AddOverwrittenItems(1);
+      continue;
+    }
+
+    // Get tracked frame from buffer (actually copies pixel and field data)
+    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+    this->NextUnreadUid = uid + 1;
+    if (this->Channel->GetTrackedFrame(itemTimestamp, *trackedFrame) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Consumer " << this->ConsumerName << " is unable to retrieve frame from the devices for time: " << std::fixed << nextSampleTimestamp << ", probably the item is not available in the buffers anymore. Frames may be lost.");
+      delete trackedFrame;
+      continue;
+    }
+    this->LastReadTimestamp = trackedFrame->GetTimestamp();
+    ++this->NumberOfReadItems;
+
+    if (trackedFrameList->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("PlusChannelReadCursor::ReadNextTrackedFramesSampled: Unable to add tracked frame to the list");
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
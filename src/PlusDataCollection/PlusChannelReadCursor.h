@@ -0,0 +1,150 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusChannelReadCursor_h
+#define __PlusChannelReadCursor_h
+
+#include "vtkPlusDataCollectionExport.h"
+#include "PlusStreamBufferItem.h"
+
+// STL includes
+#include <atomic>
+#include <string>
+#include <vector>
+
+class vtkIGSIOTrackedFrameList;
+class vtkPlusChannel;
+class vtkPlusDataSource;
+
+/*!
+  \class PlusChannelReadCursor
+  \brief Position of one consumer (e.g., a broadcasting or recording thread) in the items of a channel.
+
+  The cursor follows the items of the master source of the channel (the video source if video data is available,
+  otherwise the timestamp master tool or the first field data source) by their UID, so each item is returned once,
+  in acquisition order, without searching the buffers by time.
+
+  Items that are removed from the buffer before the consumer reads them are counted (GetNumberOfOverwrittenItems)
+  and reported with the consumer name, so it is visible which consumer cannot keep up with the acquisition.
+  A warning is logged at the first overwrite, then at most once in each OverwrittenItemsWarningPeriodSec with the number
+  of items overwritten since the previous warning, so a consumer that keeps falling behind does not flood the log.
+  Items that the consumer skips on purpose (sampling, or reading only the latest items) are not counted as overwritten.
+
+  Cursors are created by vtkPlusChannel::CreateReadCursor. A cursor is intended to be used by a single consumer thread,
+  the counters can be read from any thread.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusChannelReadCursor
+{
+public:
+  PlusChannelReadCursor(vtkPlusChannel* channel, const std::string& consumerName);
+  virtual ~PlusChannelReadCursor();
+
+  /*! Get the name of the consumer that uses the cursor (used in log messages) */
+  std::string GetConsumerName() const { return this->ConsumerName; }
+
+  /*! Get the channel that the cursor reads */
+  vtkPlusChannel* GetChannel() const { return this->Channel; }
+
+  /*!
+    Forget the read position (this is the initial state). The next ReadNextTrackedFrames call starts at the latest item,
+    the next ReadNextTrackedFramesSampled call starts at the item that is closest to the sampling time.
+  */
+  void Reset();
+
+  /*! The next read starts at the first item that is acquired after the specified time */
+  PlusStatus SeekToTime(double timestamp);
+
+  /*!
+    Get the timestamps of the next unread items of the master source (oldest first) and mark them as read.
+    \param timestamps Receives the timestamps (the vector is cleared first)
+    \param maxNumberOfItems Maximum number of returned items, 0 if not limited
+    \param skipToLatest If true and more items are unread than maxNumberOfItems then the latest maxNumberOfItems items are returned and the older ones are skipped.
+      Otherwise the oldest unread items are returned and the rest is returned by the next calls.
+  */
+  PlusStatus GetNextUnreadTimestamps(std::vector<double>& timestamps, int maxNumberOfItems = 0, bool skipToLatest = false);
+
+  /*! Append the tracked frames of the next unread items to the list (see GetNextUnreadTimestamps) */
+  PlusStatus ReadNextTrackedFrames(vtkIGSIOTrackedFrameList* trackedFrameList, int maxNumberOfItems = 0, bool skipToLatest = false);
+
+  /*!
+    Append unread tracked frames to the list that are closest to regularly spaced sampling times.
+    Frames between the sampling times are skipped, they are not counted as overwritten. Sampling times that
+    are not in the buffer anymore are counted as overwritten items and skipped.
+    \param nextSampleTimestamp In: time of the next sample. Out: time of the next sample after the last returned frame.
+    \param samplingPeriodSec Time between samples
+    \param maxTimeLimitSec Maximum time spent in the function (in sec), not limited if negative
+  */
+  PlusStatus ReadNextTrackedFramesSampled(vtkIGSIOTrackedFrameList* trackedFrameList, double& nextSampleTimestamp, double samplingPeriodSec, double maxTimeLimitSec = -1);
+
+  /*! Get the number of items that were removed from the buffer before the consumer read them */
+  unsigned long long GetNumberOfOverwrittenItems() const { return this->NumberOfOverwrittenItems; }
+
+  /*! Get the number of warnings that have been logged about overwritten items */
+  unsigned long long GetNumberOfOverwrittenItemsWarnings() const { return this->NumberOfOverwrittenItemsWarnings; }
+
+  /*! Set the minimum time between warnings about overwritten items (in sec, default: 10) */
+  void SetOverwrittenItemsWarningPeriodSec(double periodSec) { this->OverwrittenItemsWarningPeriodSec = periodSec; }
+  double GetOverwrittenItemsWarningPeriodSec() const { return this->OverwrittenItemsWarningPeriodSec; }
+
+  /*! Get the number of items that the consumer skipped on purpose (skipToLatest) */
+  unsigned long long GetNumberOfSkippedItems() const { return this->NumberOfSkippedItems; }
+
+  /*! Get the number of items that have been returned to the consumer */
+  unsigned long long GetNumberOfReadItems() const { return this->NumberOfReadItems; }
+
+  /*! Get the number of items that are in the buffer and have not been read yet (to be called from the consumer thread) */
+  int GetNumberOfUnreadItems();
+
+  /*! Get the timestamp of the last returned item, UNDEFINED_TIMESTAMP if no item has been returned */
+  double GetLastReadTimestamp() const { return this->LastReadTimestamp; }
+
+protected:
+  /*! Get the source that determines the items of the channel (see class description), NULL if the channel has no data source */
+  vtkPlusDataSource* GetMasterSource();
+
+  /*!
+    Get the range of unread items that are still in the buffer. Overwritten items are counted and skipped.
+    Returns false if there is no unread item.
+  */
+  bool GetUnreadItemRange(vtkPlusDataSource* masterSource, BufferItemUidType& firstUnreadUid, BufferItemUidType& latestUid);
+
+  /*! Count items that were removed from the buffer before they could be read, log a warning if the warning period has elapsed */
+  void AddOverwrittenItems(BufferItemUidType numberOfItems);
+
+  vtkPlusChannel* Channel;
+  std::string ConsumerName;
+
+  /*! Source whose items are followed, the position is reset if it changes */
+  vtkPlusDataSource* MasterSource;
+
+  /*! UID of the next item to read in the master source, valid only if Positioned is true */
+  BufferItemUidType NextUnreadUid;
+  /*! If false then the next read position is determined by the next read (see Reset) */
+  bool Positioned;
+  /*! If not UNDEFINED_TIMESTAMP then the next read starts at the first item after this time */
+  double SeekTimestamp;
+
+  double LastReadTimestamp;
+
+  std::atomic<unsigned long long> NumberOfOverwrittenItems;
+  std::atomic<unsigned long long> NumberOfSkippedItems;
+  std::atomic<unsigned long long> NumberOfReadItems;
+  std::atomic<unsigned long long> NumberOfOverwrittenItemsWarnings;
+
+  double OverwrittenItemsWarningPeriodSec;
+  /*! System time of the last warning about overwritten items, negative if no warning has been logged yet */
+  double LastOverwrittenItemsWarningTime;
+  /*! Number of items overwritten since the last warning */
+  unsigned long long NumberOfUnreportedOverwrittenItems;
+
+private:
+  PlusChannelReadCursor(const PlusChannelReadCursor&);
+  void operator=(const PlusChannelReadCursor&);
+};
+
+#endif
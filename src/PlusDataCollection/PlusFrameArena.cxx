@@ -0,0 +1,216 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusFrameArena.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  // Size of the explicit huge pages that are requested on Linux
+  const size_t HUGE_PAGE_SIZE_BYTES = 2 * 1024 * 1024;
+  // Page size that is assumed if it cannot be queried from the operating system
+  const size_t DEFAULT_PAGE_SIZE_BYTES = 4096;
+
+  //----------------------------------------------------------------------------
+  size_t RoundUp(size_t value, size_t alignment)
+  {
+    return ((value + alignment - 1) / alignment) * alignment;
+  }
+
+  //----------------------------------------------------------------------------
+  size_t GetPageSize()
+  {
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwPageSize > 0 ? systemInfo.dwPageSize : DEFAULT_PAGE_SIZE_BYTES;
+#else
+    long pageSize = sysconf(_SC_PAGESIZE);
+    return pageSize > 0 ? static_cast<size_t>(pageSize) : DEFAULT_PAGE_SIZE_BYTES;
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusFrameArena::PlusFrameArena()
+  : Memory(NULL)
+  , ReservedBytes(0)
+  , NumberOfSlots(0)
+  , SlotSizeBytes(0)
+  , SlotStrideBytes(0)
+  , UsingHugePages(false)
+  , Prefaulted(false)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusFrameArena::~PlusFrameArena()
+{
+  this->Release();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusFrameArena::Allocate(size_t numberOfSlots, size_t slotSizeBytes)
+{
+  this->Release();
+  if (numberOfSlots == 0 || slotSizeBytes == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  const size_t slotStrideBytes = RoundUp(slotSizeBytes, SLOT_ALIGNMENT);
+  size_t requestedBytes = RoundUp(numberOfSlots * slotStrideBytes, GetPageSize());
+  void* memory = NULL;
+  bool usingHugePages = false;
+
+#ifdef _WIN32
+  // Large pages require the SeLockMemoryPrivilege, fall back to regular pages if the allocation fails
+  SIZE_T largePageSize = GetLargePageMinimum();
+  if (largePageSize > 0 && requestedBytes >= largePageSize)
+  {
+    memory = VirtualAlloc(NULL, RoundUp(requestedBytes, largePageSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (memory != NULL)
+    {
+      requestedBytes = RoundUp(requestedBytes, largePageSize);
+      usingHugePages = true;
+    }
+  }
+  if (memory == NULL)
+  {
+    memory = VirtualAlloc(NULL, requestedBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  }
+#else
+#ifdef MAP_HUGETLB
+  // Explicit huge pages are only available if they are reserved in the system (vm.nr_hugepages)
+  if (requestedBytes >= HUGE_PAGE_SIZE_BYTES)
+  {
+    memory = mmap(NULL, RoundUp(requestedBytes, HUGE_PAGE_SIZE_BYTES), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+    {
+      requestedBytes = RoundUp(requestedBytes, HUGE_PAGE_SIZE_BYTES);
+      usingHugePages = true;
+    }
+    else
+    {
+      memory = NULL;
+    }
+  }
+#endif
+  if (memory == NULL)
+  {
+    memory = mmap(NULL, requestedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+      memory = NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    else if (requestedBytes >= HUGE_PAGE_SIZE_BYTES && madvise(memory, requestedBytes, MADV_HUGEPAGE) == 0)
+    {
+      // transparent huge pages are used if they are enabled in the system
+      usingHugePages = true;
+    }
+#endif
+  }
+#endif
+
+  if (memory == NULL)
+  {
+    LOG_ERROR("Failed to reserve " << requestedBytes << " bytes for " << numberOfSlots << " frames");
+    return PLUS_FAIL;
+  }
+
+  this->Memory = static_cast<unsigned char*>(memory);
+  this->ReservedBytes = requestedBytes;
+  this->NumberOfSlots = numberOfSlots;
+  this->SlotSizeBytes = slotSizeBytes;
+  this->SlotStrideBytes = slotStrideBytes;
+  this->UsingHugePages = usingHugePages;
+  this->Prefaulted = false;
+
+  LOG_DEBUG("Frame arena reserved " << this->ReservedBytes << " bytes for " << numberOfSlots << " frames" << (usingHugePages ? " using huge pages" : ""));
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusFrameArena::Release()
+{
+  if (this->Memory != NULL)
+  {
+#ifdef _WIN32
+    VirtualFree(this->Memory, 0, MEM_RELEASE);
+#else
+    munmap(this->Memory, this->ReservedBytes);
+#endif
+  }
+  this->Memory = NULL;
+  this->ReservedBytes = 0;
+  this->NumberOfSlots = 0;
+  this->SlotSizeBytes = 0;
+  this->SlotStrideBytes = 0;
+  this->UsingHugePages = false;
+  this->Prefaulted = false;
+}
+
+//----------------------------------------------------------------------------
+void PlusFrameArena::Prefault()
+{
+  if (this->Memory == NULL || this->Prefaulted)
+  {
+    return;
+  }
+  PrefaultMemory(this->Memory, this->ReservedBytes);
+  this->Prefaulted = true;
+}
+
+//----------------------------------------------------------------------------
+void PlusFrameArena::PrefaultMemory(void* memory, size_t sizeBytes)
+{
+  if (memory == NULL)
+  {
+    return;
+  }
+  // Write back the current value of one byte in each page: the page is mapped, but the content does not change
+  const size_t pageSize = GetPageSize();
+  volatile unsigned char* bytes = static_cast<volatile unsigned char*>(memory);
+  for (size_t offset = 0; offset < sizeBytes; offset += pageSize)
+  {
+    bytes[offset] = bytes[offset];
+  }
+  if (sizeBytes > 0)
+  {
+    bytes[sizeBytes - 1] = bytes[sizeBytes - 1];
+  }
+}
+
+//----------------------------------------------------------------------------
+void* PlusFrameArena::GetSlot(size_t slotIndex) const
+{
+  if (this->Memory == NULL || slotIndex >= this->NumberOfSlots)
+  {
+    return NULL;
+  }
+  return this->Memory + slotIndex * this->SlotStrideBytes;
+}
+
+//----------------------------------------------------------------------------
+bool PlusFrameArena::Contains(const void* ptr) const
+{
+  const unsigned char* bytePtr = static_cast<const unsigned char*>(ptr);
+  return this->Memory != NULL && bytePtr >= this->Memory && bytePtr < this->Memory + this->ReservedBytes;
+}
+
+//----------------------------------------------------------------------------
+bool PlusFrameArena::IsAllocated(size_t numberOfSlots, size_t slotSizeBytes) const
+{
+  return this->Memory != NULL && this->NumberOfSlots == numberOfSlots && this->SlotSizeBytes == slotSizeBytes;
+}
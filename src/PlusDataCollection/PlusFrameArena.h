@@ -0,0 +1,97 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusFrameArena_h
+#define __PlusFrameArena_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <cstddef>
+
+/*!
+  \class PlusFrameArena
+  \brief Contiguous memory block that holds the pixel data of all the frames of a buffer.
+
+  The memory is reserved with a single allocation and is split into equally sized slots (one slot for each
+  buffer item). Each slot starts at a SLOT_ALIGNMENT byte aligned address, so that SIMD instructions
+  can process the frames efficiently.
+
+  On Linux explicit huge pages (MAP_HUGETLB) are used if they are available, otherwise transparent huge pages
+  are requested for the block. On Windows large pages are used if the process has the required privilege.
+  In all other cases regular pages are used.
+
+  Memory pages are mapped by the operating system at the first write, which makes the first pass
+  of the acquisition through the buffer slow. Prefault() writes all the pages in advance, so that
+  it can be done before the acquisition is started.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusFrameArena
+{
+public:
+  /*! Alignment of the slots (in bytes) */
+  static const size_t SLOT_ALIGNMENT = 64;
+
+  PlusFrameArena();
+  virtual ~PlusFrameArena();
+
+  /*!
+    Reserve memory for numberOfSlots slots, each of them can hold at least slotSizeBytes bytes.
+    Previously reserved memory is released, so pointers to the previous slots become invalid.
+  */
+  PlusStatus Allocate(size_t numberOfSlots, size_t slotSizeBytes);
+
+  /*! Release the reserved memory */
+  void Release();
+
+  /*! Write all memory pages of the arena, so that no page faults occur when the slots are first used. The content is not modified. */
+  void Prefault();
+
+  /*! Write each memory page of a memory block (without modifying the content), so that the operating system maps all of them */
+  static void PrefaultMemory(void* memory, size_t sizeBytes);
+
+  /*! Get the start address of a slot. Returns NULL if the slot index is invalid. */
+  void* GetSlot(size_t slotIndex) const;
+
+  /*! Returns true if the address is within the memory of the arena */
+  bool Contains(const void* ptr) const;
+
+  /*! Returns true if the memory has been reserved for the requested number of slots and slot size */
+  bool IsAllocated(size_t numberOfSlots, size_t slotSizeBytes) const;
+
+  /*! Get the number of slots */
+  size_t GetNumberOfSlots() const { return this->NumberOfSlots; }
+
+  /*! Get the usable size of a slot (in bytes) */
+  size_t GetSlotSizeBytes() const { return this->SlotSizeBytes; }
+
+  /*! Get the total number of bytes reserved by the arena (including padding) */
+  size_t GetReservedBytes() const { return this->ReservedBytes; }
+
+  /*! Returns true if the memory is backed by huge pages (or transparent huge pages are requested) */
+  bool GetUsingHugePages() const { return this->UsingHugePages; }
+
+  /*! Returns true if the memory pages have been written since the last allocation */
+  bool GetPrefaulted() const { return this->Prefaulted; }
+
+protected:
+  unsigned char* Memory;
+  size_t ReservedBytes;
+  size_t NumberOfSlots;
+  size_t SlotSizeBytes;
+  /*! Distance between the start addresses of consecutive slots */
+  size_t SlotStrideBytes;
+  bool UsingHugePages;
+  bool Prefaulted;
+
+private:
+  PlusFrameArena(const PlusFrameArena&);
+  void operator=(const PlusFrameArena&);
+};
+
+#endif
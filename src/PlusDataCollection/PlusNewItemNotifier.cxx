@@ -0,0 +1,49 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusNewItemNotifier.h"
+
+// STL includes
+#include <chrono>
+
+//----------------------------------------------------------------------------
+PlusNewItemNotifier::PlusNewItemNotifier()
+  : NotificationCount(0)
+  , ProcessedNotificationCount(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusNewItemNotifier::~PlusNewItemNotifier()
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusNewItemNotifier::Notify()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->NotificationCount++;
+  }
+  this->NewItemCondition.notify_all();
+}
+
+//----------------------------------------------------------------------------
+bool PlusNewItemNotifier::WaitForNewItem(double timeoutSec)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  if (this->NotificationCount == this->ProcessedNotificationCount && timeoutSec > 0)
+  {
+    this->NewItemCondition.wait_for(lock, std::chrono::duration<double>(timeoutSec), [this]
+    {
+      return this->NotificationCount != this->ProcessedNotificationCount;
+    });
+  }
+  bool newItemAvailable = (this->NotificationCount != this->ProcessedNotificationCount);
+  this->ProcessedNotificationCount = this->NotificationCount;
+  return newItemAvailable;
+}
@@ -0,0 +1,60 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusNewItemNotifier_h
+#define __PlusNewItemNotifier_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include <condition_variable>
+#include <mutex>
+
+/*!
+  \class PlusNewItemNotifier
+  \brief Wakes up a thread that waits for new items in one or more buffers.
+
+  The notifier is registered in the buffers that the thread reads (usually all the data sources of a channel,
+  see vtkPlusChannel::AddNewItemNotifier) and the buffers call Notify() each time an item is added.
+  The thread calls WaitForNewItem() instead of polling the buffers at a fixed rate, so that it
+  can process each item as soon as it is available.
+
+  A notifier is intended to be used by a single waiting thread. Notifications are counted, so an item that
+  is added while the thread is not waiting wakes up the next WaitForNewItem() call immediately.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusNewItemNotifier
+{
+public:
+  PlusNewItemNotifier();
+  virtual ~PlusNewItemNotifier();
+
+  /*! Signal that a new item is available. Called by the buffers after the item is added. */
+  void Notify();
+
+  /*!
+    Wait until Notify() is called or the timeout expires.
+    Returns immediately if Notify() has been called since the previous WaitForNewItem() call.
+    \param timeoutSec Maximum waiting time in seconds
+    \return true if a new item is available, false if the timeout expired
+  */
+  bool WaitForNewItem(double timeoutSec);
+
+protected:
+  std::mutex Mutex;
+  std::condition_variable NewItemCondition;
+
+  /*! Number of Notify() calls */
+  unsigned long long NotificationCount;
+  /*! Value of NotificationCount at the end of the previous WaitForNewItem() call */
+  unsigned long long ProcessedNotificationCount;
+
+private:
+  PlusNewItemNotifier(const PlusNewItemNotifier&);
+  void operator=(const PlusNewItemNotifier&);
+};
+
+#endif
@@ -8,6 +8,14 @@
 #include "PlusStreamBufferItem.h"
 #include "vtkMatrix4x4.h"
 
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  const double IDENTITY_MATRIX_ELEMENTS[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+}
+
 //----------------------------------------------------------------------------
 //            DataBufferItem
 //----------------------------------------------------------------------------
@@ -17,9 +25,10 @@ StreamBufferItem::StreamBufferItem()
   , Index(0)
   , Uid(0)
   , ValidTransformData(false)
-  , Matrix(vtkSmartPointer<vtkMatrix4x4>::New())
   , Status(TOOL_OK)
+  , FrameCompressed(false)
 {
+  std::copy(IDENTITY_MATRIX_ELEMENTS, IDENTITY_MATRIX_ELEMENTS + 16, this->Matrix);
 }
 
 //----------------------------------------------------------------------------
@@ -30,8 +39,8 @@ StreamBufferItem::~StreamBufferItem()
 //----------------------------------------------------------------------------
 StreamBufferItem::StreamBufferItem(const StreamBufferItem& dataItem)
 {
-  this->Matrix = vtkSmartPointer<vtkMatrix4x4>::New();
   this->Status = TOOL_OK;
+  this->FrameCompressed = false;
   *this = dataItem;
 }
 
@@ -44,15 +53,35 @@ StreamBufferItem& StreamBufferItem::operator=(StreamBufferItem const& dataItem)
     return *this;
   }
 
-  this->Frame = dataItem.Frame;
+  if (dataItem.FrameCompressed && dataItem.Frame.GetImage() != NULL)
+  {
+    // The pixel data is in CompressedFrameData, the image only has an empty pixel array of the frame format.
+    // Copying the frame would read the pixels based on the frame size, so only the image structure is copied.
+    this->Frame.SetImageType(dataItem.Frame.GetImageType());
+    this->Frame.SetImageOrientation(dataItem.Frame.GetImageOrientation());
+    this->Frame.DeepCopyFrom(dataItem.Frame.GetImage());
+  }
+  else
+  {
+    this->Frame = dataItem.Frame;
+  }
   this->FilteredTimeStamp = dataItem.FilteredTimeStamp;
   this->UnfilteredTimeStamp = dataItem.UnfilteredTimeStamp;
   this->Index = dataItem.Index;
   this->Uid = dataItem.Uid;
   this->FrameFields = dataItem.FrameFields;
   this->Status = dataItem.Status;
-  this->Matrix->DeepCopy(dataItem.Matrix);
+  std::copy(dataItem.Matrix, dataItem.Matrix + 16, this->Matrix);
   this->ValidTransformData = dataItem.ValidTransformData;
+  this->FrameCompressed = dataItem.FrameCompressed;
+  if (this->FrameCompressed)
+  {
+    this->CompressedFrameData = dataItem.CompressedFrameData;
+  }
+  else
+  {
+    this->CompressedFrameData.clear();
+  }
 
   return *this;
 }
@@ -121,6 +150,60 @@ PlusStatus StreamBufferItem::DeepCopy(StreamBufferItem* dataItem)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::DeepCopyTrackingData(StreamBufferItem* dataItem)
+{
+  if (dataItem == NULL)
+  {
+    LOG_ERROR("Failed to deep copy data buffer item - buffer item NULL!");
+    return PLUS_FAIL;
+  }
+  if (this == dataItem)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  this->FilteredTimeStamp = dataItem->FilteredTimeStamp;
+  this->UnfilteredTimeStamp = dataItem->UnfilteredTimeStamp;
+  this->Index = dataItem->Index;
+  this->Uid = dataItem->Uid;
+  this->FrameFields = dataItem->FrameFields;
+  this->Status = dataItem->Status;
+  std::copy(dataItem->Matrix, dataItem->Matrix + 16, this->Matrix);
+  this->ValidTransformData = dataItem->ValidTransformData;
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void StreamBufferItem::SetCompressedFrameData(const unsigned char* data, size_t sizeBytes)
+{
+  // assign reuses the allocated memory if the data fits
+  if (data != NULL && sizeBytes > 0)
+  {
+    this->CompressedFrameData.assign(data, data + sizeBytes);
+  }
+  else
+  {
+    this->CompressedFrameData.clear();
+  }
+  this->FrameCompressed = true;
+}
+
+//----------------------------------------------------------------------------
+void StreamBufferItem::SwapCompressedFrameData(std::vector<unsigned char>& data)
+{
+  this->CompressedFrameData.swap(data);
+  this->FrameCompressed = true;
+}
+
+//----------------------------------------------------------------------------
+void StreamBufferItem::ClearCompressedFrameData()
+{
+  this->CompressedFrameData.clear();
+  this->FrameCompressed = false;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
 {
@@ -132,11 +215,18 @@ PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
 
   ValidTransformData = true;
 
-  this->Matrix->DeepCopy(matrix);
+  std::copy(&matrix->Element[0][0], &matrix->Element[0][0] + 16, this->Matrix);
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void StreamBufferItem::SetMatrixElements(const double elements[16])
+{
+  this->ValidTransformData = true;
+  std::copy(elements, elements + 16, this->Matrix);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StreamBufferItem::GetMatrix(vtkMatrix4x4* outputMatrix)
 {
@@ -33,6 +33,8 @@ class vtkPlusVirtualMixer;
 /*!
   \class DataBufferItem
   \brief Stores a single video frame OR a single transform with a timestamp. This object can be stored in a timestamped buffer.
+  The transform is stored inline (not in a separate vtkMatrix4x4 object), so that creating and copying items does not
+  allocate memory and buffers of tracker items are stored contiguously.
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport StreamBufferItem
@@ -85,6 +87,9 @@ public:
   /*! Copy stream buffer item */
   PlusStatus DeepCopy(StreamBufferItem* dataItem);
 
+  /*! Copy all data of the stream buffer item except the video frame (the frame of this item is not modified) */
+  PlusStatus DeepCopyTrackingData(StreamBufferItem* dataItem);
+
   igsioVideoFrame& GetFrame() { return this->Frame; };
 
   /*! Set tracker matrix */
@@ -92,6 +97,11 @@ public:
   /*! Get tracker matrix */
   PlusStatus GetMatrix(vtkMatrix4x4* outputMatrix);
 
+  /*! Set tracker matrix from 16 elements in row-major order (same as vtkMatrix4x4::Element) */
+  void SetMatrixElements(const double elements[16]);
+  /*! Get tracker matrix elements in row-major order (same as vtkMatrix4x4::Element) */
+  const double* GetMatrixElements() const { return this->Matrix; }
+
   /*! Set tracker item status */
   void SetStatus(ToolStatus status);
   /*! Get tracker item status */
@@ -105,6 +115,20 @@ public:
     return Frame.IsImageValid();
   }
 
+  /*!
+    True if the pixel data of the frame is stored compressed (see vtkPlusBuffer::SetCompressFrames).
+    The frame of such an item has no pixel data, vtkPlusBuffer::GetStreamBufferItem returns the item with the uncompressed frame.
+  */
+  bool IsFrameCompressed() const { return this->FrameCompressed; }
+  /*! Get the compressed pixel data of the frame */
+  const std::vector<unsigned char>& GetCompressedFrameData() const { return this->CompressedFrameData; }
+  /*! Store the compressed pixel data of the frame. The memory of previously stored data is reused. */
+  void SetCompressedFrameData(const unsigned char* data, size_t sizeBytes);
+  /*! Store the compressed pixel data of the frame without copying: the previously stored data is returned in data */
+  void SwapCompressedFrameData(std::vector<unsigned char>& data);
+  /*! Mark the frame as uncompressed. The memory of the compressed data is kept for reuse. */
+  void ClearCompressedFrameData();
+
 protected:
   double FilteredTimeStamp;
   double UnfilteredTimeStamp;
@@ -120,8 +144,13 @@ protected:
 
   bool ValidTransformData;
   igsioVideoFrame Frame;
-  vtkSmartPointer<vtkMatrix4x4> Matrix;
+  /*! Tracker matrix elements in row-major order */
+  double Matrix[16];
   ToolStatus Status;
+
+  /*! If true then the pixel data of Frame is stored in CompressedFrameData */
+  bool FrameCompressed;
+  std::vector<unsigned char> CompressedFrameData;
 };
 
 #endif
@@ -5,14 +5,15 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusSequenceStreamReader.h"
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
-#include "vtkIGSIOSequenceIO.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtksys/SystemTools.hxx"
 
@@ -31,6 +32,9 @@ vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   , LastAddedFrameUid(0)
   , LastAddedLoopIndex(0)
   , SimulatedStream(VIDEO_STREAM)
+  , StreamingEnabled(false)
+  , StreamingReadAheadFrames(32)
+  , StreamReader(NULL)
 {
   // No callback function provided by the device, so the data capture thread will be used to poll the hardware and add new items to the buffer
   this->StartThreadForInternalUpdates = true;
@@ -45,6 +49,7 @@ vtkPlusSavedDataSource::~vtkPlusSavedDataSource()
     this->Disconnect();
   }
   DeleteLocalBuffers();
+  DeleteStreamReader();
 }
 
 //----------------------------------------------------------------------------
@@ -107,8 +112,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       currentLoopIndex = floor(elapsedTime / loopTime);
       currentFrameTime_Local = this->LoopStartTime_Local + elapsedTime - loopTime * currentLoopIndex;
+      double oldestTimestamp_Local = 0;
       double latestTimestamp_Local = 0;
-      GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+      GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
       if (currentFrameTime_Local > latestTimestamp_Local)
       {
         // hold the last frame after the end of the buffer
@@ -119,9 +125,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
 
     // Get the uid of the frame that has been most recently acquired
     BufferItemUidType closestFrameUid = 0;
-    GetLocalBuffer()->GetItemUidFromTime(currentFrameTime_Local, closestFrameUid);
+    GetLocalItemUidFromTime(currentFrameTime_Local, closestFrameUid);
     double closestFrameTime_Local = 0;
-    GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+    GetLocalTimeStamp(closestFrameUid, closestFrameTime_Local);
     if (closestFrameTime_Local > currentFrameTime_Local)
     {
       // the closest frame is newer than the current time, so don't use this item but the one before
@@ -156,7 +162,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     this->FrameNumber++;
 
     StreamBufferItem dataBufferItemToBeAdded;
-    if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+    if (GetLocalStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
     {
       LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
       status = PLUS_FAIL;
@@ -173,12 +179,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       case VIDEO_STREAM:
         {
-          igsioFieldMapType fieldMap;
-          if (this->UseAllFrameFields)
-          {
-            fieldMap = dataBufferItemToBeAdded.GetFrameFieldMap();
-          }
-          if (this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItemToBeAdded.GetFrame(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap) != PLUS_SUCCESS)
+          if (this->AddLocalVideoItemToVideoSources(frameToBeAddedUid, dataBufferItemToBeAdded, unfilteredTimestamp, filteredTimestamp) != PLUS_SUCCESS)
           {
             status = PLUS_FAIL;
           }
@@ -263,7 +264,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
 
   this->FrameNumber++;
   StreamBufferItem dataBufferItemToBeAdded;
-  if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+  if (GetLocalStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
   {
     LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
     return PLUS_FAIL;
@@ -274,12 +275,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   {
     case VIDEO_STREAM:
       {
-        igsioFieldMapType fieldMap;
-        if (this->UseAllFrameFields)
-        {
-          fieldMap = dataBufferItemToBeAdded.GetFrameFieldMap();
-        }
-        if (this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItemToBeAdded.GetFrame(), this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &fieldMap) != PLUS_SUCCESS)
+        if (this->AddLocalVideoItemToVideoSources(frameToBeAddedUid, dataBufferItemToBeAdded, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP) != PLUS_SUCCESS)
         {
           // UNDEFINED_TIMESTAMP => use current timestamp
           status = PLUS_FAIL;
@@ -379,28 +375,60 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-
-  // Read sequence file into tracked frame list
-  vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+  DeleteStreamReader();
 
-  if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+  bool streamingSupported = false;
+  if (this->StreamingEnabled)
   {
-    LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
-    return PLUS_FAIL;
+    streamingSupported = PlusSequenceStreamReader::IsStreamingSupported(foundAbsoluteImagePath);
+    if (!streamingSupported)
+    {
+      LOG_WARNING("Sequence file cannot be streamed, it is loaded into memory: " << foundAbsoluteImagePath);
+    }
   }
 
   PlusStatus status = PLUS_FAIL;
-  switch (this->SimulatedStream)
+  if (streamingSupported && this->SimulatedStream == VIDEO_STREAM)
   {
-    case VIDEO_STREAM:
-      status = InternalConnectVideo(savedDataBuffer);
-      break;
-    case TRACKER_STREAM:
-      status = InternalConnectTracker(savedDataBuffer);
-      break;
-    default:
-      LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    status = InternalConnectVideoStreaming(foundAbsoluteImagePath);
+  }
+  else
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+
+    if (streamingSupported)
+    {
+      // Only the frame fields are needed for replaying a tracker stream, so image data is not read
+      PlusSequenceStreamReader reader;
+      if (reader.Open(foundAbsoluteImagePath) != PLUS_SUCCESS || reader.GetTrackedFrameListWithoutImages(savedDataBuffer) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to connect to saved data video source: Unable to read sequence file: " << this->SequenceFile);
+        return PLUS_FAIL;
+      }
+    }
+    else
+    {
+      // Read sequence file into tracked frame list
+      vtkPlusSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+    }
+
+    if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+    {
+      LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
+      return PLUS_FAIL;
+    }
+
+    switch (this->SimulatedStream)
+    {
+      case VIDEO_STREAM:
+        status = InternalConnectVideo(savedDataBuffer);
+        break;
+      case TRACKER_STREAM:
+        status = InternalConnectTracker(savedDataBuffer);
+        break;
+      default:
+        LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    }
   }
 
   if (status != PLUS_SUCCESS)
@@ -408,28 +436,26 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  if (GetLocalBuffer() == NULL)
+  if (this->StreamReader == NULL && GetLocalBuffer() == NULL)
   {
     LOG_ERROR("Local buffer is invalid");
     return PLUS_FAIL;
   }
 
   double oldestTimestamp_Local = 0;
-  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // Set the default loop start time and length to match the video buffer start time and length
 
-  this->LoopFirstFrameUid = GetLocalBuffer()->GetOldestItemUidInBuffer();
-  this->LoopLastFrameUid = GetLocalBuffer()->GetLatestItemUidInBuffer();
+  GetLocalItemUidRange(this->LoopFirstFrameUid, this->LoopLastFrameUid);
 
   this->LoopStartTime_Local = oldestTimestamp_Local;
 
   // When we reach the last frame we have to wait one frame period before
   // playing the first frame, so we have to add one frame period to the loop length (loopTime)
   double framePeriodSec = 0;
-  double frameRate = GetLocalBuffer()->GetFrameRate();
+  double frameRate = GetLocalFrameRate();
   if (frameRate != 0.0)
   {
     framePeriodSec = 1.0 / frameRate;
@@ -453,6 +479,8 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
 
+  UpdateStreamReadAheadRange();
+
   return PLUS_SUCCESS;
 }
 
@@ -502,44 +530,83 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
   this->LocalVideoBuffer->CopyImagesFromTrackedFrameList(savedDataBuffer, vtkPlusBuffer::READ_FILTERED_IGNORE_UNFILTERED_TIMESTAMPS, this->UseAllFrameFields);
   savedDataBuffer->Clear();
 
+  return SetVideoSourcesInputParameters(this->LocalVideoBuffer->GetImageOrientation(), this->LocalVideoBuffer->GetFrameSize(),
+                                        this->LocalVideoBuffer->GetNumberOfScalarComponents(), this->LocalVideoBuffer->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalConnectVideoStreaming(const std::string& sequenceFilePath)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Image data is read from the file during replay, no local buffer is needed
+  DeleteLocalBuffers();
+  DeleteStreamReader();
+  this->StreamReader = new PlusSequenceStreamReader;
+  this->StreamReader->SetNumberOfReadAheadFrames(std::max(this->StreamingReadAheadFrames, 1));
+  if (this->StreamReader->Open(sequenceFilePath, this->UseAllFrameFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to connect to saved data video source: Unable to read sequence file: " << this->SequenceFile);
+    DeleteStreamReader();
+    return PLUS_FAIL;
+  }
+
+  if (outputDataSource->SetImageType(this->StreamReader->GetImageType()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set video buffer image type");
+    return PLUS_FAIL;
+  }
+
+  LOG_DEBUG("Streaming " << this->StreamReader->GetNumberOfFrames() << " frames from " << sequenceFilePath);
+  return SetVideoSourcesInputParameters(this->StreamReader->GetImageOrientation(), this->StreamReader->GetFrameSize(),
+                                        this->StreamReader->GetNumberOfScalarComponents(), this->StreamReader->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::SetVideoSourcesInputParameters(US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType)
+{
   PlusStatus result(PLUS_SUCCESS);
   for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
   {
     vtkPlusDataSource* source(it->second);
 
-    if (source->SetInputImageOrientation(this->LocalVideoBuffer->GetImageOrientation()) != PLUS_SUCCESS)
+    if (source->SetInputImageOrientation(imageOrientation) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
-      LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
+      LOG_ERROR(source->GetId() << ": Failed to set video frame size");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetNumberOfScalarComponents(this->LocalVideoBuffer->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    if (source->SetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
     {
-      LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
+      LOG_ERROR(source->GetId() << ": Failed to set video number of scalar components");
       result = PLUS_FAIL;
       continue;
     }
 
     source->Clear();
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
-      LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
+      LOG_ERROR(source->GetId() << ": Failed to set video frame size");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetPixelType(this->LocalVideoBuffer->GetPixelType()) != PLUS_SUCCESS)
+    if (source->SetPixelType(pixelType) != PLUS_SUCCESS)
     {
-      LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
+      LOG_ERROR(source->GetId() << ": Failed to set video pixel type");
       result = PLUS_FAIL;
       continue;
     }
@@ -614,6 +681,7 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectTracker(vtkIGSIOTrackedFrameLi
 PlusStatus vtkPlusSavedDataSource::InternalDisconnect()
 {
   DeleteLocalBuffers();
+  DeleteStreamReader();
   return PLUS_SUCCESS;
 }
 
@@ -670,6 +738,8 @@ PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConf
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RepeatEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseOriginalTimestamps, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(StreamingEnabled, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, StreamingReadAheadFrames, deviceConfig);
 
   const char* useData = deviceConfig->GetAttribute("UseData");
   if (useData != NULL)
@@ -707,6 +777,8 @@ PlusStatus vtkPlusSavedDataSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(SequenceFile, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(RepeatEnabled, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(UseOriginalTimestamps, imageAcquisitionConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(StreamingEnabled, imageAcquisitionConfig);
+  imageAcquisitionConfig->SetIntAttribute("StreamingReadAheadFrames", this->StreamingReadAheadFrames);
 
   if (this->UseAllFrameFields)
   {
@@ -776,6 +848,8 @@ void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopS
 
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
+
+  UpdateStreamReadAheadRange();
 }
 
 //----------------------------------------------------------------------------
@@ -792,9 +866,8 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
   // time_Local should be also within the local buffer time range
   double oldestTimestamp_Local = 0;
-  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // if the asked time is outside of the loop range then return the closest element in the range
   if (time_Local < oldestTimestamp_Local)
@@ -808,9 +881,9 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
 
   // Get the uid of the frame that has been most recently acquired
   BufferItemUidType closestFrameUid = 0;
-  GetLocalBuffer()->GetItemUidFromTime(time_Local, closestFrameUid);
+  GetLocalItemUidFromTime(time_Local, closestFrameUid);
   double closestFrameTime_Local = 0;
-  GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+  GetLocalTimeStamp(closestFrameUid, closestFrameTime_Local);
 
   // The closest frame is at the boundary, but it may be just outside the range:
   // use the next/previous frame if the closest frame is on the wrong side of the boundary
@@ -863,6 +936,195 @@ void vtkPlusSavedDataSource::DeleteLocalBuffers()
   this->LocalTrackerBuffers.clear();
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::DeleteStreamReader()
+{
+  if (this->StreamReader != NULL)
+  {
+    LOG_DEBUG("Number of frames that were not read ahead in time: " << this->StreamReader->GetNumberOfReadAheadMisses());
+    delete this->StreamReader;
+    this->StreamReader = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::UpdateStreamReadAheadRange()
+{
+  if (this->StreamReader == NULL || this->LoopFirstFrameUid < 1 || this->LoopLastFrameUid < this->LoopFirstFrameUid)
+  {
+    return;
+  }
+  this->StreamReader->SetReadAheadFrameRange(this->LoopFirstFrameUid - 1, this->LoopLastFrameUid - 1);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetLocalTimeRange(double& oldestTimestamp_Local, double& latestTimestamp_Local)
+{
+  if (this->StreamReader != NULL)
+  {
+    oldestTimestamp_Local = this->StreamReader->GetFrameTimestamp(0);
+    latestTimestamp_Local = this->StreamReader->GetFrameTimestamp(this->StreamReader->GetNumberOfFrames() - 1);
+    return PLUS_SUCCESS;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  if (localBuffer->GetOldestTimeStamp(oldestTimestamp_Local) != ITEM_OK || localBuffer->GetLatestTimeStamp(latestTimestamp_Local) != ITEM_OK)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetLocalItemUidRange(BufferItemUidType& oldestUid, BufferItemUidType& latestUid)
+{
+  if (this->StreamReader != NULL)
+  {
+    oldestUid = 1;
+    latestUid = this->StreamReader->GetNumberOfFrames();
+    return PLUS_SUCCESS;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  oldestUid = localBuffer->GetOldestItemUidInBuffer();
+  latestUid = localBuffer->GetLatestItemUidInBuffer();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusSavedDataSource::GetLocalItemUidFromTime(double time_Local, BufferItemUidType& uid)
+{
+  if (this->StreamReader != NULL)
+  {
+    uid = this->StreamReader->GetFrameIndexFromTime(time_Local) + 1;
+    return ITEM_OK;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL)
+  {
+    return ITEM_UNKNOWN_ERROR;
+  }
+  return localBuffer->GetItemUidFromTime(time_Local, uid);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusSavedDataSource::GetLocalTimeStamp(BufferItemUidType uid, double& timestamp_Local)
+{
+  if (this->StreamReader != NULL)
+  {
+    if (uid < 1)
+    {
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    if (uid > this->StreamReader->GetNumberOfFrames())
+    {
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+    timestamp_Local = this->StreamReader->GetFrameTimestamp(uid - 1);
+    return ITEM_OK;
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL)
+  {
+    return ITEM_UNKNOWN_ERROR;
+  }
+  return localBuffer->GetTimeStamp(uid, timestamp_Local);
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusSavedDataSource::GetLocalFrameRate()
+{
+  if (this->StreamReader != NULL)
+  {
+    unsigned int numberOfFrames = this->StreamReader->GetNumberOfFrames();
+    double oldestTimestamp_Local = 0;
+    double latestTimestamp_Local = 0;
+    GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
+    if (numberOfFrames < 2 || latestTimestamp_Local <= oldestTimestamp_Local)
+    {
+      return 0.0;
+    }
+    return (numberOfFrames - 1) / (latestTimestamp_Local - oldestTimestamp_Local);
+  }
+  vtkPlusBuffer* localBuffer = GetLocalBuffer();
+  if (localBuffer == NULL)
+  {
+    return 0.0;
+  }
+  return localBuffer->GetFrameRate();
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusSavedDataSource::GetLocalStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  if (this->StreamReader == NULL)
+  {
+    vtkPlusBuffer* localBuffer = GetLocalBuffer();
+    if (localBuffer == NULL)
+    {
+      return ITEM_UNKNOWN_ERROR;
+    }
+    return localBuffer->GetStreamBufferItem(uid, bufferItem);
+  }
+
+  double timestamp_Local = 0;
+  ItemStatus status = GetLocalTimeStamp(uid, timestamp_Local);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  bufferItem->SetFilteredTimestamp(timestamp_Local);
+  bufferItem->SetUnfilteredTimestamp(timestamp_Local);
+  bufferItem->SetUid(uid);
+  bufferItem->SetIndex(uid - 1);
+  if (this->UseAllFrameFields)
+  {
+    // Same fields as in the local buffer: timestamps and frame number are provided by the output data source
+    const igsioFieldMapType& fields = this->StreamReader->GetFrameFields(uid - 1);
+    for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      if (fieldIt->first == "Timestamp" || fieldIt->first == "UnfilteredTimestamp" || fieldIt->first == "FrameNumber")
+      {
+        continue;
+      }
+      bufferItem->SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+    }
+  }
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::AddLocalVideoItemToVideoSources(BufferItemUidType uid, StreamBufferItem& bufferItem, double unfilteredTimestamp, double filteredTimestamp)
+{
+  igsioFieldMapType fieldMap;
+  if (this->UseAllFrameFields)
+  {
+    fieldMap = bufferItem.GetFrameFieldMap();
+  }
+
+  if (this->StreamReader == NULL)
+  {
+    return this->AddVideoItemToVideoSources(this->GetVideoSources(), bufferItem.GetFrame(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap);
+  }
+
+  const unsigned char* pixelData = NULL;
+  if (this->StreamReader->GetFramePixels(uid - 1, pixelData) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusSavedDataSource: Failed to read image data from the sequence file, UID=" << uid);
+    return PLUS_FAIL;
+  }
+  // The image data is copied into the video sources, so the pixel data is not modified
+  return this->AddVideoItemToVideoSources(this->GetVideoSources(), const_cast<unsigned char*>(pixelData), this->StreamReader->GetImageOrientation(),
+                                          this->StreamReader->GetFrameSize(), this->StreamReader->GetPixelType(), this->StreamReader->GetNumberOfScalarComponents(),
+                                          this->StreamReader->GetImageType(), 0, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap);
+}
+
 //----------------------------------------------------------------------------
 vtkPlusBuffer* vtkPlusSavedDataSource::GetLocalBuffer()
 {
@@ -11,6 +11,7 @@ See License.txt for details.
 
 #include "vtkPlusDevice.h"
 
+class PlusSequenceStreamReader;
 class vtkPlusBuffer;
 
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource;
@@ -27,6 +28,10 @@ Attributes:
 \li UseOriginalTimestamps: if true then the original timestamps (recorded originally in the source file)
   will be replayed exactly, otherwise only the timestamp difference will be replayed exactly,
   starting from the current time (TRUE|FALSE)
+\li StreamingEnabled: if true then image data is read from the file during replay, only the frames that are replayed soon
+  are kept in memory. Connect is fast and memory usage does not depend on the length of the sequence.
+  Only uncompressed MetaImage files and indexed sequence files (.pseq) can be streamed, other files are loaded into memory (TRUE|FALSE, default: FALSE)
+\li StreamingReadAheadFrames: number of frames that are read ahead of the replayed frame if streaming is enabled (default: 32)
 
 */
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource : public vtkPlusDevice
@@ -73,7 +78,19 @@ public:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   vtkBooleanMacro( UseOriginalTimestamps, bool );
 
-  /*! Get local video buffer */
+  /*! If enabled then image data is read from the file during replay instead of loading the whole file on connect */
+  vtkGetMacro( StreamingEnabled, bool );
+  /*! If enabled then image data is read from the file during replay instead of loading the whole file on connect */
+  vtkSetMacro( StreamingEnabled, bool );
+  /*! If enabled then image data is read from the file during replay instead of loading the whole file on connect */
+  vtkBooleanMacro( StreamingEnabled, bool );
+
+  /*! Number of frames that are read ahead of the replayed frame if streaming is enabled */
+  vtkGetMacro( StreamingReadAheadFrames, int );
+  /*! Number of frames that are read ahead of the replayed frame if streaming is enabled */
+  vtkSetMacro( StreamingReadAheadFrames, int );
+
+  /*! Get local video buffer (NULL if the image data is streamed from the file) */
   vtkGetObjectMacro( LocalVideoBuffer, vtkPlusBuffer );
 
   virtual bool IsTracker() const;
@@ -98,6 +115,9 @@ protected:
   /*! Connect to device, in case the output is a video stream */
   virtual PlusStatus InternalConnectVideo( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
+  /*! Connect to device, in case the output is a video stream that is read from the file during replay */
+  virtual PlusStatus InternalConnectVideoStreaming( const std::string& sequenceFilePath );
+
   /*! Connect to device, in case the output is a tracker stream */
   virtual PlusStatus InternalConnectTracker( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
@@ -113,6 +133,30 @@ protected:
   /*! Internal update, called when the original timestamps are used */
   PlusStatus InternalUpdateOriginalTimestamp( BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex );
 
+  /*! Set input image properties of all video sources */
+  PlusStatus SetVideoSourcesInputParameters( US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType );
+
+  /*!
+    Accessors of the replayed data. If image data is streamed then the data is retrieved from the stream reader
+    (buffer item UID = frame index + 1), otherwise from the local buffer.
+  */
+  PlusStatus GetLocalTimeRange( double& oldestTimestamp_Local, double& latestTimestamp_Local );
+  PlusStatus GetLocalItemUidRange( BufferItemUidType& oldestUid, BufferItemUidType& latestUid );
+  ItemStatus GetLocalItemUidFromTime( double time_Local, BufferItemUidType& uid );
+  ItemStatus GetLocalTimeStamp( BufferItemUidType uid, double& timestamp_Local );
+  double GetLocalFrameRate();
+  /*! Get a replayed item. If image data is streamed then the returned item contains timestamps and frame fields only, no image. */
+  ItemStatus GetLocalStreamBufferItem( BufferItemUidType uid, StreamBufferItem* bufferItem );
+
+  /*! Add a replayed frame to the video sources. The image data is taken from the stream reader if streaming is enabled, otherwise from the buffer item. */
+  PlusStatus AddLocalVideoItemToVideoSources( BufferItemUidType uid, StreamBufferItem& bufferItem, double unfilteredTimestamp, double filteredTimestamp );
+
+  /*! Read ahead the frames of the loop if image data is streamed */
+  void UpdateStreamReadAheadRange();
+
+  /*! Close and delete the stream reader */
+  void DeleteStreamReader();
+
   BufferItemUidType GetClosestFrameUidWithinTimeRange( double time_Local, double startTime_Local, double stopTime_Local );
 
   /*! Get local tracker buffer */
@@ -181,6 +225,15 @@ protected:
 
   SimulatedStreamType SimulatedStream;
 
+  /*! Read image data from the file during replay instead of loading the whole file on connect */
+  bool StreamingEnabled;
+
+  /*! Number of frames that are read ahead of the replayed frame if streaming is enabled */
+  int StreamingReadAheadFrames;
+
+  /*! Reads image data from the file during replay. NULL if the image data is loaded into LocalVideoBuffer. */
+  PlusSequenceStreamReader* StreamReader;
+
 private:
   static vtkPlusSavedDataSource* Instance;
   vtkPlusSavedDataSource( const vtkPlusSavedDataSource& ); // Not implemented.
@@ -0,0 +1,162 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferCompressionTest.cxx
+  \brief Verifies that frames stored compressed in a video buffer keep their content.
+
+  A buffer with frame compression enabled is filled with frames of a pattern that is derived from the frame number.
+  Frames are compressed in the background, after waiting for the compression the content of all items is verified.
+  The buffer is then copied (DeepCopy) and the copy is enlarged (SetBufferSize), neither of them may lose the content
+  of the compressed items. The test is run with and without lock-free reads.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusTestFramePattern.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus VerifyBufferContent(vtkPlusBuffer* buffer, const std::string& description)
+  {
+    StreamBufferItem item;
+    int numberOfVerifiedItems(0);
+    for (BufferItemUidType uid = buffer->GetOldestItemUidInBuffer(); uid <= buffer->GetLatestItemUidInBuffer(); ++uid)
+    {
+      if (buffer->GetStreamBufferItem(uid, &item) != ITEM_OK)
+      {
+        LOG_ERROR(description << ": failed to get item " << uid);
+        return PLUS_FAIL;
+      }
+      if (PlusTestFramePattern::VerifyItemFrame(item, static_cast<long>(item.GetIndex()), description) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      numberOfVerifiedItems++;
+    }
+    if (numberOfVerifiedItems == 0)
+    {
+      LOG_ERROR(description << ": the buffer is empty");
+      return PLUS_FAIL;
+    }
+    LOG_INFO(description << ": content of " << numberOfVerifiedItems << " items verified");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunCompressionTest(bool lockFreeReads, int frameSizePx, int bufferSize, int numberOfUncompressedFrames)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = PlusTestFramePattern::CreateVideoBuffer(lockFreeReads ? "LockFreeCompressedBuffer" : "LockedCompressedBuffer", bufferSize, frameSizePx);
+    buffer->SetLockFreeReads(lockFreeReads);
+    buffer->SetNumberOfUncompressedFrames(numberOfUncompressedFrames);
+    buffer->SetCompressFrames(true);
+
+    // Fill the buffer one and a half times, so that compressed slots are reused
+    if (PlusTestFramePattern::AddFrames(buffer, 1, bufferSize + bufferSize / 2) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    buffer->WaitForFrameCompression();
+
+    const unsigned long long compressedBytes = buffer->GetCompressedFramesSizeBytes();
+    if (compressedBytes == 0)
+    {
+      LOG_ERROR("No frames were compressed in the buffer");
+      return PLUS_FAIL;
+    }
+    LOG_INFO((lockFreeReads ? "Lock-free reads" : "Locked reads") << ": " << bufferSize << " frames of " << frameSizePx * frameSizePx << " bytes are stored in "
+             << compressedBytes << " bytes of compressed data and " << numberOfUncompressedFrames << " uncompressed frames");
+
+    if (VerifyBufferContent(buffer, "Compressed buffer") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    vtkSmartPointer<vtkPlusBuffer> bufferCopy = vtkSmartPointer<vtkPlusBuffer>::New();
+    bufferCopy->SetDescriptiveName("CompressedBufferCopy");
+    bufferCopy->DeepCopy(buffer);
+    if (VerifyBufferContent(bufferCopy, "Copy of the compressed buffer") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    if (bufferCopy->SetBufferSize(bufferSize * 2) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to enlarge the copy of the compressed buffer");
+      return PLUS_FAIL;
+    }
+    if (VerifyBufferContent(bufferCopy, "Enlarged copy of the compressed buffer") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int frameSizePx(256);
+  int bufferSize(50);
+  int numberOfUncompressedFrames(2);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--frame-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameSizePx, "Width and height of the frames in pixels (Default: 256).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 50).");
+  args.AddArgument("--number-of-uncompressed-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfUncompressedFrames, "Number of most recent frames that are kept uncompressed (Default: 2).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (frameSizePx < 1 || numberOfUncompressedFrames < 1 || bufferSize <= numberOfUncompressedFrames)
+  {
+    std::cerr << "Frame size must be at least 1 and the buffer must be larger than the number of uncompressed frames" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  for (int lockFreeReads = 0; lockFreeReads <= 1; ++lockFreeReads)
+  {
+    if (RunCompressionTest(lockFreeReads != 0, frameSizePx, bufferSize, numberOfUncompressedFrames) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
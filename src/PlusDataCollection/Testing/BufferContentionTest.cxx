@@ -0,0 +1,442 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferContentionTest.cxx
+  \brief Measures how much concurrent readers delay the acquisition thread that writes into a buffer.
+
+  One writer adds video frames at a fixed rate while several reader threads continuously look up items by time
+  and copy them (the same way as the OpenIGTLink server or virtual devices do). The test is run with and without
+  lock-free reads, and with copying the frames in AddItem or writing them directly into the buffer with ReserveItem/CommitItem.
+  The time the writer spends on each item (filling the frame and adding it to the buffer) and the reader throughput are reported.
+  Each frame is filled with a value that is derived from its frame number, which allows detection of torn reads.
+  The test also checks that a new item notifier registered in the buffer is signaled by the writer.
+  The writer periodically resizes the buffer (as buffer size limits do when the measured frame rate changes),
+  which must not disturb the readers, not even the lock-free ones.
+  A reservation that is cancelled before its frame is written is checked to keep the oldest item of a full buffer.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusNewItemNotifier.h"
+#include "vtkPlusBuffer.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <vector>
+
+namespace
+{
+  struct ContentionTestData
+  {
+    vtkPlusBuffer* Buffer;
+    double FramePeriodSec;
+    std::atomic<bool> StopRequested;
+  };
+
+  struct ReaderStatistics
+  {
+    ReaderStatistics()
+      : TestData(NULL)
+      , RandomSeed(1)
+      , NumberOfReads(0)
+      , NumberOfUnavailableItems(0)
+      , NumberOfInconsistentItems(0)
+    {
+    }
+    ContentionTestData* TestData;
+    unsigned int RandomSeed;
+    long long NumberOfReads;
+    long long NumberOfUnavailableItems;
+    long long NumberOfInconsistentItems;
+  };
+
+  //----------------------------------------------------------------------------
+  void* ReaderThread(vtkMultiThreader::ThreadInfo* data)
+  {
+    ReaderStatistics* stats = static_cast<ReaderStatistics*>(data->UserData);
+    vtkPlusBuffer* buffer = stats->TestData->Buffer;
+    StreamBufferItem item;
+    unsigned int randomSeed = stats->RandomSeed;
+    while (!stats->TestData->StopRequested)
+    {
+      double oldestTime(0);
+      double latestTime(0);
+      if (buffer->GetOldestTimeStamp(oldestTime) != ITEM_OK || buffer->GetLatestTimeStamp(latestTime) != ITEM_OK)
+      {
+        continue;
+      }
+      // Request items from the newer half of the buffer, so that they are not overwritten between the lookup and the copy
+      randomSeed = randomSeed * 1103515245 + 12345;
+      double requestedTime = latestTime - (latestTime - oldestTime) * 0.5 * ((randomSeed >> 16) % 1000) / 1000.0;
+
+      BufferItemUidType uid(0);
+      if (buffer->GetItemUidFromTime(requestedTime, uid) != ITEM_OK || buffer->GetStreamBufferItem(uid, &item) != ITEM_OK)
+      {
+        stats->NumberOfUnavailableItems++;
+        continue;
+      }
+      stats->NumberOfReads++;
+
+      // Frame content, frame number and timestamp must all belong to the same frame
+      const unsigned char expectedPixelValue = static_cast<unsigned char>(item.GetIndex() % 256);
+      vtkImageData* image = item.GetFrame().GetImage();
+      const unsigned char* firstPixel = static_cast<unsigned char*>(image->GetScalarPointer());
+      const unsigned char* lastPixel = firstPixel + item.GetFrame().GetFrameSizeInBytes() - 1;
+      const double expectedTimestamp = item.GetIndex() * stats->TestData->FramePeriodSec;
+      if (*firstPixel != expectedPixelValue || *lastPixel != expectedPixelValue
+          || fabs(item.GetFilteredTimestamp(0) - expectedTimestamp) > 1e-6)
+      {
+        stats->NumberOfInconsistentItems++;
+      }
+    }
+    return NULL;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunContentionTest(bool lockFreeReads, bool zeroCopyWrite, int numberOfReaders, double writerRateHz, double durationSec, int frameSizePx, int bufferSize, int resizePeriod)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetDescriptiveName(lockFreeReads ? "LockFreeBuffer" : "LockedBuffer");
+    buffer->SetLockFreeReads(lockFreeReads);
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetImageOrientation(US_IMG_ORIENT_MF);
+    buffer->SetImageType(US_IMG_BRIGHTNESS);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    FrameSizeType frameSize = { static_cast<unsigned int>(frameSizePx), static_cast<unsigned int>(frameSizePx), 1 };
+    buffer->SetFrameSize(frameSize);
+
+    ContentionTestData testData;
+    testData.Buffer = buffer;
+    testData.FramePeriodSec = 1.0 / writerRateHz;
+    testData.StopRequested = false;
+
+    std::vector<unsigned char> frame(frameSizePx * frameSizePx);
+    const std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+
+    // Fill the buffer before the readers start
+    long frameNumber = 1;
+    for (; frameNumber <= bufferSize; ++frameNumber)
+    {
+      std::fill(frame.begin(), frame.end(), static_cast<unsigned char>(frameNumber % 256));
+      double timestamp = frameNumber * testData.FramePeriodSec;
+      buffer->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber, noClip, noClip, timestamp, timestamp);
+    }
+
+    PlusNewItemNotifier newItemNotifier;
+    buffer->AddNewItemNotifier(&newItemNotifier);
+
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    std::vector<ReaderStatistics> readerStatistics(numberOfReaders);
+    std::vector<int> readerThreadIds;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readerStatistics[i].TestData = &testData;
+      readerStatistics[i].RandomSeed = i + 1;
+      readerThreadIds.push_back(threader->SpawnThread((vtkThreadFunctionType)&ReaderThread, &readerStatistics[i]));
+    }
+
+    double writeTimeSumSec(0);
+    double writeTimeMaxSec(0);
+    int numberOfAddedItems(0);
+    int numberOfFailedAddItems(0);
+    int numberOfFailedResizes(0);
+    const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    double nextFrameTime = startTime;
+    while (vtkIGSIOAccurateTimer::GetSystemTime() - startTime < durationSec)
+    {
+      double timestamp = frameNumber * testData.FramePeriodSec;
+
+      double writeStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (zeroCopyWrite)
+      {
+        // Write the frame directly into the buffer
+        igsioVideoFrame* reservedFrame = buffer->ReserveItem();
+        if (reservedFrame == NULL)
+        {
+          numberOfFailedAddItems++;
+        }
+        else
+        {
+          unsigned char* reservedPixels = static_cast<unsigned char*>(reservedFrame->GetImage()->GetScalarPointer());
+          std::fill(reservedPixels, reservedPixels + reservedFrame->GetFrameSizeInBytes(), static_cast<unsigned char>(frameNumber % 256));
+          if (buffer->CommitItem(frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+          {
+            numberOfFailedAddItems++;
+          }
+        }
+      }
+      else
+      {
+        std::fill(frame.begin(), frame.end(), static_cast<unsigned char>(frameNumber % 256));
+        if (buffer->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber, noClip, noClip, timestamp, timestamp) != PLUS_SUCCESS)
+        {
+          numberOfFailedAddItems++;
+        }
+      }
+      double writeTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - writeStartTime;
+      writeTimeSumSec += writeTimeSec;
+      writeTimeMaxSec = std::max(writeTimeMaxSec, writeTimeSec);
+      numberOfAddedItems++;
+      frameNumber++;
+
+      if (resizePeriod > 0 && numberOfAddedItems % resizePeriod == 0)
+      {
+        // Alternate between the original and a larger size
+        const int newBufferSize = (buffer->GetBufferSize() == bufferSize) ? bufferSize + bufferSize / 2 : bufferSize;
+        if (buffer->SetBufferSize(newBufferSize) != PLUS_SUCCESS)
+        {
+          numberOfFailedResizes++;
+        }
+      }
+
+      nextFrameTime += testData.FramePeriodSec;
+      double delaySec = nextFrameTime - vtkIGSIOAccurateTimer::GetSystemTime();
+      if (delaySec > 0)
+      {
+        vtkIGSIOAccurateTimer::Delay(delaySec);
+      }
+    }
+    const double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+
+    testData.StopRequested = true;
+    for (std::vector<int>::iterator it = readerThreadIds.begin(); it != readerThreadIds.end(); ++it)
+    {
+      threader->TerminateThread(*it);
+    }
+
+    long long numberOfReads(0);
+    long long numberOfUnavailableItems(0);
+    long long numberOfInconsistentItems(0);
+    for (std::vector<ReaderStatistics>::iterator it = readerStatistics.begin(); it != readerStatistics.end(); ++it)
+    {
+      numberOfReads += it->NumberOfReads;
+      numberOfUnavailableItems += it->NumberOfUnavailableItems;
+      numberOfInconsistentItems += it->NumberOfInconsistentItems;
+    }
+
+    LOG_INFO((lockFreeReads ? "Lock-free reads" : "Locked reads") << ", " << (zeroCopyWrite ? "zero-copy write" : "AddItem write") << ": "
+             << numberOfReaders << " readers, " << numberOfAddedItems << " items added in " << std::fixed << std::setprecision(2) << elapsedTimeSec << " s");
+    LOG_INFO("  Writer time per item: mean = " << std::fixed << std::setprecision(1) << 1e6 * writeTimeSumSec / std::max(numberOfAddedItems, 1)
+             << " us, max = " << 1e6 * writeTimeMaxSec << " us");
+    LOG_INFO("  Reader throughput: " << std::fixed << std::setprecision(0) << numberOfReads / elapsedTimeSec << " items/s"
+             << " (unavailable: " << numberOfUnavailableItems << ", inconsistent: " << numberOfInconsistentItems << ")");
+
+    PlusStatus status = PLUS_SUCCESS;
+    if (!newItemNotifier.WaitForNewItem(0) || newItemNotifier.WaitForNewItem(0))
+    {
+      LOG_ERROR("New item notifier was not signaled as expected");
+      status = PLUS_FAIL;
+    }
+    buffer->RemoveNewItemNotifier(&newItemNotifier);
+    if (numberOfFailedAddItems > 0)
+    {
+      LOG_ERROR("Failed to add " << numberOfFailedAddItems << " items to the buffer");
+      status = PLUS_FAIL;
+    }
+    if (numberOfFailedResizes > 0)
+    {
+      LOG_ERROR("Failed to resize the buffer " << numberOfFailedResizes << " times");
+      status = PLUS_FAIL;
+    }
+    if (numberOfInconsistentItems > 0)
+    {
+      LOG_ERROR("Readers received " << numberOfInconsistentItems << " items with inconsistent content");
+      status = PLUS_FAIL;
+    }
+    if (numberOfReads == 0)
+    {
+      LOG_ERROR("Readers could not retrieve any items");
+      status = PLUS_FAIL;
+    }
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus VerifyOldestItem(vtkPlusBuffer* buffer, int expectedNumberOfItems, long expectedFrameNumber, const std::string& description)
+  {
+    if (buffer->GetNumberOfItems() != expectedNumberOfItems)
+    {
+      LOG_ERROR(description << ": unexpected number of items " << buffer->GetNumberOfItems() << " (expected: " << expectedNumberOfItems << ")");
+      return PLUS_FAIL;
+    }
+    StreamBufferItem item;
+    if (buffer->GetOldestStreamBufferItem(&item) != ITEM_OK)
+    {
+      LOG_ERROR(description << ": the oldest item is not available");
+      return PLUS_FAIL;
+    }
+    const unsigned char* pixels = static_cast<unsigned char*>(item.GetFrame().GetImage()->GetScalarPointer());
+    const unsigned char expectedValue = static_cast<unsigned char>(expectedFrameNumber % 256);
+    if (item.GetIndex() != static_cast<unsigned long>(expectedFrameNumber)
+        || std::count(pixels, pixels + item.GetFrame().GetFrameSizeInBytes(), expectedValue) != static_cast<std::ptrdiff_t>(item.GetFrame().GetFrameSizeInBytes()))
+    {
+      LOG_ERROR(description << ": the oldest item is not frame " << expectedFrameNumber << " or its content is modified (frame number: " << item.GetIndex() << ")");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! A reservation that is cancelled before the frame is written must not lose the oldest item of a full buffer */
+  PlusStatus TestCancelledReservation(int frameSizePx)
+  {
+    const int bufferSize = 4;
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetDescriptiveName("ReservationBuffer");
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetImageOrientation(US_IMG_ORIENT_MF);
+    buffer->SetImageType(US_IMG_BRIGHTNESS);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    FrameSizeType frameSize = { static_cast<unsigned int>(frameSizePx), static_cast<unsigned int>(frameSizePx), 1 };
+    buffer->SetFrameSize(frameSize);
+
+    std::vector<unsigned char> frame(frameSizePx * frameSizePx);
+    const std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    long frameNumber = 0;
+    for (; frameNumber < bufferSize; ++frameNumber)
+    {
+      std::fill(frame.begin(), frame.end(), static_cast<unsigned char>(frameNumber % 256));
+      buffer->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber, noClip, noClip, frameNumber * 0.1, frameNumber * 0.1);
+    }
+
+    // Cancelled before the frame is written (e.g., no frame was available from the device): the oldest item is kept
+    if (buffer->ReserveItem() == NULL)
+    {
+      LOG_ERROR("Cancelled reservation: failed to reserve an item");
+      return PLUS_FAIL;
+    }
+    buffer->CancelItem();
+    if (VerifyOldestItem(buffer, bufferSize, 0, "Cancelled reservation") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // Committed: the oldest item is overwritten
+    igsioVideoFrame* reservedFrame = buffer->ReserveItem();
+    if (reservedFrame == NULL)
+    {
+      LOG_ERROR("Committed reservation: failed to reserve an item");
+      return PLUS_FAIL;
+    }
+    unsigned char* reservedPixels = static_cast<unsigned char*>(reservedFrame->GetImage()->GetScalarPointer());
+    std::fill(reservedPixels, reservedPixels + reservedFrame->GetFrameSizeInBytes(), static_cast<unsigned char>(frameNumber % 256));
+    if (buffer->CommitItem(frameNumber, frameNumber * 0.1, frameNumber * 0.1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Committed reservation: failed to commit the item");
+      return PLUS_FAIL;
+    }
+    frameNumber++;
+    if (VerifyOldestItem(buffer, bufferSize, 1, "Committed reservation") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // Cancelled after the frame is written: the pixels of the oldest item are lost, so it remains removed
+    reservedFrame = buffer->ReserveItem();
+    if (reservedFrame == NULL)
+    {
+      LOG_ERROR("Cancelled written reservation: failed to reserve an item");
+      return PLUS_FAIL;
+    }
+    reservedPixels = static_cast<unsigned char*>(reservedFrame->GetImage()->GetScalarPointer());
+    std::fill(reservedPixels, reservedPixels + reservedFrame->GetFrameSizeInBytes(), static_cast<unsigned char>(frameNumber % 256));
+    buffer->CancelItem(true);
+    if (VerifyOldestItem(buffer, bufferSize - 1, 2, "Cancelled written reservation") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    LOG_INFO("Cancelled reservation: the oldest item is kept if the reserved frame was not written");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfReaders(4);
+  double writerRateHz(1000);
+  double durationSec(2.0);
+  int frameSizePx(128);
+  int bufferSize(500);
+  int resizePeriod(250);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-readers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfReaders, "Number of reader threads (Default: 4).");
+  args.AddArgument("--writer-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &writerRateHz, "Rate of adding items to the buffer, in Hz (Default: 1000).");
+  args.AddArgument("--duration", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Duration of each test run, in seconds (Default: 2).");
+  args.AddArgument("--frame-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameSizePx, "Width and height of the square frames, in pixels (Default: 128).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 500).");
+  args.AddArgument("--resize-period", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &resizePeriod, "Number of added items between buffer resizes, 0 disables resizing (Default: 250).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfReaders < 1 || writerRateHz <= 0 || frameSizePx < 1 || bufferSize < 2 || resizePeriod < 0)
+  {
+    std::cerr << "Invalid arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  if (TestCancelledReservation(frameSizePx) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  for (int lockFreeReads = 0; lockFreeReads <= 1; ++lockFreeReads)
+  {
+    for (int zeroCopyWrite = 0; zeroCopyWrite <= 1; ++zeroCopyWrite)
+    {
+      if (RunContentionTest(lockFreeReads != 0, zeroCopyWrite != 0, numberOfReaders, writerRateHz, durationSec, frameSizePx, bufferSize, resizePeriod) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+      }
+    }
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferSizeLimitsTest.cxx
+  \brief Verifies the number of items that is computed from the duration (BufferSizeSec) and memory (BufferSizeMB) limits of a video buffer.
+
+  The number of items is checked for a memory limit, for a duration limit with the nominal item rate and for both limits together.
+  Then frames are added at a different rate than the nominal rate: the buffer must be resized to the duration limit at the measured rate,
+  without losing the stored frames, and the reserved memory must be published in the metrics registry.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+#include "PlusTestFramePattern.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+  //----------------------------------------------------------------------------
+  PlusStatus CheckBufferSize(vtkPlusBuffer* buffer, int expectedBufferSize, const std::string& description)
+  {
+    if (buffer->GetBufferSize() != expectedBufferSize)
+    {
+      LOG_ERROR(description << ": buffer size is " << buffer->GetBufferSize() << " items (expected: " << expectedBufferSize << ")");
+      return PLUS_FAIL;
+    }
+    LOG_INFO(description << ": buffer size is " << expectedBufferSize << " items");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestMemoryLimit(int frameSizePx)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = PlusTestFramePattern::CreateVideoBuffer("MemoryLimitedBuffer", 30, frameSizePx);
+    const unsigned long long bytesPerItem = buffer->GetNumberOfBytesPerItem();
+    if (bytesPerItem < static_cast<unsigned long long>(frameSizePx) * frameSizePx)
+    {
+      LOG_ERROR("Memory limit: " << bytesPerItem << " bytes per item is less than the frame size");
+      return PLUS_FAIL;
+    }
+
+    // the memory of 40.5 items is available, partial items are not allowed
+    const double bufferSizeMB = 40.5 * bytesPerItem / BYTES_PER_MB;
+    if (buffer->SetBufferSizeMB(bufferSizeMB) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, 40, "Memory limit") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // larger frames, fewer items fit into the same memory
+    if (buffer->SetNumberOfScalarComponents(3) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Memory limit: failed to change the number of scalar components");
+      return PLUS_FAIL;
+    }
+    const int expectedBufferSize = static_cast<int>(bufferSizeMB * BYTES_PER_MB / buffer->GetNumberOfBytesPerItem());
+    if (CheckBufferSize(buffer, expectedBufferSize, "Memory limit with three component frames") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // the limit is not used anymore, the buffer keeps its size
+    if (buffer->SetBufferSizeMB(0) != PLUS_SUCCESS || buffer->SetNumberOfScalarComponents(1) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, expectedBufferSize, "Memory limit removed") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestDurationAndMemoryLimits(int frameSizePx)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = PlusTestFramePattern::CreateVideoBuffer("DurationAndMemoryLimitedBuffer", 30, frameSizePx);
+
+    // 5 sec at 20 items/sec
+    if (buffer->SetNominalItemRate(20) != PLUS_SUCCESS || buffer->SetBufferSizeSec(5) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, 100, "Duration limit") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // the smaller resulting number of items is used
+    if (buffer->SetBufferSizeMB(60.5 * buffer->GetNumberOfBytesPerItem() / BYTES_PER_MB) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, 60, "Duration and memory limits") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (buffer->SetNominalItemRate(10) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, 50, "Duration and memory limits at lower nominal rate") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestMeasuredItemRate(int frameSizePx)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = PlusTestFramePattern::CreateVideoBuffer("RateLimitedBuffer", 30, frameSizePx);
+    buffer->SetMetricsOwner("BufferSizeLimitsTest", "RateLimitedBuffer");
+
+    // the nominal rate is twice the actual rate of the frames
+    const double actualItemRate = 1.0 / PlusTestFramePattern::FRAME_PERIOD_SEC;
+    const double bufferSizeSec = 5.0;
+    if (buffer->SetNominalItemRate(2 * actualItemRate) != PLUS_SUCCESS || buffer->SetBufferSizeSec(bufferSizeSec) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, static_cast<int>(2 * actualItemRate * bufferSizeSec), "Duration limit at nominal rate") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // the rate is stable after two measurement periods (of 1 sec), the buffer is resized before the next item is added
+    const long numberOfFrames = static_cast<long>(4 * actualItemRate);
+    if (PlusTestFramePattern::AddFrames(buffer, 1, numberOfFrames) != PLUS_SUCCESS
+        || CheckBufferSize(buffer, static_cast<int>(actualItemRate * bufferSizeSec), "Duration limit at measured rate") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // the buffer is enlarged, so all frames are kept
+    if (buffer->GetNumberOfItems() != numberOfFrames)
+    {
+      LOG_ERROR("Measured rate: " << buffer->GetNumberOfItems() << " items are in the buffer (expected: " << numberOfFrames << ")");
+      return PLUS_FAIL;
+    }
+    StreamBufferItem item;
+    for (BufferItemUidType uid = buffer->GetOldestItemUidInBuffer(); uid <= buffer->GetLatestItemUidInBuffer(); ++uid)
+    {
+      if (buffer->GetStreamBufferItem(uid, &item) != ITEM_OK)
+      {
+        LOG_ERROR("Measured rate: failed to get item " << uid);
+        return PLUS_FAIL;
+      }
+      if (PlusTestFramePattern::VerifyItemFrame(item, numberOfFrames - static_cast<long>(buffer->GetLatestItemUidInBuffer() - uid), "Measured rate") != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+
+    PlusMetric::LabelMapType labels;
+    labels["device"] = "BufferSizeLimitsTest";
+    labels["source"] = "RateLimitedBuffer";
+    PlusMetric* reservedMemoryMetric = PlusMetricsRegistry::GetInstance()->GetMetric("plus_buffer_reserved_memory_bytes", "", PlusMetric::METRIC_GAUGE, labels);
+    if (reservedMemoryMetric->Get() < numberOfFrames * buffer->GetNumberOfBytesPerItem() / 2)
+    {
+      LOG_ERROR("Measured rate: reserved memory metric is " << reservedMemoryMetric->Get() << " bytes, which is less than half of the memory of the added frames");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int frameSizePx(64);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--frame-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameSizePx, "Width and height of the frames in pixels (Default: 64).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (frameSizePx < 1)
+  {
+    std::cerr << "Invalid arguments: frame size must be at least 1" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  if (TestMemoryLimit(frameSizePx) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestDurationAndMemoryLimits(frameSizePx) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestMeasuredItemRate(frameSizePx) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
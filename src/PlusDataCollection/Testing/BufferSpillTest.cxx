@@ -0,0 +1,154 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferSpillTest.cxx
+  \brief Verifies that items removed from a video buffer are stored in the spill file and can be read back.
+
+  A small buffer with a spill file is filled with many more frames than it can hold. The frames have a pattern
+  that is derived from the frame number. Removed items are written to the spill file by the spill thread,
+  after waiting for the spill queue, all items (in the spill file and in the buffer) are read back by UID and by time
+  and their content is verified. The test is run with and without frame compression, as compressed frames are
+  decompressed by the spill thread.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusTestFramePattern.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus RunSpillTest(bool compressFrames, int frameSizePx, int bufferSize, int numberOfFrames, double spillFileSizeMB)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = PlusTestFramePattern::CreateVideoBuffer(compressFrames ? "CompressedSpilledBuffer" : "SpilledBuffer", bufferSize, frameSizePx);
+    buffer->SetCompressFrames(compressFrames);
+    if (buffer->SetSpillFileSizeMB(spillFileSizeMB) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to create the spill file");
+      return PLUS_FAIL;
+    }
+
+    for (long firstFrameNumber = 1; firstFrameNumber <= numberOfFrames; firstFrameNumber += bufferSize / 2)
+    {
+      const long lastFrameNumber = std::min<long>(firstFrameNumber + bufferSize / 2 - 1, numberOfFrames);
+      if (PlusTestFramePattern::AddFrames(buffer, firstFrameNumber, lastFrameNumber) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      // let the spill thread keep up, so that no items are dropped on a slow test machine
+      buffer->WaitForSpillQueueEmpty();
+    }
+
+    const long expectedNumberOfSpilledItems = numberOfFrames - bufferSize;
+    if (buffer->GetNumberOfDroppedSpillItems() != 0)
+    {
+      LOG_ERROR(buffer->GetNumberOfDroppedSpillItems() << " items were dropped instead of being stored in the spill file");
+      return PLUS_FAIL;
+    }
+    if (buffer->GetNumberOfSpilledItems() != static_cast<unsigned int>(expectedNumberOfSpilledItems))
+    {
+      LOG_ERROR("Unexpected number of spilled items: " << buffer->GetNumberOfSpilledItems() << " (expected: " << expectedNumberOfSpilledItems << ")");
+      return PLUS_FAIL;
+    }
+
+    StreamBufferItem item;
+    for (long frameNumber = 1; frameNumber <= numberOfFrames; ++frameNumber)
+    {
+      // the UID of the items is the same as the frame number
+      if (buffer->GetStreamBufferItem(frameNumber, &item) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to read back item " << frameNumber);
+        return PLUS_FAIL;
+      }
+      if (PlusTestFramePattern::VerifyItemFrame(item, frameNumber, "Item read by UID") != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      if (buffer->GetStreamBufferItemFromTime(frameNumber * PlusTestFramePattern::FRAME_PERIOD_SEC, &item, vtkPlusBuffer::EXACT_TIME) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to read back item at time " << frameNumber * PlusTestFramePattern::FRAME_PERIOD_SEC);
+        return PLUS_FAIL;
+      }
+      if (PlusTestFramePattern::VerifyItemFrame(item, frameNumber, "Item read by time") != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+
+    LOG_INFO((compressFrames ? "Compressed frames" : "Uncompressed frames") << ": " << expectedNumberOfSpilledItems << " spilled and "
+             << bufferSize << " buffered items verified");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int frameSizePx(128);
+  int bufferSize(20);
+  int numberOfFrames(200);
+  double spillFileSizeMB(16.0);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--frame-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameSizePx, "Width and height of the frames in pixels (Default: 128).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 20).");
+  args.AddArgument("--number-of-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of frames added to the buffer (Default: 200).");
+  args.AddArgument("--spill-file-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &spillFileSizeMB, "Maximum size of the spill file in MB (Default: 16). All removed frames must fit into it.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (frameSizePx < 1 || bufferSize < 4 || numberOfFrames <= bufferSize || spillFileSizeMB <= 0)
+  {
+    std::cerr << "Invalid arguments: the buffer must have at least 4 items and more frames must be added than the buffer size" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  for (int compressFrames = 0; compressFrames <= 1; ++compressFrames)
+  {
+    if (RunSpillTest(compressFrames != 0, frameSizePx, bufferSize, numberOfFrames, spillFileSizeMB) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
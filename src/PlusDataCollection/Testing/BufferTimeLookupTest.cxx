@@ -0,0 +1,271 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferTimeLookupTest.cxx
+  \brief Measures the speed of finding buffer items by time in a large tracker buffer.
+
+  The buffer is filled with tracker items (as a 1 kHz tracker would do) and then items are looked up
+  by time with sequentially increasing and with random timestamps. The lookup that uses the timestamp index
+  of the buffer (GetItemUidFromTime) is compared to a binary search that reads the timestamps from the
+  buffer items. Both searches must find the same items, the lookup times are reported.
+  While the buffer is filled, some items are cancelled after PrepareForNewItem (as vtkPlusBuffer does when
+  adding an item fails) to verify that cancelled items do not leave invalid items in the buffer.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusTimestampedCircularBuffer.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <iomanip>
+#include <vector>
+
+namespace
+{
+  const double TRACKER_PERIOD_SEC = 0.001;
+  const int CANCELLED_ITEM_PERIOD = 97;
+
+  //----------------------------------------------------------------------------
+  // Binary search that reads the timestamps from the buffer items (the way GetItemUidFromTime worked before the timestamp index was added)
+  ItemStatus GetItemUidFromTimeUsingItems(vtkPlusTimestampedCircularBuffer* buffer, double time, BufferItemUidType& uid)
+  {
+    igsioLockGuard<vtkPlusTimestampedCircularBuffer> bufferGuardedLock(buffer);
+    BufferItemUidType lo = buffer->GetOldestItemUidInBuffer();
+    BufferItemUidType hi = buffer->GetLatestItemUidInBuffer();
+    StreamBufferItem* item = NULL;
+    if (buffer->GetBufferItemPointerFromUid(lo, item) != ITEM_OK)
+    {
+      return ITEM_UNKNOWN_ERROR;
+    }
+    double tlo = item->GetFilteredTimestamp(buffer->GetLocalTimeOffsetSec());
+    if (buffer->GetBufferItemPointerFromUid(hi, item) != ITEM_OK)
+    {
+      return ITEM_UNKNOWN_ERROR;
+    }
+    double thi = item->GetFilteredTimestamp(buffer->GetLocalTimeOffsetSec());
+    if (time < tlo || time > thi)
+    {
+      return (time < tlo) ? ITEM_NOT_AVAILABLE_ANYMORE : ITEM_NOT_AVAILABLE_YET;
+    }
+    while (hi - lo > 1)
+    {
+      BufferItemUidType mid = lo + (hi - lo) / 2;
+      buffer->GetBufferItemPointerFromUid(mid, item);
+      double tmid = item->GetFilteredTimestamp(buffer->GetLocalTimeOffsetSec());
+      if (time < tmid)
+      {
+        hi = mid;
+        thi = tmid;
+      }
+      else
+      {
+        lo = mid;
+        tlo = tmid;
+      }
+    }
+    uid = (time - tlo > thi - time) ? hi : lo;
+    return ITEM_OK;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus FillBuffer(vtkPlusTimestampedCircularBuffer* buffer, int numberOfItems)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int i = 1; i <= numberOfItems; ++i)
+    {
+      const double timestamp = i * TRACKER_PERIOD_SEC;
+      matrix->SetElement(0, 3, i);
+
+      igsioLockGuard<vtkPlusTimestampedCircularBuffer> bufferGuardedLock(buffer);
+      BufferItemUidType uid(0);
+      int bufferIndex(0);
+      if (i % CANCELLED_ITEM_PERIOD == 0)
+      {
+        // Simulate an item that could not be filled: it is partially written and then cancelled
+        BufferItemUidType cancelledUid(0);
+        int cancelledBufferIndex(0);
+        if (buffer->PrepareForNewItem(timestamp - 0.5 * TRACKER_PERIOD_SEC, cancelledUid, cancelledBufferIndex) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to prepare cancelled item before item " << i);
+          return PLUS_FAIL;
+        }
+        buffer->GetBufferItemPointerFromBufferIndex(cancelledBufferIndex)->SetFilteredTimestamp(-1.0);
+        buffer->CancelNewItem(cancelledUid, cancelledBufferIndex);
+      }
+      if (buffer->PrepareForNewItem(timestamp, uid, bufferIndex) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << i << " to the buffer");
+        return PLUS_FAIL;
+      }
+      if (uid != static_cast<BufferItemUidType>(i))
+      {
+        LOG_ERROR("Unexpected UID of item " << i << ": " << uid);
+        return PLUS_FAIL;
+      }
+      StreamBufferItem* item = buffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+      item->SetFilteredTimestamp(timestamp);
+      item->SetUnfilteredTimestamp(timestamp);
+      item->SetIndex(i);
+      item->SetUid(uid);
+      item->SetMatrix(matrix);
+      item->SetStatus(TOOL_OK);
+      item->SetValidTransformData(true);
+      buffer->CommitNewItem(uid, bufferIndex);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunLookupTest(bool lockFreeReads, bool sequentialLookups, int bufferSize, int numberOfLookups)
+  {
+    vtkSmartPointer<vtkPlusTimestampedCircularBuffer> buffer = vtkSmartPointer<vtkPlusTimestampedCircularBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetLockFreeReads(lockFreeReads);
+    // Fill the buffer one and a half times, so that the items wrap around
+    if (FillBuffer(buffer, bufferSize + bufferSize / 2) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    double oldestTime(0);
+    double latestTime(0);
+    buffer->GetOldestTimeStamp(oldestTime);
+    buffer->GetLatestTimeStamp(latestTime);
+
+    std::vector<double> requestedTimes(numberOfLookups);
+    unsigned int randomSeed = 1;
+    for (int i = 0; i < numberOfLookups; ++i)
+    {
+      if (sequentialLookups)
+      {
+        // Requests that follow the acquisition, e.g., tool poses at each new frame of a slower video device
+        requestedTimes[i] = oldestTime + fmod(i * 0.37 * TRACKER_PERIOD_SEC, latestTime - oldestTime);
+      }
+      else
+      {
+        randomSeed = randomSeed * 1103515245 + 12345;
+        requestedTimes[i] = oldestTime + (latestTime - oldestTime) * ((randomSeed >> 8) % 1000000) / 1000000.0;
+      }
+    }
+
+    std::vector<BufferItemUidType> indexedUids(numberOfLookups);
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (int i = 0; i < numberOfLookups; ++i)
+    {
+      if (buffer->GetItemUidFromTime(requestedTimes[i], indexedUids[i]) != ITEM_OK)
+      {
+        LOG_ERROR("Item was not found at time " << std::fixed << requestedTimes[i]);
+        return PLUS_FAIL;
+      }
+    }
+    const double indexedLookupTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+
+    std::vector<BufferItemUidType> itemBasedUids(numberOfLookups);
+    startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (int i = 0; i < numberOfLookups; ++i)
+    {
+      if (GetItemUidFromTimeUsingItems(buffer, requestedTimes[i], itemBasedUids[i]) != ITEM_OK)
+      {
+        LOG_ERROR("Item was not found by the reference search at time " << std::fixed << requestedTimes[i]);
+        return PLUS_FAIL;
+      }
+    }
+    const double itemBasedLookupTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+
+    int numberOfMismatches(0);
+    for (int i = 0; i < numberOfLookups; ++i)
+    {
+      if (indexedUids[i] != itemBasedUids[i])
+      {
+        if (numberOfMismatches == 0)
+        {
+          LOG_ERROR("Different item found at time " << std::fixed << requestedTimes[i] << ": " << indexedUids[i] << " (expected: " << itemBasedUids[i] << ")");
+        }
+        numberOfMismatches++;
+      }
+    }
+
+    LOG_INFO((lockFreeReads ? "Lock-free reads" : "Locked reads") << ", " << (sequentialLookups ? "sequential" : "random") << " lookups in " << bufferSize << " items:"
+             << " indexed = " << std::fixed << std::setprecision(1) << 1e9 * indexedLookupTimeSec / numberOfLookups << " ns"
+             << ", item-based = " << 1e9 * itemBasedLookupTimeSec / numberOfLookups << " ns"
+             << " (speedup: " << std::setprecision(2) << itemBasedLookupTimeSec / std::max(indexedLookupTimeSec, 1e-9) << "x)");
+
+    if (numberOfMismatches > 0)
+    {
+      LOG_ERROR(numberOfMismatches << " of " << numberOfLookups << " lookups found a different item than the reference search");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int bufferSize(10000);
+  int numberOfLookups(200000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 10000).");
+  args.AddArgument("--number-of-lookups", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfLookups, "Number of lookups in each test run (Default: 200000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (bufferSize < 2 || numberOfLookups < 1)
+  {
+    std::cerr << "Buffer size must be at least 2 and the number of lookups must be at least 1" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  for (int lockFreeReads = 0; lockFreeReads <= 1; ++lockFreeReads)
+  {
+    for (int sequentialLookups = 1; sequentialLookups >= 0; --sequentialLookups)
+    {
+      if (RunLookupTest(lockFreeReads != 0, sequentialLookups != 0, bufferSize, numberOfLookups) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+      }
+    }
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusChannelReadCursorTest.cxx
+  \brief Tests reading the items of a channel with a read cursor.
+
+  A channel with a single tracker tool is filled with items while a cursor reads them. The test verifies that
+  each item is returned once and in order, that skipping to the latest items is counted as skipped (not as overwritten),
+  that items removed from the buffer before they are read are counted as overwritten, and that the warning about
+  overwritten items is logged at the first occurrence and then at most once per warning period.
+  Warnings about overwritten items are expected in the output of this test.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusChannelReadCursor.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const double ITEM_PERIOD_SEC = 0.01;
+
+  //----------------------------------------------------------------------------
+  class CursorTestChannel
+  {
+  public:
+    CursorTestChannel(int bufferSize)
+      : Channel(vtkSmartPointer<vtkPlusChannel>::New())
+      , Tool(vtkSmartPointer<vtkPlusDataSource>::New())
+      , Matrix(vtkSmartPointer<vtkMatrix4x4>::New())
+      , NumberOfAddedItems(0)
+    {
+      this->Channel->SetChannelId("CursorTestChannel");
+      this->Tool->SetId("Tool");
+      this->Tool->SetBufferSize(bufferSize);
+      this->Channel->AddTool(this->Tool);
+    }
+
+    PlusStatus AddItems(int numberOfItems)
+    {
+      for (int i = 0; i < numberOfItems; ++i)
+      {
+        ++this->NumberOfAddedItems;
+        double timestamp = this->NumberOfAddedItems * ITEM_PERIOD_SEC;
+        if (this->Tool->AddTimeStampedItem(this->Matrix, TOOL_OK, this->NumberOfAddedItems, timestamp, timestamp) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to add item " << this->NumberOfAddedItems << " to the buffer");
+          return PLUS_FAIL;
+        }
+      }
+      return PLUS_SUCCESS;
+    }
+
+    /*! Timestamp of the item that was added as the n-th item (starting from 1) */
+    double GetItemTimestamp(long itemNumber) const { return itemNumber * ITEM_PERIOD_SEC; }
+
+    long GetNumberOfAddedItems() const { return this->NumberOfAddedItems; }
+
+    vtkSmartPointer<vtkPlusChannel> Channel;
+    vtkSmartPointer<vtkPlusDataSource> Tool;
+    vtkSmartPointer<vtkMatrix4x4> Matrix;
+    long NumberOfAddedItems;
+  };
+
+  //----------------------------------------------------------------------------
+  PlusStatus VerifyTimestamps(const std::vector<double>& timestamps, const CursorTestChannel& channel, long firstItemNumber, long lastItemNumber, const std::string& description)
+  {
+    if (timestamps.size() != static_cast<size_t>(lastItemNumber - firstItemNumber + 1))
+    {
+      LOG_ERROR(description << ": " << timestamps.size() << " items were read (expected: " << lastItemNumber - firstItemNumber + 1 << ")");
+      return PLUS_FAIL;
+    }
+    for (size_t i = 0; i < timestamps.size(); ++i)
+    {
+      if (fabs(timestamps[i] - channel.GetItemTimestamp(firstItemNumber + i)) > 1e-6)
+      {
+        LOG_ERROR(description << ": unexpected timestamp of item " << i << ": " << timestamps[i] << " (expected: " << channel.GetItemTimestamp(firstItemNumber + i) << ")");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestSequentialReads()
+  {
+    CursorTestChannel channel(50);
+    PlusChannelReadCursor* cursor = channel.Channel->CreateReadCursor("SequentialReader");
+    PlusStatus status = PLUS_SUCCESS;
+    std::vector<double> timestamps;
+
+    // Start at the first item
+    cursor->SeekToTime(0);
+    channel.AddItems(5);
+    if (cursor->GetNextUnreadTimestamps(timestamps) != PLUS_SUCCESS || VerifyTimestamps(timestamps, channel, 1, 5, "First read") != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    if (cursor->GetNextUnreadTimestamps(timestamps) != PLUS_SUCCESS || !timestamps.empty())
+    {
+      LOG_ERROR("Read without new items: " << timestamps.size() << " items were returned");
+      status = PLUS_FAIL;
+    }
+    channel.AddItems(3);
+    if (cursor->GetNumberOfUnreadItems() != 3)
+    {
+      LOG_ERROR("Unexpected number of unread items: " << cursor->GetNumberOfUnreadItems() << " (expected: 3)");
+      status = PLUS_FAIL;
+    }
+    if (cursor->GetNextUnreadTimestamps(timestamps) != PLUS_SUCCESS || VerifyTimestamps(timestamps, channel, 6, 8, "Second read") != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+
+    // Limited number of items per read, without skipping
+    channel.AddItems(10);
+    if (cursor->GetNextUnreadTimestamps(timestamps, 4) != PLUS_SUCCESS || VerifyTimestamps(timestamps, channel, 9, 12, "Limited read") != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    // Skipping to the latest items
+    if (cursor->GetNextUnreadTimestamps(timestamps, 2, true) != PLUS_SUCCESS || VerifyTimestamps(timestamps, channel, 17, 18, "Read of the latest items") != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    if (cursor->GetNumberOfSkippedItems() != 4 || cursor->GetNumberOfOverwrittenItems() != 0)
+    {
+      LOG_ERROR("Sequential reads: unexpected number of skipped (" << cursor->GetNumberOfSkippedItems() << ", expected: 4) or overwritten ("
+                << cursor->GetNumberOfOverwrittenItems() << ", expected: 0) items");
+      status = PLUS_FAIL;
+    }
+
+    // After reset the next read starts at the latest item
+    cursor->Reset();
+    channel.AddItems(3);
+    if (cursor->GetNextUnreadTimestamps(timestamps) != PLUS_SUCCESS || VerifyTimestamps(timestamps, channel, 21, 21, "Read after reset") != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+
+    channel.Channel->DeleteReadCursor(cursor);
+    if (status == PLUS_SUCCESS)
+    {
+      LOG_INFO("Sequential reads: all items were returned once and in order");
+    }
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestOverwrittenItems(double warningPeriodSec)
+  {
+    const int bufferSize = 10;
+    CursorTestChannel channel(bufferSize);
+    PlusChannelReadCursor* cursor = channel.Channel->CreateReadCursor("SlowReader");
+    cursor->SetOverwrittenItemsWarningPeriodSec(warningPeriodSec);
+    PlusStatus status = PLUS_SUCCESS;
+    std::vector<double> timestamps;
+
+    cursor->SeekToTime(0);
+    channel.AddItems(bufferSize / 2);
+    cursor->GetNextUnreadTimestamps(timestamps);
+
+    // The reader falls behind repeatedly within the warning period, only the first occurrence is reported
+    unsigned long long expectedNumberOfOverwrittenItems(0);
+    for (int i = 0; i < 5; ++i)
+    {
+      channel.AddItems(bufferSize + 7);
+      expectedNumberOfOverwrittenItems += 7;
+      if (cursor->GetNextUnreadTimestamps(timestamps) != PLUS_SUCCESS
+          || VerifyTimestamps(timestamps, channel, channel.GetNumberOfAddedItems() - bufferSize + 1, channel.GetNumberOfAddedItems(), "Read after overwrite") != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+    }
+    if (cursor->GetNumberOfOverwrittenItems() != expectedNumberOfOverwrittenItems)
+    {
+      LOG_ERROR("Overwritten items: " << cursor->GetNumberOfOverwrittenItems() << " items were counted as overwritten (expected: " << expectedNumberOfOverwrittenItems << ")");
+      status = PLUS_FAIL;
+    }
+    if (cursor->GetNumberOfOverwrittenItemsWarnings() != 1)
+    {
+      LOG_ERROR("Overwritten items: " << cursor->GetNumberOfOverwrittenItemsWarnings() << " warnings were logged within the warning period (expected: 1)");
+      status = PLUS_FAIL;
+    }
+
+    // After the warning period the next overwrite is reported again
+    std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(warningPeriodSec * 1000 * 1.5)));
+    channel.AddItems(bufferSize + 3);
+    expectedNumberOfOverwrittenItems += 3;
+    cursor->GetNextUnreadTimestamps(timestamps);
+    if (cursor->GetNumberOfOverwrittenItems() != expectedNumberOfOverwrittenItems || cursor->GetNumberOfOverwrittenItemsWarnings() != 2)
+    {
+      LOG_ERROR("Overwritten items: after the warning period " << cursor->GetNumberOfOverwrittenItems() << " overwritten items (expected: " << expectedNumberOfOverwrittenItems
+                << ") and " << cursor->GetNumberOfOverwrittenItemsWarnings() << " warnings (expected: 2) were counted");
+      status = PLUS_FAIL;
+    }
+
+    channel.Channel->DeleteReadCursor(cursor);
+    if (status == PLUS_SUCCESS)
+    {
+      LOG_INFO("Overwritten items: " << expectedNumberOfOverwrittenItems << " overwritten items were reported in 2 warnings");
+    }
+    return status;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double warningPeriodSec(0.2);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--warning-period", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &warningPeriodSec, "Minimum time between warnings about overwritten items in sec (Default: 0.2).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  if (TestSequentialReads() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestOverwrittenItems(warningPeriodSec) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusFrameArenaTest.cxx
+  \brief Tests the frame arena: allocation of aligned slots, and recycling of the slots by a video buffer.
+
+  The slots of the arena must be aligned, must not overlap and must keep their content when the memory is prefaulted.
+  A video buffer that stores its frames in an arena is filled with several times more frames than it can hold.
+  The slots are reused, so no frames may be allocated after startup, and the content of the buffered frames must be
+  preserved when the arena is disabled and enabled again.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusFrameArena.h"
+#include "PlusTestFramePattern.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cstdint>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus TestArenaSlots(size_t numberOfSlots, size_t slotSizeBytes)
+  {
+    PlusFrameArena arena;
+    if (arena.Allocate(numberOfSlots, slotSizeBytes) != PLUS_SUCCESS || !arena.IsAllocated(numberOfSlots, slotSizeBytes))
+    {
+      LOG_ERROR("Arena slots: failed to allocate " << numberOfSlots << " slots of " << slotSizeBytes << " bytes");
+      return PLUS_FAIL;
+    }
+    if (arena.GetReservedBytes() < numberOfSlots * slotSizeBytes)
+    {
+      LOG_ERROR("Arena slots: " << arena.GetReservedBytes() << " bytes were reserved for " << numberOfSlots * slotSizeBytes << " bytes of frames");
+      return PLUS_FAIL;
+    }
+
+    // Slots are aligned and consecutive slots do not overlap
+    for (size_t slotIndex = 0; slotIndex < numberOfSlots; ++slotIndex)
+    {
+      unsigned char* slot = static_cast<unsigned char*>(arena.GetSlot(slotIndex));
+      if (slot == NULL || reinterpret_cast<std::uintptr_t>(slot) % PlusFrameArena::SLOT_ALIGNMENT != 0)
+      {
+        LOG_ERROR("Arena slots: slot " << slotIndex << " is not aligned to " << PlusFrameArena::SLOT_ALIGNMENT << " bytes");
+        return PLUS_FAIL;
+      }
+      if (!arena.Contains(slot) || !arena.Contains(slot + slotSizeBytes - 1))
+      {
+        LOG_ERROR("Arena slots: slot " << slotIndex << " is not within the arena");
+        return PLUS_FAIL;
+      }
+      if (slotIndex > 0 && slot < static_cast<unsigned char*>(arena.GetSlot(slotIndex - 1)) + slotSizeBytes)
+      {
+        LOG_ERROR("Arena slots: slot " << slotIndex << " overlaps with the previous slot");
+        return PLUS_FAIL;
+      }
+      PlusTestFramePattern::FillFrame(slot, slotSizeBytes, static_cast<long>(slotIndex));
+    }
+    if (arena.GetSlot(numberOfSlots) != NULL)
+    {
+      LOG_ERROR("Arena slots: a slot is returned for an invalid slot index");
+      return PLUS_FAIL;
+    }
+    int localVariable(0);
+    if (arena.Contains(&localVariable))
+    {
+      LOG_ERROR("Arena slots: an address outside the arena is reported to be within the arena");
+      return PLUS_FAIL;
+    }
+
+    // Prefaulting maps the pages without modifying the content
+    arena.Prefault();
+    if (!arena.GetPrefaulted())
+    {
+      LOG_ERROR("Arena slots: the arena is not prefaulted");
+      return PLUS_FAIL;
+    }
+    for (size_t slotIndex = 0; slotIndex < numberOfSlots; ++slotIndex)
+    {
+      const unsigned char* slot = static_cast<const unsigned char*>(arena.GetSlot(slotIndex));
+      if (PlusTestFramePattern::VerifyFrame(slot, slotSizeBytes, static_cast<long>(slotIndex), "Arena slots after prefaulting") != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+
+    // A new allocation replaces the previous one, release removes all slots
+    if (arena.Allocate(numberOfSlots * 2, slotSizeBytes / 2 + 1) != PLUS_SUCCESS || arena.IsAllocated(numberOfSlots, slotSizeBytes)
+        || arena.GetNumberOfSlots() != numberOfSlots * 2 || arena.GetPrefaulted())
+    {
+      LOG_ERROR("Arena slots: reallocation with a different slot count and size failed");
+      return PLUS_FAIL;
+    }
+    arena.Release();
+    if (arena.GetNumberOfSlots() != 0 || arena.GetReservedBytes() != 0 || arena.GetSlot(0) != NULL)
+    {
+      LOG_ERROR("Arena slots: slots are still available after the arena is released");
+      return PLUS_FAIL;
+    }
+
+    LOG_INFO("Arena slots: " << numberOfSlots << " slots of " << slotSizeBytes << " bytes verified");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus VerifyBufferedFrames(vtkPlusBuffer* buffer, long firstFrameNumber, long lastFrameNumber, const std::string& description)
+  {
+    StreamBufferItem item;
+    for (long frameNumber = firstFrameNumber; frameNumber <= lastFrameNumber; ++frameNumber)
+    {
+      // the UID of the items is the same as the frame number
+      if (buffer->GetStreamBufferItem(frameNumber, &item) != ITEM_OK)
+      {
+        LOG_ERROR(description << ": failed to read frame " << frameNumber);
+        return PLUS_FAIL;
+      }
+      if (PlusTestFramePattern::VerifyItemFrame(item, frameNumber, description) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestBufferSlotRecycling(int frameSizePx, int bufferSize, int numberOfFrames)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = PlusTestFramePattern::CreateVideoBuffer("ArenaBuffer", bufferSize, frameSizePx);
+    if (buffer->SetUseFrameArena(true) != PLUS_SUCCESS || buffer->PrefaultFrameMemory() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Slot recycling: failed to set up the frame arena of the buffer");
+      return PLUS_FAIL;
+    }
+
+    // The buffer wraps around several times, each new frame is written into the slot of the removed frame
+    if (PlusTestFramePattern::AddFrames(buffer, 1, numberOfFrames) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (buffer->GetNumberOfFrameAllocationsAfterStartup() != 0)
+    {
+      LOG_ERROR("Slot recycling: " << buffer->GetNumberOfFrameAllocationsAfterStartup() << " frames were allocated after startup (expected: 0)");
+      return PLUS_FAIL;
+    }
+    const long firstBufferedFrameNumber = numberOfFrames - bufferSize + 1;
+    if (VerifyBufferedFrames(buffer, firstBufferedFrameNumber, numberOfFrames, "Slot recycling") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // Frames are moved out of the arena and back into it without losing their content
+    if (buffer->SetUseFrameArena(false) != PLUS_SUCCESS
+        || VerifyBufferedFrames(buffer, firstBufferedFrameNumber, numberOfFrames, "Frames detached from the arena") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (buffer->SetUseFrameArena(true) != PLUS_SUCCESS
+        || VerifyBufferedFrames(buffer, firstBufferedFrameNumber, numberOfFrames, "Frames attached to the arena") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    LOG_INFO("Slot recycling: " << numberOfFrames << " frames were added to a buffer of " << bufferSize << " items without frame allocations");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int frameSizePx(100);
+  int bufferSize(10);
+  int numberOfFrames(55);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--frame-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameSizePx, "Width and height of the frames in pixels (Default: 100).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 10).");
+  args.AddArgument("--number-of-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of frames added to the buffer (Default: 55).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (frameSizePx < 1 || bufferSize < 1 || numberOfFrames <= bufferSize)
+  {
+    std::cerr << "Invalid arguments: more frames must be added than the buffer size" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  // The slot size is not a multiple of the alignment, so the slots have to be padded
+  if (TestArenaSlots(bufferSize, static_cast<size_t>(frameSizePx) * frameSizePx + 1) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestBufferSlotRecycling(frameSizePx, bufferSize, numberOfFrames) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
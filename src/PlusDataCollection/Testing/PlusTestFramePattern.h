@@ -0,0 +1,130 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusTestFramePattern.h
+  \brief Test frames with a known content for the buffer tests.
+
+  Each frame is filled with a pattern that is derived from its frame number, so that the content of a frame
+  can be verified after it has been stored in a buffer (compressed, spilled to a file, moved between frame arenas, etc.).
+  The pattern consists of runs of constant value, so the frames compress well but each frame is different.
+  Frame number N is added to the buffer with timestamp N * FRAME_PERIOD_SEC.
+*/
+
+#ifndef __PlusTestFramePattern_h
+#define __PlusTestFramePattern_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <array>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace PlusTestFramePattern
+{
+  /*! Time between consecutive test frames (in seconds) */
+  const double FRAME_PERIOD_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  inline unsigned char GetPixelValue(long frameNumber, size_t pixelIndex)
+  {
+    return static_cast<unsigned char>((frameNumber * 7 + pixelIndex / 16) % 251);
+  }
+
+  //----------------------------------------------------------------------------
+  inline void FillFrame(unsigned char* pixels, size_t frameSizeBytes, long frameNumber)
+  {
+    for (size_t i = 0; i < frameSizeBytes; ++i)
+    {
+      pixels[i] = GetPixelValue(frameNumber, i);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  inline PlusStatus VerifyFrame(const unsigned char* pixels, size_t frameSizeBytes, long frameNumber, const std::string& description)
+  {
+    if (pixels == NULL || frameSizeBytes == 0)
+    {
+      LOG_ERROR(description << ": frame " << frameNumber << " has no content");
+      return PLUS_FAIL;
+    }
+    for (size_t i = 0; i < frameSizeBytes; ++i)
+    {
+      if (pixels[i] != GetPixelValue(frameNumber, i))
+      {
+        LOG_ERROR(description << ": content of frame " << frameNumber << " differs at pixel " << i
+                  << ": " << static_cast<int>(pixels[i]) << " (expected: " << static_cast<int>(GetPixelValue(frameNumber, i)) << ")");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Verify the frame number (stored as the index of the item), the timestamp and the frame content of a buffer item */
+  inline PlusStatus VerifyItemFrame(StreamBufferItem& item, long expectedFrameNumber, const std::string& description)
+  {
+    if (item.GetIndex() != static_cast<unsigned long>(expectedFrameNumber))
+    {
+      LOG_ERROR(description << ": unexpected frame number " << item.GetIndex() << " (expected: " << expectedFrameNumber << ")");
+      return PLUS_FAIL;
+    }
+    if (fabs(item.GetFilteredTimestamp(0) - expectedFrameNumber * FRAME_PERIOD_SEC) > 1e-6)
+    {
+      LOG_ERROR(description << ": unexpected timestamp of frame " << expectedFrameNumber << ": " << item.GetFilteredTimestamp(0));
+      return PLUS_FAIL;
+    }
+    vtkImageData* image = item.GetFrame().GetImage();
+    const unsigned char* pixels = (image != NULL ? static_cast<unsigned char*>(image->GetScalarPointer()) : NULL);
+    return VerifyFrame(pixels, item.GetFrame().GetFrameSizeInBytes(), expectedFrameNumber, description);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Create a buffer for square 8-bit grayscale frames */
+  inline vtkSmartPointer<vtkPlusBuffer> CreateVideoBuffer(const std::string& descriptiveName, int bufferSize, int frameSizePx)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetDescriptiveName(descriptiveName.c_str());
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetImageOrientation(US_IMG_ORIENT_MF);
+    buffer->SetImageType(US_IMG_BRIGHTNESS);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    FrameSizeType frameSize = { static_cast<unsigned int>(frameSizePx), static_cast<unsigned int>(frameSizePx), 1 };
+    buffer->SetFrameSize(frameSize);
+    return buffer;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Add the frames from firstFrameNumber to lastFrameNumber (inclusive) to a buffer created by CreateVideoBuffer */
+  inline PlusStatus AddFrames(vtkPlusBuffer* buffer, long firstFrameNumber, long lastFrameNumber)
+  {
+    FrameSizeType frameSize = buffer->GetFrameSize();
+    std::vector<unsigned char> frame(static_cast<size_t>(frameSize[0]) * frameSize[1] * frameSize[2]);
+    const std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    for (long frameNumber = firstFrameNumber; frameNumber <= lastFrameNumber; ++frameNumber)
+    {
+      FillFrame(&frame[0], frame.size(), frameNumber);
+      const double timestamp = frameNumber * FRAME_PERIOD_SEC;
+      if (buffer->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber, noClip, noClip, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameNumber << " to the buffer");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+#endif
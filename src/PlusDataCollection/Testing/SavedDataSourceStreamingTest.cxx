@@ -0,0 +1,417 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SavedDataSourceStreamingTest.cxx
+  \brief Tests that streamed playback of a sequence file provides the same frames as playback of the fully loaded file.
+
+  An uncompressed sequence file is generated with a known image content and a transform in each frame.
+  First the sequence stream reader is compared frame by frame to the fully loaded frame list, with a read-ahead
+  window that is much smaller than the sequence and with reads that wrap around and jump back in the sequence.
+  Then two saved data sources replay the same file, one loads it into memory and the other one streams it from the file.
+  All frames of the loop are replayed twice by both devices and the items of their output video sources must match:
+  timestamps, frame fields, and image data.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusSequenceStreamReader.h"
+#include "PlusTestFramePattern.h"
+#include "vtkIGSIOSequenceIO.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSavedDataSource.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+  const double FIRST_FRAME_TIMESTAMP_SEC = 1.0;
+
+  //----------------------------------------------------------------------------
+  /*! Saved data source that replays the frames of its loop without the acquisition thread, so that the output is deterministic */
+  class PlaybackTestSource : public vtkPlusSavedDataSource
+  {
+  public:
+    static PlaybackTestSource* New();
+    vtkTypeMacro(PlaybackTestSource, vtkPlusSavedDataSource);
+
+    /*! Add all frames of the loop to the output video source, numberOfLoops times */
+    PlusStatus ReplayLoop(int numberOfLoops)
+    {
+      BufferItemUidType firstUid(0);
+      BufferItemUidType lastUid(0);
+      if (this->GetLocalItemUidRange(firstUid, lastUid) != PLUS_SUCCESS)
+      {
+        LOG_ERROR(this->GetDeviceId() << ": failed to get the range of the frames to replay");
+        return PLUS_FAIL;
+      }
+      double loopStartTime(0);
+      double loopStopTime(0);
+      this->GetLoopTimeRange(loopStartTime, loopStopTime);
+
+      StreamBufferItem bufferItem;
+      for (int loopIndex = 0; loopIndex < numberOfLoops; ++loopIndex)
+      {
+        for (BufferItemUidType uid = firstUid; uid <= lastUid; ++uid)
+        {
+          if (this->GetLocalStreamBufferItem(uid, &bufferItem) != ITEM_OK)
+          {
+            LOG_ERROR(this->GetDeviceId() << ": failed to get frame " << uid);
+            return PLUS_FAIL;
+          }
+          const double timestamp = bufferItem.GetFilteredTimestamp(0) + loopIndex * (loopStopTime - loopStartTime);
+          this->FrameNumber++;
+          if (this->AddLocalVideoItemToVideoSources(uid, bufferItem, timestamp, timestamp) != PLUS_SUCCESS)
+          {
+            LOG_ERROR(this->GetDeviceId() << ": failed to replay frame " << uid);
+            return PLUS_FAIL;
+          }
+        }
+      }
+      return PLUS_SUCCESS;
+    }
+
+  protected:
+    PlaybackTestSource() {}
+  };
+
+  vtkStandardNewMacro(PlaybackTestSource);
+
+  //----------------------------------------------------------------------------
+  PlusStatus WriteTestSequence(const std::string& fileName, const FrameSizeType& frameSize, int numberOfFrames)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    vtkSmartPointer<vtkMatrix4x4> probeToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+    const igsioTransformName probeToTrackerTransformName("Probe", "Tracker");
+    const int numberOfPixels = frameSize[0] * frameSize[1] * frameSize[2];
+    for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      igsioTrackedFrame frame;
+      if (frame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to allocate frame " << frameIndex);
+        return PLUS_FAIL;
+      }
+      PlusTestFramePattern::FillFrame(static_cast<unsigned char*>(frame.GetImageData()->GetImage()->GetScalarPointer()), numberOfPixels, frameIndex);
+      probeToTracker->SetElement(0, 3, frameIndex * 1.5);
+      probeToTracker->SetElement(1, 3, -frameIndex * 0.5);
+      frame.SetFrameTransform(probeToTrackerTransformName, probeToTracker);
+      frame.SetFrameTransformStatus(probeToTrackerTransformName, TOOL_OK);
+      frame.SetTimestamp(FIRST_FRAME_TIMESTAMP_SEC + frameIndex * PlusTestFramePattern::FRAME_PERIOD_SEC);
+      if (frames->AddTrackedFrame(&frame) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameIndex << " to the frame list");
+        return PLUS_FAIL;
+      }
+    }
+    // Only uncompressed files can be streamed
+    if (vtkIGSIOSequenceIO::Write(fileName, frames, US_IMG_ORIENT_MF, false) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write test sequence file: " << fileName);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareStreamedFrame(PlusSequenceStreamReader& reader, vtkIGSIOTrackedFrameList* loadedFrames, unsigned int frameIndex)
+  {
+    igsioTrackedFrame* loadedFrame = loadedFrames->GetTrackedFrame(frameIndex);
+    if (fabs(reader.GetFrameTimestamp(frameIndex) - loadedFrame->GetTimestamp()) > 1e-6)
+    {
+      LOG_ERROR("Stream reader: timestamp of frame " << frameIndex << " is " << reader.GetFrameTimestamp(frameIndex) << " (expected: " << loadedFrame->GetTimestamp() << ")");
+      return PLUS_FAIL;
+    }
+    const unsigned char* streamedPixels = NULL;
+    if (reader.GetFramePixels(frameIndex, streamedPixels) != PLUS_SUCCESS || streamedPixels == NULL)
+    {
+      LOG_ERROR("Stream reader: failed to read the image data of frame " << frameIndex);
+      return PLUS_FAIL;
+    }
+    const unsigned char* loadedPixels = static_cast<unsigned char*>(loadedFrame->GetImageData()->GetImage()->GetScalarPointer());
+    if (memcmp(streamedPixels, loadedPixels, reader.GetFrameSizeBytes()) != 0)
+    {
+      LOG_ERROR("Stream reader: the image data of frame " << frameIndex << " differs from the loaded frame");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestStreamReader(const std::string& fileName, const FrameSizeType& frameSize, int numberOfFrames, int numberOfReadAheadFrames)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> loadedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (vtkIGSIOSequenceIO::Read(fileName, loadedFrames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to load test sequence file: " << fileName);
+      return PLUS_FAIL;
+    }
+
+    if (!PlusSequenceStreamReader::IsStreamingSupported(fileName))
+    {
+      LOG_ERROR("Stream reader: streaming of the uncompressed test sequence file is not supported");
+      return PLUS_FAIL;
+    }
+    PlusSequenceStreamReader reader;
+    reader.SetNumberOfReadAheadFrames(numberOfReadAheadFrames);
+    if (reader.Open(fileName) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Stream reader: failed to open " << fileName);
+      return PLUS_FAIL;
+    }
+    if (reader.GetNumberOfFrames() != static_cast<unsigned int>(numberOfFrames) || loadedFrames->GetNumberOfTrackedFrames() != static_cast<unsigned int>(numberOfFrames))
+    {
+      LOG_ERROR("Stream reader: " << reader.GetNumberOfFrames() << " frames are streamed and " << loadedFrames->GetNumberOfTrackedFrames() << " frames are loaded (expected: " << numberOfFrames << ")");
+      return PLUS_FAIL;
+    }
+    if (reader.GetFrameSize()[0] != frameSize[0] || reader.GetFrameSize()[1] != frameSize[1] || reader.GetFrameSize()[2] != frameSize[2]
+        || reader.GetPixelType() != VTK_UNSIGNED_CHAR || reader.GetNumberOfScalarComponents() != 1)
+    {
+      LOG_ERROR("Stream reader: unexpected image properties");
+      return PLUS_FAIL;
+    }
+
+    // Replay the full sequence twice, the read-ahead must wrap around to the first frame
+    reader.SetReadAheadFrameRange(0, numberOfFrames - 1);
+    PlusStatus status = PLUS_SUCCESS;
+    for (int loopIndex = 0; loopIndex < 2; ++loopIndex)
+    {
+      for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+      {
+        if (CompareStreamedFrame(reader, loadedFrames, frameIndex) != PLUS_SUCCESS)
+        {
+          status = PLUS_FAIL;
+        }
+      }
+    }
+    // Jumping back (e.g., after changing the loop range) must return the requested frame, even if it is not read ahead
+    if (CompareStreamedFrame(reader, loadedFrames, numberOfFrames / 2) != PLUS_SUCCESS
+        || CompareStreamedFrame(reader, loadedFrames, 1) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+
+    if (status == PLUS_SUCCESS)
+    {
+      LOG_INFO("Stream reader: all frames match the loaded frames (" << reader.GetNumberOfReadAheadMisses() << " read-ahead misses)");
+    }
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<PlaybackTestSource> ConnectPlaybackSource(const std::string& deviceId, const std::string& fileName, bool streamingEnabled, int numberOfReadAheadFrames, int bufferSize)
+  {
+    std::ostringstream configXml;
+    configXml << "<PlusConfiguration version=\"2.1\">"
+              << "<DataCollection StartupDelaySec=\"0\">"
+              << "<Device Id=\"" << deviceId << "\" Type=\"SavedDataSource\" SequenceFile=\"" << fileName << "\" UseData=\"IMAGE_AND_TRANSFORM\""
+              << " UseOriginalTimestamps=\"TRUE\" RepeatEnabled=\"TRUE\" StreamingEnabled=\"" << (streamingEnabled ? "TRUE" : "FALSE") << "\""
+              << " StreamingReadAheadFrames=\"" << numberOfReadAheadFrames << "\">"
+              << "<DataSources><DataSource Type=\"Video\" Id=\"Video\" PortUsImageOrientation=\"MF\" BufferSize=\"" << bufferSize << "\" /></DataSources>"
+              << "<OutputChannels><OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" /></OutputChannels>"
+              << "</Device>"
+              << "</DataCollection>"
+              << "</PlusConfiguration>";
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configXml.str().c_str()));
+
+    vtkSmartPointer<PlaybackTestSource> device = vtkSmartPointer<PlaybackTestSource>::New();
+    device->SetDeviceId(deviceId);
+    if (configRootElement == NULL || device->ReadConfiguration(configRootElement) != PLUS_SUCCESS || device->NotifyConfigured() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(deviceId << ": failed to read the device configuration");
+      return NULL;
+    }
+    if (device->Connect() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(deviceId << ": failed to connect");
+      return NULL;
+    }
+    return device;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetOutputVideoSource(PlaybackTestSource* device, vtkPlusDataSource*& videoSource)
+  {
+    vtkPlusChannel* outputChannel(NULL);
+    if (device->GetFirstOutputChannel(outputChannel) != PLUS_SUCCESS || outputChannel->GetVideoSource(videoSource) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(device->GetDeviceId() << ": output video source is not found");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareOutputItems(StreamBufferItem& loadedItem, StreamBufferItem& streamedItem, const FrameSizeType& frameSize, int frameIndex)
+  {
+    if (fabs(loadedItem.GetFilteredTimestamp(0) - streamedItem.GetFilteredTimestamp(0)) > 1e-6)
+    {
+      LOG_ERROR("Playback: timestamp of the streamed frame " << frameIndex << " is " << streamedItem.GetFilteredTimestamp(0)
+                << " (loaded frame: " << loadedItem.GetFilteredTimestamp(0) << ")");
+      return PLUS_FAIL;
+    }
+    if (loadedItem.GetFrameFieldMap() != streamedItem.GetFrameFieldMap() || loadedItem.GetFrameFieldMap().empty())
+    {
+      LOG_ERROR("Playback: frame fields of the streamed frame " << frameIndex << " differ from the loaded frame");
+      return PLUS_FAIL;
+    }
+    vtkImageData* loadedImage = loadedItem.GetFrame().GetImage();
+    vtkImageData* streamedImage = streamedItem.GetFrame().GetImage();
+    if (loadedImage == NULL || streamedImage == NULL)
+    {
+      LOG_ERROR("Playback: frame " << frameIndex << " has no image data");
+      return PLUS_FAIL;
+    }
+    const int numberOfPixels = frameSize[0] * frameSize[1] * frameSize[2];
+    const unsigned char* loadedPixels = static_cast<unsigned char*>(loadedImage->GetScalarPointer());
+    const unsigned char* streamedPixels = static_cast<unsigned char*>(streamedImage->GetScalarPointer());
+    if (memcmp(loadedPixels, streamedPixels, numberOfPixels) != 0)
+    {
+      LOG_ERROR("Playback: the image data of the streamed frame " << frameIndex << " differs from the loaded frame");
+      return PLUS_FAIL;
+    }
+    // The pixels are compared to the generated content too, so that a frame that is replayed in the wrong order by both devices is detected
+    return PlusTestFramePattern::VerifyFrame(loadedPixels, numberOfPixels, frameIndex, "Playback");
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestPlayback(const std::string& fileName, const FrameSizeType& frameSize, int numberOfFrames, int numberOfReadAheadFrames)
+  {
+    const int numberOfLoops = 2;
+    vtkSmartPointer<PlaybackTestSource> loadedDevice = ConnectPlaybackSource("LoadedVideoDevice", fileName, false, numberOfReadAheadFrames, numberOfLoops * numberOfFrames);
+    vtkSmartPointer<PlaybackTestSource> streamedDevice = ConnectPlaybackSource("StreamedVideoDevice", fileName, true, numberOfReadAheadFrames, numberOfLoops * numberOfFrames);
+    if (loadedDevice == NULL || streamedDevice == NULL)
+    {
+      return PLUS_FAIL;
+    }
+    if (loadedDevice->GetLocalVideoBuffer() == NULL || streamedDevice->GetLocalVideoBuffer() != NULL)
+    {
+      LOG_ERROR("Playback: the file must be loaded into the local buffer only if streaming is disabled");
+      return PLUS_FAIL;
+    }
+
+    vtkPlusDataSource* loadedVideo(NULL);
+    vtkPlusDataSource* streamedVideo(NULL);
+    if (loadedDevice->ReplayLoop(numberOfLoops) != PLUS_SUCCESS || streamedDevice->ReplayLoop(numberOfLoops) != PLUS_SUCCESS
+        || GetOutputVideoSource(loadedDevice, loadedVideo) != PLUS_SUCCESS || GetOutputVideoSource(streamedDevice, streamedVideo) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (loadedVideo->GetNumberOfItems() != numberOfLoops * numberOfFrames || streamedVideo->GetNumberOfItems() != numberOfLoops * numberOfFrames)
+    {
+      LOG_ERROR("Playback: " << loadedVideo->GetNumberOfItems() << " loaded and " << streamedVideo->GetNumberOfItems() << " streamed frames are replayed (expected: "
+                << numberOfLoops * numberOfFrames << ")");
+      return PLUS_FAIL;
+    }
+
+    PlusStatus status = PLUS_SUCCESS;
+    StreamBufferItem loadedItem;
+    StreamBufferItem streamedItem;
+    const BufferItemUidType loadedOldestUid = loadedVideo->GetOldestItemUidInBuffer();
+    const BufferItemUidType streamedOldestUid = streamedVideo->GetOldestItemUidInBuffer();
+    for (int i = 0; i < numberOfLoops * numberOfFrames; ++i)
+    {
+      if (loadedVideo->GetStreamBufferItem(loadedOldestUid + i, &loadedItem) != ITEM_OK || streamedVideo->GetStreamBufferItem(streamedOldestUid + i, &streamedItem) != ITEM_OK)
+      {
+        LOG_ERROR("Playback: failed to get replayed item " << i);
+        status = PLUS_FAIL;
+        continue;
+      }
+      if (CompareOutputItems(loadedItem, streamedItem, frameSize, i % numberOfFrames) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Playback: replayed item " << i << " of the streamed device does not match the loaded device");
+        status = PLUS_FAIL;
+      }
+    }
+
+    loadedDevice->Disconnect();
+    streamedDevice->Disconnect();
+    if (status == PLUS_SUCCESS)
+    {
+      LOG_INFO("Playback: " << numberOfLoops * numberOfFrames << " streamed frames match the frames replayed from the loaded file");
+    }
+    return status;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfFrames(30);
+  int numberOfReadAheadFrames(4);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of frames in the generated sequence file (Default: 30).");
+  args.AddArgument("--read-ahead-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfReadAheadFrames, "Number of frames that are read ahead while streaming (Default: 4).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfFrames < 2 || numberOfReadAheadFrames < 1)
+  {
+    std::cerr << "Invalid arguments: at least 2 frames and 1 read-ahead frame are needed" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  const FrameSizeType frameSize = { 64, 48, 1 };
+  const std::string sequenceFileName = vtkPlusConfig::GetInstance()->GetOutputPath("SavedDataSourceStreamingTest.mha");
+  if (WriteTestSequence(sequenceFileName, frameSize, numberOfFrames) != PLUS_SUCCESS)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  if (TestStreamReader(sequenceFileName, frameSize, numberOfFrames, numberOfReadAheadFrames) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestPlayback(sequenceFileName, frameSize, numberOfFrames, numberOfReadAheadFrames) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -16,6 +16,7 @@ See License.txt for details.
 #endif
 #include "vtkPlusBuffer.h"
 #include "vtkPlusHTMLGenerator.h"
+#include "vtkPlusTimestampedCircularBuffer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 
@@ -24,6 +25,125 @@ See License.txt for details.
 #include <vtksys/SystemTools.hxx>
 #include <vtkTable.h>
 
+// STL includes
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  // Maximum difference between the incrementally computed and the reference filtered timestamps
+  const double MAX_FILTERED_TIMESTAMP_DIFFERENCE_SEC = 1e-8;
+
+  //----------------------------------------------------------------------------
+  // Reference implementation of the timestamp filtering: fits a line to all the (item index, unfiltered timestamp) pairs
+  // in the window for each new item (the way the filtered timestamps were computed before the running sums were introduced)
+  class ReferenceTimestampFilter
+  {
+  public:
+    ReferenceTimestampFilter(unsigned int averagedItemsForFiltering, double maxAllowedFilteringTimeDifference)
+      : AveragedItemsForFiltering(averagedItemsForFiltering)
+      , MaxAllowedFilteringTimeDifference(maxAllowedFilteringTimeDifference)
+    {
+    }
+
+    void CreateFilteredTimeStampForItem(unsigned long itemIndex, double unfilteredTimestamp, double& filteredTimestamp, bool& filteredTimestampProbablyValid)
+    {
+      filteredTimestampProbablyValid = true;
+      if (this->AveragedItemsForFiltering < 2)
+      {
+        filteredTimestamp = unfilteredTimestamp;
+        return;
+      }
+      this->Window.push_back(std::make_pair(static_cast<double>(itemIndex), unfilteredTimestamp));
+      if (this->Window.size() > this->AveragedItemsForFiltering)
+      {
+        this->Window.pop_front();
+      }
+      if (this->Window.size() < this->AveragedItemsForFiltering)
+      {
+        filteredTimestamp = unfilteredTimestamp;
+        return;
+      }
+      double xMean(0);
+      double yMean(0);
+      for (std::deque<std::pair<double, double> >::const_iterator it = this->Window.begin(); it != this->Window.end(); ++it)
+      {
+        xMean += it->first;
+        yMean += it->second;
+      }
+      xMean /= this->Window.size();
+      yMean /= this->Window.size();
+      double covarianceXY(0);
+      double varianceX(0);
+      for (std::deque<std::pair<double, double> >::const_iterator it = this->Window.begin(); it != this->Window.end(); ++it)
+      {
+        covarianceXY += (it->first - xMean) * (it->second - yMean);
+        varianceX += (it->first - xMean) * (it->first - xMean);
+      }
+      double a = covarianceXY / varianceX;
+      double b = yMean - a * xMean;
+      filteredTimestamp = a * itemIndex + b;
+      filteredTimestampProbablyValid = (fabs(filteredTimestamp - unfilteredTimestamp) <= this->MaxAllowedFilteringTimeDifference);
+    }
+
+  protected:
+    unsigned int AveragedItemsForFiltering;
+    double MaxAllowedFilteringTimeDifference;
+    std::deque<std::pair<double, double> > Window;
+  };
+
+  //----------------------------------------------------------------------------
+  // Compare filtered timestamps computed by vtkPlusTimestampedCircularBuffer to the reference implementation
+  int CompareToReferenceFiltering(const std::string& dataName, const std::vector<unsigned long>& itemIndexes, const std::vector<double>& unfilteredTimestamps, unsigned int averagedItemsForFiltering)
+  {
+    const double maxAllowedFilteringTimeDifference = 0.5;
+    vtkSmartPointer<vtkPlusTimestampedCircularBuffer> buffer = vtkSmartPointer<vtkPlusTimestampedCircularBuffer>::New();
+    buffer->SetAveragedItemsForFiltering(averagedItemsForFiltering);
+    buffer->SetMaxAllowedFilteringTimeDifference(maxAllowedFilteringTimeDifference);
+    ReferenceTimestampFilter referenceFilter(averagedItemsForFiltering, maxAllowedFilteringTimeDifference);
+
+    int numberOfErrors(0);
+    int numberOfProbablyInvalid(0);
+    double maxDifferenceSec(0);
+    for (size_t i = 0; i < itemIndexes.size(); ++i)
+    {
+      double filteredTimestamp(0);
+      bool filteredTimestampProbablyValid(true);
+      buffer->CreateFilteredTimeStampForItem(itemIndexes[i], unfilteredTimestamps[i], filteredTimestamp, filteredTimestampProbablyValid);
+
+      double referenceFilteredTimestamp(0);
+      bool referenceFilteredTimestampProbablyValid(true);
+      referenceFilter.CreateFilteredTimeStampForItem(itemIndexes[i], unfilteredTimestamps[i], referenceFilteredTimestamp, referenceFilteredTimestampProbablyValid);
+
+      const double difference = fabs(filteredTimestamp - referenceFilteredTimestamp);
+      maxDifferenceSec = std::max(maxDifferenceSec, difference);
+      if (difference > MAX_FILTERED_TIMESTAMP_DIFFERENCE_SEC || filteredTimestampProbablyValid != referenceFilteredTimestampProbablyValid)
+      {
+        if (numberOfErrors == 0)
+        {
+          LOG_ERROR(dataName << ": filtered timestamp of item " << itemIndexes[i] << " differs from the reference: " << std::fixed << std::setprecision(9) << filteredTimestamp
+                    << " (probably valid: " << filteredTimestampProbablyValid << "), expected: " << referenceFilteredTimestamp << " (probably valid: " << referenceFilteredTimestampProbablyValid << ")");
+        }
+        numberOfErrors++;
+      }
+      if (!referenceFilteredTimestampProbablyValid)
+      {
+        numberOfProbablyInvalid++;
+      }
+    }
+
+    LOG_INFO(dataName << ": compared " << itemIndexes.size() << " filtered timestamps to the reference, maximum difference: " << std::scientific << maxDifferenceSec << " sec"
+             << ", probably invalid: " << numberOfProbablyInvalid);
+    if (numberOfErrors > 0)
+    {
+      LOG_ERROR(dataName << ": " << numberOfErrors << " filtered timestamps differ from the reference");
+    }
+    return numberOfErrors;
+  }
+}
 
 int main(int argc, char** argv)
 {
@@ -202,6 +322,39 @@ int main(int argc, char** argv)
     timestampReportTable->Dump();
   }
 
+  // 3. The incrementally computed filtered timestamps shall match the timestamps that are computed by fitting a line to all the items
+  {
+    std::vector<unsigned long> itemIndexes;
+    std::vector<double> unfilteredTimestamps;
+    for (BufferItemUidType item = trackerBuffer->GetOldestItemUidInBuffer(); item <= trackerBuffer->GetLatestItemUidInBuffer(); ++item)
+    {
+      StreamBufferItem bufferItem;
+      if (trackerBuffer->GetStreamBufferItem(item, &bufferItem) != ITEM_OK)
+      {
+        continue;
+      }
+      itemIndexes.push_back(bufferItem.GetIndex());
+      unfilteredTimestamps.push_back(bufferItem.GetUnfilteredTimestamp(0));
+    }
+    numberOfErrors += CompareToReferenceFiltering("Recorded data", itemIndexes, unfilteredTimestamps, inputAveragedItemsForFiltering);
+
+    // Long simulated acquisition at 1 kHz with large item indexes and timestamps, random jitter, dropped items and occasional delays
+    itemIndexes.clear();
+    unfilteredTimestamps.clear();
+    unsigned long itemIndex = 10000000;
+    unsigned int randomSeed = 1;
+    for (int i = 0; i < 100000; ++i)
+    {
+      itemIndex += (i % 997 == 0) ? 3 : 1;
+      randomSeed = randomSeed * 1103515245 + 12345;
+      double jitterSec = 0.001 * ((randomSeed >> 8) % 1000) / 1000.0;
+      double delaySec = (i % 5003 == 0) ? 0.7 : 0.0;
+      itemIndexes.push_back(itemIndex);
+      unfilteredTimestamps.push_back(100000.0 + itemIndex * 0.001 + jitterSec + delaySec);
+    }
+    numberOfErrors += CompareToReferenceFiltering("Simulated data", itemIndexes, unfilteredTimestamps, inputAveragedItemsForFiltering);
+  }
+
   if (numberOfErrors != 0)
   {
     LOG_INFO("Test failed!");
@@ -10,11 +10,217 @@
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkPlusBuffer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtksys/CommandLineArguments.hxx"
 #include "vtksys/SystemTools.hxx"
+#include <vtkIGSIOAccurateTimer.h>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+  // Number of tools in the channel used for testing batched pose interpolation
+  const int NUMBER_OF_TOOLS_IN_CHANNEL = 12;
+
+  //----------------------------------------------------------------------------
+  // Compare the poses computed by vtkPlusChannel::GetToolPosesAtTime to poses interpolated for each tool separately
+  int TestToolPosesAtTime(vtkPlusBuffer* trackerBuffer, double startTime, double endTime, double timeStep)
+  {
+    int numberOfErrors(0);
+
+    vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+    std::vector<vtkSmartPointer<vtkPlusDataSource> > tools;
+    for (int i = 0; i < NUMBER_OF_TOOLS_IN_CHANNEL; ++i)
+    {
+      vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+      std::ostringstream toolId;
+      toolId << "Tool" << i;
+      tool->SetId(toolId.str());
+      tool->GetBuffer()->DeepCopy(trackerBuffer);
+      tool->SetType(DATA_SOURCE_TYPE_TOOL);
+      channel->AddTool(tool);
+      tools.push_back(tool);
+    }
+
+    std::vector<vtkPlusChannel::ToolPose> toolPoses;
+    double batchedTimeSec(0);
+    double separateTimeSec(0);
+    int numberOfComparedPoses(0);
+    for (double time = startTime; time < endTime; time += timeStep)
+    {
+      double lookupStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      PlusStatus batchedStatus = channel->GetToolPosesAtTime(time, toolPoses);
+      batchedTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - lookupStartTime;
+
+      lookupStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      std::vector<StreamBufferItem> bufferItems(tools.size());
+      std::vector<ItemStatus> itemStatuses(tools.size());
+      for (DataSourceContainerConstIterator it = channel->GetToolsStartConstIterator(); it != channel->GetToolsEndConstIterator(); ++it)
+      {
+        size_t toolIndex = std::distance(channel->GetToolsStartConstIterator(), it);
+        itemStatuses[toolIndex] = it->second->GetStreamBufferItemFromTime(time, &bufferItems[toolIndex], vtkPlusBuffer::INTERPOLATED);
+      }
+      separateTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - lookupStartTime;
+
+      if (toolPoses.size() != tools.size())
+      {
+        LOG_ERROR("Number of tool poses is " << toolPoses.size() << " (expected: " << tools.size() << ")");
+        return numberOfErrors + 1;
+      }
+      for (size_t toolIndex = 0; toolIndex < tools.size(); ++toolIndex)
+      {
+        if (toolPoses[toolIndex].Valid != (itemStatuses[toolIndex] == ITEM_OK))
+        {
+          LOG_ERROR("Batched and separate pose lookup results differ for " << toolPoses[toolIndex].Tool->GetId() << " at time " << std::fixed << time);
+          numberOfErrors++;
+          continue;
+        }
+        if (!toolPoses[toolIndex].Valid)
+        {
+          continue;
+        }
+        if (toolPoses[toolIndex].Status != bufferItems[toolIndex].GetStatus())
+        {
+          LOG_ERROR("Batched and separate pose status differ for " << toolPoses[toolIndex].Tool->GetId() << " at time " << std::fixed << time);
+          numberOfErrors++;
+        }
+        const double* expectedMatrix = bufferItems[toolIndex].GetMatrixElements();
+        for (int elementIndex = 0; elementIndex < 16; ++elementIndex)
+        {
+          if (fabs(toolPoses[toolIndex].Matrix[elementIndex] - expectedMatrix[elementIndex]) > 1e-6)
+          {
+            LOG_ERROR("Batched and separate pose interpolation results differ for " << toolPoses[toolIndex].Tool->GetId() << " at time " << std::fixed << time
+                      << " (element " << elementIndex << ": " << toolPoses[toolIndex].Matrix[elementIndex] << ", expected: " << expectedMatrix[elementIndex] << ")");
+            numberOfErrors++;
+            break;
+          }
+        }
+        numberOfComparedPoses++;
+      }
+      if (batchedStatus != PLUS_SUCCESS && numberOfErrors == 0)
+      {
+        LOG_DEBUG("Pose of some of the tools is not available at time " << std::fixed << time);
+      }
+    }
+
+    LOG_INFO("Compared " << numberOfComparedPoses << " poses of " << NUMBER_OF_TOOLS_IN_CHANNEL << " tools. Frame assembly time: batched = "
+             << std::fixed << 1e6 * batchedTimeSec / std::max(numberOfComparedPoses / NUMBER_OF_TOOLS_IN_CHANNEL, 1) << " us"
+             << ", separate = " << 1e6 * separateTimeSec / std::max(numberOfComparedPoses / NUMBER_OF_TOOLS_IN_CHANNEL, 1) << " us");
+    if (numberOfComparedPoses == 0)
+    {
+      LOG_ERROR("No tool poses were compared");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Compare the matrix, status and timestamps of two tracker items
+  int CompareTrackerItems(StreamBufferItem& item, StreamBufferItem& expectedItem, double maxElementDifference, const std::string& description)
+  {
+    if (item.GetStatus() != expectedItem.GetStatus()
+        || item.GetFilteredTimestamp(0) != expectedItem.GetFilteredTimestamp(0)
+        || item.GetUnfilteredTimestamp(0) != expectedItem.GetUnfilteredTimestamp(0))
+    {
+      LOG_ERROR(description << ": status or timestamp of the transform-only item differs at time " << std::fixed << expectedItem.GetFilteredTimestamp(0));
+      return 1;
+    }
+    for (int elementIndex = 0; elementIndex < 16; ++elementIndex)
+    {
+      if (fabs(item.GetMatrixElements()[elementIndex] - expectedItem.GetMatrixElements()[elementIndex]) > maxElementDifference)
+      {
+        LOG_ERROR(description << ": matrix of the transform-only item differs at time " << std::fixed << expectedItem.GetFilteredTimestamp(0)
+                  << " (element " << elementIndex << ": " << item.GetMatrixElements()[elementIndex] << ", expected: " << expectedItem.GetMatrixElements()[elementIndex] << ")");
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the poses to a transform-only buffer, read them back and compare the interpolated poses to the poses of the original buffer
+  int TestTransformOnlyBuffer(vtkPlusBuffer* trackerBuffer, double startTime, double endTime, double timeStep)
+  {
+    int numberOfErrors(0);
+
+    vtkSmartPointer<vtkPlusBuffer> transformOnlyBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    transformOnlyBuffer->SetTransformOnly(true);
+    transformOnlyBuffer->SetBufferSize(trackerBuffer->GetBufferSize());
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    StreamBufferItem item;
+    const BufferItemUidType oldestUid = trackerBuffer->GetOldestItemUidInBuffer();
+    const BufferItemUidType latestUid = trackerBuffer->GetLatestItemUidInBuffer();
+    for (BufferItemUidType uid = oldestUid; uid <= latestUid; ++uid)
+    {
+      if (trackerBuffer->GetStreamBufferItem(uid, &item) != ITEM_OK || item.GetMatrix(matrix) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to get tracker item " << uid);
+        return numberOfErrors + 1;
+      }
+      if (transformOnlyBuffer->AddTimeStampedItem(matrix, item.GetStatus(), item.GetIndex(), item.GetUnfilteredTimestamp(0), item.GetFilteredTimestamp(0)) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add tracker item " << uid << " to the transform-only buffer");
+        return numberOfErrors + 1;
+      }
+    }
+
+    // Round trip: the items are stored without changes
+    if (transformOnlyBuffer->GetNumberOfItems() != trackerBuffer->GetNumberOfItems())
+    {
+      LOG_ERROR("Transform-only buffer contains " << transformOnlyBuffer->GetNumberOfItems() << " items (expected: " << trackerBuffer->GetNumberOfItems() << ")");
+      return numberOfErrors + 1;
+    }
+    StreamBufferItem transformOnlyItem;
+    for (BufferItemUidType uid = oldestUid; uid <= latestUid; ++uid)
+    {
+      if (trackerBuffer->GetStreamBufferItem(uid, &item) != ITEM_OK
+          || transformOnlyBuffer->GetStreamBufferItem(transformOnlyBuffer->GetOldestItemUidInBuffer() + (uid - oldestUid), &transformOnlyItem) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to read back tracker item " << uid);
+        return numberOfErrors + 1;
+      }
+      if (transformOnlyItem.GetIndex() != item.GetIndex())
+      {
+        LOG_ERROR("Round trip: index of the transform-only item is " << transformOnlyItem.GetIndex() << " (expected: " << item.GetIndex() << ")");
+        numberOfErrors++;
+      }
+      numberOfErrors += CompareTrackerItems(transformOnlyItem, item, 0.0, "Round trip");
+    }
+
+    // Interpolation gives the same poses as the interpolation in a buffer that stores full items
+    int numberOfComparedPoses(0);
+    for (double time = startTime; time < endTime; time += timeStep)
+    {
+      ItemStatus status = trackerBuffer->GetStreamBufferItemFromTime(time, &item, vtkPlusBuffer::INTERPOLATED);
+      ItemStatus transformOnlyStatus = transformOnlyBuffer->GetStreamBufferItemFromTime(time, &transformOnlyItem, vtkPlusBuffer::INTERPOLATED);
+      if (status != transformOnlyStatus)
+      {
+        LOG_ERROR("Interpolation: transform-only buffer returned a different status at time " << std::fixed << time);
+        numberOfErrors++;
+        continue;
+      }
+      if (status != ITEM_OK)
+      {
+        continue;
+      }
+      numberOfErrors += CompareTrackerItems(transformOnlyItem, item, 1e-9, "Interpolation");
+      numberOfComparedPoses++;
+    }
+
+    LOG_INFO("Compared " << latestUid - oldestUid + 1 << " stored and " << numberOfComparedPoses << " interpolated poses of the transform-only buffer");
+    if (numberOfComparedPoses == 0)
+    {
+      LOG_ERROR("No interpolated poses of the transform-only buffer were compared");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
 
 int main(int argc, char **argv)
 {
@@ -162,6 +368,16 @@ int main(int argc, char **argv)
     prevmatrix->DeepCopy(matrix);      
   }
 
+  // Check batched interpolation of multiple tools
+  //****************************
+
+  numberOfErrors += TestToolPosesAtTime(trackerBuffer, startTime, endTime, 1.0 / (frameRate * 5.0));
+
+  // Check storage and interpolation of poses in a transform-only buffer
+  //****************************
+
+  numberOfErrors += TestTransformOnlyBuffer(trackerBuffer, startTime, endTime, 1.0 / (frameRate * 5.0));
+
   if ( numberOfErrors != 0 )
   {
     LOG_INFO("Test failed!");
@@ -0,0 +1,432 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file VirtualCaptureWriteQueueTest.cxx
+  \brief Tests the asynchronous writing of the virtual capture device.
+
+  The writer thread is held back while frames are queued, so the write queue can be filled deterministically.
+  For each write queue full policy the test verifies which frames are dropped and which frames are passed to the file writer
+  after the writer thread is released. It also verifies that WaitForWriteQueueEmpty returns only after all queued frames
+  are written, and that the asynchronous writing parameters are written to the device configuration.
+  Warnings about dropped frames are expected in the output of this test.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusVirtualCapture.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Virtual capture device that can hold back its writer thread and that records the timestamps of the written frames */
+  class WriteQueueTestCapture : public vtkPlusVirtualCapture
+  {
+  public:
+    static WriteQueueTestCapture* New();
+    vtkTypeMacro(WriteQueueTestCapture, vtkPlusVirtualCapture);
+
+    using vtkPlusVirtualCapture::StartWriterThread;
+    using vtkPlusVirtualCapture::StopWriterThread;
+    using vtkPlusVirtualCapture::IsWriteQueueFull;
+
+    PlusStatus EnqueueFrame(double timestamp)
+    {
+      vtkSmartPointer<vtkIGSIOTrackedFrameList> frames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+      igsioTrackedFrame frame;
+      FrameSizeType frameSize = { 8, 8, 1 };
+      if (frame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to allocate frame " << timestamp);
+        return PLUS_FAIL;
+      }
+      frame.SetTimestamp(timestamp);
+      if (frames->AddTrackedFrame(&frame) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << timestamp << " to the frame list");
+        return PLUS_FAIL;
+      }
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+      return this->EnqueueFramesForWriting(frames, false);
+    }
+
+    void WaitForWriteQueueEmpty()
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+      vtkPlusVirtualCapture::WaitForWriteQueueEmpty();
+    }
+
+    void SetWriterBlocked(bool blocked)
+    {
+      std::lock_guard<std::mutex> lock(this->GateMutex);
+      this->WriterBlocked = blocked;
+      this->GateCondition.notify_all();
+    }
+
+    /*! Wait until the writer thread has taken frames from the queue and is held back */
+    void WaitForBlockedWriter()
+    {
+      std::unique_lock<std::mutex> lock(this->GateMutex);
+      while (!this->WriterWaiting)
+      {
+        this->GateCondition.wait(lock);
+      }
+    }
+
+    void SetWriteDelayMs(int delayMs) { this->WriteDelayMs = delayMs; }
+
+    std::vector<double> GetWrittenTimestamps()
+    {
+      std::lock_guard<std::mutex> lock(this->GateMutex);
+      return this->WrittenTimestamps;
+    }
+
+  protected:
+    WriteQueueTestCapture()
+      : WriterBlocked(false)
+      , WriterWaiting(false)
+      , WriteDelayMs(0)
+    {
+    }
+
+    virtual PlusStatus WriteRecordedFrames(bool force)
+    {
+      {
+        std::unique_lock<std::mutex> lock(this->GateMutex);
+        this->WriterWaiting = true;
+        this->GateCondition.notify_all();
+        while (this->WriterBlocked)
+        {
+          this->GateCondition.wait(lock);
+        }
+        this->WriterWaiting = false;
+        for (unsigned int i = 0; i < this->RecordedFrames->GetNumberOfTrackedFrames(); ++i)
+        {
+          this->WrittenTimestamps.push_back(this->RecordedFrames->GetTrackedFrame(i)->GetTimestamp());
+        }
+      }
+      if (this->WriteDelayMs > 0)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(this->WriteDelayMs));
+      }
+      return vtkPlusVirtualCapture::WriteRecordedFrames(force);
+    }
+
+    std::mutex GateMutex;
+    std::condition_variable GateCondition;
+    bool WriterBlocked;
+    bool WriterWaiting;
+    int WriteDelayMs;
+    std::vector<double> WrittenTimestamps;
+
+  private:
+    WriteQueueTestCapture(const WriteQueueTestCapture&);
+    void operator=(const WriteQueueTestCapture&);
+  };
+
+  vtkStandardNewMacro(WriteQueueTestCapture);
+
+  //----------------------------------------------------------------------------
+  std::string GetPolicyName(vtkPlusVirtualCapture::WriteQueueFullPolicyType policy)
+  {
+    switch (policy)
+    {
+      case vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_OLDEST:
+        return "DROP_OLDEST";
+      case vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_NEWEST:
+        return "DROP_NEWEST";
+      default:
+        return "WAIT";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetTimestampsAsString(const std::vector<double>& timestamps)
+  {
+    std::ostringstream str;
+    for (size_t i = 0; i < timestamps.size(); ++i)
+    {
+      str << (i > 0 ? ", " : "") << timestamps[i];
+    }
+    return str.str();
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<WriteQueueTestCapture> CreateCapture(const std::string& deviceId, unsigned int writeQueueSize, vtkPlusVirtualCapture::WriteQueueFullPolicyType policy)
+  {
+    vtkSmartPointer<WriteQueueTestCapture> capture = vtkSmartPointer<WriteQueueTestCapture>::New();
+    capture->SetDeviceId(deviceId.c_str());
+    capture->SetEnableAsyncWriting(true);
+    capture->SetWriteQueueSize(writeQueueSize);
+    capture->SetWriteQueueFullPolicy(policy);
+    capture->SetEnableFileCompression(false);
+    if (capture->OpenFile((deviceId + ".mha").c_str()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(deviceId << ": failed to open the output file");
+      return vtkSmartPointer<WriteQueueTestCapture>();
+    }
+    capture->StartWriterThread();
+    return capture;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CloseCapture(WriteQueueTestCapture* capture)
+  {
+    capture->StopWriterThread();
+    if (capture->CloseFile() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(capture->GetDeviceId() << ": failed to close the output file");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWriteQueueFullPolicy(vtkPlusVirtualCapture::WriteQueueFullPolicyType policy)
+  {
+    const unsigned int writeQueueSize = 4;
+    const std::string policyName = GetPolicyName(policy);
+    vtkSmartPointer<WriteQueueTestCapture> capture = CreateCapture("VirtualCaptureWriteQueueTest_" + policyName, writeQueueSize, policy);
+    if (capture == NULL)
+    {
+      return PLUS_FAIL;
+    }
+
+    // The writer thread takes the first frame and is held back, then the queue is filled and 2 more frames are collected
+    capture->SetWriterBlocked(true);
+    capture->EnqueueFrame(1);
+    capture->WaitForBlockedWriter();
+    for (int frameNumber = 2; frameNumber <= 5; ++frameNumber)
+    {
+      capture->EnqueueFrame(frameNumber);
+    }
+    PlusStatus status = PLUS_SUCCESS;
+    if (!capture->IsWriteQueueFull())
+    {
+      LOG_ERROR(policyName << ": the write queue is not full after " << writeQueueSize << " frames were queued");
+      status = PLUS_FAIL;
+    }
+    capture->EnqueueFrame(6);
+    capture->EnqueueFrame(7);
+
+    std::vector<double> expectedTimestamps;
+    unsigned int expectedNumberOfQueuedFrames = writeQueueSize;
+    long expectedNumberOfDroppedFrames = 2;
+    switch (policy)
+    {
+      case vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_NEWEST:
+        expectedTimestamps = { 1, 2, 3, 4, 5 };
+        break;
+      case vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_OLDEST:
+        expectedTimestamps = { 1, 4, 5, 6, 7 };
+        break;
+      default:
+        // The capture thread does not collect frames while the queue is full, so the frames that are passed to the queue are kept
+        expectedTimestamps = { 1, 2, 3, 4, 5, 6, 7 };
+        expectedNumberOfQueuedFrames = writeQueueSize + 2;
+        expectedNumberOfDroppedFrames = 0;
+    }
+
+    if (capture->GetWriteQueueNumberOfFrames() != expectedNumberOfQueuedFrames || capture->GetNumberOfDroppedFrames() != expectedNumberOfDroppedFrames)
+    {
+      LOG_ERROR(policyName << ": " << capture->GetWriteQueueNumberOfFrames() << " queued (expected: " << expectedNumberOfQueuedFrames << ") and "
+                << capture->GetNumberOfDroppedFrames() << " dropped (expected: " << expectedNumberOfDroppedFrames << ") frames");
+      status = PLUS_FAIL;
+    }
+
+    capture->SetWriterBlocked(false);
+    capture->WaitForWriteQueueEmpty();
+    std::vector<double> writtenTimestamps = capture->GetWrittenTimestamps();
+    if (writtenTimestamps != expectedTimestamps)
+    {
+      LOG_ERROR(policyName << ": unexpected written frames: " << GetTimestampsAsString(writtenTimestamps) << " (expected: " << GetTimestampsAsString(expectedTimestamps) << ")");
+      status = PLUS_FAIL;
+    }
+    if (capture->GetTotalFramesRecorded() != static_cast<long>(expectedTimestamps.size()))
+    {
+      LOG_ERROR(policyName << ": " << capture->GetTotalFramesRecorded() << " frames were counted as recorded (expected: " << expectedTimestamps.size() << ")");
+      status = PLUS_FAIL;
+    }
+
+    if (CloseCapture(capture) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    if (status == PLUS_SUCCESS)
+    {
+      LOG_INFO(policyName << ": written frames: " << GetTimestampsAsString(writtenTimestamps));
+    }
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWaitForWriteQueueEmpty(int numberOfFrames)
+  {
+    vtkSmartPointer<WriteQueueTestCapture> capture = CreateCapture("VirtualCaptureWriteQueueTest_Wait", numberOfFrames, vtkPlusVirtualCapture::WRITE_QUEUE_FULL_WAIT);
+    if (capture == NULL)
+    {
+      return PLUS_FAIL;
+    }
+
+    // A slow writer: WaitForWriteQueueEmpty must return only after the last frame is written
+    capture->SetWriteDelayMs(10);
+    for (int frameNumber = 1; frameNumber <= numberOfFrames; ++frameNumber)
+    {
+      capture->EnqueueFrame(frameNumber);
+    }
+    capture->WaitForWriteQueueEmpty();
+
+    PlusStatus status = PLUS_SUCCESS;
+    std::vector<double> writtenTimestamps = capture->GetWrittenTimestamps();
+    if (capture->GetWriteQueueNumberOfFrames() != 0 || writtenTimestamps.size() != static_cast<size_t>(numberOfFrames)
+        || writtenTimestamps.back() != numberOfFrames)
+    {
+      LOG_ERROR("Wait for write queue empty: " << writtenTimestamps.size() << " frames were written (expected: " << numberOfFrames << "), "
+                << capture->GetWriteQueueNumberOfFrames() << " frames are still queued");
+      status = PLUS_FAIL;
+    }
+
+    if (CloseCapture(capture) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    if (status == PLUS_SUCCESS)
+    {
+      LOG_INFO("Wait for write queue empty: all " << numberOfFrames << " frames were written");
+    }
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestWriteConfiguration()
+  {
+    const char* configXml =
+      "<PlusConfiguration>"
+      "  <DataCollection>"
+      "    <Device Id=\"CaptureDevice\" Type=\"VirtualCapture\" EnableAsyncWriting=\"FALSE\" WriteQueueSize=\"20\" WriteQueueFullPolicy=\"WAIT\" KeyFrameInterval=\"10\" />"
+      "  </DataCollection>"
+      "</PlusConfiguration>";
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configXml));
+    vtkSmartPointer<vtkPlusVirtualCapture> capture = vtkSmartPointer<vtkPlusVirtualCapture>::New();
+    capture->SetDeviceId("CaptureDevice");
+    if (configRootElement == NULL || capture->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Write configuration: failed to read the device configuration");
+      return PLUS_FAIL;
+    }
+
+    capture->SetEnableAsyncWriting(true);
+    capture->SetWriteQueueSize(150);
+    capture->SetWriteQueueFullPolicy(vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_OLDEST);
+    capture->SetKeyFrameInterval(60);
+    if (capture->WriteConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Write configuration: failed to write the device configuration");
+      return PLUS_FAIL;
+    }
+
+    // Reading the written configuration must restore the parameters
+    vtkSmartPointer<vtkPlusVirtualCapture> restoredCapture = vtkSmartPointer<vtkPlusVirtualCapture>::New();
+    restoredCapture->SetDeviceId("CaptureDevice");
+    if (restoredCapture->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Write configuration: failed to read the written device configuration");
+      return PLUS_FAIL;
+    }
+    if (!restoredCapture->GetEnableAsyncWriting() || restoredCapture->GetWriteQueueSize() != 150
+        || restoredCapture->GetWriteQueueFullPolicy() != vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_OLDEST || restoredCapture->GetKeyFrameInterval() != 60)
+    {
+      LOG_ERROR("Write configuration: the asynchronous writing parameters are not written to the device configuration");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Write configuration: the asynchronous writing parameters are written");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfFrames(20);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of frames written by the slow writer (Default: 20).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfFrames < 1)
+  {
+    std::cerr << "Invalid arguments: at least one frame must be written" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors(0);
+  if (TestWriteQueueFullPolicy(vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_NEWEST) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWriteQueueFullPolicy(vtkPlusVirtualCapture::WRITE_QUEUE_FULL_DROP_OLDEST) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWriteQueueFullPolicy(vtkPlusVirtualCapture::WRITE_QUEUE_FULL_WAIT) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWaitForWriteQueueEmpty(numberOfFrames) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestWriteConfiguration() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -541,6 +541,20 @@ PlusStatus vtkPlusV4L2VideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
+  // With read() I/O the frame can be read directly into the buffer, if it does not have to be clipped
+  if (this->IOMethod == IO_METHOD_READ && !igsioCommon::IsClippingRequested(this->DataSource->GetClipRectangleOrigin(), this->DataSource->GetClipRectangleSize()))
+  {
+    bool frameAdded(false);
+    if (this->ReadFrameFileDescriptorIntoBuffer(frameAdded) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (frameAdded)
+    {
+      return PLUS_SUCCESS;
+    }
+  }
+
   unsigned int currentBufferIndex;
   unsigned int bytesUsed;
   if (this->ReadFrame(currentBufferIndex, bytesUsed) != PLUS_SUCCESS)
@@ -609,6 +623,51 @@ PlusStatus vtkPlusV4L2VideoSource::ReadFrameFileDescriptor(unsigned int& current
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusV4L2VideoSource::ReadFrameFileDescriptorIntoBuffer(bool& frameAdded)
+{
+  frameAdded = false;
+  // Check the frame size before reserving, as the reservation removes the oldest item from the buffer
+  FrameSizeType bufferFrameSize = this->DataSource->GetBuffer()->GetFrameSize();
+  const size_t bufferFrameSizeInBytes = static_cast<size_t>(bufferFrameSize[0]) * bufferFrameSize[1] * bufferFrameSize[2] * this->DataSource->GetNumberOfBytesPerPixel();
+  if (bufferFrameSizeInBytes < this->FrameBuffers[0].length)
+  {
+    // The buffer frame format does not match the device frame, the frame is read and added by copying
+    return PLUS_SUCCESS;
+  }
+
+  igsioVideoFrame* frame = this->DataSource->ReserveItem();
+  if (frame == NULL)
+  {
+    LOG_ERROR("vtkPlusV4L2VideoSource::Unable to reserve item in the buffer.");
+    return PLUS_FAIL;
+  }
+
+  ssize_t bytesRead = read(this->FileDescriptor, frame->GetImage()->GetScalarPointer(), this->FrameBuffers[0].length);
+  if (-1 == bytesRead)
+  {
+    // Nothing was read (e.g., EAGAIN, no frame is available yet), so the oldest item is added back to the buffer
+    this->DataSource->CancelItem(false);
+    if (errno != EAGAIN)
+    {
+      LOG_ERROR("Read" << ": " << strerror(errno));
+    }
+    return PLUS_FAIL;
+  }
+
+  this->FrameFields["FrameSizeInBytes"].first = FRAMEFIELD_NONE;
+  this->FrameFields["FrameSizeInBytes"].second = igsioCommon::ToString<unsigned int>(static_cast<unsigned int>(bytesRead));
+  if (this->DataSource->CommitItem(this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &this->FrameFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusV4L2VideoSource::Unable to add item to the buffer.");
+    return PLUS_FAIL;
+  }
+
+  this->FrameNumber++;
+  frameAdded = true;
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusV4L2VideoSource::ReadFrameMemoryMap(unsigned int& currentBufferIndex, unsigned int& bytesUsed)
 {
@@ -73,6 +73,12 @@ protected:
   PlusStatus ReadFrameMemoryMap(unsigned int& currentBufferIndex, unsigned int& bytesUsed);
   PlusStatus ReadFrameUserPtr(unsigned int& currentBufferIndex, unsigned int& bytesUsed);
 
+  /*!
+    Read the frame with read() directly into a reserved item of the buffer, without an intermediate copy.
+    frameAdded is false if the reserved buffer frame is smaller than the device frame, then nothing is read.
+  */
+  PlusStatus ReadFrameFileDescriptorIntoBuffer(bool& frameAdded);
+
   PlusStatus InitRead(unsigned int bufferSize);
   PlusStatus InitMmap();
   PlusStatus InitUserp(unsigned int bufferSize);
@@ -4,6 +4,7 @@ Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
 See License.txt for details.
 =========================================================Plus=header=end*/
 
+#include "PlusChannelReadCursor.h"
 #include "PlusConfigure.h"
 #include "igsioTrackedFrame.h"
 #include "vtkIGSIOMetaImageSequenceIO.h"
@@ -30,23 +31,26 @@ namespace
   static const double WARNING_RECORDING_LAG_SEC = 1.0; // if the recording lags more than this then a warning message will be displayed
   static const double MAX_ALLOWED_RECORDING_LAG_SEC = 3.0; // if the recording lags more than this then it'll skip frames to catch up
   static const unsigned int DISABLE_FRAME_BUFFER = std::numeric_limits<unsigned int>::max();
+  static const double DROPPED_FRAMES_WARNING_PERIOD_SEC = 5.0; // minimum time between warnings about dropped frames
 }
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   : vtkPlusDevice()
   , RecordedFrames(vtkIGSIOTrackedFrameList::New())
-  , LastAlreadyRecordedFrameTimestamp(UNDEFINED_TIMESTAMP)
+  , RecordingCursor(NULL)
   , NextFrameToBeRecordedTimestamp(0.0)
   , RequestedFrameRate(15.0)
   , ActualFrameRate(0.0)
-  , FirstFrameIndexInThisSegment(0)
   , TimeWaited(0.0)
   , LastUpdateTime(0.0)
   , CurrentFilename("")
   , BaseFilename("TrackedImageSequence.nrrd")
   , Writer(NULL)
+  , UseIndexedWriter(false)
   , EnableFileCompression(false)
+  , FileCompressionType(PlusIndexedSequenceFile::COMPRESSION_ZLIB)
+  , KeyFrameInterval(30)
   , IsHeaderPrepared(false)
   , TotalFramesRecorded(0)
   , EnableCapturingOnStart(false)
@@ -55,6 +59,18 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   , IsData3D(false)
   , WriterAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
+  , EnableAsyncWriting(true)
+  , WriteQueueSize(300)
+  , WriteQueueFullPolicy(WRITE_QUEUE_FULL_WAIT)
+  , WriteQueueNumberOfFrames(0)
+  , WriterThreadBusy(false)
+  , WriterThreadStopRequested(false)
+  , WriteFailed(false)
+  , NumberOfDroppedFrames(0)
+  , LastDroppedFramesWarningTime(0.0)
+  , WriteQueueFramesMetric(NULL)
+  , WrittenFramesMetric(NULL)
+  , DroppedFramesMetric(NULL)
   , EncodingFourCC("VP90")
 {
   this->AcquisitionRate = 30.0;
@@ -68,6 +84,8 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
 //----------------------------------------------------------------------------
 vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
 {
+  this->StopWriterThread();
+
   if (IsHeaderPrepared)
   {
     this->CloseFile();
@@ -84,6 +102,12 @@ vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
     this->Writer->Delete();
     this->Writer = NULL;
   }
+
+  if (this->RecordingCursor != NULL)
+  {
+    this->RecordingCursor->GetChannel()->DeleteReadCursor(this->RecordingCursor);
+    this->RecordingCursor = NULL;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -105,10 +129,26 @@ PlusStatus vtkPlusVirtualCapture::ReadConfiguration(vtkXMLDataElement* rootConfi
 
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(BaseFilename, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableFileCompression, deviceConfig);
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(FileCompressionType, deviceConfig,
+                                    "ZLIB", PlusIndexedSequenceFile::COMPRESSION_ZLIB,
+                                    "LZ4", PlusIndexedSequenceFile::COMPRESSION_LZ4,
+                                    "DELTA_ZLIB", PlusIndexedSequenceFile::COMPRESSION_DELTA_ZLIB);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, KeyFrameInterval, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableCapturingOnStart, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, RequestedFrameRate, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FrameBufferSize, deviceConfig);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(EncodingFourCC, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableAsyncWriting, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, WriteQueueSize, deviceConfig);
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(WriteQueueFullPolicy, deviceConfig,
+                                    "WAIT", WRITE_QUEUE_FULL_WAIT,
+                                    "DROP_OLDEST", WRITE_QUEUE_FULL_DROP_OLDEST,
+                                    "DROP_NEWEST", WRITE_QUEUE_FULL_DROP_NEWEST);
+  if (this->WriteQueueSize < 1)
+  {
+    LOG_WARNING("WriteQueueSize must be at least 1. Using 1 instead of " << this->WriteQueueSize << ".");
+    this->WriteQueueSize = 1;
+  }
 
   return PLUS_SUCCESS;
 }
@@ -119,8 +159,23 @@ PlusStatus vtkPlusVirtualCapture::WriteConfiguration(vtkXMLDataElement* rootConf
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceElement, rootConfig);
   deviceElement->SetAttribute("EnableCapturing", this->EnableCapturing ? "TRUE" : "FALSE");
   deviceElement->SetAttribute("EnableFileCompression", this->EnableFileCompression ? "TRUE" : "FALSE");
+  deviceElement->SetAttribute("FileCompressionType", PlusIndexedSequenceFile::GetCompressionTypeAsString(this->FileCompressionType).c_str());
+  deviceElement->SetIntAttribute("KeyFrameInterval", static_cast<int>(this->KeyFrameInterval));
   deviceElement->SetAttribute("EnableCaptureOnStart", this->EnableCapturingOnStart ? "TRUE" : "FALSE");
   deviceElement->SetDoubleAttribute("RequestedFrameRate", this->GetRequestedFrameRate());
+  deviceElement->SetAttribute("EnableAsyncWriting", this->EnableAsyncWriting ? "TRUE" : "FALSE");
+  deviceElement->SetIntAttribute("WriteQueueSize", static_cast<int>(this->WriteQueueSize));
+  switch (this->WriteQueueFullPolicy)
+  {
+    case WRITE_QUEUE_FULL_DROP_OLDEST:
+      deviceElement->SetAttribute("WriteQueueFullPolicy", "DROP_OLDEST");
+      break;
+    case WRITE_QUEUE_FULL_DROP_NEWEST:
+      deviceElement->SetAttribute("WriteQueueFullPolicy", "DROP_NEWEST");
+      break;
+    default:
+      deviceElement->SetAttribute("WriteQueueFullPolicy", "WAIT");
+  }
 
   return PLUS_SUCCESS;
 }
@@ -134,6 +189,8 @@ PlusStatus vtkPlusVirtualCapture::InternalConnect()
     return PLUS_FAIL;
   }
 
+  this->StartWriterThread();
+
   if (this->GetEnableCapturingOnStart())
   {
     this->SetEnableCapturing(true);
@@ -149,23 +206,18 @@ PlusStatus vtkPlusVirtualCapture::InternalDisconnect()
 {
   this->EnableCapturing = false;
 
+  // Write the frames that are still in the write queue
+  this->StopWriterThread();
+
   // If outstanding frames to be written, deal with them
   if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0 && this->IsHeaderPrepared)
   {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append image data to header.");
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
+    if (this->WriteRecordedFrames(true) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << this->LastAlreadyRecordedFrameTimestamp);
+      LOG_ERROR("Stopping recording at timestamp: " << (this->RecordingCursor != NULL ? this->RecordingCursor->GetLastReadTimestamp() : UNDEFINED_TIMESTAMP));
       this->Disconnect();
       return PLUS_FAIL;
     }
-
-    this->ClearRecordedFrames();
   }
   PlusStatus status = this->CloseFile();
   return status;
@@ -175,12 +227,24 @@ PlusStatus vtkPlusVirtualCapture::InternalDisconnect()
 PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
 {
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+  this->WaitForWriteQueueEmpty();
+
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    this->WriteFailed = false;
+    this->NumberOfDroppedFrames = 0;
+  }
 
   if (aFilename == NULL || strlen(aFilename) == 0)
   {
     std::string filenameRoot = igsioCommon::GetSequenceFilenameWithoutExtension(this->BaseFilename);
     std::string ext = igsioCommon::GetSequenceFilenameExtension(this->BaseFilename);
-    if (ext.empty())
+    if (PlusIndexedSequenceFile::IsIndexedSequenceFileName(this->BaseFilename))
+    {
+      filenameRoot = this->BaseFilename.substr(0, this->BaseFilename.size() - std::string(".pseq").size());
+      ext = ".pseq";
+    }
+    else if (ext.empty())
     {
       // default to nrrd
       ext = ".nrrd";
@@ -205,6 +269,19 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
     this->CurrentFilename = aFilename;
   }
 
+  this->UseIndexedWriter = PlusIndexedSequenceFile::IsIndexedSequenceFileName(aFilename);
+  if (this->UseIndexedWriter)
+  {
+    // The file is created when the first frames are written
+    this->IndexedWriterFileName = vtkPlusConfig::GetInstance()->GetOutputPath(aFilename);
+    return PLUS_SUCCESS;
+  }
+
+  if (this->GetEnableFileCompression() && this->FileCompressionType != PlusIndexedSequenceFile::COMPRESSION_ZLIB)
+  {
+    LOG_WARNING("FileCompressionType is only used for indexed sequence files (.pseq). File " << aFilename << " will be compressed with gzip.");
+  }
+
   this->Writer = vtkIGSIOSequenceIO::CreateSequenceHandlerForFile(aFilename);
   if (!this->Writer)
   {
@@ -224,6 +301,7 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
 {
   // Fix the header to write the correct number of frames
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+  this->WaitForWriteQueueEmpty();
 
   if (!this->IsHeaderPrepared)
   {
@@ -231,30 +309,40 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
     return PLUS_SUCCESS;
   }
 
-  if (aFilename != NULL && strlen(aFilename) != 0)
+  if (this->UseIndexedWriter)
   {
-    // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
-    this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
-    this->CurrentFilename = aFilename;
+    if (this->CloseIndexedFile(aFilename, resultFilename) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
   }
-
-  // Do we have any outstanding unwritten data?
-  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+  else
   {
-    this->WriteFrames(true);
-  }
+    if (aFilename != NULL && strlen(aFilename) != 0)
+    {
+      // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
+      this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
+      this->CurrentFilename = aFilename;
+    }
 
-  this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
-  this->Writer->FinalizeHeader();
+    // Do we have any outstanding unwritten data?
+    if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+    {
+      this->WriteFrames(true);
+    }
 
-  if (resultFilename != NULL)
-  {
-    (*resultFilename) = this->Writer->GetFileName();
-  }
+    this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
+    this->Writer->FinalizeHeader();
 
-  this->Writer->Close();
+    if (resultFilename != NULL)
+    {
+      (*resultFilename) = this->Writer->GetFileName();
+    }
+
+    this->Writer->Close();
+  }
 
   std::string fullPath = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
   std::string path = vtksys::SystemTools::GetFilenamePath(fullPath);
@@ -274,6 +362,58 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::CloseIndexedFile(const char* aFilename, std::string* resultFilename)
+{
+  // Do we have any outstanding unwritten data?
+  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+  {
+    this->WriteFrames(true);
+  }
+
+  std::vector<std::string> customFieldNames;
+  this->RecordedFrames->GetCustomFieldNameList(customFieldNames);
+  for (std::vector<std::string>::iterator fieldIt = customFieldNames.begin(); fieldIt != customFieldNames.end(); ++fieldIt)
+  {
+    this->IndexedWriter.SetCustomField(*fieldIt, this->RecordedFrames->GetCustomString(*fieldIt));
+  }
+
+  // Wait for the compression of the remaining frames and write the index
+  if (this->IndexedWriter.Finalize() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to finalize file: " << this->IndexedWriterFileName);
+    return PLUS_FAIL;
+  }
+
+  if (aFilename != NULL && strlen(aFilename) != 0)
+  {
+    // The file is created before the final file name is known, so it has to be moved now
+    this->CurrentFilename = aFilename;
+    if (!PlusIndexedSequenceFile::IsIndexedSequenceFileName(this->CurrentFilename))
+    {
+      LOG_WARNING("Indexed sequence file is saved with .pseq extension: " << this->CurrentFilename << ".pseq");
+      this->CurrentFilename += ".pseq";
+    }
+    std::string finalFileName = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
+    if (finalFileName != this->IndexedWriterFileName)
+    {
+      if (!vtksys::SystemTools::RenameFile(this->IndexedWriterFileName.c_str(), finalFileName.c_str()))
+      {
+        LOG_ERROR("Unable to rename " << this->IndexedWriterFileName << " to " << finalFileName);
+        return PLUS_FAIL;
+      }
+      this->IndexedWriterFileName = finalFileName;
+    }
+  }
+
+  if (resultFilename != NULL)
+  {
+    (*resultFilename) = this->IndexedWriterFileName;
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 
 PlusStatus vtkPlusVirtualCapture::InternalUpdate()
@@ -337,48 +477,63 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
     return PLUS_SUCCESS;
   }
 
-  int nbFramesBefore = this->RecordedFrames->GetNumberOfTrackedFrames();
-  if (this->GetInputTrackedFrameListSampled(this->LastAlreadyRecordedFrameTimestamp, this->NextFrameToBeRecordedTimestamp, this->RecordedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
+  bool asyncWriting = this->WriterThread.joinable();
+  if (asyncWriting)
   {
-    LOG_ERROR("Error while getting tracked frame list from data collector during capturing. Last recorded timestamp: " << std::fixed << this->NextFrameToBeRecordedTimestamp);
+    bool writeFailed = false;
+    {
+      std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+      writeFailed = this->WriteFailed;
+    }
+    if (writeFailed)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Writing of recorded frames to file failed. Capturing is stopped.");
+      this->EnableCapturing = false;
+      return PLUS_FAIL;
+    }
+  }
+
+  // In asynchronous mode frames are collected into a new list, which is then passed to the writer thread
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> collectedFrames = this->RecordedFrames;
+  if (asyncWriting)
+  {
+    collectedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    collectedFrames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
   }
-  int nbFramesAfter = this->RecordedFrames->GetNumberOfTrackedFrames();
 
-  // Compute the average frame rate from the ratio of recently acquired frames
-  int frame1Index = this->RecordedFrames->GetNumberOfTrackedFrames() - 1; // index of the latest frame
-  int frame2Index = frame1Index - this->RequestedFrameRate * 5.0 - 1; // index of an earlier acquired frame (go back by approximately 5 seconds + one frame)
-  if (frame2Index < this->FirstFrameIndexInThisSegment)
+  int nbFramesBefore = collectedFrames->GetNumberOfTrackedFrames();
+  if (asyncWriting && this->WriteQueueFullPolicy == WRITE_QUEUE_FULL_WAIT && this->IsWriteQueueFull())
+  {
+    // Frames are left in the input buffer until the writer thread catches up
+    LOG_DEBUG(this->GetDeviceId() << ": Write queue is full, waiting for the writer to catch up");
+  }
+  else if (this->GetInputTrackedFrameListSampled(this->NextFrameToBeRecordedTimestamp, collectedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
   {
-    // make sure we stay in the current recording segment
-    frame2Index = this->FirstFrameIndexInThisSegment;
+    LOG_ERROR("Error while getting tracked frame list from data collector during capturing. Last recorded timestamp: " << std::fixed << this->NextFrameToBeRecordedTimestamp);
   }
-  if (frame1Index > frame2Index)
+  int nbFramesAfter = collectedFrames->GetNumberOfTrackedFrames();
+
+  this->UpdateActualFrameRate(collectedFrames, nbFramesBefore);
+
+  if (asyncWriting)
   {
-    igsioTrackedFrame* frame1 = this->RecordedFrames->GetTrackedFrame(frame1Index);
-    igsioTrackedFrame* frame2 = this->RecordedFrames->GetTrackedFrame(frame2Index);
-    if (frame1 != NULL && frame2 != NULL)
+    if (nbFramesAfter > nbFramesBefore && this->EnqueueFramesForWriting(collectedFrames, false) != PLUS_SUCCESS)
     {
-      double frameTimeDiff = frame1->GetTimestamp() - frame2->GetTimestamp();
-      if (frameTimeDiff > 0)
-      {
-        this->ActualFrameRate = (frame1Index - frame2Index) / frameTimeDiff;
-      }
-      else
-      {
-        this->ActualFrameRate = 0;
-      }
+      LOG_ERROR(this->GetDeviceId() << ": Unable to queue " << nbFramesAfter - nbFramesBefore << " frames for writing.");
+      return PLUS_FAIL;
     }
   }
-
-  if (this->WriteFrames() != PLUS_SUCCESS)
+  else
   {
-    LOG_ERROR(this->GetDeviceId() << ": Unable to write " << nbFramesAfter - nbFramesBefore << " frames.");
-    return PLUS_FAIL;
+    if (this->WriteFrames() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Unable to write " << nbFramesAfter - nbFramesBefore << " frames.");
+      return PLUS_FAIL;
+    }
+    this->TotalFramesRecorded += nbFramesAfter - nbFramesBefore;
   }
 
-  this->TotalFramesRecorded += nbFramesAfter - nbFramesBefore;
-
-  if (this->TotalFramesRecorded == 0)
+  if (this->TotalFramesRecorded == 0 && nbFramesAfter == nbFramesBefore)
   {
     // We haven't received any data so far
     LOG_DYNAMIC("No input data available to capture thread. Waiting until input data arrives.", this->GracePeriodLogLevel);
@@ -450,7 +605,7 @@ PlusStatus vtkPlusVirtualCapture::NotifyConfigured()
 //-----------------------------------------------------------------------------
 bool vtkPlusVirtualCapture::HasUnsavedData() const
 {
-  return this->IsHeaderPrepared;
+  return this->IsHeaderPrepared || this->GetWriteQueueNumberOfFrames() > 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -481,15 +636,21 @@ void vtkPlusVirtualCapture::SetEnableFileCompression(bool aFileCompression)
 //-----------------------------------------------------------------------------
 void vtkPlusVirtualCapture::SetEnableCapturing(bool aValue)
 {
+  // Prevent changing the recording state while the internal update thread is collecting frames
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
   this->EnableCapturing = aValue;
 
   if (this->EnableCapturing)
   {
     this->LastUpdateTime = 0.0;
     this->TimeWaited = 0.0;
-    this->LastAlreadyRecordedFrameTimestamp = UNDEFINED_TIMESTAMP;
+    if (this->RecordingCursor != NULL)
+    {
+      this->RecordingCursor->Reset();
+    }
     this->NextFrameToBeRecordedTimestamp = 0.0;
-    this->FirstFrameIndexInThisSegment = this->RecordedFrames->GetNumberOfTrackedFrames();
+    this->RecentFrameTimestamps.clear();
     this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); // reset the starting time for the grace period
   }
 }
@@ -501,14 +662,21 @@ PlusStatus vtkPlusVirtualCapture::Reset()
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
 
     this->SetEnableCapturing(false);
+    this->ClearWriteQueue();
 
     if (this->IsHeaderPrepared)
     {
-      this->Writer->Discard();
+      if (this->UseIndexedWriter)
+      {
+        this->IndexedWriter.Discard();
+      }
+      else
+      {
+        this->Writer->Discard();
+      }
     }
 
     this->ClearRecordedFrames();
-    this->Writer->GetTrackedFrameList()->Clear();
     this->IsHeaderPrepared = false;
     this->TotalFramesRecorded = 0;
   }
@@ -576,14 +744,31 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
     return PLUS_FAIL;
   }
 
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
+  // In asynchronous mode the snapshot is passed to the writer thread, similarly to frames collected during capturing
+  bool asyncWriting = this->WriterThread.joinable();
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> snapshotFrames = this->RecordedFrames;
+  if (asyncWriting)
+  {
+    snapshotFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    snapshotFrames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  }
+
   // Add tracked frame to the list
   // Snapshots are triggered manually, so the additional copying in AddTrackedFrame compared to TakeTrackedFrame is not relevant.
-  if (this->RecordedFrames->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+  if (snapshotFrames->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
   {
     LOG_WARNING(this->GetDeviceId() << ": Frame could not be added because validation failed");
     return PLUS_FAIL;
   }
 
+  if (asyncWriting)
+  {
+    // Snapshots are requested explicitly, so they are never dropped
+    return this->EnqueueFramesForWriting(snapshotFrames, true);
+  }
+
   if (this->WriteFrames() != PLUS_SUCCESS)
   {
     LOG_ERROR(this->GetDeviceId() << ": Failed to write snapshot frame");
@@ -598,18 +783,43 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::SetCustomHeaderField(const std::string& fieldName, const std::string& fieldValue)
 {
-  return this->Writer->GetTrackedFrameList()->SetCustomString(fieldName, fieldValue);
+  // Custom fields are read by the writer thread when the header is written
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+  this->WaitForWriteQueueEmpty();
+  return this->RecordedFrames->SetCustomString(fieldName, fieldValue);
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
+{
+  if (this->WriteRecordedFrames(force) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Stopping recording at timestamp: " << (this->RecordingCursor != NULL ? this->RecordingCursor->GetLastReadTimestamp() : UNDEFINED_TIMESTAMP));
+    this->StopRecording();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::WriteRecordedFrames(bool force)
 {
   if (!this->IsHeaderPrepared && this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
   {
-    if (this->Writer->PrepareHeader() != PLUS_SUCCESS)
+    if (this->UseIndexedWriter)
+    {
+      PlusIndexedSequenceFile::CompressionType compression = this->EnableFileCompression ? this->FileCompressionType : PlusIndexedSequenceFile::COMPRESSION_NONE;
+      this->IndexedWriter.SetKeyFrameInterval(this->KeyFrameInterval);
+      if (this->IndexedWriter.Create(this->IndexedWriterFileName, compression) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to create file: " << this->IndexedWriterFileName);
+        return PLUS_FAIL;
+      }
+    }
+    else if (this->Writer->PrepareHeader() != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to prepare header");
-      this->StopRecording();
       return PLUS_FAIL;
     }
     this->IsHeaderPrepared = true;
@@ -625,17 +835,27 @@ PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
   if (force || !this->IsFrameBuffered() ||
       (this->IsFrameBuffered() && this->RecordedFrames->GetNumberOfTrackedFrames() > this->GetFrameBufferSize()))
   {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
+    if (this->UseIndexedWriter)
     {
-      LOG_ERROR("Unable to append image data to header.");
-      this->StopRecording();
-      return PLUS_FAIL;
+      // Frames are compressed on the thread pool, so this returns before the frames are written to the file
+      if (this->IndexedWriter.AppendFrames(this->RecordedFrames) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to append images.");
+        return PLUS_FAIL;
+      }
     }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
+    else
     {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
-      this->StopRecording();
-      return PLUS_FAIL;
+      if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to append image data to header.");
+        return PLUS_FAIL;
+      }
+      if (this->Writer->WriteImages() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to append images.");
+        return PLUS_FAIL;
+      }
     }
 
     this->ClearRecordedFrames();
@@ -665,7 +885,7 @@ PlusStatus vtkPlusVirtualCapture::GetInputTrackedFrame(igsioTrackedFrame& aFrame
 }
 
 //-----------------------------------------------------------------------------
-PlusStatus vtkPlusVirtualCapture::GetInputTrackedFrameListSampled(double& lastAlreadyRecordedFrameTimestamp, double& nextFrameToBeRecordedTimestamp, vtkIGSIOTrackedFrameList* recordedFrames, double requestedFramePeriodSec, double maxProcessingTimeSec)
+PlusStatus vtkPlusVirtualCapture::GetInputTrackedFrameListSampled(double& nextFrameToBeRecordedTimestamp, vtkIGSIOTrackedFrameList* recordedFrames, double requestedFramePeriodSec, double maxProcessingTimeSec)
 {
   if (this->OutputChannels.empty())
   {
@@ -673,7 +893,11 @@ PlusStatus vtkPlusVirtualCapture::GetInputTrackedFrameListSampled(double& lastAl
     return PLUS_FAIL;
   }
 
-  return this->OutputChannels[0]->GetTrackedFrameListSampled(lastAlreadyRecordedFrameTimestamp, nextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec);
+  if (this->RecordingCursor == NULL)
+  {
+    this->RecordingCursor = this->OutputChannels[0]->CreateReadCursor(this->GetDeviceId());
+  }
+  return this->RecordingCursor->ReadNextTrackedFramesSampled(recordedFrames, nextFrameToBeRecordedTimestamp, requestedFramePeriodSec, maxProcessingTimeSec);
 }
 
 //-----------------------------------------------------------------------------
@@ -686,3 +910,252 @@ PlusStatus vtkPlusVirtualCapture::GetLatestInputItemTimestamp(double& timestamp)
   }
   return this->OutputChannels[0]->GetLatestTimestamp(timestamp);
 }
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::UpdateActualFrameRate(vtkIGSIOTrackedFrameList* frames, int firstNewFrameIndex)
+{
+  for (unsigned int frameIndex = firstNewFrameIndex; frameIndex < frames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    this->RecentFrameTimestamps.push_back(frames->GetTrackedFrame(frameIndex)->GetTimestamp());
+  }
+
+  // Compute the average frame rate from the recently acquired frames (approximately the last 5 seconds + one frame)
+  unsigned int maxNumberOfTimestamps = static_cast<unsigned int>(this->RequestedFrameRate * 5.0) + 2;
+  while (this->RecentFrameTimestamps.size() > maxNumberOfTimestamps)
+  {
+    this->RecentFrameTimestamps.pop_front();
+  }
+  if (this->RecentFrameTimestamps.size() < 2)
+  {
+    return;
+  }
+  double frameTimeDiff = this->RecentFrameTimestamps.back() - this->RecentFrameTimestamps.front();
+  if (frameTimeDiff > 0)
+  {
+    this->ActualFrameRate = (this->RecentFrameTimestamps.size() - 1) / frameTimeDiff;
+  }
+  else
+  {
+    this->ActualFrameRate = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+unsigned int vtkPlusVirtualCapture::GetWriteQueueNumberOfFrames() const
+{
+  std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+  return this->WriteQueueNumberOfFrames;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusVirtualCapture::IsWriteQueueFull()
+{
+  std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+  return this->WriteQueueNumberOfFrames >= this->WriteQueueSize;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::EnqueueFramesForWriting(vtkIGSIOTrackedFrameList* frames, bool force)
+{
+  if (!this->WriterThread.joinable())
+  {
+    LOG_ERROR(this->GetDeviceId() << ": Cannot queue frames for writing, the writer thread is not running.");
+    return PLUS_FAIL;
+  }
+
+  unsigned int numberOfNewFrames = frames->GetNumberOfTrackedFrames();
+  unsigned int numberOfDroppedNewFrames = 0;
+  unsigned int numberOfDroppedQueuedFrames = 0;
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    if (!force && this->WriteQueueNumberOfFrames + numberOfNewFrames > this->WriteQueueSize)
+    {
+      switch (this->WriteQueueFullPolicy)
+      {
+        case WRITE_QUEUE_FULL_DROP_NEWEST:
+          numberOfDroppedNewFrames = numberOfNewFrames;
+          break;
+        case WRITE_QUEUE_FULL_DROP_OLDEST:
+          while (!this->WriteQueue.empty() && this->WriteQueueNumberOfFrames + numberOfNewFrames > this->WriteQueueSize)
+          {
+            unsigned int numberOfFramesInItem = this->WriteQueue.front()->GetNumberOfTrackedFrames();
+            this->WriteQueue.pop_front();
+            this->WriteQueueNumberOfFrames -= numberOfFramesInItem;
+            numberOfDroppedQueuedFrames += numberOfFramesInItem;
+          }
+          break;
+        default:
+          // WRITE_QUEUE_FULL_WAIT: frames are not collected while the queue is full, so the queue size
+          // can be exceeded only by the frames collected in one update
+          break;
+      }
+    }
+    if (numberOfDroppedNewFrames == 0)
+    {
+      this->WriteQueue.push_back(frames);
+      this->WriteQueueNumberOfFrames += numberOfNewFrames;
+    }
+    this->WriteQueueFramesMetric->Set(this->WriteQueueNumberOfFrames);
+  }
+  this->WriteQueueNotEmptyCondition.notify_one();
+
+  // Frames that were already queued were counted as recorded, dropped new frames were not
+  this->TotalFramesRecorded += (numberOfNewFrames - numberOfDroppedNewFrames);
+  this->TotalFramesRecorded -= numberOfDroppedQueuedFrames;
+
+  unsigned int numberOfDroppedFrames = numberOfDroppedNewFrames + numberOfDroppedQueuedFrames;
+  if (numberOfDroppedFrames > 0)
+  {
+    this->NumberOfDroppedFrames += numberOfDroppedFrames;
+    this->DroppedFramesMetric->Add(numberOfDroppedFrames);
+    double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (currentTime - this->LastDroppedFramesWarningTime > DROPPED_FRAMES_WARNING_PERIOD_SEC)
+    {
+      LOG_WARNING(this->GetDeviceId() << ": Writing to file cannot keep up with the acquisition, write queue is full. "
+                  << this->NumberOfDroppedFrames << " frames have been dropped since the file was opened.");
+      this->LastDroppedFramesWarningTime = currentTime;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::WaitForWriteQueueEmpty()
+{
+  std::unique_lock<std::mutex> queueLock(this->WriteQueueMutex);
+  while (!this->WriteQueue.empty() || this->WriterThreadBusy)
+  {
+    this->FramesWrittenCondition.wait(queueLock);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::ClearWriteQueue()
+{
+  std::unique_lock<std::mutex> queueLock(this->WriteQueueMutex);
+  this->WriteQueue.clear();
+  this->WriteQueueNumberOfFrames = 0;
+  if (this->WriteQueueFramesMetric != NULL)
+  {
+    this->WriteQueueFramesMetric->Set(0);
+  }
+  while (this->WriterThreadBusy)
+  {
+    this->FramesWrittenCondition.wait(queueLock);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StartWriterThread()
+{
+  if (!this->EnableAsyncWriting || this->WriterThread.joinable())
+  {
+    return;
+  }
+
+  if (this->WriteQueueFramesMetric == NULL)
+  {
+    std::string deviceId = this->GetDeviceId();
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    this->WriteQueueFramesMetric = registry->GetMetric("plus_capture_write_queue_frames", "Number of recorded frames waiting to be written to file", PlusMetric::METRIC_GAUGE, "device", deviceId);
+    this->WrittenFramesMetric = registry->GetMetric("plus_capture_written_frames_total", "Number of recorded frames written to file", PlusMetric::METRIC_COUNTER, "device", deviceId);
+    this->DroppedFramesMetric = registry->GetMetric("plus_capture_dropped_frames_total", "Number of recorded frames that were dropped because the write queue was full", PlusMetric::METRIC_COUNTER, "device", deviceId);
+    this->WriteRateMeter.SetGauge(registry->GetMetric("plus_capture_write_rate_hz", "Number of frames written to file per second", PlusMetric::METRIC_GAUGE, "device", deviceId));
+    this->WriteThroughputMeter.SetGauge(registry->GetMetric("plus_capture_write_throughput_bytes_per_second", "Amount of image data written to file per second (before compression)", PlusMetric::METRIC_GAUGE, "device", deviceId));
+  }
+
+  std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+  this->WriterThreadStopRequested = false;
+  this->WriterThreadBusy = false;
+  this->WriterThread = std::thread(&vtkPlusVirtualCapture::WriterThreadMain, this);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StopWriterThread()
+{
+  if (!this->WriterThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    this->WriterThreadStopRequested = true;
+    this->WriteQueueNotEmptyCondition.notify_all();
+  }
+  // The writer thread exits when all queued frames are written
+  this->WriterThread.join();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::WriterThreadMain()
+{
+  std::unique_lock<std::mutex> queueLock(this->WriteQueueMutex);
+  while (true)
+  {
+    if (this->WriteQueue.empty())
+    {
+      if (this->WriterThreadStopRequested)
+      {
+        break;
+      }
+      this->WriteQueueNotEmptyCondition.wait(queueLock);
+      continue;
+    }
+
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frames = this->WriteQueue.front();
+    this->WriteQueue.pop_front();
+    this->WriteQueueNumberOfFrames -= frames->GetNumberOfTrackedFrames();
+    this->WriteQueueFramesMetric->Set(this->WriteQueueNumberOfFrames);
+    if (this->WriteFailed)
+    {
+      // Frames are discarded until the file is reopened
+      this->FramesWrittenCondition.notify_all();
+      continue;
+    }
+
+    // While the writer thread is busy, other threads do not access the file writer or the recorded frames
+    // (they wait in WaitForWriteQueueEmpty), so the file can be written without holding the lock
+    this->WriterThreadBusy = true;
+    queueLock.unlock();
+
+    unsigned int numberOfFrames = frames->GetNumberOfTrackedFrames();
+    double numberOfBytes = 0.0;
+    for (unsigned int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      igsioVideoFrame* image = frames->GetTrackedFrame(frameIndex)->GetImageData();
+      if (image->IsImageValid())
+      {
+        numberOfBytes += image->GetFrameSizeInBytes();
+      }
+    }
+
+    PlusStatus status = PLUS_FAIL;
+    if (this->RecordedFrames->AddTrackedFrameList(frames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Unable to pass " << numberOfFrames << " frames to the file writer.");
+    }
+    else
+    {
+      status = this->WriteRecordedFrames(false);
+    }
+    frames = NULL;
+
+    if (status == PLUS_SUCCESS)
+    {
+      double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      this->WrittenFramesMetric->Add(numberOfFrames);
+      this->WriteRateMeter.Add(numberOfFrames, currentTime);
+      this->WriteThroughputMeter.Add(numberOfBytes, currentTime);
+    }
+
+    queueLock.lock();
+    this->WriterThreadBusy = false;
+    if (status != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Failed to write recorded frames to file. Further frames are discarded until the file is reopened.");
+      this->WriteFailed = true;
+    }
+    this->FramesWrittenCondition.notify_all();
+  }
+}
@@ -10,19 +10,41 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIOSequenceIOBase.h"
+#include "PlusIndexedSequenceFile.h"
+#include "PlusMetricsRegistry.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 
 //class vtkIGSIOTrackedFrameList;
+class PlusChannelReadCursor;
 
 /*!
 \class vtkPlusVirtualCapture
-\brief
+\brief Records frames of the input channel into a sequence file
+
+If asynchronous writing is enabled (default) then the internal update thread only collects the frames from the input channel
+and puts them into a bounded write queue. A dedicated writer thread takes the frames from the queue, encodes them and writes
+them to file, therefore a temporary slow-down of the disk does not block the acquisition. If the queue is full then
+the WriteQueueFullPolicy determines what happens: the frames are left in the input buffer until the writer catches up (WAIT),
+or the oldest queued (DROP_OLDEST) or the newly collected frames (DROP_NEWEST) are dropped.
 
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusVirtualCapture : public vtkPlusDevice
 {
 public:
+  /*! Action to perform when frames are collected but the write queue is full */
+  enum WriteQueueFullPolicyType
+  {
+    WRITE_QUEUE_FULL_WAIT,        /*!< keep the frames in the input buffer until there is space in the queue */
+    WRITE_QUEUE_FULL_DROP_OLDEST, /*!< drop the oldest frames from the queue to make space for the new frames */
+    WRITE_QUEUE_FULL_DROP_NEWEST  /*!< drop the new frames */
+  };
+
   static vtkPlusVirtualCapture* New();
   vtkTypeMacro(vtkPlusVirtualCapture, vtkPlusDevice);
   void PrintSelf(ostream& os, vtkIndent indent);
@@ -78,6 +100,14 @@ public:
   vtkGetMacro(EnableFileCompression, bool);
   void SetEnableFileCompression(bool aFileCompression);
 
+  /*! Compression method of indexed sequence files (.pseq). Other file formats are always compressed with gzip. */
+  vtkGetMacro(FileCompressionType, PlusIndexedSequenceFile::CompressionType);
+  vtkSetMacro(FileCompressionType, PlusIndexedSequenceFile::CompressionType);
+
+  /*! Maximum number of frames between key frames if FileCompressionType is DELTA_ZLIB */
+  vtkGetMacro(KeyFrameInterval, unsigned int);
+  vtkSetMacro(KeyFrameInterval, unsigned int);
+
   vtkGetStdStringMacro(EncodingFourCC);
   vtkSetStdStringMacro(EncodingFourCC)
 
@@ -89,6 +119,23 @@ public:
   vtkSetMacro(FrameBufferSize, unsigned int);
   vtkGetMacro(FrameBufferSize, unsigned int);
 
+  /*! If enabled then frames are written to file on a separate thread. Takes effect when the device is connected. */
+  vtkSetMacro(EnableAsyncWriting, bool);
+  vtkGetMacro(EnableAsyncWriting, bool);
+
+  /*! Maximum number of frames waiting in the write queue */
+  vtkSetMacro(WriteQueueSize, unsigned int);
+  vtkGetMacro(WriteQueueSize, unsigned int);
+
+  vtkSetMacro(WriteQueueFullPolicy, WriteQueueFullPolicyType);
+  vtkGetMacro(WriteQueueFullPolicy, WriteQueueFullPolicyType);
+
+  /*! Number of frames that are collected but not yet passed to the file writer */
+  unsigned int GetWriteQueueNumberOfFrames() const;
+
+  /*! Number of frames that were dropped because the write queue was full, since the file was opened */
+  vtkGetMacro(NumberOfDroppedFrames, long int);
+
   virtual vtkPlusDataCollector* GetDataCollector() { return this->DataCollector; }
 
   virtual bool IsTracker() const { return false; }
@@ -111,17 +158,56 @@ protected:
   virtual bool IsFrameBuffered() const;
 
   /*!
-    Copy frames to memory buffer or disk.
+    Copy frames to memory buffer or disk. Recording is stopped if writing fails.
     If force flag is true then data is written to disk immediately.
   */
   virtual PlusStatus WriteFrames(bool force = false);
 
+  /*! Same as WriteFrames but it does not stop the recording if writing fails */
+  virtual PlusStatus WriteRecordedFrames(bool force);
+
+  /*!
+    Write the remaining frames and the index of the indexed sequence file, then move the file to its final location.
+    The caller must have locked WriterAccessMutex.
+  */
+  PlusStatus CloseIndexedFile(const char* aFilename, std::string* resultFilename);
+
+  /*! Start the writer thread (if asynchronous writing is enabled) */
+  void StartWriterThread();
+
+  /*! Write all queued frames and then stop the writer thread */
+  void StopWriterThread();
+
+  /*! Main function of the writer thread: writes the queued frames to file */
+  void WriterThreadMain();
+
+  /*!
+    Add collected frames to the write queue. If the queue is full then frames are dropped according to WriteQueueFullPolicy,
+    unless force is true. The caller must have locked WriterAccessMutex.
+  */
+  PlusStatus EnqueueFramesForWriting(vtkIGSIOTrackedFrameList* frames, bool force);
+
+  /*! Returns true if there is no space in the write queue for more frames */
+  bool IsWriteQueueFull();
+
+  /*!
+    Wait until the writer thread writes all the queued frames. After this, the caller can access the file writer
+    until it releases WriterAccessMutex. The caller must have locked WriterAccessMutex.
+  */
+  void WaitForWriteQueueEmpty();
+
+  /*! Remove all frames from the write queue and wait until the writer thread completes writing of the current frames */
+  void ClearWriteQueue();
+
+  /*! Update the actual frame rate from the timestamps of the newly recorded frames */
+  void UpdateActualFrameRate(vtkIGSIOTrackedFrameList* frames, int firstNewFrameIndex);
+
 protected:
   /*! Recorded tracked frame list */
   vtkIGSIOTrackedFrameList* RecordedFrames;
 
-  /*! Timestamp of last recorded frame (only frames that have more recent timestamp will be added) */
-  double LastAlreadyRecordedFrameTimestamp;
+  /*! Position of the recording in the input channel (only frames that have not been recorded yet will be added) */
+  PlusChannelReadCursor* RecordingCursor;
 
   /*! Desired timestamp of the next frame to be recorded */
   double NextFrameToBeRecordedTimestamp;
@@ -137,12 +223,11 @@ protected:
   double ActualFrameRate;
 
   /*!
-    Frame index of the first frame that is recorded in this segment (since pressed the record button).
-    It is used when estimating the actual frame rate: frames that are acquired before this frame index (i.e.,
-    those that were acquired in a different recording segment) will not be taken into account in the actual
-    frame rate computation.
+    Timestamps of the frames that are recorded recently in this segment (since pressed the record button).
+    It is used for estimating the actual frame rate: frames that were acquired in a different recording segment
+    will not be taken into account in the actual frame rate computation.
   */
-  int FirstFrameIndexInThisSegment;
+  std::deque<double> RecentFrameTimestamps;
 
   /* Time waited in update */
   double TimeWaited;
@@ -155,9 +240,20 @@ protected:
   /*! Sequence writer to write to */
   vtkIGSIOSequenceIOBase* Writer;
 
+  /*! Writer of indexed sequence files, used instead of Writer if the file has .pseq extension */
+  PlusIndexedSequenceFile IndexedWriter;
+  bool UseIndexedWriter;
+  /*! Full path of the indexed sequence file, it is created when the first frames are written */
+  std::string IndexedWriterFileName;
+
   /*! When closing the file, re-read the data from file, and write it compressed */
   bool EnableFileCompression;
 
+  /*! Compression method used for indexed sequence files if EnableFileCompression is true */
+  PlusIndexedSequenceFile::CompressionType FileCompressionType;
+
+  unsigned int KeyFrameInterval;
+
   /*! FourCC code represending the codec to use when writing the file*/
   std::string EncodingFourCC;
 
@@ -182,8 +278,39 @@ protected:
 
   vtkPlusLogger::LogLevelType GracePeriodLogLevel;
 
+  bool EnableAsyncWriting;
+  unsigned int WriteQueueSize;
+  WriteQueueFullPolicyType WriteQueueFullPolicy;
+
+  /*! Frames collected by the update thread, waiting to be written by the writer thread. Protected by WriteQueueMutex. */
+  std::deque<vtkSmartPointer<vtkIGSIOTrackedFrameList> > WriteQueue;
+  /*! Total number of frames in WriteQueue. Protected by WriteQueueMutex. */
+  unsigned int WriteQueueNumberOfFrames;
+  /*! True while the writer thread writes frames that are already removed from the queue. Protected by WriteQueueMutex. */
+  bool WriterThreadBusy;
+  bool WriterThreadStopRequested;
+  /*! Set by the writer thread if writing failed. Further frames are not written until the file is reopened. Protected by WriteQueueMutex. */
+  bool WriteFailed;
+  mutable std::mutex WriteQueueMutex;
+  /*! Signaled when frames are added to the queue or the writer thread should stop */
+  std::condition_variable WriteQueueNotEmptyCondition;
+  /*! Signaled when the writer thread completed writing of frames */
+  std::condition_variable FramesWrittenCondition;
+  std::thread WriterThread;
+
+  long int NumberOfDroppedFrames;
+  double LastDroppedFramesWarningTime;
+
+  /*! Metrics of the writer (owned by PlusMetricsRegistry) */
+  PlusMetric* WriteQueueFramesMetric;
+  PlusMetric* WrittenFramesMetric;
+  PlusMetric* DroppedFramesMetric;
+  /*! Rate meters are updated by the writer thread only */
+  PlusMetricRateMeter WriteRateMeter;
+  PlusMetricRateMeter WriteThroughputMeter;
+
   PlusStatus GetInputTrackedFrame(igsioTrackedFrame& aFrame);
-  PlusStatus GetInputTrackedFrameListSampled(double& lastAlreadyRecordedFrameTimestamp, double& nextFrameToBeRecordedTimestamp, vtkIGSIOTrackedFrameList* recordedFrames, double requestedFramePeriodSec, double maxProcessingTimeSec);
+  PlusStatus GetInputTrackedFrameListSampled(double& nextFrameToBeRecordedTimestamp, vtkIGSIOTrackedFrameList* recordedFrames, double requestedFramePeriodSec, double maxProcessingTimeSec);
   PlusStatus GetLatestInputItemTimestamp(double& timestamp);
 
 private:
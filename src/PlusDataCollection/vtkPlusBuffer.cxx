@@ -6,27 +6,59 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusBufferSpillFile.h"
+#include "PlusFrameArena.h"
+#include "PlusLatencyTracer.h"
+#include "PlusNewItemNotifier.h"
 #include "igsioMath.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusBuffer.h"
+#include "vtkPlusConfig.h"
 #include "vtkPlusDevice.h"
 #include "vtkPlusSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 
 // VTK includes
+#include <vtkDataArray.h>
 #include <vtkDoubleArray.h>
 #include <vtkImageData.h>
 #include <vtkIntArray.h>
+#include <vtkLZ4DataCompressor.h>
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
 #include <vtkUnsignedLongLongArray.h>
 
 // vtkAddon includes
 #include <vtkStreamingVolumeCodec.h>
 
+// STL includes
+#include <algorithm>
+#include <limits>
+
 static const double NEGLIGIBLE_TIME_DIFFERENCE = 0.00001; // in seconds, used for comparing between exact timestamps
 static const double ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG = 10; // if the interpolated orientation differs from both the interpolated orientation by more than this threshold then display a warning
+static const int MIN_BUFFER_SIZE_FROM_LIMITS = 2; // the buffer must hold at least two items (e.g., for interpolation), even if BufferSizeSec or BufferSizeMB would allow fewer
+static const int MIN_NUMBER_OF_ITEMS_FOR_RATE_MEASUREMENT = 10; // item rate is measured from the buffer content if it contains at least this many items
+static const double ITEM_RATE_MEASUREMENT_PERIOD_SEC = 1.0; // during acquisition the item rate is measured from the items that are added during this period
+static const double ITEM_RATE_TOLERANCE = 0.1; // item rates that differ by less than this fraction are considered equal (the measured rate is stable, or the buffer does not have to be resized)
+static const double RESERVED_MEMORY_METRIC_UPDATE_PERIOD_SEC = 1.0; // computing the reserved memory requires iterating through all items, so the metric is not updated for each item
+static const int DEFAULT_NUMBER_OF_UNCOMPRESSED_FRAMES = 2; // the latest items are read most often (e.g., by the broadcasting and recording threads), so they are not compressed
+static const size_t SPILL_QUEUE_SIZE = 32; // maximum number of removed items that wait for being written to the spill file
+static const double DROPPED_SPILL_ITEMS_WARNING_PERIOD_SEC = 10.0; // minimum time between warnings about removed items that could not be spilled
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Returns the address of the pixel data of the frame, NULL if no pixel data is allocated
+  void* GetFramePixelPointer(igsioVideoFrame& frame)
+  {
+    vtkImageData* image = frame.GetImage();
+    vtkDataArray* scalars = (image != NULL ? image->GetPointData()->GetScalars() : NULL);
+    return (scalars != NULL ? scalars->GetVoidPointer(0) : NULL);
+  }
+}
 
 vtkStandardNewMacro(vtkPlusBuffer);
 
@@ -84,6 +116,37 @@ vtkPlusBuffer::vtkPlusBuffer()
   , StreamBuffer(vtkPlusTimestampedCircularBuffer::New())
   , MaxAllowedTimeDifference(0.5)
   , DescriptiveName(NULL)
+  , TransformOnly(false)
+  , BufferSizeSec(0.0)
+  , BufferSizeMB(0.0)
+  , NominalItemRate(0.0)
+  , BufferSizeItemRate(0.0)
+  , StableItemRate(0.0)
+  , LastMeasuredItemRate(0.0)
+  , ItemRatePeriodStartTimestamp(UNDEFINED_TIMESTAMP)
+  , NumberOfItemsInItemRatePeriod(0)
+  , BufferSizeUpdatePending(false)
+  , UseFrameArena(false)
+  , FrameArena(new PlusFrameArena)
+  , StartupCompleted(false)
+  , NumberOfFrameAllocationsAfterStartup(0)
+  , ReservedItemRestorable(false)
+  , SpillFileSizeMB(0.0)
+  , SpillFile(new PlusBufferSpillFile)
+  , CompressFrames(false)
+  , NumberOfUncompressedFrames(DEFAULT_NUMBER_OF_UNCOMPRESSED_FRAMES)
+  , FrameCompressor(vtkLZ4DataCompressor::New())
+  , SpillThreadBusy(false)
+  , SpillThreadStopRequested(false)
+  , NumberOfDroppedSpillItems(0)
+  , LastDroppedSpillItemsWarningTime(-DROPPED_SPILL_ITEMS_WARNING_PERIOD_SEC)
+  , ItemsAddedMetric(NULL)
+  , FillLevelMetric(NULL)
+  , OverwrittenItemsMetric(NULL)
+  , RejectedItemsMetric(NULL)
+  , AcquisitionRateMetric(NULL)
+  , ReservedMemoryMetric(NULL)
+  , ReservedMemoryMetricUpdateTime(-RESERVED_MEMORY_METRIC_UPDATE_PERIOD_SEC)
 {
   this->FrameSize[0] = 0;
   this->FrameSize[1] = 0;
@@ -96,49 +159,891 @@ vtkPlusBuffer::vtkPlusBuffer()
 }
 
 //----------------------------------------------------------------------------
-vtkPlusBuffer::~vtkPlusBuffer()
+vtkPlusBuffer::~vtkPlusBuffer()
+{
+  // background compression tasks and the spill thread use the compressor and the buffer
+  this->CompressionTasks.Wait();
+  this->StopSpillThread();
+  for (std::vector<StreamBufferItem*>::iterator it = this->FreeSpillItems.begin(); it != this->FreeSpillItems.end(); ++it)
+  {
+    delete *it;
+  }
+  this->FreeSpillItems.clear();
+  if (this->StreamBuffer != NULL)
+  {
+    this->StreamBuffer->Delete();
+    this->StreamBuffer = NULL;
+  }
+  // frames may use the arena memory, so it is released after the items
+  delete this->FrameArena;
+  this->FrameArena = NULL;
+  delete this->SpillFile;
+  this->SpillFile = NULL;
+  if (this->FrameCompressor != NULL)
+  {
+    this->FrameCompressor->Delete();
+    this->FrameCompressor = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Frame size in pixel: " << this->GetFrameSize()[0] << "   " << this->GetFrameSize()[1] << "   " << this->GetFrameSize()[2] << std::endl;
+  os << indent << "Scalar pixel type: " << vtkImageScalarTypeNameMacro(this->GetPixelType()) << std::endl;
+  os << indent << "Image type: " << igsioCommon::GetStringFromUsImageType(this->GetImageType()) << std::endl;
+  os << indent << "Image orientation: " << igsioCommon::GetStringFromUsImageOrientation(this->GetImageOrientation()) << std::endl;
+  os << indent << "Transform only: " << (this->TransformOnly ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "Buffer size (sec): " << this->BufferSizeSec << std::endl;
+  os << indent << "Buffer size (MB): " << this->BufferSizeMB << std::endl;
+  os << indent << "Nominal item rate: " << this->NominalItemRate << std::endl;
+  os << indent << "Item rate of the buffer size: " << this->BufferSizeItemRate << std::endl;
+  os << indent << "Reserved memory (bytes): " << this->GetReservedMemoryBytes() << std::endl;
+  os << indent << "Use frame arena: " << (this->UseFrameArena ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "Frame allocations after startup: " << this->GetNumberOfFrameAllocationsAfterStartup() << std::endl;
+  os << indent << "Spill file size (MB): " << this->SpillFileSizeMB << std::endl;
+  os << indent << "Spilled items: " << this->GetNumberOfSpilledItems() << std::endl;
+  os << indent << "Compress frames: " << (this->CompressFrames ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "Uncompressed frames: " << this->NumberOfUncompressedFrames << std::endl;
+  os << indent << "Compressed frames size (bytes): " << this->GetCompressedFramesSizeBytes() << std::endl;
+
+  os << indent << "StreamBuffer: " << this->StreamBuffer << "\n";
+  if (this->StreamBuffer)
+  {
+    this->StreamBuffer->PrintSelf(os, indent.GetNextIndent());
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AllocateMemoryForFrames()
+{
+  if (this->TransformOnly)
+  {
+    // Frames are not used in transform-only buffers
+    return PLUS_SUCCESS;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  // Background compressions must not refer to the frames that are reallocated. The tasks do not lock the buffer, so they can be waited for here.
+  this->CompressionTasks.Wait();
+  this->ApplyCompressedFrames();
+  // Frames of all slots may be reallocated, lock-free readers must not copy them meanwhile
+  this->StreamBuffer->BeginSlotStorageChange();
+  PlusStatus result = PLUS_SUCCESS;
+
+  const size_t frameSizeBytes = static_cast<size_t>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2] * this->GetNumberOfBytesPerPixel();
+  const int bufferSize = this->StreamBuffer->GetBufferSize();
+  if (this->UseFrameArena && !this->CompressFrames && frameSizeBytes > 0 && bufferSize > 0)
+  {
+    if (!this->FrameArena->IsAllocated(bufferSize, frameSizeBytes))
+    {
+      // Frames that are in the current arena keep their content in separate allocations until they are moved to the new arena
+      this->DetachFramesFromArena();
+      if (this->FrameArena->Allocate(bufferSize, frameSizeBytes) != PLUS_SUCCESS)
+      {
+        LOCAL_LOG_WARNING("Failed to reserve memory for the frame arena, frames are allocated separately");
+      }
+      else if (this->StartupCompleted)
+      {
+        // the acquisition is already running, map the pages now and not at the first write
+        this->FrameArena->Prefault();
+      }
+    }
+  }
+  else if (this->FrameArena->GetNumberOfSlots() > 0)
+  {
+    this->DetachFramesFromArena();
+    this->FrameArena->Release();
+  }
+
+  if (this->UpdateSpillFile() != PLUS_SUCCESS)
+  {
+    result = PLUS_FAIL;
+  }
+
+  // pooled pixel arrays may have the previous frame format
+  this->PixelArrayPool.clear();
+  this->EmptyPixelArrayPool.clear();
+
+  for (int i = 0; i < bufferSize; ++i)
+  {
+    StreamBufferItem* item = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i);
+    igsioVideoFrame& frame = item->GetFrame();
+    if (item->IsFrameCompressed())
+    {
+      const bool frameFormatUnchanged = this->HasBufferFrameFormat(frame);
+      if (this->CompressFrames && frameFormatUnchanged)
+      {
+        // the compressed frame remains valid
+        continue;
+      }
+      // the content can only be kept if the frame format did not change
+      if (this->RestoreItemFrame(*item, frameFormatUnchanged) != PLUS_SUCCESS)
+      {
+        LOCAL_LOG_ERROR("Failed to decompress frame " << i);
+        result = PLUS_FAIL;
+      }
+    }
+    if (!frame.IsFrameEncoded())
+    {
+      if (this->AllocateFrame(frame, i) != PLUS_SUCCESS)
+      {
+        LOCAL_LOG_ERROR("Failed to allocate memory for frame " << i);
+        result = PLUS_FAIL;
+      }
+    }
+  }
+
+  if (frameSizeBytes > 0)
+  {
+    this->UpdateCompressedFrames();
+  }
+  this->StreamBuffer->EndSlotStorageChange();
+  return result;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusBuffer::HasBufferFrameFormat(igsioVideoFrame& frame)
+{
+  FrameSizeType frameSize = { 0, 0, 0 };
+  unsigned int numberOfScalarComponents(0);
+  return frame.GetImage() != NULL
+         && frame.GetFrameSize(frameSize) == PLUS_SUCCESS
+         && frame.GetNumberOfScalarComponents(numberOfScalarComponents) == PLUS_SUCCESS
+         && frameSize[0] == this->GetFrameSize()[0]
+         && frameSize[1] == this->GetFrameSize()[1]
+         && frameSize[2] == this->GetFrameSize()[2]
+         && frame.GetVTKScalarPixelType() == this->GetPixelType()
+         && numberOfScalarComponents == this->GetNumberOfScalarComponents();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AllocateFrame(igsioVideoFrame& frame, int bufferIndex)
+{
+  void* pixelsBeforeAllocation = GetFramePixelPointer(frame);
+  if (frame.AllocateFrame(this->GetFrameSize(), this->GetPixelType(), this->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->StartupCompleted && GetFramePixelPointer(frame) != pixelsBeforeAllocation)
+  {
+    this->NumberOfFrameAllocationsAfterStartup++;
+  }
+  if (this->FrameArena->GetNumberOfSlots() > 0)
+  {
+    return this->AttachFrameToArena(frame, bufferIndex);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AttachFrameToArena(igsioVideoFrame& frame, int bufferIndex)
+{
+  vtkImageData* image = frame.GetImage();
+  vtkDataArray* scalars = (image != NULL ? image->GetPointData()->GetScalars() : NULL);
+  void* slot = this->FrameArena->GetSlot(bufferIndex);
+  if (scalars == NULL || slot == NULL)
+  {
+    LOCAL_LOG_ERROR("Failed to place frame " << bufferIndex << " in the frame arena");
+    return PLUS_FAIL;
+  }
+  void* pixels = scalars->GetVoidPointer(0);
+  if (pixels == slot)
+  {
+    // already in the arena
+    return PLUS_SUCCESS;
+  }
+  const size_t frameSizeBytes = static_cast<size_t>(scalars->GetNumberOfValues()) * scalars->GetDataTypeSize();
+  if (frameSizeBytes > this->FrameArena->GetSlotSizeBytes())
+  {
+    LOCAL_LOG_ERROR("Frame " << bufferIndex << " does not fit into the frame arena (frame: " << frameSizeBytes << " bytes, slot: " << this->FrameArena->GetSlotSizeBytes() << " bytes)");
+    return PLUS_FAIL;
+  }
+  memcpy(slot, pixels, frameSizeBytes);
+  // The memory is owned by the arena, the array must not free it (save=1)
+  scalars->SetVoidArray(slot, scalars->GetNumberOfValues(), 1);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::DetachFramesFromArena()
+{
+  if (this->FrameArena->GetNumberOfSlots() == 0)
+  {
+    return;
+  }
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    vtkImageData* image = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame().GetImage();
+    vtkDataArray* scalars = (image != NULL ? image->GetPointData()->GetScalars() : NULL);
+    if (scalars == NULL || !this->FrameArena->Contains(scalars->GetVoidPointer(0)))
+    {
+      continue;
+    }
+    vtkSmartPointer<vtkDataArray> ownScalars = vtkSmartPointer<vtkDataArray>::Take(scalars->NewInstance());
+    ownScalars->DeepCopy(scalars);
+    image->GetPointData()->SetScalars(ownScalars);
+    if (this->StartupCompleted)
+    {
+      this->NumberOfFrameAllocationsAfterStartup++;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::UpdateSpillFile()
+{
+  const size_t frameSizeBytes = static_cast<size_t>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2] * this->GetNumberOfBytesPerPixel();
+  if (this->SpillFileSizeMB <= 0 || this->TransformOnly || frameSizeBytes == 0)
+  {
+    this->CloseSpillFile();
+    return PLUS_SUCCESS;
+  }
+  if (this->SpillFile->IsOpen() && this->SpillFile->GetFrameSizeBytes() == frameSizeBytes)
+  {
+    // the spill file is already suitable for the current frame format
+    return PLUS_SUCCESS;
+  }
+
+  std::ostringstream fileName;
+  fileName << "BufferSpill_" << vtkIGSIOAccurateTimer::GetInstance()->GetDateAndTimeString() << "_" << this << ".bin";
+  std::string filePath = this->SpillFileDirectory.empty()
+                         ? vtkPlusConfig::GetInstance()->GetOutputPath(fileName.str())
+                         : this->SpillFileDirectory + "/" + fileName.str();
+
+  // queued items have the previous frame format
+  this->CloseSpillFile();
+  const unsigned long long maximumFileSizeBytes = static_cast<unsigned long long>(this->SpillFileSizeMB * 1024 * 1024);
+  if (this->SpillFile->Open(filePath, frameSizeBytes, maximumFileSizeBytes) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("Failed to create spill file, items that are removed from the buffer will not be available");
+    return PLUS_FAIL;
+  }
+  this->StartSpillThread();
+  this->StreamBuffer->SetItemRemovedCallback([this](StreamBufferItem & item) { this->QueueRemovedItemForSpilling(item); });
+  LOCAL_LOG_DEBUG("Spill file can store " << this->SpillFile->GetNumberOfRecords() << " items in addition to the " << this->StreamBuffer->GetBufferSize() << " items of the buffer");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetSpillFileSizeMB(double spillFileSizeMB)
+{
+  if (spillFileSizeMB < 0)
+  {
+    LOCAL_LOG_ERROR("Invalid spill file size requested: " << spillFileSizeMB << " MB");
+    return PLUS_FAIL;
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->SpillFileSizeMB == spillFileSizeMB)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->SpillFileSizeMB = spillFileSizeMB;
+  // recreate the file with the new size
+  this->CloseSpillFile();
+  return this->UpdateSpillFile();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetSpillFileDirectory(const std::string& directory)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->SpillFileDirectory == directory)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->SpillFileDirectory = directory;
+  if (!this->SpillFile->IsOpen())
+  {
+    return PLUS_SUCCESS;
+  }
+  // recreate the file in the new directory
+  this->CloseSpillFile();
+  return this->UpdateSpillFile();
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusBuffer::GetNumberOfSpilledItems()
+{
+  return this->SpillFile->GetNumberOfItems();
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusBuffer::GetNumberOfDroppedSpillItems()
+{
+  std::lock_guard<std::mutex> queueLock(this->SpillQueueMutex);
+  return this->NumberOfDroppedSpillItems;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::WaitForSpillQueueEmpty()
+{
+  std::unique_lock<std::mutex> queueLock(this->SpillQueueMutex);
+  while (!this->SpillQueue.empty() && this->SpillThread.joinable())
+  {
+    this->ItemSpilledCondition.wait(queueLock);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::CloseSpillFile()
+{
+  // the caller must have locked the buffer
+  this->StreamBuffer->SetItemRemovedCallback(nullptr);
+  this->DiscardQueuedSpillItems();
+  this->StopSpillThread();
+  this->SpillFile->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::QueueRemovedItemForSpilling(StreamBufferItem& item)
+{
+  // the caller must have locked the buffer
+  StreamBufferItem* queuedItem = NULL;
+  {
+    std::lock_guard<std::mutex> queueLock(this->SpillQueueMutex);
+    if (this->SpillQueue.size() < SPILL_QUEUE_SIZE)
+    {
+      if (this->FreeSpillItems.empty())
+      {
+        queuedItem = new StreamBufferItem;
+      }
+      else
+      {
+        queuedItem = this->FreeSpillItems.back();
+        this->FreeSpillItems.pop_back();
+      }
+    }
+    else
+    {
+      this->NumberOfDroppedSpillItems++;
+    }
+  }
+
+  if (queuedItem == NULL)
+  {
+    double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (currentTime - this->LastDroppedSpillItemsWarningTime > DROPPED_SPILL_ITEMS_WARNING_PERIOD_SEC)
+    {
+      LOCAL_LOG_WARNING("Writing to the spill file cannot keep up with the acquisition, spill queue is full. "
+                        << this->GetNumberOfDroppedSpillItems() << " removed items have not been stored in the spill file.");
+      this->LastDroppedSpillItemsWarningTime = currentTime;
+    }
+    return;
+  }
+
+  // Compressed frames are copied as they are, the spill thread decompresses them
+  queuedItem->DeepCopy(&item);
+
+  // The item is added to the queue after it is copied, so that readers of the queue never see a partial item
+  {
+    std::lock_guard<std::mutex> queueLock(this->SpillQueueMutex);
+    this->SpillQueue.push_back(queuedItem);
+  }
+  this->SpillQueueNotEmptyCondition.notify_one();
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetQueuedSpillItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  std::lock_guard<std::mutex> queueLock(this->SpillQueueMutex);
+  for (std::deque<StreamBufferItem*>::iterator it = this->SpillQueue.begin(); it != this->SpillQueue.end(); ++it)
+  {
+    if ((*it)->GetUid() == uid)
+    {
+      // queued items are only read by the spill thread, so they can be copied concurrently
+      return (this->CopyStreamBufferItem(bufferItem, *it) == PLUS_SUCCESS ? ITEM_OK : ITEM_UNKNOWN_ERROR);
+    }
+  }
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::StartSpillThread()
+{
+  if (this->SpillThread.joinable())
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> queueLock(this->SpillQueueMutex);
+  this->SpillThreadStopRequested = false;
+  this->SpillThreadBusy = false;
+  this->SpillThread = std::thread(&vtkPlusBuffer::SpillThreadMain, this);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::DiscardQueuedSpillItems()
+{
+  std::unique_lock<std::mutex> queueLock(this->SpillQueueMutex);
+  // the first item may be written by the spill thread right now
+  while (this->SpillQueue.size() > (this->SpillThreadBusy ? 1 : 0))
+  {
+    this->FreeSpillItems.push_back(this->SpillQueue.back());
+    this->SpillQueue.pop_back();
+  }
+  while (this->SpillThreadBusy)
+  {
+    this->ItemSpilledCondition.wait(queueLock);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::StopSpillThread()
+{
+  if (!this->SpillThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> queueLock(this->SpillQueueMutex);
+    this->SpillThreadStopRequested = true;
+    this->SpillQueueNotEmptyCondition.notify_all();
+  }
+  // The spill thread exits when all queued items are written
+  this->SpillThread.join();
+  this->ItemSpilledCondition.notify_all();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::SpillThreadMain()
+{
+  std::unique_lock<std::mutex> queueLock(this->SpillQueueMutex);
+  while (true)
+  {
+    if (this->SpillQueue.empty())
+    {
+      if (this->SpillThreadStopRequested)
+      {
+        break;
+      }
+      this->SpillQueueNotEmptyCondition.wait(queueLock);
+      continue;
+    }
+
+    // The item remains in the queue while it is written, so that it can be read by GetQueuedSpillItem meanwhile
+    StreamBufferItem* item = this->SpillQueue.front();
+    this->SpillThreadBusy = true;
+    queueLock.unlock();
+
+    if (!item->IsFrameCompressed())
+    {
+      this->SpillFile->AppendItem(*item);
+    }
+    else
+    {
+      // The spill file stores uncompressed frames, so that they can be read without decompression.
+      // The frame format of the item is used, as the buffer frame format may be changed meanwhile.
+      igsioVideoFrame& frame = item->GetFrame();
+      igsioVideoFrame& targetFrame = this->SpillItem.GetFrame();
+      FrameSizeType frameSize = { 0, 0, 0 };
+      unsigned int numberOfScalarComponents(0);
+      if (this->SpillItem.DeepCopyTrackingData(item) != PLUS_SUCCESS
+          || frame.GetFrameSize(frameSize) != PLUS_SUCCESS
+          || frame.GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS
+          || targetFrame.AllocateFrame(frameSize, frame.GetVTKScalarPixelType(), numberOfScalarComponents) != PLUS_SUCCESS
+          || this->DecompressItemFrame(*item, targetFrame) != PLUS_SUCCESS)
+      {
+        LOCAL_LOG_WARNING("Failed to decompress item " << item->GetUid() << ", it is not moved to the spill file");
+      }
+      else
+      {
+        this->SpillItem.ClearCompressedFrameData();
+        targetFrame.SetImageType(frame.GetImageType());
+        targetFrame.SetImageOrientation(frame.GetImageOrientation());
+        this->SpillFile->AppendItem(this->SpillItem);
+      }
+    }
+
+    queueLock.lock();
+    this->SpillQueue.pop_front();
+    this->FreeSpillItems.push_back(item);
+    this->SpillThreadBusy = false;
+    this->ItemSpilledCondition.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetCompressFrames(bool compressFrames)
+{
+  if (this->CompressFrames == compressFrames)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->CompressFrames = compressFrames;
+  if (this->CompressFrames && this->UseFrameArena)
+  {
+    LOCAL_LOG_WARNING("The frame arena is not used while frame compression is enabled");
+  }
+  return this->AllocateMemoryForFrames();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetNumberOfUncompressedFrames(int numberOfUncompressedFrames)
+{
+  if (numberOfUncompressedFrames < 1)
+  {
+    LOCAL_LOG_ERROR("Invalid number of uncompressed frames requested: " << numberOfUncompressedFrames << ". At least the latest frame must be kept uncompressed.");
+    return PLUS_FAIL;
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->NumberOfUncompressedFrames = numberOfUncompressedFrames;
+  this->UpdateCompressedFrames();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusBuffer::GetCompressedFramesSizeBytes()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->ApplyCompressedFrames();
+  unsigned long long compressedBytes(0);
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    StreamBufferItem* item = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i);
+    if (item->IsFrameCompressed())
+    {
+      compressedBytes += item->GetCompressedFrameData().size();
+    }
+  }
+  return compressedBytes;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::ScheduleItemFrameCompression(BufferItemUidType uid)
+{
+  // the caller must have locked the buffer
+  StreamBufferItem* item = NULL;
+  if (this->StreamBuffer->GetBufferItemPointerFromUid(uid, item) != ITEM_OK)
+  {
+    // the item is not in the buffer anymore
+    return;
+  }
+
+  igsioVideoFrame& frame = item->GetFrame();
+  vtkImageData* image = frame.GetImage();
+  vtkDataArray* pixels = (image != NULL ? image->GetPointData()->GetScalars() : NULL);
+  if (item->IsFrameCompressed() || frame.IsFrameEncoded() || pixels == NULL || pixels->GetNumberOfValues() == 0)
+  {
+    return;
+  }
+
+  // The task keeps a reference to the pixel array, so the array is not reused while it is compressed.
+  // The pixels of a committed item are not modified, only replaced, so they can be read without locking the buffer.
+  vtkSmartPointer<vtkDataArray> framePixels = pixels;
+  vtkLZ4DataCompressor* compressor = this->FrameCompressor;
+  this->CompressionTasks.Submit([this, uid, framePixels, compressor]()
+  {
+    CompressedFrame compressedFrame;
+    compressedFrame.Uid = uid;
+    compressedFrame.Pixels = framePixels;
+    const size_t frameSizeBytes = static_cast<size_t>(framePixels->GetNumberOfValues()) * framePixels->GetDataTypeSize();
+    compressedFrame.Data.resize(compressor->GetMaximumCompressionSpace(frameSizeBytes));
+    const size_t compressedSizeBytes = compressor->Compress(static_cast<const unsigned char*>(framePixels->GetVoidPointer(0)), frameSizeBytes,
+                                       &compressedFrame.Data[0], compressedFrame.Data.size());
+    if (compressedSizeBytes == 0)
+    {
+      LOCAL_LOG_WARNING("Failed to compress frame of item " << uid << ", it is kept uncompressed");
+      compressedFrame.Data.clear();
+    }
+    else
+    {
+      compressedFrame.Data.resize(compressedSizeBytes);
+    }
+    std::lock_guard<std::mutex> compressedFramesGuard(this->CompressedFramesMutex);
+    this->CompressedFrames.push_back(std::move(compressedFrame));
+  });
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::ApplyCompressedFrames()
+{
+  // the caller must have locked the buffer
+  std::vector<CompressedFrame> compressedFrames;
+  {
+    std::lock_guard<std::mutex> compressedFramesGuard(this->CompressedFramesMutex);
+    compressedFrames.swap(this->CompressedFrames);
+  }
+  for (std::vector<CompressedFrame>::iterator compressedFrame = compressedFrames.begin(); compressedFrame != compressedFrames.end(); ++compressedFrame)
+  {
+    if (compressedFrame->Data.empty())
+    {
+      continue;
+    }
+    StreamBufferItem* item = NULL;
+    if (this->StreamBuffer->GetBufferItemPointerFromUid(compressedFrame->Uid, item) != ITEM_OK || item->IsFrameCompressed())
+    {
+      continue;
+    }
+    vtkImageData* image = item->GetFrame().GetImage();
+    if (image == NULL || image->GetPointData()->GetScalars() != compressedFrame->Pixels.GetPointer())
+    {
+      // the frame content was replaced since the compression started
+      continue;
+    }
+    // Release our reference first, so that the pixel array can be reused for new frames
+    compressedFrame->Pixels = NULL;
+    std::vector<unsigned char>& compressedData = compressedFrame->Data;
+    this->StreamBuffer->UpdateCommittedItem(compressedFrame->Uid, [this, &compressedData](StreamBufferItem & updatedItem)
+    {
+      this->ReleaseItemFramePixels(updatedItem);
+      updatedItem.SwapCompressedFrameData(compressedData);
+    });
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::WaitForFrameCompression()
+{
+  this->CompressionTasks.Wait();
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->ApplyCompressedFrames();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::UpdateCompressedFrames()
+{
+  // the caller must have locked the buffer
+  if (!this->CompressFrames || this->TransformOnly)
+  {
+    return;
+  }
+  const BufferItemUidType latestUid = this->StreamBuffer->GetLatestItemUidInBuffer();
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    StreamBufferItem* item = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i);
+    StreamBufferItem* bufferedItem = NULL;
+    if (this->StreamBuffer->GetBufferItemPointerFromUid(item->GetUid(), bufferedItem) != ITEM_OK || bufferedItem != item)
+    {
+      // The slot does not contain an item, it does not need pixel memory until a new item is written into it
+      if (!item->IsFrameCompressed() && !item->GetFrame().IsFrameEncoded())
+      {
+        this->ReleaseItemFramePixels(*item);
+        item->SetCompressedFrameData(NULL, 0);
+      }
+    }
+    else if (item->GetUid() + this->NumberOfUncompressedFrames <= latestUid)
+    {
+      this->ScheduleItemFrameCompression(item->GetUid());
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::DecompressItemFrame(StreamBufferItem& item, igsioVideoFrame& targetFrame)
+{
+  vtkImageData* image = targetFrame.GetImage();
+  vtkDataArray* pixels = (image != NULL ? image->GetPointData()->GetScalars() : NULL);
+  if (pixels == NULL)
+  {
+    LOCAL_LOG_ERROR("Failed to decompress frame of item " << item.GetUid() << ": output frame is not allocated");
+    return PLUS_FAIL;
+  }
+  const std::vector<unsigned char>& compressedData = item.GetCompressedFrameData();
+  if (compressedData.empty())
+  {
+    // the slot did not have frame content when it was compressed (e.g., the frame format was changed since the item was added)
+    return PLUS_SUCCESS;
+  }
+  const size_t frameSizeBytes = static_cast<size_t>(pixels->GetNumberOfValues()) * pixels->GetDataTypeSize();
+  if (this->FrameCompressor->Uncompress(&compressedData[0], compressedData.size(), static_cast<unsigned char*>(pixels->GetVoidPointer(0)), frameSizeBytes) != frameSizeBytes)
+  {
+    LOCAL_LOG_ERROR("Failed to decompress frame of item " << item.GetUid());
+    return PLUS_FAIL;
+  }
+  pixels->Modified();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::RestoreItemFrame(StreamBufferItem& item, bool decompress)
+{
+  // the caller must have locked the buffer
+  if (!item.IsFrameCompressed())
+  {
+    return PLUS_SUCCESS;
+  }
+  vtkImageData* image = item.GetFrame().GetImage();
+  if (image == NULL)
+  {
+    item.ClearCompressedFrameData();
+    return PLUS_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkDataArray> pixels;
+  if (!this->PixelArrayPool.empty())
+  {
+    pixels = this->PixelArrayPool.back();
+    this->PixelArrayPool.pop_back();
+  }
+  else
+  {
+    pixels = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(this->PixelType));
+    pixels->SetNumberOfComponents(this->NumberOfScalarComponents);
+    pixels->SetNumberOfTuples(static_cast<vtkIdType>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2]);
+    if (this->StartupCompleted)
+    {
+      this->NumberOfFrameAllocationsAfterStartup++;
+    }
+  }
+  vtkDataArray* emptyPixels = image->GetPointData()->GetScalars();
+  if (emptyPixels != NULL)
+  {
+    this->EmptyPixelArrayPool.push_back(emptyPixels);
+  }
+  image->GetPointData()->SetScalars(pixels);
+
+  PlusStatus status = PLUS_SUCCESS;
+  if (decompress)
+  {
+    status = this->DecompressItemFrame(item, item.GetFrame());
+  }
+  item.ClearCompressedFrameData();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::ReleaseItemFramePixels(StreamBufferItem& item)
+{
+  // the caller must have locked the buffer
+  vtkImageData* image = item.GetFrame().GetImage();
+  vtkDataArray* pixels = (image != NULL ? image->GetPointData()->GetScalars() : NULL);
+  if (pixels == NULL)
+  {
+    return;
+  }
+
+  // Keep enough pixel arrays for the uncompressed items, so that no memory is allocated while the buffer is filled
+  const size_t maximumNumberOfPooledArrays = static_cast<size_t>(this->NumberOfUncompressedFrames) + 1;
+  if (this->PixelArrayPool.size() < maximumNumberOfPooledArrays
+      && pixels->GetDataType() == this->PixelType
+      && pixels->GetNumberOfComponents() == static_cast<int>(this->NumberOfScalarComponents)
+      && pixels->GetNumberOfTuples() == static_cast<vtkIdType>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2])
+  {
+    this->PixelArrayPool.push_back(pixels);
+  }
+
+  // The image keeps an empty array of the same type, so that the frame format remains available
+  vtkSmartPointer<vtkDataArray> emptyPixels;
+  if (!this->EmptyPixelArrayPool.empty()
+      && this->EmptyPixelArrayPool.back()->GetDataType() == pixels->GetDataType()
+      && this->EmptyPixelArrayPool.back()->GetNumberOfComponents() == pixels->GetNumberOfComponents())
+  {
+    emptyPixels = this->EmptyPixelArrayPool.back();
+    this->EmptyPixelArrayPool.pop_back();
+  }
+  else
+  {
+    emptyPixels = vtkSmartPointer<vtkDataArray>::Take(pixels->NewInstance());
+    emptyPixels->SetNumberOfComponents(pixels->GetNumberOfComponents());
+  }
+  image->GetPointData()->SetScalars(emptyPixels);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetUseFrameArena(bool useFrameArena)
+{
+  if (this->UseFrameArena == useFrameArena)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->UseFrameArena = useFrameArena;
+  if (this->UseFrameArena && this->CompressFrames)
+  {
+    LOCAL_LOG_WARNING("The frame arena is not used while frame compression is enabled");
+  }
+  return this->AllocateMemoryForFrames();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::PrefaultFrameMemory()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (!this->TransformOnly)
+  {
+    this->FrameArena->Prefault();
+    for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+    {
+      igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+      void* pixels = GetFramePixelPointer(frame);
+      if (pixels != NULL && !this->FrameArena->Contains(pixels))
+      {
+        PlusFrameArena::PrefaultMemory(pixels, frame.GetFrameSizeInBytes());
+      }
+    }
+    if (this->CompressFrames)
+    {
+      // Pixel memory for the uncompressed items is taken from the pool, fill it now, so that the acquisition does not allocate
+      const size_t numberOfFramePixels = static_cast<size_t>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2];
+      const size_t maximumNumberOfPooledArrays = static_cast<size_t>(this->NumberOfUncompressedFrames) + 1;
+      while (numberOfFramePixels > 0 && this->PixelArrayPool.size() < maximumNumberOfPooledArrays)
+      {
+        vtkSmartPointer<vtkDataArray> pixels = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(this->PixelType));
+        pixels->SetNumberOfComponents(this->NumberOfScalarComponents);
+        pixels->SetNumberOfTuples(static_cast<vtkIdType>(numberOfFramePixels));
+        PlusFrameArena::PrefaultMemory(pixels->GetVoidPointer(0), numberOfFramePixels * this->GetNumberOfBytesPerPixel());
+        this->PixelArrayPool.push_back(pixels);
+      }
+    }
+  }
+  this->StartupCompleted = true;
+  LOCAL_LOG_DEBUG("Frame memory is prefaulted (" << (this->FrameArena->GetNumberOfSlots() > 0 ? "frame arena" : "separate frames")
+                  << (this->FrameArena->GetUsingHugePages() ? ", huge pages" : "") << ")");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusBuffer::GetNumberOfFrameAllocationsAfterStartup() const
 {
-  if (this->StreamBuffer != NULL)
-  {
-    this->StreamBuffer->Delete();
-    this->StreamBuffer = NULL;
-  }
+  return this->NumberOfFrameAllocationsAfterStartup;
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusBuffer::PrintSelf(ostream& os, vtkIndent indent)
+void vtkPlusBuffer::SetTransformOnly(bool transformOnly)
 {
-  this->Superclass::PrintSelf(os, indent);
-  os << indent << "Frame size in pixel: " << this->GetFrameSize()[0] << "   " << this->GetFrameSize()[1] << "   " << this->GetFrameSize()[2] << std::endl;
-  os << indent << "Scalar pixel type: " << vtkImageScalarTypeNameMacro(this->GetPixelType()) << std::endl;
-  os << indent << "Image type: " << igsioCommon::GetStringFromUsImageType(this->GetImageType()) << std::endl;
-  os << indent << "Image orientation: " << igsioCommon::GetStringFromUsImageOrientation(this->GetImageOrientation()) << std::endl;
-
-  os << indent << "StreamBuffer: " << this->StreamBuffer << "\n";
-  if (this->StreamBuffer)
+  if (this->TransformOnly == transformOnly)
   {
-    this->StreamBuffer->PrintSelf(os, indent.GetNextIndent());
+    // no change
+    return;
+  }
+  this->TransformOnly = transformOnly;
+  if (!this->TransformOnly)
+  {
+    this->AllocateMemoryForFrames();
   }
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusBuffer::AllocateMemoryForFrames()
+PlusStatus vtkPlusBuffer::CopyStreamBufferItem(StreamBufferItem* targetItem, StreamBufferItem* sourceItem)
 {
-  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
-  PlusStatus result = PLUS_SUCCESS;
-
-  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  if (this->TransformOnly)
+  {
+    return targetItem->DeepCopyTrackingData(sourceItem);
+  }
+  if (sourceItem->IsFrameCompressed())
   {
-    if (!this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame().IsFrameEncoded())
+    // The output item receives the decompressed frame
+    if (targetItem->DeepCopyTrackingData(sourceItem) != PLUS_SUCCESS)
     {
-      if (this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame().AllocateFrame(this->GetFrameSize(), this->GetPixelType(), this->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
-      {
-        LOCAL_LOG_ERROR("Failed to allocate memory for frame " << i);
-        result = PLUS_FAIL;
-      }
+      return PLUS_FAIL;
     }
+    targetItem->ClearCompressedFrameData();
+    igsioVideoFrame& targetFrame = targetItem->GetFrame();
+    if (targetFrame.AllocateFrame(this->GetFrameSize(), this->GetPixelType(), this->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Failed to allocate memory for the decompressed frame of item " << sourceItem->GetUid());
+      return PLUS_FAIL;
+    }
+    targetFrame.SetImageType(sourceItem->GetFrame().GetImageType());
+    targetFrame.SetImageOrientation(sourceItem->GetFrame().GetImageOrientation());
+    return this->DecompressItemFrame(*sourceItem, targetFrame);
   }
-  return result;
+  return targetItem->DeepCopy(sourceItem);
 }
 
 //----------------------------------------------------------------------------
@@ -173,6 +1078,8 @@ PlusStatus vtkPlusBuffer::SetBufferSize(int bufsize)
     return PLUS_SUCCESS;
   }
 
+  // items are moved to new slots, compressed frames of the current slots are stored first
+  this->WaitForFrameCompression();
   PlusStatus result = PLUS_SUCCESS;
   if (this->StreamBuffer->SetBufferSize(bufsize) != PLUS_SUCCESS)
   {
@@ -186,6 +1093,204 @@ PlusStatus vtkPlusBuffer::SetBufferSize(int bufsize)
   return result;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetBufferSizeSec(double bufferSizeSec)
+{
+  if (bufferSizeSec < 0)
+  {
+    LOCAL_LOG_ERROR("Invalid buffer size requested: " << bufferSizeSec << " sec");
+    return PLUS_FAIL;
+  }
+  this->BufferSizeSec = bufferSizeSec;
+  return this->UpdateBufferSizeFromLimits();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetBufferSizeMB(double bufferSizeMB)
+{
+  if (bufferSizeMB < 0)
+  {
+    LOCAL_LOG_ERROR("Invalid buffer size requested: " << bufferSizeMB << " MB");
+    return PLUS_FAIL;
+  }
+  this->BufferSizeMB = bufferSizeMB;
+  return this->UpdateBufferSizeFromLimits();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetNominalItemRate(double itemsPerSec)
+{
+  if (this->NominalItemRate == itemsPerSec)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->NominalItemRate = itemsPerSec;
+  return this->UpdateBufferSizeFromLimits();
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusBuffer::GetNumberOfBytesPerItem()
+{
+  unsigned long long bytesPerItem = sizeof(StreamBufferItem);
+  if (!this->TransformOnly)
+  {
+    bytesPerItem += static_cast<unsigned long long>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2] * this->GetNumberOfBytesPerPixel();
+  }
+  return bytesPerItem;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusBuffer::GetReservedMemoryBytes()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  unsigned long long reservedBytes = static_cast<unsigned long long>(this->StreamBuffer->GetBufferSize()) * sizeof(StreamBufferItem);
+  reservedBytes += this->FrameArena->GetReservedBytes();
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+    vtkImageData* image = frame.GetImage();
+    if (image != NULL && !this->FrameArena->Contains(GetFramePixelPointer(frame)))
+    {
+      // GetActualMemorySize returns kibibytes
+      reservedBytes += static_cast<unsigned long long>(image->GetActualMemorySize()) * 1024;
+    }
+    reservedBytes += this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetCompressedFrameData().capacity();
+  }
+  for (std::vector< vtkSmartPointer<vtkDataArray> >::iterator it = this->PixelArrayPool.begin(); it != this->PixelArrayPool.end(); ++it)
+  {
+    reservedBytes += static_cast<unsigned long long>((*it)->GetActualMemorySize()) * 1024;
+  }
+  return reservedBytes;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::UpdateBufferSizeFromLimits()
+{
+  if (this->BufferSizeSec <= 0 && this->BufferSizeMB <= 0)
+  {
+    // buffer size is specified by the number of items
+    return PLUS_SUCCESS;
+  }
+
+  // Use the item rate that is measured during acquisition, or measure it from the buffer content if enough items have been acquired already
+  double itemRate = this->NominalItemRate;
+  double stableItemRate(0);
+  {
+    igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+    stableItemRate = this->StableItemRate;
+  }
+  if (stableItemRate > 0)
+  {
+    itemRate = stableItemRate;
+  }
+  else if (this->GetNumberOfItems() >= MIN_NUMBER_OF_ITEMS_FOR_RATE_MEASUREMENT)
+  {
+    double measuredItemRate = this->GetFrameRate();
+    if (measuredItemRate > 0)
+    {
+      itemRate = measuredItemRate;
+    }
+  }
+  if (this->BufferSizeSec > 0)
+  {
+    this->BufferSizeItemRate = itemRate;
+  }
+
+  int numberOfItems = -1;
+  if (this->BufferSizeSec > 0)
+  {
+    if (itemRate > 0)
+    {
+      numberOfItems = static_cast<int>(std::min(ceil(this->BufferSizeSec * itemRate), static_cast<double>(std::numeric_limits<int>::max())));
+    }
+    else
+    {
+      LOCAL_LOG_DEBUG("Item rate is unknown, buffer size cannot be computed from duration yet");
+    }
+  }
+
+  const bool frameSizeKnown = this->TransformOnly || (this->FrameSize[0] > 0 && this->FrameSize[1] > 0 && this->FrameSize[2] > 0);
+  if (this->BufferSizeMB > 0 && frameSizeKnown)
+  {
+    const double numberOfItemsInMemoryBudget = floor(this->BufferSizeMB * 1024 * 1024 / this->GetNumberOfBytesPerItem());
+    const int memoryLimitedNumberOfItems = static_cast<int>(std::min(numberOfItemsInMemoryBudget, static_cast<double>(std::numeric_limits<int>::max())));
+    if (numberOfItems < 0 || memoryLimitedNumberOfItems < numberOfItems)
+    {
+      numberOfItems = memoryLimitedNumberOfItems;
+    }
+  }
+
+  if (numberOfItems < 0)
+  {
+    // limits cannot be resolved yet (rate or frame size is unknown), keep the current size
+    return PLUS_SUCCESS;
+  }
+  if (numberOfItems < MIN_BUFFER_SIZE_FROM_LIMITS)
+  {
+    LOCAL_LOG_WARNING("Buffer size limits (" << this->BufferSizeSec << " sec, " << this->BufferSizeMB << " MB) allow only " << numberOfItems
+                      << " items, using the minimum buffer size of " << MIN_BUFFER_SIZE_FROM_LIMITS << " items");
+    numberOfItems = MIN_BUFFER_SIZE_FROM_LIMITS;
+  }
+  if (numberOfItems == this->GetBufferSize())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  const int numberOfDiscardedItems = this->GetNumberOfItems() - numberOfItems;
+  if (numberOfDiscardedItems > 0)
+  {
+    LOCAL_LOG_WARNING("Buffer is shrunk from " << this->GetBufferSize() << " to " << numberOfItems << " items to meet the buffer size limits, the oldest "
+                      << numberOfDiscardedItems << " items are discarded");
+  }
+  PlusStatus status = this->SetBufferSize(numberOfItems);
+  LOCAL_LOG_DEBUG("Buffer size is set to " << this->GetBufferSize() << " items from limits (" << this->BufferSizeSec << " sec, " << this->BufferSizeMB << " MB, "
+                  << itemRate << " items/sec, " << this->GetNumberOfBytesPerItem() << " bytes/item)");
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::UpdateMeasuredItemRate(double itemTimestamp)
+{
+  // the caller must have locked the buffer
+  if (this->ItemRatePeriodStartTimestamp == UNDEFINED_TIMESTAMP || itemTimestamp < this->ItemRatePeriodStartTimestamp)
+  {
+    // first item after startup or after the buffer is cleared
+    this->ItemRatePeriodStartTimestamp = itemTimestamp;
+    this->NumberOfItemsInItemRatePeriod = 0;
+    return;
+  }
+  this->NumberOfItemsInItemRatePeriod++;
+  const double periodSec = itemTimestamp - this->ItemRatePeriodStartTimestamp;
+  if (periodSec < ITEM_RATE_MEASUREMENT_PERIOD_SEC || this->NumberOfItemsInItemRatePeriod < MIN_NUMBER_OF_ITEMS_FOR_RATE_MEASUREMENT)
+  {
+    return;
+  }
+
+  const double measuredItemRate = this->NumberOfItemsInItemRatePeriod / periodSec;
+  if (fabs(measuredItemRate - this->LastMeasuredItemRate) <= ITEM_RATE_TOLERANCE * measuredItemRate)
+  {
+    // the same rate is measured in two consecutive periods, so the buffer size can be computed from it
+    this->StableItemRate = measuredItemRate;
+    if (fabs(measuredItemRate - this->BufferSizeItemRate) > ITEM_RATE_TOLERANCE * measuredItemRate)
+    {
+      this->BufferSizeUpdatePending = true;
+    }
+  }
+  this->LastMeasuredItemRate = measuredItemRate;
+  this->ItemRatePeriodStartTimestamp = itemTimestamp;
+  this->NumberOfItemsInItemRatePeriod = 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::ApplyPendingBufferSizeUpdate()
+{
+  if (this->BufferSizeUpdatePending.exchange(false))
+  {
+    this->UpdateBufferSizeFromLimits();
+  }
+}
+
 //----------------------------------------------------------------------------
 bool vtkPlusBuffer::CheckFrameFormat(const FrameSizeType& frameSizeInPx, igsioCommon::VTKScalarPixelType pixelType, US_IMAGE_TYPE imgType, int numberOfScalarComponents)
 {
@@ -325,6 +1430,7 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
   {
     return PLUS_SUCCESS;
   }
+  this->ApplyPendingBufferSizeUpdate();
 
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
@@ -365,6 +1471,7 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
   if (newObjectInBuffer == NULL)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to data buffer object from the tracker buffer for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
     return PLUS_FAIL;
   }
 
@@ -380,6 +1487,8 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
     std::string name(it->first);
   }
 
+  this->PublishNewItem(itemUid, bufferIndex);
+
   return PLUS_SUCCESS;
 }
 
@@ -399,6 +1508,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
                                   const igsioFieldMapType* customFields /*= NULL */,
                                   vtkStreamingVolumeFrame* encodedFrame /*=NULL*/)
 {
+  this->ApplyPendingBufferSizeUpdate();
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
@@ -476,6 +1586,13 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
   if (newObjectInBuffer == NULL)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to video buffer object from the video buffer for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
+    return PLUS_FAIL;
+  }
+  if (this->RestoreItemFrame(*newObjectInBuffer, false) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to allocate memory for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
     return PLUS_FAIL;
   }
 
@@ -491,6 +1608,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
                     outputFrameSizeInPx[0] << "x" << outputFrameSizeInPx[1] << "x" << outputFrameSizeInPx[2] <<
                     ",   buffer: " <<
                     receivedFrameSize[0] << "x" << receivedFrameSize[1] << "x" << receivedFrameSize[2] << ")!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
     return PLUS_FAIL;
   }
 
@@ -503,6 +1621,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
     if (igsioVideoFrame::GetOrientedClippedImage(byteImageDataPtr, flipInfo, imageType, pixelType, numberOfScalarComponents, inputFrameSizeInPx, newObjectInBuffer->GetFrame(), clipRectangleOrigin, clipRectangleSize) != PLUS_SUCCESS)
     {
       LOCAL_LOG_ERROR("Failed to convert input US image to the requested orientation!");
+      this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
       return PLUS_FAIL;
     }
   }
@@ -531,12 +1650,15 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
     }
   }
 
+  this->PublishNewItem(itemUid, bufferIndex);
+
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frameSize, unsigned int inputFrameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
+  this->ApplyPendingBufferSizeUpdate();
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
@@ -589,6 +1711,13 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
   if (newObjectInBuffer == NULL)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to video buffer object from the video buffer for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
+    return PLUS_FAIL;
+  }
+  if (this->RestoreItemFrame(*newObjectInBuffer, false) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to allocate memory for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
     return PLUS_FAIL;
   }
 
@@ -596,6 +1725,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
   if (bufferFrameSizeBytes < inputFrameSizeInBytes)
   {
     LOCAL_LOG_ERROR("Input frame size is larger than buffer frame size (input: " << inputFrameSizeInBytes << ",   buffer: " << bufferFrameSizeBytes << ")!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
     return PLUS_FAIL;
   }
 
@@ -606,48 +1736,186 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
   newObjectInBuffer->GetFrame().SetImageType(imageType);
   memcpy(newObjectInBuffer->GetFrame().GetImage()->GetScalarPointer(), imageDataPtr, inputFrameSizeInBytes);
 
-  // Add custom fields
-  if (customFields != NULL)
+  // Add custom fields
+  if (customFields != NULL)
+  {
+    for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
+    {
+      newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
+      std::string name(it->first);
+      if (name.find("Transform") != std::string::npos)
+      {
+        newObjectInBuffer->SetValidTransformData(true);
+      }
+    }
+  }
+
+  newObjectInBuffer->SetFrameField("FrameSizeInBytes", igsioCommon::ToString<unsigned int>(inputFrameSizeInBytes));
+
+  this->PublishNewItem(itemUid, bufferIndex);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+{
+  if (matrix == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add NULL matrix to tracker buffer!");
+    return PLUS_FAIL;
+  }
+  this->ApplyPendingBufferSizeUpdate();
+  if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+  if (filteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    bool filteredTimestampProbablyValid = true;
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_DEBUG("Failed to create filtered timestamp for tracker buffer item with item index: " << frameNumber);
+      return PLUS_FAIL;
+    }
+    if (!filteredTimestampProbablyValid)
+    {
+      LOG_INFO("Filtered timestamp is probably invalid for tracker buffer item with item index=" << frameNumber << ", time=" << unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      return PLUS_SUCCESS;
+    }
+  }
+  else
+  {
+    this->StreamBuffer->AddToTimeStampReport(frameNumber, unfilteredTimestamp, filteredTimestamp);
+  }
+
+  int bufferIndex(0);
+  BufferItemUidType itemUid;
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
+  {
+    // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
+    LOCAL_LOG_DEBUG("vtkPlusBuffer: Failed to prepare for adding new frame to tracker buffer!");
+    return PLUS_FAIL;
+  }
+
+  // get the pointer to the correct location in the tracker buffer, where this data needs to be copied
+  StreamBufferItem* newObjectInBuffer = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+  if (newObjectInBuffer == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to data buffer object from the tracker buffer for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
+    return PLUS_FAIL;
+  }
+
+  PlusStatus itemStatus = newObjectInBuffer->SetMatrix(matrix);
+  newObjectInBuffer->SetStatus(status);
+  newObjectInBuffer->SetFilteredTimestamp(filteredTimestamp);
+  newObjectInBuffer->SetUnfilteredTimestamp(unfilteredTimestamp);
+  newObjectInBuffer->SetIndex(frameNumber);
+  newObjectInBuffer->SetUid(itemUid);
+
+  // Add custom fields
+  if (customFields != NULL)
+  {
+    for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
+    {
+      newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
+      std::string name(it->first);
+      if (name.find("Transform") != std::string::npos)
+      {
+        newObjectInBuffer->SetValidTransformData(true);
+      }
+    }
+  }
+
+  this->PublishNewItem(itemUid, bufferIndex);
+
+  return itemStatus;
+}
+
+//----------------------------------------------------------------------------
+igsioVideoFrame* vtkPlusBuffer::ReserveItem()
+{
+  this->ApplyPendingBufferSizeUpdate();
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  int bufferIndex(0);
+  if (this->StreamBuffer->ReserveNewItem(bufferIndex) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to reserve new item in the buffer!");
+    return NULL;
+  }
+
+  StreamBufferItem* reservedObjectInBuffer = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+  if (reservedObjectInBuffer == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to the reserved buffer object!");
+    this->StreamBuffer->ReleaseReservedItem();
+    return NULL;
+  }
+  // The removed item can be restored by CancelItem only if its frame is not decompressed or reallocated here
+  this->ReservedItemRestorable = !reservedObjectInBuffer->IsFrameCompressed();
+  if (this->RestoreItemFrame(*reservedObjectInBuffer, false) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to allocate memory for the reserved frame!");
+    this->StreamBuffer->ReleaseReservedItem();
+    return NULL;
+  }
+
+  igsioVideoFrame& reservedFrame = reservedObjectInBuffer->GetFrame();
+  if (reservedFrame.IsFrameEncoded())
   {
-    for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot reserve an item in a buffer of encoded frames!");
+    this->StreamBuffer->ReleaseReservedItem();
+    return NULL;
+  }
+
+  // The slot may have been used for an item without image data, make sure that it is allocated with the buffer frame format
+  if (!reservedFrame.IsImageValid() || !this->HasBufferFrameFormat(reservedFrame))
+  {
+    this->ReservedItemRestorable = false;
+    if (this->AllocateFrame(reservedFrame, bufferIndex) != PLUS_SUCCESS)
     {
-      newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
-      std::string name(it->first);
-      if (name.find("Transform") != std::string::npos)
-      {
-        newObjectInBuffer->SetValidTransformData(true);
-      }
+      LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to allocate memory for the reserved frame!");
+      this->StreamBuffer->ReleaseReservedItem();
+      return NULL;
     }
   }
+  reservedFrame.SetImageType(this->ImageType);
+  reservedFrame.SetImageOrientation(this->ImageOrientation);
 
-  newObjectInBuffer->SetFrameField("FrameSizeInBytes", igsioCommon::ToString<unsigned int>(inputFrameSizeInBytes));
-
-  return PLUS_SUCCESS;
+  return &reservedFrame;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+PlusStatus vtkPlusBuffer::CommitItem(long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  if (matrix == NULL)
+  if (!this->StreamBuffer->GetItemReserved())
   {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add NULL matrix to tracker buffer!");
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to commit item, no item has been reserved!");
     return PLUS_FAIL;
   }
+
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
   }
+
   if (filteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     bool filteredTimestampProbablyValid = true;
     if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
     {
-      LOCAL_LOG_DEBUG("Failed to create filtered timestamp for tracker buffer item with item index: " << frameNumber);
+      LOCAL_LOG_WARNING("Failed to create filtered timestamp for video buffer item with item index: " << frameNumber);
+      this->CancelItem(true);
       return PLUS_FAIL;
     }
     if (!filteredTimestampProbablyValid)
     {
-      LOG_INFO("Filtered timestamp is probably invalid for tracker buffer item with item index=" << frameNumber << ", time=" << unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      LOG_INFO("Filtered timestamp is probably invalid for video buffer item with item index=" << frameNumber << ", time=" <<
+               unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      this->CancelItem(true);
       return PLUS_SUCCESS;
     }
   }
@@ -658,25 +1926,24 @@ PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus st
 
   int bufferIndex(0);
   BufferItemUidType itemUid;
-
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->StreamBuffer->ReleaseReservedItem();
   if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
   {
     // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
-    LOCAL_LOG_DEBUG("vtkPlusBuffer: Failed to prepare for adding new frame to tracker buffer!");
+    LOCAL_LOG_DEBUG("vtkPlusBuffer: Failed to prepare for adding new frame to video buffer!");
     return PLUS_FAIL;
   }
 
-  // get the pointer to the correct location in the tracker buffer, where this data needs to be copied
+  // the reserved frame is already filled, only the item properties have to be set
   StreamBufferItem* newObjectInBuffer = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
   if (newObjectInBuffer == NULL)
   {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to data buffer object from the tracker buffer for the new frame!");
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to video buffer object from the video buffer for the new frame!");
+    this->StreamBuffer->CancelNewItem(itemUid, bufferIndex);
     return PLUS_FAIL;
   }
 
-  PlusStatus itemStatus = newObjectInBuffer->SetMatrix(matrix);
-  newObjectInBuffer->SetStatus(status);
   newObjectInBuffer->SetFilteredTimestamp(filteredTimestamp);
   newObjectInBuffer->SetUnfilteredTimestamp(unfilteredTimestamp);
   newObjectInBuffer->SetIndex(frameNumber);
@@ -696,7 +1963,119 @@ PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus st
     }
   }
 
-  return itemStatus;
+  this->PublishNewItem(itemUid, bufferIndex);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::CancelItem(bool frameModified /*=false*/)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  // If the frame has been written then the pixels of the removed item are lost, it remains removed
+  this->StreamBuffer->ReleaseReservedItem(!frameModified && this->ReservedItemRestorable);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::AddNewItemNotifier(PlusNewItemNotifier* notifier)
+{
+  if (notifier == NULL)
+  {
+    return;
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (std::find(this->NewItemNotifiers.begin(), this->NewItemNotifiers.end(), notifier) == this->NewItemNotifiers.end())
+  {
+    this->NewItemNotifiers.push_back(notifier);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::RemoveNewItemNotifier(PlusNewItemNotifier* notifier)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->NewItemNotifiers.erase(std::remove(this->NewItemNotifiers.begin(), this->NewItemNotifiers.end(), notifier), this->NewItemNotifiers.end());
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::PublishNewItem(BufferItemUidType uid, int bufferIndex)
+{
+  // the caller must have locked the buffer
+  this->StreamBuffer->CommitNewItem(uid, bufferIndex);
+  if (this->CompressFrames)
+  {
+    // frames that were compressed in the background since the previous item
+    this->ApplyCompressedFrames();
+  }
+  if (PlusLatencyTracer::IsEnabled())
+  {
+    // Frames are identified by the timestamp that consumers of the buffer see
+    StreamBufferItem* newItem = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+    if (newItem != NULL)
+    {
+      double localTimeOffsetSec = this->StreamBuffer->GetLocalTimeOffsetSec();
+      double frameTimestamp = newItem->GetFilteredTimestamp(localTimeOffsetSec);
+      PlusLatencyTracer* tracer = PlusLatencyTracer::GetInstance();
+      // time of the commit, measured from the unfiltered timestamp, so that timestamp filtering does not hide the acquisition latency
+      tracer->Record(PlusLatencyTracer::STAGE_DEVICE_TIMESTAMP, newItem->GetUnfilteredTimestamp(localTimeOffsetSec));
+      tracer->Record(PlusLatencyTracer::STAGE_BUFFER_ADD_ITEM, frameTimestamp);
+    }
+  }
+  if (this->BufferSizeSec > 0)
+  {
+    StreamBufferItem* newItem = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+    if (newItem != NULL)
+    {
+      this->UpdateMeasuredItemRate(newItem->GetFilteredTimestamp(0));
+    }
+  }
+  this->UpdateMetrics();
+  for (std::vector<PlusNewItemNotifier*>::iterator it = this->NewItemNotifiers.begin(); it != this->NewItemNotifiers.end(); ++it)
+  {
+    (*it)->Notify();
+  }
+  if (this->CompressFrames && !this->TransformOnly && uid > static_cast<BufferItemUidType>(this->NumberOfUncompressedFrames))
+  {
+    // the item that has just become older than the uncompressed items
+    this->ScheduleItemFrameCompression(uid - this->NumberOfUncompressedFrames);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::UpdateMetrics()
+{
+  // the caller must have locked the buffer
+  if (this->MetricsDeviceId.empty() && this->MetricsSourceId.empty())
+  {
+    // temporary buffers are not owned by a data source, they would collide with each other in the registry
+    return;
+  }
+  if (this->ItemsAddedMetric == NULL)
+  {
+    PlusMetric::LabelMapType labels;
+    labels["device"] = this->MetricsDeviceId;
+    labels["source"] = this->MetricsSourceId;
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    this->ItemsAddedMetric = registry->GetMetric("plus_buffer_items_total", "Number of items added to the buffer", PlusMetric::METRIC_COUNTER, labels);
+    this->FillLevelMetric = registry->GetMetric("plus_buffer_fill_ratio", "Number of items in the buffer divided by the buffer size", PlusMetric::METRIC_GAUGE, labels);
+    this->OverwrittenItemsMetric = registry->GetMetric("plus_buffer_overwritten_items_total", "Number of items that were overwritten because the buffer was full", PlusMetric::METRIC_COUNTER, labels);
+    this->RejectedItemsMetric = registry->GetMetric("plus_buffer_dropped_items_total", "Number of items that were not added because their timestamp was not newer than the latest item", PlusMetric::METRIC_COUNTER, labels);
+    this->AcquisitionRateMetric = registry->GetMetric("plus_buffer_acquisition_rate_hz", "Number of items added to the buffer per second", PlusMetric::METRIC_GAUGE, labels);
+    this->AcquisitionRateMeter.SetGauge(this->AcquisitionRateMetric);
+    this->ReservedMemoryMetric = registry->GetMetric("plus_buffer_reserved_memory_bytes", "Number of bytes reserved by the buffer items and their frames", PlusMetric::METRIC_GAUGE, labels);
+  }
+  this->ItemsAddedMetric->Add(1);
+  int bufferSize = this->StreamBuffer->GetBufferSize();
+  this->FillLevelMetric->Set(bufferSize > 0 ? static_cast<double>(this->StreamBuffer->GetNumberOfItems()) / bufferSize : 0.0);
+  this->OverwrittenItemsMetric->Set(static_cast<double>(this->StreamBuffer->GetNumberOfOverwrittenItems()));
+  this->RejectedItemsMetric->Set(static_cast<double>(this->StreamBuffer->GetNumberOfRejectedItems()));
+  const double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->AcquisitionRateMeter.Add(1, currentTime);
+  if (currentTime - this->ReservedMemoryMetricUpdateTime >= RESERVED_MEMORY_METRIC_UPDATE_PERIOD_SEC)
+  {
+    this->ReservedMemoryMetric->Set(static_cast<double>(this->GetReservedMemoryBytes()));
+    this->ReservedMemoryMetricUpdateTime = currentTime;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -769,17 +2148,32 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBuffe
     return ITEM_UNKNOWN_ERROR;
   }
 
-  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
-
+  // In lock-free mode the buffer is not locked, only the slot is pinned while the item is copied
   StreamBufferItem* dataItem = NULL;
-  ItemStatus itemStatus = this->StreamBuffer->GetBufferItemPointerFromUid(uid, dataItem);
+  ItemStatus itemStatus = this->StreamBuffer->AcquireItemForReading(uid, dataItem);
+  if (itemStatus == ITEM_NOT_AVAILABLE_ANYMORE && this->SpillFile->IsOpen())
+  {
+    // The item may have been moved to the spill file already. Items are moved from the queue to the file,
+    // so the queue is checked first to not miss an item that is written to the file meanwhile.
+    itemStatus = this->GetQueuedSpillItem(uid, bufferItem);
+    if (itemStatus != ITEM_OK)
+    {
+      itemStatus = this->SpillFile->GetItem(uid, bufferItem);
+    }
+    if (itemStatus == ITEM_OK)
+    {
+      return ITEM_OK;
+    }
+  }
   if (itemStatus != ITEM_OK)
   {
     LOCAL_LOG_WARNING("Failed to retrieve data item");
     return itemStatus;
   }
 
-  if (bufferItem->DeepCopy(dataItem) != PLUS_SUCCESS)
+  PlusStatus copyStatus = this->CopyStreamBufferItem(bufferItem, dataItem);
+  this->StreamBuffer->ReleaseItemForReading(uid);
+  if (copyStatus != PLUS_SUCCESS)
   {
     LOCAL_LOG_WARNING("Failed to copy data item");
     return ITEM_UNKNOWN_ERROR;
@@ -793,22 +2187,41 @@ void vtkPlusBuffer::DeepCopy(vtkPlusBuffer* buffer)
 {
   LOG_TRACE("vtkPlusBuffer::DeepCopy");
 
-  this->StreamBuffer->DeepCopy(buffer->StreamBuffer);
+  // pending background compressions refer to the items of the buffers
+  this->WaitForFrameCompression();
+  buffer->WaitForFrameCompression();
+
+  this->SetTransformOnly(buffer->GetTransformOnly());
+  // compressed items are copied as they are, so the copy must use the same compression settings
+  this->CompressFrames = buffer->GetCompressFrames();
+  this->NumberOfUncompressedFrames = buffer->GetNumberOfUncompressedFrames();
+  // The frame format is set without allocating the frames: the copied items already have this format
+  // and their frames are allocated once after the copy, so the content of compressed items is kept
   if (buffer->GetFrameSize()[0] != -1 && buffer->GetFrameSize()[1] != -1 && buffer->GetFrameSize()[2] != -1)
   {
-    this->SetFrameSize(buffer->GetFrameSize());
+    this->SetFrameSize(buffer->GetFrameSize(), false);
   }
-  this->SetPixelType(buffer->GetPixelType());
+  this->PixelType = buffer->GetPixelType();
+  this->NumberOfScalarComponents = buffer->GetNumberOfScalarComponents();
   this->SetImageType(buffer->GetImageType());
-  this->SetNumberOfScalarComponents(buffer->GetNumberOfScalarComponents());
+  this->StreamBuffer->DeepCopy(buffer->StreamBuffer);
   this->SetImageOrientation(buffer->GetImageOrientation());
-  this->SetBufferSize(buffer->GetBufferSize());
+  this->AllocateMemoryForFrames();
+  // the source buffer size is already resolved from the limits, so only store them for later frame format or rate changes
+  this->BufferSizeSec = buffer->GetBufferSizeSec();
+  this->BufferSizeMB = buffer->GetBufferSizeMB();
+  this->NominalItemRate = buffer->GetNominalItemRate();
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::Clear()
 {
+  this->WaitForFrameCompression();
   this->StreamBuffer->Clear();
+  this->DiscardQueuedSpillItems();
+  this->SpillFile->Clear();
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->ItemRatePeriodStartTimestamp = UNDEFINED_TIMESTAMP;
 }
 
 //----------------------------------------------------------------------------
@@ -829,6 +2242,8 @@ PlusStatus vtkPlusBuffer::SetFrameSize(unsigned int x, unsigned int y, unsigned
   this->FrameSize[2] = z;
   if (allocateFrames)
   {
+    // the number of items that fit into the memory budget depends on the frame size
+    this->UpdateBufferSizeFromLimits();
     return AllocateMemoryForFrames();
   }
   return PLUS_SUCCESS;
@@ -849,6 +2264,7 @@ PlusStatus vtkPlusBuffer::SetPixelType(igsioCommon::VTKScalarPixelType pixelType
     return PLUS_SUCCESS;
   }
   this->PixelType = pixelType;
+  this->UpdateBufferSizeFromLimits();
   return AllocateMemoryForFrames();
 }
 
@@ -861,6 +2277,7 @@ PlusStatus vtkPlusBuffer::SetNumberOfScalarComponents(unsigned int numberOfScala
     return PLUS_SUCCESS;
   }
   this->NumberOfScalarComponents = numberOfScalarComponents;
+  this->UpdateBufferSizeFromLimits();
   return AllocateMemoryForFrames();
 }
 
@@ -1152,12 +2569,93 @@ bool vtkPlusBuffer::GetTimeStampReporting()
   return this->StreamBuffer->GetTimeStampReporting();
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::SetLockFreeReads(bool enable)
+{
+  this->StreamBuffer->SetLockFreeReads(enable);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusBuffer::GetLockFreeReads()
+{
+  return this->StreamBuffer->GetLockFreeReads();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::SetMetricsOwner(const std::string& deviceId, const std::string& sourceId)
+{
+  igsioLockGuard<StreamItemCircularBuffer> bufferGuardedLock(this->StreamBuffer);
+  if (this->MetricsDeviceId == deviceId && this->MetricsSourceId == sourceId)
+  {
+    return;
+  }
+  this->MetricsDeviceId = deviceId;
+  this->MetricsSourceId = sourceId;
+  // the metrics of the new owner are requested when the next item is added
+  this->ItemsAddedMetric = NULL;
+  this->FillLevelMetric = NULL;
+  this->OverwrittenItemsMetric = NULL;
+  this->RejectedItemsMetric = NULL;
+  this->AcquisitionRateMetric = NULL;
+  this->AcquisitionRateMeter.SetGauge(NULL);
+}
+
 //----------------------------------------------------------------------------
 // Returns the two buffer items that are closest previous and next buffer items relative to the specified time.
 // itemA is the closest item
 PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB)
 {
-  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  PoseSample sampleA;
+  PoseSample sampleB;
+  if (this->GetPrevNextPoseSamplesFromTime(time, sampleA, sampleB) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->GetStreamBufferItem(sampleA.Uid, &itemA) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << sampleA.Uid);
+    return PLUS_FAIL;
+  }
+  if (sampleB.Uid == sampleA.Uid)
+  {
+    this->CopyStreamBufferItem(&itemB, &itemA);
+    return PLUS_SUCCESS;
+  }
+  if (this->GetStreamBufferItem(sampleB.Uid, &itemB) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << sampleB.Uid);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetPoseSample(BufferItemUidType uid, PoseSample& sample, igsioFieldMapType* frameFields/*=NULL*/)
+{
+  // Only the tracking data is copied, while the slot is pinned
+  StreamBufferItem* dataItem = NULL;
+  ItemStatus itemStatus = this->StreamBuffer->AcquireItemForReading(uid, dataItem);
+  if (itemStatus != ITEM_OK)
+  {
+    return itemStatus;
+  }
+  sample.Uid = uid;
+  sample.Timestamp = dataItem->GetFilteredTimestamp(this->StreamBuffer->GetLocalTimeOffsetSec());
+  sample.UnfilteredTimestamp = dataItem->GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
+  sample.Status = dataItem->GetStatus();
+  std::copy(dataItem->GetMatrixElements(), dataItem->GetMatrixElements() + 16, sample.Matrix);
+  if (frameFields != NULL)
+  {
+    *frameFields = dataItem->GetFrameFieldMap();
+  }
+  this->StreamBuffer->ReleaseItemForReading(uid);
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::GetPrevNextPoseSamplesFromTime(double time, PoseSample& sampleA, PoseSample& sampleB, igsioFieldMapType* frameFieldsA/*=NULL*/)
+{
+  StreamItemCircularBuffer::ReadGuard dataBufferGuardedLock(this->StreamBuffer);
 
   // The returned item is computed by interpolation between itemA and itemB in time. The itemA is the closest item to the requested time.
   // Accept itemA (the closest item) as is if it is very close to the requested time.
@@ -1184,7 +2682,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
     }
     return PLUS_FAIL;
   }
-  status = this->GetStreamBufferItem(itemAuid, &itemA);
+  status = this->GetPoseSample(itemAuid, sampleA, frameFieldsA);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemAuid);
@@ -1192,26 +2690,20 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   }
 
   // If tracker is out of view, etc. then we don't have a valid before and after the requested time, so we cannot do interpolation
-  if (itemA.GetStatus() != TOOL_OK)
+  if (sampleA.Status != TOOL_OK)
   {
     // tracker is out of view, ...
     LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot do data interpolation. The closest item to the requested time (time: " << std::fixed << time << ", uid: " << itemAuid << ") is invalid.");
     return PLUS_FAIL;
   }
 
-  double itemAtime(0);
-  status = this->StreamBuffer->GetTimeStamp(itemAuid, itemAtime);
-  if (status != ITEM_OK)
-  {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemAuid << ")");
-    return PLUS_FAIL;
-  }
+  double itemAtime = sampleA.Timestamp;
 
   // If the time difference is negligible then don't interpolate, just return the closest item
   if (fabs(itemAtime - time) < NEGLIGIBLE_TIME_DIFFERENCE)
   {
     //No need for interpolation, it's very close to the closest element
-    itemB.DeepCopy(&itemA);
+    sampleB = sampleA;
     return PLUS_SUCCESS;
   }
 
@@ -1240,29 +2732,22 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
     LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot perform interpolation, itemB is not available " << std::fixed << " ( itemBuid: " << itemBuid << ", oldest UID: " << this->GetOldestItemUidInBuffer() << ", latest UID: " << this->GetLatestItemUidInBuffer());
     return PLUS_FAIL;
   }
-  // Get item B details
-  double itemBtime(0);
-  status = this->StreamBuffer->GetTimeStamp(itemBuid, itemBtime);
+  // Get the item
+  status = this->GetPoseSample(itemBuid, sampleB);
   if (status != ITEM_OK)
   {
-    LOCAL_LOG_ERROR("Cannot do interpolation: Failed to get data buffer timestamp with Uid: " << itemBuid);
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemBuid);
     return PLUS_FAIL;
   }
   // If the next closest item is too far, then we don't do interpolation
+  double itemBtime = sampleB.Timestamp;
   if (fabs(itemBtime - time) > this->GetMaxAllowedTimeDifference())
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot perform interpolation, time difference compared to itemB is too big " << std::fixed << fabs(itemBtime - time) << " ( itemBtime: " << itemBtime << ", requested time: " << time << ").");
     return PLUS_FAIL;
   }
-  // Get the item
-  status = this->GetStreamBufferItem(itemBuid, &itemB);
-  if (status != ITEM_OK)
-  {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemBuid);
-    return PLUS_FAIL;
-  }
   // If there is no valid element on the other side of the requested time, then we cannot do an interpolation
-  if (itemB.GetStatus() != TOOL_OK)
+  if (sampleB.Status != TOOL_OK)
   {
     LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot get a second element (uid=" << itemBuid << ") on the other side of the requested time (" << std::fixed << time << ")");
     return PLUS_FAIL;
@@ -1274,6 +2759,16 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation)
 {
+  if (this->SpillFile->IsOpen())
+  {
+    double oldestTimestamp(0);
+    if (this->GetOldestTimeStamp(oldestTimestamp) == ITEM_OK && time < oldestTimestamp)
+    {
+      // The requested item has been removed from the buffer already
+      return this->GetSpilledStreamBufferItemFromTime(time, bufferItem, interpolation);
+    }
+  }
+
   switch (interpolation)
   {
     case EXACT_TIME:
@@ -1291,15 +2786,50 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromTime(double time, StreamBufferI
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
 {
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
   StreamBufferItem* item;
-  auto itemStatus = this->StreamBuffer->GetBufferItemPointerFromUid(uid, item);
+  int bufferIndex(0);
+  auto itemStatus = this->StreamBuffer->ReopenItemForWriting(uid, item, bufferIndex);
   if (itemStatus == ITEM_OK)
   {
     item->SetFrameField(key, value);
+    this->StreamBuffer->CommitNewItem(uid, bufferIndex);
   }
   return itemStatus == ITEM_OK ? PLUS_SUCCESS : PLUS_FAIL;
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetSpilledStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation)
+{
+  const double localTimeOffsetSec = this->StreamBuffer->GetLocalTimeOffsetSec();
+  ItemStatus status = this->SpillFile->GetItemFromClosestTime(time - localTimeOffsetSec, bufferItem);
+  if (status != ITEM_OK)
+  {
+    LOCAL_LOG_WARNING("vtkPlusBuffer: Cannot get any item from the buffer or the spill file for time: " << std::fixed << time << ". Item is not available anymore.");
+    return status;
+  }
+
+  // The requested time may be between the latest spilled item and the oldest item in the buffer
+  double itemTime = bufferItem->GetFilteredTimestamp(localTimeOffsetSec);
+  double oldestTimestamp(0);
+  if (time > itemTime && this->GetOldestTimeStamp(oldestTimestamp) == ITEM_OK && oldestTimestamp - time < time - itemTime)
+  {
+    status = this->GetStreamBufferItem(this->GetOldestItemUidInBuffer(), bufferItem);
+    if (status != ITEM_OK)
+    {
+      return status;
+    }
+    itemTime = oldestTimestamp;
+  }
+
+  if (interpolation == EXACT_TIME && fabs(itemTime - time) > NEGLIGIBLE_TIME_DIFFERENCE)
+  {
+    LOCAL_LOG_WARNING("vtkPlusBuffer: Cannot find an item exactly at the requested time (requested time: " << std::fixed << time << ", item time: " << itemTime << ")");
+    return ITEM_UNKNOWN_ERROR;
+  }
+  return ITEM_OK;
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetStreamBufferItemFromExactTime(double time, StreamBufferItem* bufferItem)
 {
@@ -1324,7 +2854,7 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromExactTime(double time, StreamBu
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem)
 {
-  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  StreamItemCircularBuffer::ReadGuard dataBufferGuardedLock(this->StreamBuffer);
 
   BufferItemUidType itemUid(0);
   ItemStatus status = this->StreamBuffer->GetItemUidFromTime(time, itemUid);
@@ -1362,10 +2892,10 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, Stream
 // The flags correspond to the closest element.
 ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem)
 {
-  StreamBufferItem itemA;
-  StreamBufferItem itemB;
+  PoseSample sampleA;
+  PoseSample sampleB;
 
-  if (GetPrevNextBufferItemFromTime(time, itemA, itemB) != PLUS_SUCCESS)
+  if (GetPrevNextPoseSamplesFromTime(time, sampleA, sampleB) != PLUS_SUCCESS)
   {
     // cannot get two neighbors, so cannot do interpolation
     // it may be normal (e.g., when tracker out of view), so don't return with an error
@@ -1382,122 +2912,194 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
     return ITEM_OK;
   }
 
-  if (itemA.GetUid() == itemB.GetUid())
+  // The rest of the item (frame fields, etc.) is taken from the closest element
+  ItemStatus status = this->GetStreamBufferItem(sampleA.Uid, bufferItem);
+  if (status != ITEM_OK)
   {
-    // exact match, no need for interpolation
-    bufferItem->DeepCopy(&itemA);
-    return ITEM_OK;
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << sampleA.Uid);
+    return status;
   }
 
-  //============== Get item weights ==================
-
-  double itemAtime(0);
-  if (this->StreamBuffer->GetTimeStamp(itemA.GetUid(), itemAtime) != ITEM_OK)
+  if (sampleA.Uid == sampleB.Uid)
   {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemA.GetUid() << ")");
-    return ITEM_UNKNOWN_ERROR;
+    // exact match, no need for interpolation
+    return ITEM_OK;
   }
 
-  double itemBtime(0);
-  if (this->StreamBuffer->GetTimeStamp(itemB.GetUid(), itemBtime) != ITEM_OK)
-  {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemB.GetUid() << ")");
-    return ITEM_UNKNOWN_ERROR;
-  }
+  //============== Get item weights ==================
 
-  if (fabs(itemAtime - itemBtime) < NEGLIGIBLE_TIME_DIFFERENCE)
+  double itemBweight(0);
+  if (!ComputeInterpolationWeight(sampleA, sampleB, time, itemBweight))
   {
     // exact time match, no need for interpolation
-    bufferItem->DeepCopy(&itemA);
     bufferItem->SetFilteredTimestamp(time);
     bufferItem->SetUnfilteredTimestamp(time);
     return ITEM_OK;
   }
+  double itemAweight = 1 - itemBweight;
 
-  double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
-  double itemBweight = 1 - itemAweight;
-
-  //============== Get transform matrices ==================
-
-  vtkSmartPointer<vtkMatrix4x4> itemAmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemA.GetMatrix(itemAmatrix) != PLUS_SUCCESS)
-  {
-    LOCAL_LOG_ERROR("Failed to get item A matrix");
-    return ITEM_UNKNOWN_ERROR;
-  }
-  double matrixA[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzA[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
-  {
-    matrixA[i][0] = itemAmatrix->GetElement(i, 0);
-    matrixA[i][1] = itemAmatrix->GetElement(i, 1);
-    matrixA[i][2] = itemAmatrix->GetElement(i, 2);
-    xyzA[i] = itemAmatrix->GetElement(i, 3);
-  }
-
-  vtkSmartPointer<vtkMatrix4x4> itemBmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemB.GetMatrix(itemBmatrix) != PLUS_SUCCESS)
-  {
-    LOCAL_LOG_ERROR("Failed to get item B matrix");
-    return ITEM_UNKNOWN_ERROR;
-  }
-  double matrixB[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzB[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
-  {
-    matrixB[i][0] = itemBmatrix->GetElement(i, 0);
-    matrixB[i][1] = itemBmatrix->GetElement(i, 1);
-    matrixB[i][2] = itemBmatrix->GetElement(i, 2);
-    xyzB[i] = itemBmatrix->GetElement(i, 3);
-  }
-
-  //============== Interpolate rotation ==================
-
-  double matrixAquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
-  double matrixBquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
-  double interpolatedRotationQuat[4] = {0, 0, 0, 0};
-  igsioMath::Slerp(interpolatedRotationQuat, itemBweight, matrixAquat, matrixBquat);
-  double interpolatedRotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
-
-  vtkSmartPointer<vtkMatrix4x4> interpolatedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  for (int i = 0; i < 3; i++)
-  {
-    interpolatedMatrix->Element[i][0] = interpolatedRotation[i][0];
-    interpolatedMatrix->Element[i][1] = interpolatedRotation[i][1];
-    interpolatedMatrix->Element[i][2] = interpolatedRotation[i][2];
-    interpolatedMatrix->Element[i][3] = xyzA[i] * itemAweight + xyzB[i] * itemBweight;
-  }
+  //============== Interpolate pose and time ==================
 
-  //============== Interpolate time ==================
+  double interpolatedMatrix[16] = {0};
+  double orientationDifferenceDeg(0);
+  InterpolatePoses(&sampleA, &sampleB, &itemBweight, 1, interpolatedMatrix, &orientationDifferenceDeg);
 
-  double itemAunfilteredTimestamp = itemA.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
-  double itemBunfilteredTimestamp = itemB.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
-  double interpolatedUnfilteredTimestamp = itemAunfilteredTimestamp * itemAweight + itemBunfilteredTimestamp * itemBweight;
+  double interpolatedUnfilteredTimestamp = sampleA.UnfilteredTimestamp * itemAweight + sampleB.UnfilteredTimestamp * itemBweight;
 
   //============== Write interpolated results into the bufferItem ==================
 
-  bufferItem->DeepCopy(&itemA);
-  bufferItem->SetMatrix(interpolatedMatrix);
+  bufferItem->SetMatrixElements(interpolatedMatrix);
   bufferItem->SetFilteredTimestamp(time - this->StreamBuffer->GetLocalTimeOffsetSec());   // global = local + offset => local = global - offset
   bufferItem->SetUnfilteredTimestamp(interpolatedUnfilteredTimestamp);
 
-  double angleDiffA = igsioMath::GetOrientationDifference(interpolatedMatrix, itemAmatrix);
-  double angleDiffB = igsioMath::GetOrientationDifference(interpolatedMatrix, itemBmatrix);
-  if (fabs(angleDiffA) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG && fabs(angleDiffB) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG)
+  if (orientationDifferenceDeg > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG)
   {
     static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
     if (helper.ShouldWeLog(true))
     {
-      LOCAL_LOG_WARNING("Angle difference between interpolated orientations is large (" << fabs(angleDiffA) << " and " << fabs(angleDiffB) << " deg, warning threshold is " << ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG << "), interpolation may be inaccurate. Consider moving the tools slower.");
+      LOCAL_LOG_WARNING("Angle difference between interpolated orientations is large (at least " << orientationDifferenceDeg << " deg, warning threshold is " << ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG << "), interpolation may be inaccurate. Consider moving the tools slower.");
     }
   }
 
   return ITEM_OK;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::InterpolatePoses(const PoseSample* samplesA, const PoseSample* samplesB, const double* sampleBweights, int numberOfPoses, double* interpolatedMatrices, double* orientationDifferencesDeg/*=NULL*/)
+{
+  // Poses are processed in batches that fit on the stack. Quaternions and positions are stored
+  // as separate arrays per component (structure of arrays), so that each step of the computation
+  // is a simple loop over the poses of the batch that the compiler can vectorize.
+  const int BATCH_SIZE = 16;
+  const double SLERP_EPSILON = 1e-6; // below this angle the quaternions are interpolated linearly
+  for (int batchStart = 0; batchStart < numberOfPoses; batchStart += BATCH_SIZE)
+  {
+    const int batchSize = std::min(BATCH_SIZE, numberOfPoses - batchStart);
+    const PoseSample* batchA = samplesA + batchStart;
+    const PoseSample* batchB = samplesB + batchStart;
+    const double* batchWeights = sampleBweights + batchStart;
+    double* batchMatrices = interpolatedMatrices + 16 * batchStart;
+
+    double quatA[4][BATCH_SIZE];
+    double quatB[4][BATCH_SIZE];
+    double quatResult[4][BATCH_SIZE];
+    double scaleA[BATCH_SIZE];
+    double scaleB[BATCH_SIZE];
+    double cosAngle[BATCH_SIZE];
+
+    // Convert rotations to quaternions
+    for (int i = 0; i < batchSize; ++i)
+    {
+      double rotationA[3][3];
+      double rotationB[3][3];
+      for (int row = 0; row < 3; ++row)
+      {
+        for (int col = 0; col < 3; ++col)
+        {
+          rotationA[row][col] = batchA[i].Matrix[row * 4 + col];
+          rotationB[row][col] = batchB[i].Matrix[row * 4 + col];
+        }
+      }
+      double qA[4] = {0, 0, 0, 0};
+      double qB[4] = {0, 0, 0, 0};
+      vtkMath::Matrix3x3ToQuaternion(rotationA, qA);
+      vtkMath::Matrix3x3ToQuaternion(rotationB, qB);
+      for (int c = 0; c < 4; ++c)
+      {
+        quatA[c][i] = qA[c];
+        quatB[c][i] = qB[c];
+      }
+    }
+
+    // SLERP: interpolate along the shorter arc
+    for (int i = 0; i < batchSize; ++i)
+    {
+      cosAngle[i] = quatA[0][i] * quatB[0][i] + quatA[1][i] * quatB[1][i] + quatA[2][i] * quatB[2][i] + quatA[3][i] * quatB[3][i];
+    }
+    for (int i = 0; i < batchSize; ++i)
+    {
+      const double sign = (cosAngle[i] < 0.0) ? -1.0 : 1.0;
+      cosAngle[i] *= sign;
+      if (1.0 - cosAngle[i] > SLERP_EPSILON)
+      {
+        const double angle = acos(cosAngle[i]);
+        const double sinAngle = sin(angle);
+        scaleA[i] = sin((1.0 - batchWeights[i]) * angle) / sinAngle;
+        scaleB[i] = sign * sin(batchWeights[i] * angle) / sinAngle;
+      }
+      else
+      {
+        scaleA[i] = 1.0 - batchWeights[i];
+        scaleB[i] = sign * batchWeights[i];
+      }
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+      for (int i = 0; i < batchSize; ++i)
+      {
+        quatResult[c][i] = scaleA[i] * quatA[c][i] + scaleB[i] * quatB[c][i];
+      }
+    }
+
+    // Write rotation and linearly interpolated position
+    for (int i = 0; i < batchSize; ++i)
+    {
+      const double q[4] = { quatResult[0][i], quatResult[1][i], quatResult[2][i], quatResult[3][i] };
+      double rotation[3][3];
+      vtkMath::QuaternionToMatrix3x3(q, rotation);
+      double* matrix = batchMatrices + 16 * i;
+      for (int row = 0; row < 3; ++row)
+      {
+        matrix[row * 4 + 0] = rotation[row][0];
+        matrix[row * 4 + 1] = rotation[row][1];
+        matrix[row * 4 + 2] = rotation[row][2];
+        matrix[row * 4 + 3] = batchA[i].Matrix[row * 4 + 3] * (1.0 - batchWeights[i]) + batchB[i].Matrix[row * 4 + 3] * batchWeights[i];
+      }
+      matrix[12] = 0.0;
+      matrix[13] = 0.0;
+      matrix[14] = 0.0;
+      matrix[15] = 1.0;
+    }
+
+    if (orientationDifferencesDeg == NULL)
+    {
+      continue;
+    }
+    // Rotation angle between two orientations is 2*acos(|q1.q2|)
+    for (int i = 0; i < batchSize; ++i)
+    {
+      double dotA(0);
+      double dotB(0);
+      for (int c = 0; c < 4; ++c)
+      {
+        dotA += quatResult[c][i] * quatA[c][i];
+        dotB += quatResult[c][i] * quatB[c][i];
+      }
+      const double smallerDot = std::max(fabs(dotA), fabs(dotB));
+      orientationDifferencesDeg[batchStart + i] = 2.0 * vtkMath::DegreesFromRadians(acos(std::min(1.0, smallerDot)));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusBuffer::ComputeInterpolationWeight(const PoseSample& sampleA, const PoseSample& sampleB, double time, double& sampleBweight)
+{
+  if (fabs(sampleA.Timestamp - sampleB.Timestamp) < NEGLIGIBLE_TIME_DIFFERENCE)
+  {
+    sampleBweight = 0;
+    return false;
+  }
+  double sampleAweight = fabs(sampleB.Timestamp - time) / fabs(sampleA.Timestamp - sampleB.Timestamp);
+  sampleBweight = 1 - sampleAweight;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetAngleInterpolationWarningThresholdDeg()
+{
+  return ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::CopyTransformFromTrackedFrameList(vtkIGSIOTrackedFrameList* sourceTrackedFrameList, TIMESTAMP_FILTERING_OPTION timestampFiltering, igsioTransformName& transformName)
 {
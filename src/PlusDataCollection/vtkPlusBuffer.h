@@ -17,8 +17,10 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 // Local includes
 #include "igsioCommon.h"
 #include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
 #include "vtkPlusDataCollectionExport.h"
 #include "PlusStreamBufferItem.h"
+#include "PlusThreadPool.h"
 #include "vtkPlusTimestampedCircularBuffer.h"
 
 //#include "igsioTrackedFrame.h"
@@ -26,6 +28,20 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PlusBufferSpillFile;
+class PlusFrameArena;
+class PlusNewItemNotifier;
+class vtkDataArray;
+class vtkLZ4DataCompressor;
 class vtkPlusDevice;
 enum ToolStatus;
 
@@ -49,6 +65,20 @@ public:
     CLOSEST_TIME /*!< returns the closest item  */
   };
 
+  /*! Tracking data of a buffer item that is needed for pose interpolation (no video frame, no frame fields) */
+  struct PoseSample
+  {
+    /*! Unique identifier of the item in the buffer */
+    BufferItemUidType Uid;
+    /*! Filtered timestamp (global time) */
+    double Timestamp;
+    /*! Unfiltered timestamp (local time) */
+    double UnfilteredTimestamp;
+    ToolStatus Status;
+    /*! Transform matrix elements in row-major order */
+    double Matrix[16];
+  };
+
   static vtkPlusBuffer* New();
   vtkTypeMacro(vtkPlusBuffer, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
@@ -61,6 +91,40 @@ public:
   /*! Get the size of the buffer */
   virtual int GetBufferSize();
 
+  /*!
+    Set the buffer size as the duration of acquired data that the buffer should hold (in seconds). 0 means not used.
+    The number of items is computed from the measured item rate (or the nominal rate, if there is not enough data for measurement).
+    The item rate is measured during acquisition and the buffer is resized before the next item is added when the measured rate is stable
+    and differs from the rate that the current size was computed from.
+    If both BufferSizeSec and BufferSizeMB are set then the smaller resulting number of items is used.
+  */
+  PlusStatus SetBufferSizeSec(double bufferSizeSec);
+  vtkGetMacro(BufferSizeSec, double);
+
+  /*!
+    Set the buffer size as the maximum memory that the buffer items may use (in megabytes). 0 means not used.
+    The number of items is computed from the frame size, so the buffer is resized whenever the frame format changes.
+    As reallocating the frames, changing the frame format must not happen while lock-free readers access the buffer.
+  */
+  PlusStatus SetBufferSizeMB(double bufferSizeMB);
+  vtkGetMacro(BufferSizeMB, double);
+
+  /*! Set the expected item rate (items/sec), used for computing the number of items from BufferSizeSec until the rate can be measured */
+  PlusStatus SetNominalItemRate(double itemsPerSec);
+  vtkGetMacro(NominalItemRate, double);
+
+  /*!
+    Compute the number of items from BufferSizeSec and BufferSizeMB and resize the buffer accordingly. Does nothing if none of them is set.
+    If the buffer is shrunk below the number of stored items then the oldest items are discarded (and a warning is logged).
+  */
+  PlusStatus UpdateBufferSizeFromLimits();
+
+  /*! Get the number of bytes that one buffer item uses (including the frame with the current frame format) */
+  unsigned long long GetNumberOfBytesPerItem();
+
+  /*! Get the number of bytes that are actually reserved by the buffer items and their allocated frames (also published as plus_buffer_reserved_memory_bytes metric) */
+  unsigned long long GetReservedMemoryBytes();
+
   /*!
     Add a frame plus a timestamp to the buffer with frame index.
     If the timestamp is  less than or equal to the previous timestamp,
@@ -151,6 +215,39 @@ public:
   */
   PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
 
+  /*!
+    Reserve the next item of the buffer and return its frame, so that the device can write the image data directly into the buffer
+    instead of copying it in AddItem. The frame is allocated with the frame size, pixel type and number of scalar components of the buffer
+    and its pixels are expected in the image orientation of the buffer (no reorientation or clipping is performed).
+    The oldest item is removed from the buffer when the item is reserved (it is added back if the reservation is cancelled
+    before the frame is written, see CancelItem). The frame pointer is valid until CommitItem or CancelItem is called;
+    no other item can be added to the buffer in the meantime. The buffer is not locked while the frame is being filled.
+    Returns NULL if the item cannot be reserved.
+  */
+  virtual igsioVideoFrame* ReserveItem();
+
+  /*!
+    Add the item that was reserved by ReserveItem to the buffer, with the given frame index, timestamps and custom fields.
+    Timestamps are handled the same way as in AddItem. If the item is not added (e.g., because the timestamp is not newer than
+    the latest timestamp in the buffer) then the reservation is released and the content of the frame is discarded.
+  */
+  virtual PlusStatus CommitItem(long frameNumber,
+                                double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
+                                double filteredTimestamp = UNDEFINED_TIMESTAMP,
+                                const igsioFieldMapType* customFields = NULL);
+
+  /*!
+    Release the item reserved by ReserveItem without adding it to the buffer.
+    \param frameModified Must be true if the reserved frame has been written. If false then the item that was removed
+      from the buffer by ReserveItem is added back, so an unsuccessful read from the device does not lose any data.
+  */
+  virtual void CancelItem(bool frameModified = false);
+
+  /*! Register a notifier that is signaled each time a new item is added to the buffer. The notifier is not owned by the buffer. */
+  void AddNewItemNotifier(PlusNewItemNotifier* notifier);
+  /*! Unregister a notifier that was registered by AddNewItemNotifier */
+  void RemoveNewItemNotifier(PlusNewItemNotifier* notifier);
+
   /*! Get a frame with the specified frame uid from the buffer */
   virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
   /*! Get the most recent frame from the buffer */
@@ -165,6 +262,37 @@ public:
   };
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation);
+
+  /*!
+    Get the two items that are needed for interpolating the pose at the specified time, without copying whole buffer items.
+    sampleA is the closest item, sampleB is the closest item on the other side of the requested time.
+    If the closest item is very close to the requested time then sampleB is the same as sampleA.
+    Fails if the pose cannot be interpolated (e.g., the tool is out of view), in this case
+    GetStreamBufferItemFromTime(..., INTERPOLATED) returns the closest item with TOOL_MISSING status.
+    \param frameFieldsA If not NULL then the frame fields of the item of sampleA are copied here
+  */
+  PlusStatus GetPrevNextPoseSamplesFromTime(double time, PoseSample& sampleA, PoseSample& sampleB, igsioFieldMapType* frameFieldsA = NULL);
+
+  /*!
+    Interpolate poses between pairs of pose samples: the rotation is interpolated with SLERP, the position linearly.
+    The poses are processed in fixed-size batches, with each step done for all the poses of the batch in a loop,
+    so that the computation can be vectorized and no memory is allocated.
+    \param samplesA First samples of the pairs (numberOfPoses items)
+    \param samplesB Second samples of the pairs (numberOfPoses items)
+    \param sampleBweights Weight of the second sample in each pair (0 = sampleA, 1 = sampleB)
+    \param interpolatedMatrices Output matrix elements in row-major order (16 * numberOfPoses items)
+    \param orientationDifferencesDeg If not NULL then the smaller of the orientation differences between the interpolated and the two input poses is stored here (numberOfPoses items)
+  */
+  static void InterpolatePoses(const PoseSample* samplesA, const PoseSample* samplesB, const double* sampleBweights, int numberOfPoses, double* interpolatedMatrices, double* orientationDifferencesDeg = NULL);
+
+  /*!
+    Compute the weight of sampleB for interpolating the pose at the specified time.
+    Returns false if the two samples have practically the same timestamp, in this case sampleA can be used without interpolation.
+  */
+  static bool ComputeInterpolationWeight(const PoseSample& sampleA, const PoseSample& sampleB, double time, double& sampleBweight);
+
+  /*! Angle difference above which a warning is logged, because interpolation between the orientations may be inaccurate */
+  static double GetAngleInterpolationWarningThresholdDeg();
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
   /*! Get latest timestamp in the buffer */
@@ -271,6 +399,97 @@ public:
   /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
   bool GetTimeStampReporting();
 
+  /*!
+    If enabled then readers do not lock the buffer, so they never block the acquisition thread (see vtkPlusTimestampedCircularBuffer).
+    It may only be changed while the buffer is not accessed from other threads.
+  */
+  void SetLockFreeReads(bool enable);
+  /*! Get if lock-free reads are enabled */
+  bool GetLockFreeReads();
+
+  /*!
+    Set the device and data source that own the buffer, which identify the buffer in the metrics registry (see PlusMetricsRegistry).
+    Metrics are only collected for buffers that have an owner, so temporary buffers (e.g., local copies of a recording) are not reported.
+  */
+  void SetMetricsOwner(const std::string& deviceId, const std::string& sourceId);
+
+  /*!
+    If enabled then the buffer only stores transforms (tracker data), no memory is allocated for video frames
+    and GetStreamBufferItem does not copy or modify the frame of the output item.
+    The items still contain an empty frame and frame field map, so the memory footprint of an item does not change,
+    only reading and interpolating items becomes faster (see BufferGetItemFromTimeInterpolated in PlusBenchmarks).
+    Enabled automatically by vtkPlusDataSource for tool data sources.
+  */
+  void SetTransformOnly(bool transformOnly);
+  vtkGetMacro(TransformOnly, bool);
+  vtkBooleanMacro(TransformOnly, bool);
+
+  /*!
+    If enabled then the frames of all buffer items are stored in a single contiguous memory block (see PlusFrameArena)
+    instead of a separate allocation for each frame. Frames start at 64-byte aligned addresses.
+    Changing the setting reallocates the frames, so it must not happen while other threads access the buffer.
+  */
+  PlusStatus SetUseFrameArena(bool useFrameArena);
+  vtkGetMacro(UseFrameArena, bool);
+
+  /*!
+    Write all frame memory, so that the acquisition does not trigger page faults when it fills the buffer for the first time.
+    Called by vtkPlusDevice::Connect, frame allocations after this call are counted as allocations after startup.
+  */
+  PlusStatus PrefaultFrameMemory();
+
+  /*!
+    Get the number of frames that had to be allocated after PrefaultFrameMemory was called (e.g., because the frame format changed during acquisition).
+    Each of these allocations may cause a latency spike in the acquisition, so it should be 0 for a stable acquisition.
+  */
+  unsigned long long GetNumberOfFrameAllocationsAfterStartup() const;
+
+  /*!
+    Set the maximum size of the spill file (in megabytes). 0 disables the spill file (default).
+    If enabled, video items that are removed from the full buffer are stored in a memory-mapped temporary file
+    (see PlusBufferSpillFile), and GetStreamBufferItemFromTime and GetStreamBufferItem serve older items from there.
+    This allows keeping a much longer history than what fits into memory.
+    The file is created when the frame size is known and it is recreated (and the history is discarded) when the frame format changes.
+    Removed items are queued and written to the file by a background thread, so the acquisition thread does not wait for the file.
+    If the queue is full (the file cannot keep up with the acquisition) then removed items are dropped.
+  */
+  PlusStatus SetSpillFileSizeMB(double spillFileSizeMB);
+  vtkGetMacro(SpillFileSizeMB, double);
+
+  /*! Set the directory of the spill file. If empty then the output directory of the application is used. */
+  PlusStatus SetSpillFileDirectory(const std::string& directory);
+  std::string GetSpillFileDirectory() const { return this->SpillFileDirectory; }
+
+  /*! Get the number of items in the spill file. Items that are queued for spilling are not included. */
+  unsigned int GetNumberOfSpilledItems();
+
+  /*! Get the number of removed items that were not stored in the spill file because the spill queue was full */
+  unsigned long long GetNumberOfDroppedSpillItems();
+
+  /*! Wait until all queued removed items are written to the spill file */
+  void WaitForSpillQueueEmpty();
+
+  /*!
+    If enabled then the frames of all but the most recent NumberOfUncompressedFrames items are stored LZ4-compressed in memory.
+    Frames are decompressed when they are read (GetStreamBufferItem...), so a much deeper history fits into the same memory
+    at the cost of some CPU time on each read of an older item. Compression is lossless. Encoded frames are not compressed.
+    Frames are compressed in the background by the shared thread pool, the compressed data is stored in the items when the next item is added.
+    The frame arena (UseFrameArena) is not used while compression is enabled.
+    Changing the setting reallocates the frames, so it must not happen while other threads access the buffer.
+  */
+  PlusStatus SetCompressFrames(bool compressFrames);
+  vtkGetMacro(CompressFrames, bool);
+
+  /*! Set the number of most recent items that are kept uncompressed if CompressFrames is enabled (at least 1, default 2) */
+  PlusStatus SetNumberOfUncompressedFrames(int numberOfUncompressedFrames);
+  vtkGetMacro(NumberOfUncompressedFrames, int);
+
+  /*! Get the total size of the compressed frames in the buffer (in bytes) */
+  unsigned long long GetCompressedFramesSizeBytes();
+
+  /*! Wait until the frames that are compressed in the background are completed and store them in the buffer items */
+  void WaitForFrameCompression();
+
   /*! Set the frame size in pixel  */
   PlusStatus SetFrameSize(unsigned int x, unsigned int y, unsigned int z, bool allocateFrames = true);
   /*! Set the frame size in pixel  */
@@ -346,6 +565,96 @@ protected:
   /*! Get tracker buffer item from the closest timestamp */
   virtual ItemStatus GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem);
 
+  /*! Get an item that is older than the oldest item in the buffer from the spill file. Frames are not interpolated, the closest item is returned. */
+  virtual ItemStatus GetSpilledStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation);
+
+  /*! Make the new item available for readers and signal the new item notifiers. The caller must have locked the stream buffer. */
+  void PublishNewItem(BufferItemUidType uid, int bufferIndex);
+
+  /*! Update the buffer metrics (acquisition rate, fill level, overwritten and rejected items, reserved memory). The caller must have locked the stream buffer. */
+  void UpdateMetrics();
+
+  /*!
+    Measure the item rate from the timestamp of the new item and request a buffer size update if the rate is stable
+    and differs from the rate that the buffer size was computed from. The caller must have locked the stream buffer.
+  */
+  void UpdateMeasuredItemRate(double itemTimestamp);
+
+  /*! Resize the buffer if requested by UpdateMeasuredItemRate. Must be called before the stream buffer is locked for adding a new item. */
+  void ApplyPendingBufferSizeUpdate();
+
+  /*! Copy a buffer item to an output item. If TransformOnly is enabled then the video frame is not copied. */
+  PlusStatus CopyStreamBufferItem(StreamBufferItem* targetItem, StreamBufferItem* sourceItem);
+
+  /*! Get the tracking data of an item. Frame fields are copied only if frameFields is not NULL. */
+  ItemStatus GetPoseSample(BufferItemUidType uid, PoseSample& sample, igsioFieldMapType* frameFields = NULL);
+
+  /*! Make the pixel data of the frame use the arena slot of the buffer index (the current content is copied). The caller must have locked the stream buffer. */
+  PlusStatus AttachFrameToArena(igsioVideoFrame& frame, int bufferIndex);
+
+  /*! Move the pixel data of all frames that use the arena to separate allocations, so that the arena can be released. The caller must have locked the stream buffer. */
+  void DetachFramesFromArena();
+
+  /*! Allocate the frame with the buffer frame format (if needed) and place it in the arena. The caller must have locked the stream buffer. */
+  PlusStatus AllocateFrame(igsioVideoFrame& frame, int bufferIndex);
+
+  /*! Returns true if the frame size, pixel type and number of components of the frame match the buffer frame format */
+  bool HasBufferFrameFormat(igsioVideoFrame& frame);
+
+  /*! Open, recreate or close the spill file according to SpillFileSizeMB and the current frame format. The caller must have locked the stream buffer. */
+  PlusStatus UpdateSpillFile();
+
+  /*! Stop writing to the spill file and close it. Queued items are discarded. The caller must have locked the stream buffer. */
+  void CloseSpillFile();
+
+  /*!
+    Queue an item that is removed from the buffer for writing to the spill file. Only the item is copied (compressed frames
+    are copied compressed), the file is written by the spill thread. Called by the stream buffer while it is locked.
+  */
+  void QueueRemovedItemForSpilling(StreamBufferItem& item);
+
+  /*! Get a copy of a queued item that is not written to the spill file yet */
+  ItemStatus GetQueuedSpillItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
+
+  /*! Remove the queued items that are not written to the spill file yet */
+  void DiscardQueuedSpillItems();
+
+  void StartSpillThread();
+  /*! Stop the spill thread. The queued items are written to the spill file first. */
+  void StopSpillThread();
+  /*! Writes the queued items to the spill file. Compressed frames are decompressed before writing. */
+  void SpillThreadMain();
+
+  /*!
+    Start compressing the frame of the item with the specified UID in the background, if it is in the buffer and not compressed yet.
+    The pixels are compressed into a separate buffer, ApplyCompressedFrames stores the result in the item. The caller must have locked the stream buffer.
+  */
+  void ScheduleItemFrameCompression(BufferItemUidType uid);
+
+  /*!
+    Store the frames that are compressed in the background in their buffer items. A result is discarded if the item is not in the buffer anymore
+    or its pixel data was replaced since the compression started. The caller must have locked the stream buffer.
+  */
+  void ApplyCompressedFrames();
+
+  /*!
+    Compress or restore the frames of all items according to the current settings (called after the frames are allocated).
+    Slots that do not contain an item do not keep pixel memory while compression is enabled. The caller must have locked the stream buffer.
+  */
+  void UpdateCompressedFrames();
+
+  /*! Decompress the frame of a compressed item into an allocated frame that has the buffer frame format */
+  PlusStatus DecompressItemFrame(StreamBufferItem& item, igsioVideoFrame& targetFrame);
+
+  /*!
+    Give pixel memory back to the frame of a compressed buffer item, so that it can be written. If decompress is true then the frame content is restored,
+    otherwise the content is undefined. The caller must have locked the stream buffer and must have exclusive access to the slot of the item.
+  */
+  PlusStatus RestoreItemFrame(StreamBufferItem& item, bool decompress);
+
+  /*! Move the pixel memory of a buffer item to the pool of pixel arrays. The caller must have locked the stream buffer and must have exclusive access to the slot of the item. */
+  void ReleaseItemFramePixels(StreamBufferItem& item);
+
 protected:
   /*! Image frame size in pixel */
   FrameSizeType FrameSize;
@@ -371,6 +680,130 @@ protected:
 
   char* DescriptiveName;
 
+  /*! If enabled then only transforms are stored in the buffer, video frames are not allocated or copied */
+  bool TransformOnly;
+
+  /*! Duration of data that the buffer should hold (in seconds), 0 if not used */
+  double BufferSizeSec;
+
+  /*! Maximum memory that the buffer items may use (in megabytes), 0 if not used */
+  double BufferSizeMB;
+
+  /*! Expected item rate (items/sec), used until the item rate can be measured */
+  double NominalItemRate;
+
+  /*! Item rate (items/sec) that the current buffer size is computed from, 0 if the size is not computed from BufferSizeSec */
+  double BufferSizeItemRate;
+
+  /*! Item rate (items/sec) that was measured in two consecutive periods, 0 if not known yet. Protected by the stream buffer lock. */
+  double StableItemRate;
+
+  /*! Item rate (items/sec) measured in the previous period. Protected by the stream buffer lock. */
+  double LastMeasuredItemRate;
+
+  /*! Timestamp of the item that started the current item rate measurement period. Protected by the stream buffer lock. */
+  double ItemRatePeriodStartTimestamp;
+
+  /*! Number of items added in the current item rate measurement period. Protected by the stream buffer lock. */
+  int NumberOfItemsInItemRatePeriod;
+
+  /*! Set if the buffer has to be resized because the measured item rate has changed */
+  std::atomic<bool> BufferSizeUpdatePending;
+
+  /*! If enabled then the frames are stored in FrameArena */
+  bool UseFrameArena;
+
+  /*! Contiguous memory for the frames of all items. Protected by the stream buffer lock. */
+  PlusFrameArena* FrameArena;
+
+  /*! Set by PrefaultFrameMemory, frame allocations are counted after that */
+  bool StartupCompleted;
+
+  /*! Number of frame allocations after startup */
+  std::atomic<unsigned long long> NumberOfFrameAllocationsAfterStartup;
+
+  /*! True if the item removed by ReserveItem still has its frame content. Protected by the stream buffer lock. */
+  bool ReservedItemRestorable;
+
+  /*! Maximum size of the spill file (in megabytes), 0 if spilling is disabled */
+  double SpillFileSizeMB;
+
+  /*! Directory of the spill file, the output directory is used if empty */
+  std::string SpillFileDirectory;
+
+  /*! Storage for the items that are removed from the buffer */
+  PlusBufferSpillFile* SpillFile;
+
+  /*! If enabled then the frames of older items are stored compressed */
+  bool CompressFrames;
+
+  /*! Number of most recent items that are not compressed */
+  int NumberOfUncompressedFrames;
+
+  /*! Frame codec. Compression and decompression do not modify its state, so it can be used by concurrent readers. */
+  vtkLZ4DataCompressor* FrameCompressor;
+
+  /*! Frame that is compressed in the background, waiting to be stored in its buffer item */
+  struct CompressedFrame
+  {
+    BufferItemUidType Uid;
+    /*! Pixel array that was compressed, the result is only stored if the item still has this array */
+    vtkSmartPointer<vtkDataArray> Pixels;
+    /*! Compressed data, empty if the compression failed */
+    std::vector<unsigned char> Data;
+  };
+
+  /*! Background frame compression tasks */
+  PlusThreadPool::TaskGroup CompressionTasks;
+
+  /*! Completed background compressions. Protected by CompressedFramesMutex. */
+  std::vector<CompressedFrame> CompressedFrames;
+  std::mutex CompressedFramesMutex;
+
+  /*! Pixel arrays (buffer frame format) released by compressed frames, reused when new items are written. Protected by the stream buffer lock. */
+  std::vector< vtkSmartPointer<vtkDataArray> > PixelArrayPool;
+
+  /*! Empty pixel arrays that stand in for the pixel data of compressed frames. Protected by the stream buffer lock. */
+  std::vector< vtkSmartPointer<vtkDataArray> > EmptyPixelArrayPool;
+
+  /*! Items that are removed from the buffer, waiting to be written to the spill file by the spill thread. Protected by SpillQueueMutex. */
+  std::deque<StreamBufferItem*> SpillQueue;
+  /*! Items that are not in the queue, reused to avoid memory allocation for each removed item. Protected by SpillQueueMutex. */
+  std::vector<StreamBufferItem*> FreeSpillItems;
+  /*! True while the spill thread writes the first item of the queue. Protected by SpillQueueMutex. */
+  bool SpillThreadBusy;
+  bool SpillThreadStopRequested;
+  unsigned long long NumberOfDroppedSpillItems;
+  double LastDroppedSpillItemsWarningTime;
+  std::mutex SpillQueueMutex;
+  /*! Signaled when items are added to the queue or the spill thread should stop */
+  std::condition_variable SpillQueueNotEmptyCondition;
+  /*! Signaled when the spill thread completed writing of an item */
+  std::condition_variable ItemSpilledCondition;
+  std::thread SpillThread;
+
+  /*! Temporary item for decompressing frames that are moved to the spill file. Used by the spill thread only. */
+  StreamBufferItem SpillItem;
+
+  /*! Notifiers that are signaled when a new item is added. Protected by the stream buffer lock. */
+  std::vector<PlusNewItemNotifier*> NewItemNotifiers;
+
+  /*! Labels of the device and data source that own the buffer in the metrics, empty if metrics are not collected. Protected by the stream buffer lock. */
+  std::string MetricsDeviceId;
+  std::string MetricsSourceId;
+
+  /*! Metrics of the buffer, created at the first added item after the owner is set (owned by PlusMetricsRegistry). Protected by the stream buffer lock. */
+  PlusMetric* ItemsAddedMetric;
+  PlusMetric* FillLevelMetric;
+  PlusMetric* OverwrittenItemsMetric;
+  PlusMetric* RejectedItemsMetric;
+  PlusMetric* AcquisitionRateMetric;
+  PlusMetricRateMeter AcquisitionRateMeter;
+  PlusMetric* ReservedMemoryMetric;
+
+  /*! System time of the last update of ReservedMemoryMetric, which is updated periodically as computing it requires iterating through all items */
+  double ReservedMemoryMetricUpdateTime;
+
 private:
   vtkPlusBuffer(const vtkPlusBuffer&);
   void operator=(const vtkPlusBuffer&);
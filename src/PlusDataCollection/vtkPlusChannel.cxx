@@ -6,21 +6,29 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
 #ifdef PLUS_RENDERING_ENABLED
 #include "PlusPlotter.h"
 #endif
+#include "PlusChannelReadCursor.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusHTMLGenerator.h"
 #include "vtkIGSIOTrackedFrameList.h"
 
+// IGSIO includes
+#include <vtkIGSIORecursiveCriticalSection.h>
+
 // VTK includes
 #include <vtkImageData.h>
 #include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
 #include <vtkTable.h>
 
+// STL includes
+#include <algorithm>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusChannel);
@@ -39,6 +47,9 @@ vtkPlusChannel::vtkPlusChannel(void)
   , RfProcessor(NULL)
   , BlankImage(vtkImageData::New())
   , SaveRfProcessingParameters(false)
+  , ReadCursorsMutex(vtkIGSIORecursiveCriticalSection::New())
+  , TrackedFrameToolMatrix(vtkMatrix4x4::New())
+  , TrackedFrameToolPosesMutex(vtkIGSIORecursiveCriticalSection::New())
 {
   // Default size for brightness frame
   this->BrightnessFrameSize[0] = 640;
@@ -67,6 +78,15 @@ vtkPlusChannel::~vtkPlusChannel(void)
   DELETE_IF_NOT_NULL(this->BlankImage);
 
   DELETE_IF_NOT_NULL(this->RfProcessor);
+
+  for (std::vector<PlusChannelReadCursor*>::iterator cursorIt = this->ReadCursors.begin(); cursorIt != this->ReadCursors.end(); ++cursorIt)
+  {
+    delete *cursorIt;
+  }
+  this->ReadCursors.clear();
+  DELETE_IF_NOT_NULL(this->ReadCursorsMutex);
+  DELETE_IF_NOT_NULL(this->TrackedFrameToolMatrix);
+  DELETE_IF_NOT_NULL(this->TrackedFrameToolPosesMutex);
 }
 
 //----------------------------------------------------------------------------
@@ -570,8 +590,7 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
     }
 
     // Copy frame
-    igsioVideoFrame frame = CurrentStreamBufferItem.GetFrame();
-    aTrackedFrame.SetImageData(frame);
+    aTrackedFrame.SetImageData(CurrentStreamBufferItem.GetFrame());
 
     // Copy all custom fields
     igsioFieldMapType fieldMap = CurrentStreamBufferItem.GetFrameFieldMap();
@@ -591,71 +610,72 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
   // Add main tool timestamp
   aTrackedFrame.SetTimestamp(synchronizedTimestamp);
 
-  for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it)
   {
-    vtkPlusDataSource* aTool = it->second;
-    igsioTransformName toolTransformName(aTool->GetId());
-    if (!toolTransformName.IsValid())
+    // Interpolate the pose of all tools at once. Consumer threads share the reused poses and matrix, which are only
+    // locked while the poses are copied into the tracked frame.
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> toolPosesGuardedLock(this->TrackedFrameToolPosesMutex);
+    std::vector<ToolPose>& toolPoses = this->TrackedFrameToolPoses;
+    if (this->GetToolPosesAtTime(synchronizedTimestamp, toolPoses) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Tool transform name is invalid!");
-      numberOfErrors++;
-      continue;
+      LOG_DEBUG("Failed to get the pose of some of the tools at time: " << std::fixed << synchronizedTimestamp);
     }
 
-    StreamBufferItem bufferItem;
-    ItemStatus result = aTool->GetStreamBufferItemFromTime(synchronizedTimestamp, &bufferItem, vtkPlusBuffer::INTERPOLATED);
-    if (result != ITEM_OK)
+    vtkMatrix4x4* toolMatrix = this->TrackedFrameToolMatrix;
+    for (std::vector<ToolPose>::iterator poseIt = toolPoses.begin(); poseIt != toolPoses.end(); ++poseIt)
     {
-      double latestTimestamp(0);
-      if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+      vtkPlusDataSource* aTool = poseIt->Tool;
+      igsioTransformName toolTransformName(aTool->GetId());
+      if (!toolTransformName.IsValid())
       {
-        LOG_ERROR("Failed to get latest timestamp!");
+        LOG_ERROR("Tool transform name is invalid!");
         numberOfErrors++;
+        continue;
       }
 
-      double oldestTimestamp(0);
-      if (aTool->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+      if (!poseIt->Valid)
       {
-        LOG_ERROR("Failed to get oldest timestamp!");
+        double latestTimestamp(0);
+        if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+        {
+          LOG_ERROR("Failed to get latest timestamp!");
+          numberOfErrors++;
+        }
+
+        double oldestTimestamp(0);
+        if (aTool->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+        {
+          LOG_ERROR("Failed to get oldest timestamp!");
+          numberOfErrors++;
+        }
+
+        LOG_ERROR(aTool->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << synchronizedTimestamp << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
         numberOfErrors++;
+        continue;
       }
 
-      LOG_ERROR(aTool->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << synchronizedTimestamp << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
-      numberOfErrors++;
-      continue;
-    }
-
-    vtkSmartPointer<vtkMatrix4x4> dMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    if (bufferItem.GetMatrix(dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to get matrix from buffer item for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
+      toolMatrix->DeepCopy(poseIt->Matrix);
+      if (aTrackedFrame.SetFrameTransform(toolTransformName, toolMatrix) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
+        numberOfErrors++;
+        continue;
+      }
 
-    if (aTrackedFrame.SetFrameTransform(toolTransformName, dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
+      if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, poseIt->Status) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
+        numberOfErrors++;
+        continue;
+      }
 
-    if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, bufferItem.GetStatus()) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
+      // Copy all custom fields
+      for (igsioFieldMapType::const_iterator fieldIterator = poseIt->FrameFields.begin(); fieldIterator != poseIt->FrameFields.end(); fieldIterator++)
+      {
+        aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      }
 
-    // Copy all custom fields
-    igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
-    igsioFieldMapType::iterator fieldIterator;
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
-    {
-      aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      synchronizedTimestamp = poseIt->Timestamp;
     }
-
-    synchronizedTimestamp = bufferItem.GetTimestamp(aTool->GetLocalTimeOffsetSec());
   }
 
   for (DataSourceContainerConstIterator it = this->GetFieldDataSourcesStartIterator(); it != this->GetFieldDataSourcesEndIterator(); ++it)
@@ -698,6 +718,106 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
   // Copy frame timestamp
   aTrackedFrame.SetTimestamp(synchronizedTimestamp);
 
+  PLUS_TRACE_LATENCY(STAGE_CHANNEL_GET_FRAME, synchronizedTimestamp);
+
+  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetToolPosesAtTime(double time, std::vector<ToolPose>& outPoses)
+{
+  outPoses.resize(this->Tools.size());
+
+  // Tools that need interpolation are collected in a batch and interpolated together,
+  // the pose of the other tools is copied from the closest item directly
+  const int BATCH_SIZE = 16;
+  vtkPlusBuffer::PoseSample samplesA[BATCH_SIZE];
+  vtkPlusBuffer::PoseSample samplesB[BATCH_SIZE];
+  double sampleBweights[BATCH_SIZE];
+  int poseIndices[BATCH_SIZE];
+  double interpolatedMatrices[16 * BATCH_SIZE];
+  double orientationDifferencesDeg[BATCH_SIZE];
+  int batchSize(0);
+
+  auto interpolateBatch = [&]()
+  {
+    vtkPlusBuffer::InterpolatePoses(samplesA, samplesB, sampleBweights, batchSize, interpolatedMatrices, orientationDifferencesDeg);
+    for (int i = 0; i < batchSize; ++i)
+    {
+      ToolPose& pose = outPoses[poseIndices[i]];
+      std::copy(interpolatedMatrices + 16 * i, interpolatedMatrices + 16 * (i + 1), pose.Matrix);
+      pose.Status = samplesA[i].Status;
+      pose.Timestamp = time;
+      if (orientationDifferencesDeg[i] > vtkPlusBuffer::GetAngleInterpolationWarningThresholdDeg())
+      {
+        static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
+        if (helper.ShouldWeLog(true))
+        {
+          LOG_WARNING(pose.Tool->GetId() << ": Angle difference between interpolated orientations is large (at least " << orientationDifferencesDeg[i] << " deg, warning threshold is " << vtkPlusBuffer::GetAngleInterpolationWarningThresholdDeg() << "), interpolation may be inaccurate. Consider moving the tools slower.");
+        }
+      }
+    }
+    batchSize = 0;
+  };
+
+  int numberOfErrors(0);
+  int poseIndex(0);
+  for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it, ++poseIndex)
+  {
+    ToolPose& pose = outPoses[poseIndex];
+    pose.Tool = it->second;
+    pose.Valid = true;
+
+    vtkPlusBuffer::PoseSample& sampleA = samplesA[batchSize];
+    vtkPlusBuffer::PoseSample& sampleB = samplesB[batchSize];
+    if (pose.Tool->GetBuffer()->GetPrevNextPoseSamplesFromTime(time, sampleA, sampleB, &pose.FrameFields) != PLUS_SUCCESS)
+    {
+      // The pose cannot be interpolated (e.g., the tool is out of view), get the closest item (with TOOL_MISSING status) the usual way
+      StreamBufferItem bufferItem;
+      if (pose.Tool->GetStreamBufferItemFromTime(time, &bufferItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK)
+      {
+        pose.Valid = false;
+        pose.Status = TOOL_INVALID;
+        pose.Timestamp = time;
+        pose.FrameFields.clear();
+        numberOfErrors++;
+        continue;
+      }
+      std::copy(bufferItem.GetMatrixElements(), bufferItem.GetMatrixElements() + 16, pose.Matrix);
+      pose.Status = bufferItem.GetStatus();
+      pose.Timestamp = bufferItem.GetTimestamp(pose.Tool->GetLocalTimeOffsetSec());
+      pose.FrameFields = bufferItem.GetFrameFieldMap();
+      continue;
+    }
+
+    if (sampleA.Uid == sampleB.Uid)
+    {
+      // The closest item is at the requested time
+      std::copy(sampleA.Matrix, sampleA.Matrix + 16, pose.Matrix);
+      pose.Status = sampleA.Status;
+      pose.Timestamp = sampleA.Timestamp;
+      continue;
+    }
+    if (!vtkPlusBuffer::ComputeInterpolationWeight(sampleA, sampleB, time, sampleBweights[batchSize]))
+    {
+      // The two items have the same timestamp, no need for interpolation
+      std::copy(sampleA.Matrix, sampleA.Matrix + 16, pose.Matrix);
+      pose.Status = sampleA.Status;
+      pose.Timestamp = time;
+      continue;
+    }
+
+    poseIndices[batchSize] = poseIndex;
+    if (++batchSize == BATCH_SIZE)
+    {
+      interpolateBatch();
+    }
+  }
+  if (batchSize > 0)
+  {
+    interpolateBatch();
+  }
+
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
@@ -711,6 +831,40 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(igsioTrackedFrame& trackedFrame)
   return this->GetTrackedFrame(mostRecentFrameTimestamp, trackedFrame);
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusChannel::AddNewItemNotifier(PlusNewItemNotifier* notifier)
+{
+  if (this->VideoSource != NULL)
+  {
+    this->VideoSource->AddNewItemNotifier(notifier);
+  }
+  for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    it->second->AddNewItemNotifier(notifier);
+  }
+  for (DataSourceContainerIterator it = this->FieldDataSources.begin(); it != this->FieldDataSources.end(); ++it)
+  {
+    it->second->AddNewItemNotifier(notifier);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::RemoveNewItemNotifier(PlusNewItemNotifier* notifier)
+{
+  if (this->VideoSource != NULL)
+  {
+    this->VideoSource->RemoveNewItemNotifier(notifier);
+  }
+  for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    it->second->RemoveNewItemNotifier(notifier);
+  }
+  for (DataSourceContainerIterator it = this->FieldDataSources.begin(); it != this->FieldDataSources.end(); ++it)
+  {
+    it->second->RemoveNewItemNotifier(notifier);
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd)
 {
@@ -1124,6 +1278,42 @@ PlusStatus vtkPlusChannel::GetTrackedFrameListSampled(double& aTimestampOfLastFr
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusChannelReadCursor* vtkPlusChannel::CreateReadCursor(const std::string& consumerName)
+{
+  PlusChannelReadCursor* cursor = new PlusChannelReadCursor(this, consumerName);
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cursorsGuardedLock(this->ReadCursorsMutex);
+  this->ReadCursors.push_back(cursor);
+  return cursor;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::DeleteReadCursor(PlusChannelReadCursor* cursor)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cursorsGuardedLock(this->ReadCursorsMutex);
+  std::vector<PlusChannelReadCursor*>::iterator cursorIt = std::find(this->ReadCursors.begin(), this->ReadCursors.end(), cursor);
+  if (cursorIt == this->ReadCursors.end())
+  {
+    LOG_ERROR("vtkPlusChannel::DeleteReadCursor failed: the read cursor does not belong to channel " << (this->ChannelId ? this->ChannelId : "(unknown)"));
+    return PLUS_FAIL;
+  }
+  if (cursor->GetNumberOfOverwrittenItems() > 0)
+  {
+    LOG_INFO("Consumer " << cursor->GetConsumerName() << " of channel " << (this->ChannelId ? this->ChannelId : "(unknown)") << " read " << cursor->GetNumberOfReadItems()
+             << " items, " << cursor->GetNumberOfOverwrittenItems() << " items were overwritten before they could be read");
+  }
+  this->ReadCursors.erase(cursorIt);
+  delete cursor;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::GetReadCursors(std::vector<PlusChannelReadCursor*>& cursors)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cursorsGuardedLock(this->ReadCursorsMutex);
+  cursors = this->ReadCursors;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetOldestTimestamp(double& ts)
 {
@@ -14,7 +14,13 @@
 #include "vtkDataObject.h"
 #include "vtkPlusRfProcessor.h"
 
+#include <vector>
+
 //class igsioTrackedFrame; 
+class PlusChannelReadCursor;
+class PlusNewItemNotifier;
+class vtkIGSIORecursiveCriticalSection;
+class vtkMatrix4x4;
 class vtkPlusHTMLGenerator;
 class vtkPlusDataSource;
 class vtkPlusDevice;
@@ -38,6 +44,22 @@ public:
   typedef CustomAttributeMap::iterator CustomAttributeMapIterator;
   typedef CustomAttributeMap::const_iterator CustomAttributeMapConstIterator;
 
+  /*! Pose of a tool at a requested time (see GetToolPosesAtTime) */
+  struct ToolPose
+  {
+    /*! Tool data source that the pose is retrieved from */
+    vtkPlusDataSource* Tool;
+    /*! Transform matrix elements in row-major order */
+    double Matrix[16];
+    ToolStatus Status;
+    /*! Timestamp of the pose (global time), it is the requested time if the pose is interpolated */
+    double Timestamp;
+    /*! Frame fields of the tracker item that is the closest to the requested time */
+    igsioFieldMapType FrameFields;
+    /*! False if no item could be retrieved from the tool buffer */
+    bool Valid;
+  };
+
 public:
   static vtkPlusChannel* New();
   vtkTypeMacro(vtkPlusChannel, vtkObject);
@@ -112,6 +134,23 @@ public:
   virtual PlusStatus GetTrackedFrame(double timestamp, igsioTrackedFrame& trackedFrame, bool enableImageData = true);
   virtual PlusStatus GetTrackedFrame(igsioTrackedFrame& trackedFrame);
 
+  /*!
+    Get the pose of all the tools at the specified time, in the order of the tools in the channel.
+    The result is the same as calling GetStreamBufferItemFromTime(time, ..., INTERPOLATED) for each tool, but only the
+    tracking data is read from the buffers and the interpolation is computed for all the tools at once.
+    No memory is allocated if the same outPoses vector is reused between calls (and the tool items have no frame fields).
+    \return PLUS_FAIL if the pose of any of the tools could not be retrieved (see ToolPose::Valid)
+  */
+  virtual PlusStatus GetToolPosesAtTime(double time, std::vector<ToolPose>& outPoses);
+
+  /*!
+    Register a notifier that is signaled when a new item is added to any of the data sources of the channel.
+    The notifier is not owned by the channel, it must be removed by RemoveNewItemNotifier before it is deleted.
+  */
+  void AddNewItemNotifier(PlusNewItemNotifier* notifier);
+  /*! Unregister a notifier from all the data sources of the channel */
+  void RemoveNewItemNotifier(PlusNewItemNotifier* notifier);
+
   /*!
     Get the tracked frame list from devices since time specified
     \param aTimestampOfLastFrameAlreadyGot Used for preventing returning the same frame multiple times. In: the timestamp of the timestamp that has been already returned in previous GetTrackedFrameListSampled calls. If no frames have got yet then set it to UNDEFINED_TIMESTAMP. Out: the timestamp of the most recent frame that is returned.
@@ -133,6 +172,20 @@ public:
   */
   PlusStatus GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd);
 
+  /*!
+    Create a read cursor that keeps track of which items of the channel have been read by a consumer
+    and how many of them were overwritten before the consumer could read them.
+    The cursor is owned by the channel, release it by DeleteReadCursor when it is not needed anymore.
+    \param consumerName Name of the consumer, used in log messages and reports
+  */
+  PlusChannelReadCursor* CreateReadCursor(const std::string& consumerName);
+
+  /*! Delete a read cursor that was created by CreateReadCursor */
+  PlusStatus DeleteReadCursor(PlusChannelReadCursor* cursor);
+
+  /*! Get the read cursors of all consumers of the channel (e.g., for checking which consumer cannot keep up with the acquisition) */
+  void GetReadCursors(std::vector<PlusChannelReadCursor*>& cursors);
+
   /*! Get the closest tracked frame timestamp to the specified time */
   virtual double GetClosestTrackedFrameTimestampByTime(double time);
 
@@ -199,6 +252,15 @@ protected:
 
   CustomAttributeMap CustomAttributes;
 
+  /*! Read cursors of the consumers of the channel */
+  std::vector<PlusChannelReadCursor*> ReadCursors;
+  vtkIGSIORecursiveCriticalSection* ReadCursorsMutex;
+
+  /*! Tool poses and transform matrix reused by GetTrackedFrame, so that it does not allocate them for each frame */
+  std::vector<ToolPose> TrackedFrameToolPoses;
+  vtkMatrix4x4* TrackedFrameToolMatrix;
+  vtkIGSIORecursiveCriticalSection* TrackedFrameToolPosesMutex;
+
   vtkPlusChannel(void);
   virtual ~vtkPlusChannel(void);
 
@@ -235,6 +235,22 @@ std::array<int, 3> vtkPlusDataSource::GetClipRectangleOrigin() const
   return this->ClipRectangleOrigin;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDataSource::SetType(DataSourceType type)
+{
+  if (this->Type == type)
+  {
+    // no change
+    return;
+  }
+  this->Type = type;
+  if (this->Buffer != NULL)
+  {
+    this->Buffer->SetTransformOnly(this->Type == DATA_SOURCE_TYPE_TOOL);
+  }
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusDataSource::SetClipRectangleSize(const std::array<int, 3> _arg)
 {
@@ -391,6 +407,18 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     LOG_DEBUG("Buffer size is not defined in source element \"" << this->GetId() << "\". Using default buffer size: " << this->GetBuffer()->GetBufferSize());
   }
 
+  // BufferSizeSec and BufferSizeMB override BufferSize as soon as they can be resolved (item rate and frame size are known)
+  double bufferSizeSec = 0;
+  if (sourceElement->GetScalarAttribute("BufferSizeSec", bufferSizeSec))
+  {
+    this->GetBuffer()->SetBufferSizeSec(bufferSizeSec);
+  }
+  double bufferSizeMB = 0;
+  if (sourceElement->GetScalarAttribute("BufferSizeMB", bufferSizeMB))
+  {
+    this->GetBuffer()->SetBufferSizeMB(bufferSizeMB);
+  }
+
   int averagedItemsForFiltering = 0;
   if (sourceElement->GetScalarAttribute("AveragedItemsForFiltering", averagedItemsForFiltering))
   {
@@ -401,6 +429,41 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     LOG_DEBUG("AveragedItemsForFiltering is not defined in source element \"" << this->GetId() << "\". Using default value: " << this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  const char* lockFreeReads = sourceElement->GetAttribute("LockFreeReads");
+  if (lockFreeReads != NULL)
+  {
+    this->GetBuffer()->SetLockFreeReads(STRCASECMP(lockFreeReads, "TRUE") == 0);
+  }
+
+  const char* useFrameArena = sourceElement->GetAttribute("UseFrameArena");
+  if (useFrameArena != NULL)
+  {
+    this->GetBuffer()->SetUseFrameArena(STRCASECMP(useFrameArena, "TRUE") == 0);
+  }
+
+  // The spill file is created when the frame size becomes known
+  const char* spillFileDirectory = sourceElement->GetAttribute("SpillFileDirectory");
+  if (spillFileDirectory != NULL)
+  {
+    this->GetBuffer()->SetSpillFileDirectory(spillFileDirectory);
+  }
+  double spillFileSizeMB = 0;
+  if (sourceElement->GetScalarAttribute("SpillFileSizeMB", spillFileSizeMB))
+  {
+    this->GetBuffer()->SetSpillFileSizeMB(spillFileSizeMB);
+  }
+
+  int uncompressedFrames = 0;
+  if (sourceElement->GetScalarAttribute("UncompressedFrames", uncompressedFrames))
+  {
+    this->GetBuffer()->SetNumberOfUncompressedFrames(uncompressedFrames);
+  }
+  const char* compressFrames = sourceElement->GetAttribute("CompressFrames");
+  if (compressFrames != NULL)
+  {
+    this->GetBuffer()->SetCompressFrames(STRCASECMP(compressFrames, "TRUE") == 0);
+  }
+
   std::string descName;
   if (!aDescriptiveNameForBuffer.empty())
   {
@@ -456,12 +519,47 @@ PlusStatus vtkPlusDataSource::WriteConfiguration(vtkXMLDataElement* aSourceEleme
 
   XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(PortName, aSourceElement);
   aSourceElement->SetIntAttribute("BufferSize", this->GetBuffer()->GetBufferSize());
+  if (this->GetBuffer()->GetBufferSizeSec() > 0)
+  {
+    aSourceElement->SetDoubleAttribute("BufferSizeSec", this->GetBuffer()->GetBufferSizeSec());
+  }
+  if (this->GetBuffer()->GetBufferSizeMB() > 0)
+  {
+    aSourceElement->SetDoubleAttribute("BufferSizeMB", this->GetBuffer()->GetBufferSizeMB());
+  }
 
   if (aSourceElement->GetAttribute("AveragedItemsForFiltering") != NULL)
   {
     aSourceElement->SetIntAttribute("AveragedItemsForFiltering", this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  if (aSourceElement->GetAttribute("LockFreeReads") != NULL)
+  {
+    aSourceElement->SetAttribute("LockFreeReads", this->GetBuffer()->GetLockFreeReads() ? "TRUE" : "FALSE");
+  }
+
+  if (aSourceElement->GetAttribute("UseFrameArena") != NULL)
+  {
+    aSourceElement->SetAttribute("UseFrameArena", this->GetBuffer()->GetUseFrameArena() ? "TRUE" : "FALSE");
+  }
+
+  if (this->GetBuffer()->GetSpillFileSizeMB() > 0)
+  {
+    aSourceElement->SetDoubleAttribute("SpillFileSizeMB", this->GetBuffer()->GetSpillFileSizeMB());
+  }
+  if (!this->GetBuffer()->GetSpillFileDirectory().empty())
+  {
+    aSourceElement->SetAttribute("SpillFileDirectory", this->GetBuffer()->GetSpillFileDirectory().c_str());
+  }
+  if (aSourceElement->GetAttribute("CompressFrames") != NULL)
+  {
+    aSourceElement->SetAttribute("CompressFrames", this->GetBuffer()->GetCompressFrames() ? "TRUE" : "FALSE");
+  }
+  if (aSourceElement->GetAttribute("UncompressedFrames") != NULL)
+  {
+    aSourceElement->SetIntAttribute("UncompressedFrames", this->GetBuffer()->GetNumberOfUncompressedFrames());
+  }
+
   // Write custom properties
   if (this->CustomProperties.size() > 0)
   {
@@ -903,6 +1001,18 @@ bool vtkPlusDataSource::GetTimeStampReporting()
   return this->GetBuffer()->GetTimeStampReporting();
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::SetLockFreeReads(bool enable)
+{
+  this->GetBuffer()->SetLockFreeReads(enable);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusDataSource::GetLockFreeReads()
+{
+  return this->GetBuffer()->GetLockFreeReads();
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::WriteToSequenceFile(const char* filename, bool useCompression /*= false */)
 {
@@ -923,6 +1033,36 @@ PlusStatus vtkPlusDataSource::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatu
   return this->GetBuffer()->AddTimeStampedItem(matrix, status, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
 }
 
+//-----------------------------------------------------------------------------
+igsioVideoFrame* vtkPlusDataSource::ReserveItem()
+{
+  return this->GetBuffer()->ReserveItem();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::CommitItem(long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+{
+  return this->GetBuffer()->CommitItem(frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::CancelItem(bool frameModified /*=false*/)
+{
+  this->GetBuffer()->CancelItem(frameModified);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::AddNewItemNotifier(PlusNewItemNotifier* notifier)
+{
+  this->GetBuffer()->AddNewItemNotifier(notifier);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::RemoveNewItemNotifier(PlusNewItemNotifier* notifier)
+{
+  this->GetBuffer()->RemoveNewItemNotifier(notifier);
+}
+
 //-----------------------------------------------------------------------------
 int vtkPlusDataSource::GetNumberOfBytesPerPixel()
 {
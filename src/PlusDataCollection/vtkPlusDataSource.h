@@ -160,6 +160,11 @@ public:
   /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
   bool GetTimeStampReporting();
 
+  /*! If enabled then readers of the buffer do not block the acquisition thread (see vtkPlusTimestampedCircularBuffer) */
+  void SetLockFreeReads(bool enable);
+  /*! Get if lock-free buffer reads are enabled */
+  bool GetLockFreeReads();
+
   /*!
     Set the size of the buffer, i.e. the maximum number of
     video frames that it will hold.  The default is 30.
@@ -260,6 +265,23 @@ public:
   */
   PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
 
+  /*!
+    Reserve the next item of the buffer so that the image can be written directly into the buffer (see vtkPlusBuffer::ReserveItem).
+    The returned frame has the output image orientation of the source, no reorientation or clipping is performed.
+  */
+  virtual igsioVideoFrame* ReserveItem();
+
+  /*! Add the item reserved by ReserveItem to the buffer (see vtkPlusBuffer::CommitItem) */
+  virtual PlusStatus CommitItem(long frameNumber, double unfilteredTimestamp = UNDEFINED_TIMESTAMP, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
+
+  /*! Release the item reserved by ReserveItem without adding it to the buffer (see vtkPlusBuffer::CancelItem) */
+  virtual void CancelItem(bool frameModified = false);
+
+  /*! Register a notifier that is signaled when a new item is added to the buffer (see vtkPlusBuffer::AddNewItemNotifier) */
+  void AddNewItemNotifier(PlusNewItemNotifier* notifier);
+  /*! Unregister a notifier that was registered by AddNewItemNotifier */
+  void RemoveNewItemNotifier(PlusNewItemNotifier* notifier);
+
   /*! Get the device which owns this source. */
   // TODO : consider a re-design of this idea
   void SetDevice(vtkPlusDevice* _arg) { this->Device = _arg; }
@@ -310,7 +332,8 @@ public:
 
   /*! Get type: video or tool. */
   vtkGetMacroConst(Type, DataSourceType);
-  vtkSetMacro(Type, DataSourceType);
+  /*! Set type: video or tool. Buffers of tool data sources only store transforms (see vtkPlusBuffer::SetTransformOnly). */
+  virtual void SetType(DataSourceType type);
 
   /*! Get the frame number (some devices have frame numbering, otherwise just increment if new frame received) */
   vtkGetMacroConst(FrameNumber, unsigned long);
@@ -6,6 +6,9 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusDeadlineScheduler.h"
+#include "PlusMetricsRegistry.h"
+#include "PlusNewItemNotifier.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
@@ -114,6 +117,8 @@ vtkStandardNewMacro(vtkPlusDevice);
 
 const int vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE = 50;
 static const int FRAME_RATE_AVERAGING = 10;
+// Time interval for logging the statistics of the internal update period
+static const double UPDATE_PERIOD_STATISTICS_INTERVAL_SEC = 60.0;
 const std::string vtkPlusDevice::BMODE_PORT_NAME = "B";
 const std::string vtkPlusDevice::RFMODE_PORT_NAME = "Rf";
 const std::string vtkPlusDevice::PARAMETERS_XML_ELEMENT_TAG = "Parameters";
@@ -139,6 +144,12 @@ vtkPlusDevice::vtkPlusDevice()
   , OutputNeedsInitialization(1)
   , CorrectlyConfigured(true)
   , StartThreadForInternalUpdates(false)
+  , EventDrivenUpdate(false)
+  , InputNotifier(NULL)
+  , UpdateThreadPriority(PlusThreadScheduling::PRIORITY_NORMAL)
+  , UpdateThreadPriorityDefined(false)
+  , UpdateThreadRealTimeScheduling(false)
+  , UpdateScheduler(new PlusDeadlineScheduler())
   , LocalTimeOffsetSec(0.0)
   , MissingInputGracePeriodSec(0.0)
   , RequireImageOrientationInConfiguration(false)
@@ -188,6 +199,9 @@ vtkPlusDevice::~vtkPlusDevice()
 
   DELETE_IF_NOT_NULL(this->UpdateMutex);
 
+  delete this->UpdateScheduler;
+  this->UpdateScheduler = NULL;
+
   LOCAL_LOG_TRACE("vtkPlusDevice::~vtkPlusDevice() completed");
 }
 
@@ -199,6 +213,11 @@ void vtkPlusDevice::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Connected: " << (this->Connected ? "Yes\n" : "No\n");
   os << indent << "SDK version: " << this->GetSdkVersion() << std::endl;
   os << indent << "AcquisitionRate: " << this->AcquisitionRate << std::endl;
+  os << indent << "EventDrivenUpdate: " << (this->EventDrivenUpdate ? "On\n" : "Off\n");
+  os << indent << "UpdateThreadPriority: " << (this->UpdateThreadPriorityDefined ? PlusThreadScheduling::GetPriorityAsString(this->UpdateThreadPriority) : "(default)") << std::endl;
+  os << indent << "UpdateThreadRealTimeScheduling: " << (this->UpdateThreadRealTimeScheduling ? "On\n" : "Off\n");
+  os << indent << "UpdateThreadCpuAffinity: " << (this->UpdateThreadCpuAffinity.empty() ? "(all)" : PlusThreadScheduling::GetCpuListAsString(this->UpdateThreadCpuAffinity)) << std::endl;
+  os << indent << "UpdateOverrunPolicy: " << PlusDeadlineScheduler::GetOverrunPolicyAsString(this->UpdateScheduler->GetOverrunPolicy()) << std::endl;
   os << indent << "Recording: " << (this->Recording ? "On\n" : "Off\n");
 
   for (ChannelContainerConstIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
@@ -607,6 +626,12 @@ void vtkPlusDevice::DeepCopy(const vtkPlusDevice& device)
   this->CorrectlyConfigured = device.GetCorrectlyConfigured();
   this->LocalTimeOffsetSec = device.GetLocalTimeOffsetSec();
   this->MissingInputGracePeriodSec = device.GetMissingInputGracePeriodSec();
+  this->EventDrivenUpdate = device.EventDrivenUpdate;
+  this->UpdateThreadPriority = device.UpdateThreadPriority;
+  this->UpdateThreadPriorityDefined = device.UpdateThreadPriorityDefined;
+  this->UpdateThreadRealTimeScheduling = device.UpdateThreadRealTimeScheduling;
+  this->UpdateThreadCpuAffinity = device.UpdateThreadCpuAffinity;
+  this->UpdateScheduler->SetOverrunPolicy(device.UpdateScheduler->GetOverrunPolicy());
   this->RequireImageOrientationInConfiguration = device.RequireImageOrientationInConfiguration;
   this->RequirePortNameInDeviceSetConfiguration = device.RequirePortNameInDeviceSetConfiguration;
   this->Parameters = device.Parameters;
@@ -676,11 +701,29 @@ PlusStatus vtkPlusDevice::SetAcquisitionRate(double aRate)
   }
 
   this->AcquisitionRate = aRate;
+  this->UpdateNominalItemRateOfBuffers();
   this->Modified();
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDevice::UpdateNominalItemRateOfBuffers()
+{
+  for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    it->second->GetBuffer()->SetNominalItemRate(this->AcquisitionRate);
+  }
+  for (DataSourceContainerIterator it = this->Fields.begin(); it != this->Fields.end(); ++it)
+  {
+    it->second->GetBuffer()->SetNominalItemRate(this->AcquisitionRate);
+  }
+  for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
+  {
+    it->second->GetBuffer()->SetNominalItemRate(this->AcquisitionRate);
+  }
+}
+
 //----------------------------------------------------------------------------
 bool vtkPlusDevice::IsRecording() const
 {
@@ -964,6 +1007,54 @@ PlusStatus vtkPlusDevice::ReadConfiguration(vtkXMLDataElement* rootXMLElement)
     deviceXMLElement->GetScalarAttribute("MissingInputGracePeriodSec", this->MissingInputGracePeriodSec);
   }
 
+  const char* eventDrivenUpdate = deviceXMLElement->GetAttribute("EventDrivenUpdate");
+  if (eventDrivenUpdate != NULL)
+  {
+    this->SetEventDrivenUpdate(STRCASECMP(eventDrivenUpdate, "TRUE") == 0);
+  }
+
+  const char* threadPriority = deviceXMLElement->GetAttribute("ThreadPriority");
+  if (threadPriority != NULL)
+  {
+    PlusThreadScheduling::ThreadPriorityType priority(PlusThreadScheduling::PRIORITY_NORMAL);
+    if (PlusThreadScheduling::GetPriorityFromString(threadPriority, priority) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Invalid ThreadPriority attribute value: " << threadPriority);
+      return PLUS_FAIL;
+    }
+    this->SetUpdateThreadPriority(priority);
+  }
+
+  const char* realTimeScheduling = deviceXMLElement->GetAttribute("RealTimeScheduling");
+  if (realTimeScheduling != NULL)
+  {
+    this->SetUpdateThreadRealTimeScheduling(STRCASECMP(realTimeScheduling, "TRUE") == 0);
+  }
+
+  const char* cpuAffinity = deviceXMLElement->GetAttribute("CpuAffinity");
+  if (cpuAffinity != NULL)
+  {
+    std::vector<int> cpuList;
+    if (PlusThreadScheduling::GetCpuListFromString(cpuAffinity, cpuList) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Invalid CpuAffinity attribute value: " << cpuAffinity);
+      return PLUS_FAIL;
+    }
+    this->SetUpdateThreadCpuAffinity(cpuList);
+  }
+
+  const char* updateOverrunPolicy = deviceXMLElement->GetAttribute("UpdateOverrunPolicy");
+  if (updateOverrunPolicy != NULL)
+  {
+    PlusDeadlineScheduler::OverrunPolicyType policy(PlusDeadlineScheduler::OVERRUN_SKIP);
+    if (PlusDeadlineScheduler::GetOverrunPolicyFromString(updateOverrunPolicy, policy) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Invalid UpdateOverrunPolicy attribute value: " << updateOverrunPolicy);
+      return PLUS_FAIL;
+    }
+    this->UpdateScheduler->SetOverrunPolicy(policy);
+  }
+
   vtkXMLDataElement* dataSourcesElement = deviceXMLElement->FindNestedElementWithName("DataSources");
   if (dataSourcesElement != NULL)
   {
@@ -1049,6 +1140,8 @@ PlusStatus vtkPlusDevice::ReadConfiguration(vtkXMLDataElement* rootXMLElement)
   {
     LOCAL_LOG_DEBUG("Unable to find acquisition rate in device element when it is required, using default " << this->GetAcquisitionRate());
   }
+  // SetAcquisitionRate does not update the buffers if the rate is unchanged, so make sure the data sources read above get the rate
+  this->UpdateNominalItemRateOfBuffers();
 
   vtkXMLDataElement* outputChannelsElement = deviceXMLElement->FindNestedElementWithName("OutputChannels");
   if (outputChannelsElement != NULL)
@@ -1201,6 +1294,28 @@ PlusStatus vtkPlusDevice::WriteConfiguration(vtkXMLDataElement* config)
     deviceDataElement->SetDoubleAttribute("LocalTimeOffsetSec", this->GetLocalTimeOffsetSec());
   }
 
+  if (this->EventDrivenUpdate || deviceDataElement->GetAttribute("EventDrivenUpdate") != NULL)
+  {
+    deviceDataElement->SetAttribute("EventDrivenUpdate", this->EventDrivenUpdate ? "TRUE" : "FALSE");
+  }
+
+  if (this->UpdateThreadPriorityDefined)
+  {
+    deviceDataElement->SetAttribute("ThreadPriority", PlusThreadScheduling::GetPriorityAsString(this->UpdateThreadPriority).c_str());
+  }
+  if (this->UpdateThreadRealTimeScheduling || deviceDataElement->GetAttribute("RealTimeScheduling") != NULL)
+  {
+    deviceDataElement->SetAttribute("RealTimeScheduling", this->UpdateThreadRealTimeScheduling ? "TRUE" : "FALSE");
+  }
+  if (!this->UpdateThreadCpuAffinity.empty() || deviceDataElement->GetAttribute("CpuAffinity") != NULL)
+  {
+    deviceDataElement->SetAttribute("CpuAffinity", PlusThreadScheduling::GetCpuListAsString(this->UpdateThreadCpuAffinity).c_str());
+  }
+  if (this->UpdateScheduler->GetOverrunPolicy() != PlusDeadlineScheduler::OVERRUN_SKIP || deviceDataElement->GetAttribute("UpdateOverrunPolicy") != NULL)
+  {
+    deviceDataElement->SetAttribute("UpdateOverrunPolicy", PlusDeadlineScheduler::GetOverrunPolicyAsString(this->UpdateScheduler->GetOverrunPolicy()).c_str());
+  }
+
   // Parameters writing
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(parameterList, deviceDataElement, PARAMETERS_XML_ELEMENT_TAG.c_str());
 
@@ -1240,6 +1355,12 @@ PlusStatus vtkPlusDevice::Connect()
     return PLUS_FAIL;
   }
 
+  // Map the frame memory now, so that filling the buffers for the first time does not cause page faults during acquisition
+  for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
+  {
+    it->second->GetBuffer()->PrefaultFrameMemory();
+  }
+
   this->Connected = 1;
 
   return PLUS_SUCCESS;
@@ -1289,6 +1410,19 @@ PlusStatus vtkPlusDevice::StartRecording()
     }
   }
 
+  // The buffers of the data sources that this device owns are reported in the metrics (the device ID is known by now)
+  DataSourceContainer* sourceContainers[] = { &this->Tools, &this->Fields, &this->VideoSources };
+  for (unsigned int i = 0; i < sizeof(sourceContainers) / sizeof(sourceContainers[0]); ++i)
+  {
+    for (DataSourceContainerIterator it = sourceContainers[i]->begin(); it != sourceContainers[i]->end(); ++it)
+    {
+      if (it->second->GetDevice() == this && it->second->GetBuffer() != NULL)
+      {
+        it->second->GetBuffer()->SetMetricsOwner(this->GetDeviceId(), it->second->GetId());
+      }
+    }
+  }
+
   if (this->InternalStartRecording() != PLUS_SUCCESS)
   {
     LOCAL_LOG_ERROR("Cannot start recording, internal StartRecording failed");
@@ -1300,6 +1434,14 @@ PlusStatus vtkPlusDevice::StartRecording()
 
   if (this->StartThreadForInternalUpdates)
   {
+    if (this->EventDrivenUpdate && !this->InputChannels.empty())
+    {
+      this->InputNotifier = new PlusNewItemNotifier();
+      for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
+      {
+        (*it)->AddNewItemNotifier(this->InputNotifier);
+      }
+    }
     this->ThreadId =
       this->Threader->SpawnThread((vtkThreadFunctionType)\
                                   &vtkDataCaptureThread, this);
@@ -1326,6 +1468,12 @@ PlusStatus vtkPlusDevice::StopRecording()
   this->ThreadId = -1;
   this->Recording = 0;
 
+  if (this->InputNotifier != NULL)
+  {
+    // Wake up the internal update thread so that it does not wait for the next input item
+    this->InputNotifier->Notify();
+  }
+
   if (this->GetStartThreadForInternalUpdates())
   {
     LOCAL_LOG_DEBUG("Wait for internal update thread to terminate");
@@ -1338,6 +1486,16 @@ PlusStatus vtkPlusDevice::StopRecording()
     LOCAL_LOG_DEBUG("Internal update thread terminated");
   }
 
+  if (this->InputNotifier != NULL)
+  {
+    for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
+    {
+      (*it)->RemoveNewItemNotifier(this->InputNotifier);
+    }
+    delete this->InputNotifier;
+    this->InputNotifier = NULL;
+  }
+
   if (this->InternalStopRecording() != PLUS_SUCCESS)
   {
     LOCAL_LOG_ERROR("Failed to stop tracking thread!");
@@ -1360,9 +1518,40 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
   unsigned long updatecount = 0;
   self->ThreadAlive = true;
 
+  self->ApplyUpdateThreadScheduling();
+
+  // Report the achieved update rate and jitter regularly, more visibly if the thread scheduling was configured
+  vtkPlusLogger::LogLevelType periodStatisticsLogLevel = vtkPlusLogger::LOG_LEVEL_DEBUG;
+  if (self->UpdateThreadPriorityDefined || self->UpdateThreadRealTimeScheduling || !self->UpdateThreadCpuAffinity.empty())
+  {
+    periodStatisticsLogLevel = vtkPlusLogger::LOG_LEVEL_INFO;
+  }
+  double periodStatisticsLogTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  // Updates are scheduled at absolute deadlines, so a late update does not delay all the following updates
+  PlusDeadlineScheduler* scheduler = self->UpdateScheduler;
+  scheduler->SetPeriodSec(1.0 / rate);
+  scheduler->ResetStatistics();
+  scheduler->Start();
+
+  std::string deviceId = self->GetDeviceId();
+  PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+  PlusMetric* updatesMetric = registry->GetMetric("plus_device_updates_total", "Number of internal updates of the device", PlusMetric::METRIC_COUNTER, "device", deviceId);
+  PlusMetric* updateRateMetric = registry->GetMetric("plus_device_update_rate_hz", "Achieved internal update rate of the device", PlusMetric::METRIC_GAUGE, "device", deviceId);
+  PlusMetric* overrunsMetric = registry->GetMetric("plus_device_update_overruns_total", "Number of internal updates that did not complete before the next deadline", PlusMetric::METRIC_COUNTER, "device", deviceId);
+  // counters are cumulative, while the scheduler statistics are reset whenever recording is started
+  double updatesAtStart = updatesMetric->Get();
+  double overrunsAtStart = overrunsMetric->Get();
+
   while (self->IsRecording() && self->GetCorrectlyConfigured())
   {
     double newtime = vtkIGSIOAccurateTimer::GetSystemTime();
+    scheduler->BeginUpdate();
+    if (newtime - periodStatisticsLogTime > UPDATE_PERIOD_STATISTICS_INTERVAL_SEC)
+    {
+      LOG_DYNAMIC(self->GetDeviceId() << ": internal " << scheduler->GetStatisticsAsString(), periodStatisticsLogLevel);
+      periodStatisticsLogTime = newtime;
+    }
     // get current tracking rate over last few updates
     double difftime = newtime - currtime[updatecount % FRAME_RATE_AVERAGING];
     currtime[updatecount % FRAME_RATE_AVERAGING] = newtime;
@@ -1383,19 +1572,87 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
       self->UpdateTime.Modified();
     }
 
-    double delay = (newtime + 1.0 / rate - vtkIGSIOAccurateTimer::GetSystemTime());
-    if (delay > 0)
+    scheduler->EndUpdate();
+    updatesMetric->Set(updatesAtStart + scheduler->GetNumberOfUpdates());
+    overrunsMetric->Set(overrunsAtStart + scheduler->GetNumberOfOverruns());
+    updateRateMetric->Set(self->InternalUpdateRate);
+    if (self->InputNotifier != NULL)
+    {
+      // Update as soon as new input is available, the acquisition rate only limits the waiting time
+      self->InputNotifier->WaitForNewItem(scheduler->GetTimeUntilNextDeadlineSec());
+    }
+    else
     {
-      vtkIGSIOAccurateTimer::Delay(delay);
+      scheduler->SleepUntilNextDeadline();
     }
 
     updatecount++;
   }
+  updateRateMetric->Set(0);
+
+  if (scheduler->GetNumberOfUpdates() > 1)
+  {
+    LOG_DYNAMIC(self->GetDeviceId() << ": internal " << scheduler->GetStatisticsAsString(), periodStatisticsLogLevel);
+  }
 
   self->ThreadAlive = false;
   return NULL;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDevice::ApplyUpdateThreadScheduling()
+{
+  if (this->UpdateThreadPriorityDefined || this->UpdateThreadRealTimeScheduling)
+  {
+    if (PlusThreadScheduling::SetCurrentThreadPriority(this->UpdateThreadPriority, this->UpdateThreadRealTimeScheduling) == PLUS_SUCCESS)
+    {
+      LOCAL_LOG_INFO("Internal update thread priority: " << PlusThreadScheduling::GetPriorityAsString(this->UpdateThreadPriority)
+                     << (this->UpdateThreadRealTimeScheduling ? " (real-time scheduling)" : ""));
+    }
+    else
+    {
+      LOCAL_LOG_WARNING("Internal update thread priority could not be fully applied, the thread may be preempted by other processes");
+    }
+  }
+
+  if (!this->UpdateThreadCpuAffinity.empty())
+  {
+    if (PlusThreadScheduling::SetCurrentThreadAffinity(this->UpdateThreadCpuAffinity) == PLUS_SUCCESS)
+    {
+      LOCAL_LOG_INFO("Internal update thread CPU affinity: " << PlusThreadScheduling::GetCpuListAsString(this->UpdateThreadCpuAffinity));
+    }
+    else
+    {
+      LOCAL_LOG_WARNING("Internal update thread CPU affinity could not be applied, the thread may run on any CPU");
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDevice::SetUpdateThreadPriority(PlusThreadScheduling::ThreadPriorityType priority)
+{
+  this->UpdateThreadPriority = priority;
+  this->UpdateThreadPriorityDefined = true;
+}
+
+//----------------------------------------------------------------------------
+PlusThreadScheduling::ThreadPriorityType vtkPlusDevice::GetUpdateThreadPriority() const
+{
+  return this->UpdateThreadPriority;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDevice::SetUpdateThreadCpuAffinity(const std::vector<int>& cpuList)
+{
+  this->UpdateThreadCpuAffinity = cpuList;
+}
+
+//----------------------------------------------------------------------------
+std::vector<int> vtkPlusDevice::GetUpdateThreadCpuAffinity() const
+{
+  return this->UpdateThreadCpuAffinity;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::InternalConnect()
 {
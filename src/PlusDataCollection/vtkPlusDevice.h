@@ -11,6 +11,7 @@ See License.txt for details.
 #include "igsioCommon.h"
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
+#include "PlusThreadScheduling.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataCollectionExport.h"
 
@@ -23,7 +24,10 @@ See License.txt for details.
 
 // STL includes
 #include <string>
+#include <vector>
 
+class PlusDeadlineScheduler;
+class PlusNewItemNotifier;
 class vtkPlusBuffer;
 class vtkPlusDataCollector;
 class vtkPlusDataSource;
@@ -417,6 +421,44 @@ public:
   vtkSetMacro(MissingInputGracePeriodSec, double);
   double GetMissingInputGracePeriodSec() const;
 
+  /*!
+    If enabled, the internal update thread is woken up as soon as a new item is added to any of the input channels,
+    instead of polling the inputs at the acquisition rate. The acquisition rate is still used as the maximum waiting time,
+    so the device is updated at least that often even if no new input arrives.
+    Only has effect for devices that have input channels and use the internal update thread. Must be set before StartRecording.
+  */
+  vtkSetMacro(EventDrivenUpdate, bool);
+  vtkGetMacro(EventDrivenUpdate, bool);
+  vtkBooleanMacro(EventDrivenUpdate, bool);
+
+  /*!
+    Scheduling priority of the internal update thread. The thread keeps the default priority of the process unless a priority is set.
+    Applied when the thread is started (must be set before StartRecording). If the priority cannot be set
+    (e.g., because of insufficient privileges) then a warning is logged and the thread runs with the default priority.
+  */
+  void SetUpdateThreadPriority(PlusThreadScheduling::ThreadPriorityType priority);
+  PlusThreadScheduling::ThreadPriorityType GetUpdateThreadPriority() const;
+
+  /*!
+    If enabled, the internal update thread uses real-time scheduling (SCHED_FIFO on Linux) with the configured priority.
+    Falls back to normal scheduling if real-time scheduling is not permitted. Must be set before StartRecording.
+  */
+  vtkSetMacro(UpdateThreadRealTimeScheduling, bool);
+  vtkGetMacro(UpdateThreadRealTimeScheduling, bool);
+  vtkBooleanMacro(UpdateThreadRealTimeScheduling, bool);
+
+  /*! CPUs that the internal update thread may run on. Empty list means all CPUs. Must be set before StartRecording. */
+  void SetUpdateThreadCpuAffinity(const std::vector<int>& cpuList);
+  std::vector<int> GetUpdateThreadCpuAffinity() const;
+
+  /*!
+    Scheduler of the internal update thread. Updates are performed at absolute deadlines (multiples of 1/AcquisitionRate),
+    what happens after an overrun is determined by the overrun policy (UpdateOverrunPolicy attribute: Skip or CatchUp).
+    The scheduler collects the statistics (including a histogram) of the difference between the achieved and requested update period
+    since the recording was started.
+  */
+  PlusDeadlineScheduler* GetUpdateScheduler() const { return this->UpdateScheduler; }
+
   /*!
     Creates a default output channel for the device with the name channelId or "OutputChannel".
     \param addSource If true then for imaging devices a default 'Video' source is added to the output.
@@ -463,6 +505,9 @@ protected:
   */
   virtual PlusStatus InternalStopRecording();
 
+  /*! Set the acquisition rate as nominal item rate in all data source buffers (used for resolving the BufferSizeSec attribute) */
+  void UpdateNominalItemRateOfBuffers();
+
   /*!
   This function can be called to add a video item to the specified video data sources
   */
@@ -515,6 +560,9 @@ protected:
   /*! Ensure uniqueness of given ID */
   PlusStatus EnsureUniqueDataSourceId(const std::string& aSourceId);
 
+  /*! Apply the configured priority and CPU affinity to the calling thread (the internal update thread) */
+  void ApplyUpdateThreadScheduling();
+
   vtkSetMacro(CorrectlyConfigured, bool);
 
   vtkSetMacro(StartThreadForInternalUpdates, bool);
@@ -587,6 +635,25 @@ protected:
   */
   bool StartThreadForInternalUpdates;
 
+  /*! If enabled, the internal update thread waits for new input items instead of polling at a fixed rate */
+  bool EventDrivenUpdate;
+
+  /*! Wakes up the internal update thread when a new item is added to an input channel. Only exists while recording in event-driven mode. */
+  PlusNewItemNotifier* InputNotifier;
+
+  /*! Scheduling priority of the internal update thread, only applied if UpdateThreadPriorityDefined is true */
+  PlusThreadScheduling::ThreadPriorityType UpdateThreadPriority;
+  bool UpdateThreadPriorityDefined;
+
+  /*! Use real-time scheduling for the internal update thread */
+  bool UpdateThreadRealTimeScheduling;
+
+  /*! CPUs that the internal update thread may run on, all CPUs if empty */
+  std::vector<int> UpdateThreadCpuAffinity;
+
+  /*! Deadline scheduling and update period statistics of the internal update thread */
+  PlusDeadlineScheduler* UpdateScheduler;
+
   /*! Value to use when mixing data with another temporally calibrated device*/
   double LocalTimeOffsetSec;
 
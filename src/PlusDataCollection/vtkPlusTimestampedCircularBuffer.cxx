@@ -12,14 +12,26 @@ See License.txt for details.
 #include "vtkTable.h"
 #include "vtkVariantArray.h"
 
+#include <thread>
+
 vtkStandardNewMacro(vtkPlusTimestampedCircularBuffer);
 
+namespace
+{
+  // Number of times a lock-free search is restarted if the writer overwrites items that are being searched
+  const int LOCK_FREE_READ_MAX_ATTEMPTS = 5;
+
+  // Number of times a lock-free reader yields while waiting for an in-place item update (it only swaps data, so it completes quickly)
+  const int ITEM_UPDATE_MAX_WAIT_ATTEMPTS = 1000;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   : Mutex(vtkIGSIORecursiveCriticalSection::New())
   , NumberOfItems(0)
   , WritePointer(0)
   , CurrentTimeStamp(0.0)
+  , PreviousTimeStamp(0.0)
   , LocalTimeOffsetSec(0.0)
   , LatestItemUid(0)
   , AveragedItemsForFiltering(20)
@@ -29,12 +41,26 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   , TimeStampLogging(false)
   , StartTime(0)
   , NegligibleTimeDifferenceSec(1e-5)
+  , LockFreeReads(false)
+  , SlotIndexOffset(0)
+  , PublishedLatestItemUid(0)
+  , PublishedNumberOfItems(0)
+  , ActiveLockFreeReaders(0)
+  , SlotStorageChanging(false)
+  , SlotStorageChangeDepth(0)
+  , ItemReserved(false)
+  , ReservedSlotRemovedItemUid(0)
+  , RestoredItemUid(0)
+  , TimeLookupHintUid(0)
+  , NumberOfOverwrittenItems(0)
+  , NumberOfRejectedItems(0)
 {
   this->BufferItemContainer.resize(0);
   this->FilterContainerIndexVector.set_size(0);
   this->FilterContainerTimestampVector.set_size(0);
   this->FilterContainersOldestIndex = 0;
   this->FilterContainersNumberOfValidElements = 0;
+  this->RecomputeFilterSums();
 }
 
 //----------------------------------------------------------------------------
@@ -67,6 +93,7 @@ void vtkPlusTimestampedCircularBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "CurrentTimeStamp: " << this->CurrentTimeStamp << "\n";
   os << indent << "Local time offset: " << this->LocalTimeOffsetSec << "\n";
   os << indent << "Latest Item Uid: " << this->LatestItemUid << "\n";
+  os << indent << "Lock-free reads: " << (this->LockFreeReads ? "enabled" : "disabled") << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -74,15 +101,28 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
 {
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
+  if (this->ItemReserved)
+  {
+    LOG_ERROR("Failed to add new item to the buffer - the slot is reserved for an item that has not been committed yet.");
+    return PLUS_FAIL;
+  }
+
   if (timestamp <= this->CurrentTimeStamp)
   {
     LOG_DEBUG("Need to skip newly added frame - new timestamp (" << std::fixed << timestamp << ") is not newer than the last one (" << this->CurrentTimeStamp << ")!");
+    this->NumberOfRejectedItems++;
     return PLUS_FAIL;
   }
 
+  if (this->NumberOfItems >= this->GetBufferSize())
+  {
+    this->RemoveItemFromSlot(this->WritePointer);
+  }
+
   // Increase frame unique ID
   newFrameUid = ++this->LatestItemUid;
   bufferIndex = this->WritePointer;
+  this->PreviousTimeStamp = this->CurrentTimeStamp;
   this->CurrentTimeStamp = timestamp;
 
   this->NumberOfItems++;
@@ -96,9 +136,422 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
     this->WritePointer = 0;
   }
 
+  this->BeginSlotWrite(bufferIndex, newFrameUid);
+
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::ReserveNewItem(int& bufferIndex)
+{
+  // the caller must have locked the buffer
+  if (this->ItemReserved)
+  {
+    LOG_ERROR("Failed to reserve buffer item - an item is already reserved.");
+    return PLUS_FAIL;
+  }
+  if (this->GetBufferSize() <= 0)
+  {
+    LOG_ERROR("Failed to reserve buffer item - buffer size is 0.");
+    return PLUS_FAIL;
+  }
+
+  bufferIndex = this->WritePointer;
+  this->ReservedSlotRemovedItemUid = 0;
+  if (this->NumberOfItems >= this->GetBufferSize())
+  {
+    // The slot contains the oldest item. Remove it from the buffer, so that readers never access the slot while it is being filled.
+    this->ReservedSlotRemovedItemUid = this->BufferItemContainer[bufferIndex].GetUid();
+    this->RemoveItemFromSlot(bufferIndex);
+    this->NumberOfItems = this->GetBufferSize() - 1;
+    this->PublishedNumberOfItems.store(this->NumberOfItems, std::memory_order_release);
+  }
+  // Wait for lock-free readers that are still copying the removed item
+  this->BeginSlotWrite(bufferIndex, this->LatestItemUid + 1);
+
+  this->ItemReserved = true;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ReleaseReservedItem(bool restoreRemovedItem /*=false*/)
+{
+  // the caller must have locked the buffer
+  if (restoreRemovedItem && this->ItemReserved && this->ReservedSlotRemovedItemUid != 0)
+  {
+    // The slot content is unchanged, so the oldest item is valid again. It has already been passed to ItemRemovedCallback.
+    const int bufferIndex = this->WritePointer;
+    this->NumberOfOverwrittenItems--;
+    this->RestoredItemUid = this->ReservedSlotRemovedItemUid;
+    this->NumberOfItems = this->GetBufferSize();
+    this->SlotStates[bufferIndex].Sequence.store(2 * this->ReservedSlotRemovedItemUid, std::memory_order_release);
+    this->PublishedNumberOfItems.store(this->NumberOfItems, std::memory_order_release);
+  }
+  this->ReservedSlotRemovedItemUid = 0;
+  this->ItemReserved = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RemoveItemFromSlot(const int bufferIndex)
+{
+  // the caller must have locked the buffer
+  this->NumberOfOverwrittenItems++;
+  StreamBufferItem& item = this->BufferItemContainer[bufferIndex];
+  if (this->ItemRemovedCallback && item.GetUid() != this->RestoredItemUid)
+  {
+    // The slot contains the oldest item, pass it on (e.g., to the spill file) before it is overwritten
+    this->ItemRemovedCallback(item);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::CommitNewItem(const BufferItemUidType uid, const int bufferIndex)
+{
+  // the caller must have locked the buffer
+  if (bufferIndex < 0 || bufferIndex >= static_cast<int>(this->SlotStates.size()))
+  {
+    LOG_ERROR("Failed to commit buffer item - index is out of range (bufferIndex: " << bufferIndex << ").");
+    return;
+  }
+  this->FilteredTimestampIndex[bufferIndex] = this->BufferItemContainer[bufferIndex].GetFilteredTimestamp(0);
+  // Release: readers that see the new sequence number see the complete item content
+  this->SlotStates[bufferIndex].Sequence.store(2 * uid, std::memory_order_release);
+  if (uid > this->PublishedLatestItemUid.load(std::memory_order_relaxed))
+  {
+    // The number of items is published first, so a reader that sees the new latest UID never computes an oldest UID that is too new
+    this->PublishedNumberOfItems.store(this->NumberOfItems, std::memory_order_release);
+    this->PublishedLatestItemUid.store(uid, std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::CancelNewItem(const BufferItemUidType uid, const int bufferIndex)
+{
+  // the caller must have locked the buffer
+  if (uid != this->LatestItemUid || bufferIndex < 0 || bufferIndex >= this->GetBufferSize() || (bufferIndex + 1) % this->GetBufferSize() != this->WritePointer)
+  {
+    LOG_ERROR("Failed to cancel buffer item - it is not the most recently prepared item (uid: " << uid << ", bufferIndex: " << bufferIndex << ").");
+    return;
+  }
+
+  this->LatestItemUid--;
+  this->WritePointer = bufferIndex;
+  this->CurrentTimeStamp = this->PreviousTimeStamp;
+  // If the buffer was full then NumberOfItems was not incremented, but the oldest item was in the slot and it is lost now
+  this->NumberOfItems--;
+
+  // The slot is outside the range of published items now, so its odd sequence number and its entry
+  // in the timestamp index are not accessed by readers. The slot is reused by the next item, with the same UID.
+  this->PublishedNumberOfItems.store(this->NumberOfItems, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::ReopenItemForWriting(const BufferItemUidType uid, StreamBufferItem*& itemPtr, int& bufferIndex)
+{
+  // the caller must have locked the buffer
+  ItemStatus status = this->GetBufferItemPointerFromUid(uid, itemPtr);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  bufferIndex = this->GetSlotIndexFromUid(uid);
+  this->BeginSlotWrite(bufferIndex, uid);
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::UpdateCommittedItem(const BufferItemUidType uid, const std::function<void(StreamBufferItem&)>& updateItem)
+{
+  // the caller must have locked the buffer
+  StreamBufferItem* itemPtr = NULL;
+  int bufferIndex(0);
+  ItemStatus status = this->ReopenItemForWriting(uid, itemPtr, bufferIndex);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  updateItem(*itemPtr);
+  this->CommitNewItem(uid, bufferIndex);
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusTimestampedCircularBuffer::LoadSlotSequenceForReading(const SlotState& slot, const BufferItemUidType uid) const
+{
+  BufferItemUidType sequence = slot.Sequence.load(std::memory_order_acquire);
+  // The item is already published, so an odd sequence number with its own UID means that it is being updated in place
+  for (int attempt = 0; sequence == 2 * uid + 1 && attempt < ITEM_UPDATE_MAX_WAIT_ATTEMPTS; ++attempt)
+  {
+    std::this_thread::yield();
+    sequence = slot.Sequence.load(std::memory_order_acquire);
+  }
+  return sequence;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::BeginSlotWrite(const int bufferIndex, const BufferItemUidType uid)
+{
+  // the caller must have locked the buffer
+  if (bufferIndex < 0 || bufferIndex >= static_cast<int>(this->SlotStates.size()))
+  {
+    // buffer is empty, the caller will report the error
+    return;
+  }
+  SlotState& slot = this->SlotStates[bufferIndex];
+
+  // An odd sequence number tells readers that the slot content is being changed.
+  // Sequentially consistent store and load: either the reader sees the odd sequence number
+  // after pinning the slot or the writer sees the pin and waits for the reader to finish copying.
+  slot.Sequence.store(2 * uid + 1);
+  // Seqlock readers that only read timestamps do not pin the slot, they must not see new data with the old sequence number
+  std::atomic_thread_fence(std::memory_order_release);
+  while (slot.Readers.load() > 0)
+  {
+    // A reader is copying the item that is about to be overwritten (the oldest item), it takes only a copy time
+    std::this_thread::yield();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::BeginSlotStorageChange()
+{
+  // the caller must have locked the buffer
+  if (this->SlotStorageChangeDepth++ > 0)
+  {
+    return;
+  }
+  // Sequentially consistent store and load (same as in EnterLockFreeRead): either the reader sees
+  // the flag and backs off or the writer sees the reader and waits until it leaves
+  this->SlotStorageChanging.store(true);
+  while (this->ActiveLockFreeReaders.load() > 0)
+  {
+    std::this_thread::yield();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::EndSlotStorageChange()
+{
+  // the caller must have locked the buffer
+  if (this->SlotStorageChangeDepth <= 0)
+  {
+    LOG_ERROR("EndSlotStorageChange is called without BeginSlotStorageChange");
+    return;
+  }
+  if (--this->SlotStorageChangeDepth == 0)
+  {
+    this->SlotStorageChanging.store(false, std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTimestampedCircularBuffer::EnterLockFreeRead()
+{
+  this->ActiveLockFreeReaders.fetch_add(1);
+  if (this->SlotStorageChanging.load())
+  {
+    this->ActiveLockFreeReaders.fetch_sub(1, std::memory_order_release);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::LeaveLockFreeRead()
+{
+  // Release: the slot storage may only be changed after the reader finished accessing it
+  this->ActiveLockFreeReaders.fetch_sub(1, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ResetSlotStates()
+{
+  // the caller must have locked the buffer
+  const BufferItemUidType bufferSize = this->BufferItemContainer.size();
+  if (this->SlotStates.size() != bufferSize)
+  {
+    // Slot states are not copyable, so the vector is reconstructed (lock-free readers are kept out by BeginSlotStorageChange)
+    std::vector<SlotState> newSlotStates(bufferSize);
+    this->SlotStates.swap(newSlotStates);
+  }
+
+  // Item at WritePointer-1 has the LatestItemUid
+  this->SlotIndexOffset = (bufferSize > 0) ? (this->WritePointer + bufferSize - 1 - this->LatestItemUid % bufferSize) % bufferSize : 0;
+
+  for (std::vector<SlotState>::iterator it = this->SlotStates.begin(); it != this->SlotStates.end(); ++it)
+  {
+    it->Sequence.store(0, std::memory_order_relaxed);
+  }
+
+  // Items may have been moved between slots, rebuild the timestamp index
+  this->FilteredTimestampIndex.resize(bufferSize);
+  for (BufferItemUidType bufferIndex = 0; bufferIndex < bufferSize; ++bufferIndex)
+  {
+    this->FilteredTimestampIndex[bufferIndex] = this->BufferItemContainer[bufferIndex].GetFilteredTimestamp(0);
+  }
+  if (bufferSize > 0 && this->NumberOfItems > 0)
+  {
+    for (BufferItemUidType uid = this->LatestItemUid - (this->NumberOfItems - 1); uid <= this->LatestItemUid; ++uid)
+    {
+      this->SlotStates[this->GetSlotIndexFromUid(uid)].Sequence.store(2 * uid, std::memory_order_relaxed);
+    }
+  }
+
+  this->PublishedNumberOfItems.store(this->NumberOfItems, std::memory_order_release);
+  this->PublishedLatestItemUid.store(this->LatestItemUid, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::SetLockFreeReads(bool enable)
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+  if (this->LockFreeReads == enable)
+  {
+    return;
+  }
+  this->LockFreeReads = enable;
+  this->ResetSlotStates();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::AcquireItemForReading(const BufferItemUidType uid, StreamBufferItem*& itemPtr)
+{
+  itemPtr = NULL;
+  if (!this->LockFreeReads)
+  {
+    this->Lock();
+    ItemStatus status = this->GetBufferItemPointerFromUid(uid, itemPtr);
+    if (status != ITEM_OK)
+    {
+      this->Unlock();
+    }
+    return status;
+  }
+
+  // The reader stays registered until ReleaseItemForReading, so the slot storage is not changed while the item is used
+  if (!this->EnterLockFreeRead())
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  ItemStatus status = this->GetPublishedItemStatus(uid);
+  if (status != ITEM_OK)
+  {
+    this->LeaveLockFreeRead();
+    return status;
+  }
+
+  const int bufferIndex = this->GetSlotIndexFromUid(uid);
+  SlotState& slot = this->SlotStates[bufferIndex];
+  for (int attempt = 0; ; ++attempt)
+  {
+    slot.Readers.fetch_add(1);
+    const BufferItemUidType sequence = slot.Sequence.load();
+    if (sequence == 2 * uid)
+    {
+      break;
+    }
+    // Slot is being written or it contains another item already. The pin is removed while waiting, as the writer waits for it.
+    slot.Readers.fetch_sub(1, std::memory_order_release);
+    if (attempt == 0 && this->LoadSlotSequenceForReading(slot, uid) == 2 * uid)
+    {
+      // in-place update of the item is completed
+      continue;
+    }
+    this->LeaveLockFreeRead();
+    return (sequence / 2 > uid) ? ITEM_NOT_AVAILABLE_ANYMORE : ITEM_NOT_AVAILABLE_YET;
+  }
+
+  itemPtr = &this->BufferItemContainer[bufferIndex];
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ReleaseItemForReading(const BufferItemUidType uid)
+{
+  if (!this->LockFreeReads)
+  {
+    this->Unlock();
+    return;
+  }
+  // Release: the writer may only modify the slot after the reader finished copying it
+  this->SlotStates[this->GetSlotIndexFromUid(uid)].Readers.fetch_sub(1, std::memory_order_release);
+  this->LeaveLockFreeRead();
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetPublishedItemStatus(const BufferItemUidType uid)
+{
+  if (this->SlotStates.empty())
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  const BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+  const int numberOfItems = this->PublishedNumberOfItems.load(std::memory_order_acquire);
+  if (numberOfItems < 1 || uid > latestUid)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  if (uid + numberOfItems <= latestUid)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::ReadItemLockFree(const BufferItemUidType uid, double* filteredTimestamp, double* unfilteredTimestamp, unsigned long* index)
+{
+  LockFreeReadScope readScope(this);
+  if (!readScope.IsEntered())
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  ItemStatus status = this->GetPublishedItemStatus(uid);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+
+  const int bufferIndex = this->GetSlotIndexFromUid(uid);
+  const SlotState& slot = this->SlotStates[bufferIndex];
+  StreamBufferItem& item = this->BufferItemContainer[bufferIndex];
+
+  for (int attempt = 0; attempt < LOCK_FREE_READ_MAX_ATTEMPTS; ++attempt)
+  {
+    const BufferItemUidType sequence = this->LoadSlotSequenceForReading(slot, uid);
+    if (sequence != 2 * uid)
+    {
+      return (sequence / 2 > uid) ? ITEM_NOT_AVAILABLE_ANYMORE : ITEM_NOT_AVAILABLE_YET;
+    }
+    const double itemFilteredTimestamp = item.GetFilteredTimestamp(this->LocalTimeOffsetSec);
+    const double itemUnfilteredTimestamp = item.GetUnfilteredTimestamp(this->LocalTimeOffsetSec);
+    const unsigned long itemIndex = item.GetIndex();
+    // If the writer started to modify the slot while we were reading then the values may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+    {
+      // read again, the sequence number tells if the item was overwritten or it was just updated in place
+      continue;
+    }
+
+    if (filteredTimestamp != NULL)
+    {
+      *filteredTimestamp = itemFilteredTimestamp;
+    }
+    if (unfilteredTimestamp != NULL)
+    {
+      *unfilteredTimestamp = itemUnfilteredTimestamp;
+    }
+    if (index != NULL)
+    {
+      *index = itemIndex;
+    }
+    return ITEM_OK;
+  }
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
 //----------------------------------------------------------------------------
 // Sets the buffer size, and copies the maximum number of the most current old
 // frames and timestamps
@@ -117,6 +570,9 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
     return PLUS_SUCCESS;
   }
 
+  // Items are moved between slots and the slot storage is reallocated
+  this->BeginSlotStorageChange();
+
   if (this->GetBufferSize() == 0)
   {
     for (int i = 0; i < newBufferSize; i++)
@@ -161,6 +617,11 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
     this->NumberOfItems = this->GetBufferSize();
   }
 
+  // slots are moved, a reserved slot would not be at the write pointer anymore
+  this->ItemReserved = false;
+  this->ResetSlotStates();
+  this->EndSlotStorageChange();
+
   this->Modified();
 
   return PLUS_SUCCESS;
@@ -209,6 +670,16 @@ StreamBufferItem* vtkPlusTimestampedCircularBuffer::GetBufferItemPointerFromBuff
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferItemUidType uid, double& filteredTimestamp)
 {
+  if (this->LockFreeReads)
+  {
+    ItemStatus status = this->ReadItemLockFree(uid, &filteredTimestamp, NULL, NULL);
+    if (status != ITEM_OK)
+    {
+      filteredTimestamp = 0;
+    }
+    return status;
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -224,6 +695,16 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferIt
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetUnfilteredTimeStamp(const BufferItemUidType uid, double& unfilteredTimestamp)
 {
+  if (this->LockFreeReads)
+  {
+    ItemStatus status = this->ReadItemLockFree(uid, NULL, &unfilteredTimestamp, NULL);
+    if (status != ITEM_OK)
+    {
+      unfilteredTimestamp = 0;
+    }
+    return status;
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -239,6 +720,11 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetUnfilteredTimeStamp(const Buffer
 //----------------------------------------------------------------------------
 bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidVideoData()
 {
+  if (this->LockFreeReads)
+  {
+    return this->GetLatestItemHasValidDataLockFree(&StreamBufferItem::HasValidVideoData);
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   if (this->NumberOfItems < 1)
   {
@@ -251,6 +737,11 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidVideoData()
 //----------------------------------------------------------------------------
 bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidTransformData()
 {
+  if (this->LockFreeReads)
+  {
+    return this->GetLatestItemHasValidDataLockFree(&StreamBufferItem::HasValidTransformData);
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   if (this->NumberOfItems < 1)
   {
@@ -263,6 +754,11 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidTransformData()
 //----------------------------------------------------------------------------
 bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidFieldData()
 {
+  if (this->LockFreeReads)
+  {
+    return this->GetLatestItemHasValidDataLockFree(&StreamBufferItem::HasValidFieldData);
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   if (this->NumberOfItems < 1)
   {
@@ -272,9 +768,33 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidFieldData()
   return this->BufferItemContainer[latestItemBufferIndex].HasValidFieldData();
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidDataLockFree(bool (StreamBufferItem::*hasValidDataMethod)() const)
+{
+  const BufferItemUidType latestUid = this->GetLatestItemUidInBuffer();
+  StreamBufferItem* itemPtr = NULL;
+  if (this->AcquireItemForReading(latestUid, itemPtr) != ITEM_OK)
+  {
+    return false;
+  }
+  bool hasValidData = (itemPtr->*hasValidDataMethod)();
+  this->ReleaseItemForReading(latestUid);
+  return hasValidData;
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetIndex(const BufferItemUidType uid, unsigned long& index)
 {
+  if (this->LockFreeReads)
+  {
+    ItemStatus status = this->ReadItemLockFree(uid, NULL, NULL, &index);
+    if (status != ITEM_OK)
+    {
+      index = 0;
+    }
+    return status;
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -290,8 +810,24 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetIndex(const BufferItemUidType ui
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferIndexFromTime(const double time, int& bufferIndex)
 {
-  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   bufferIndex = -1;
+  if (this->LockFreeReads)
+  {
+    LockFreeReadScope readScope(this);
+    if (!readScope.IsEntered())
+    {
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+    BufferItemUidType itemUid = 0;
+    ItemStatus itemStatus = this->GetItemUidFromTimeLockFree(time, itemUid);
+    if (itemStatus == ITEM_OK)
+    {
+      bufferIndex = this->GetSlotIndexFromUid(itemUid);
+    }
+    return itemStatus;
+  }
+
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
   BufferItemUidType itemUid = 0;
   ItemStatus itemStatus = this->GetItemUidFromTime(time, itemUid);
@@ -310,12 +846,19 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferIndexFromTime(const double
 }
 
 //----------------------------------------------------------------------------
-// do a simple divide-and-conquer search for the transform
-// that best matches the given timestamp
 ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double time, BufferItemUidType& uid)
 {
+  if (this->LockFreeReads)
+  {
+    return this->GetItemUidFromTimeLockFree(time, uid);
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
+  if (this->NumberOfItems < 1)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
   if (this->NumberOfItems == 1)
   {
     // There is only one item, it's the closest one to any timestamp
@@ -325,23 +868,10 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double tim
 
   BufferItemUidType lo = this->LatestItemUid - (this->NumberOfItems - 1);   // oldest item UID
   BufferItemUidType hi = this->LatestItemUid; // latest item UID
-
-  // minimum time
-  // This method is called often, therefore instead of calling this->GetTimeStamp(lo, tlo) we perform low-level operations to get the timestamp
-  int loBufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - lo);
-  if (loBufferIndex < 0)
-  {
-    loBufferIndex += this->BufferItemContainer.size();
-  }
-  double tlo = this->BufferItemContainer[loBufferIndex].GetFilteredTimestamp(this->LocalTimeOffsetSec);
-
-  // This method is called often, therefore instead of calling this->GetTimeStamp(hi, thi) we perform low-level operations to get the timestamp
-  int hiBufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - hi);
-  if (hiBufferIndex < 0)
-  {
-    hiBufferIndex += this->BufferItemContainer.size();
-  }
-  double thi = this->BufferItemContainer[hiBufferIndex].GetFilteredTimestamp(this->LocalTimeOffsetSec);
+  double tlo(0);
+  double thi(0);
+  this->ReadIndexedTimestamp(lo, tlo);
+  this->ReadIndexedTimestamp(hi, thi);
 
   // If the timestamp is slightly out of range then still accept it
   // (due to errors in conversions there could be slight differences)
@@ -354,32 +884,145 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double tim
     return ITEM_NOT_AVAILABLE_YET;
   }
 
-  for (;;)
+  return this->SearchItemUidFromTime(time, lo, hi, tlo, thi, uid);
+}
+
+//----------------------------------------------------------------------------
+// Same search as in GetItemUidFromTime, but timestamps are read without locking.
+// If the writer overwrites an item that is used in the search (only possible at the oldest end)
+// then the search is restarted with the current buffer content.
+ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTimeLockFree(const double time, BufferItemUidType& uid)
+{
+  LockFreeReadScope readScope(this);
+  if (!readScope.IsEntered())
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  for (int attempt = 0; attempt < LOCK_FREE_READ_MAX_ATTEMPTS; ++attempt)
   {
-    if (hi - lo <= 1)
+    BufferItemUidType hi = this->PublishedLatestItemUid.load(std::memory_order_acquire); // latest item UID
+    const int numberOfItems = this->PublishedNumberOfItems.load(std::memory_order_acquire);
+    if (numberOfItems < 1)
     {
-      if (time - tlo > thi - time)
-      {
-        uid = hi;
-        return ITEM_OK;
-      }
-      else
-      {
-        uid = lo;
-        return ITEM_OK;
-      }
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+    if (numberOfItems == 1)
+    {
+      // There is only one item, it's the closest one to any timestamp
+      uid = hi;
+      return ITEM_OK;
+    }
+    BufferItemUidType lo = hi - (numberOfItems - 1); // oldest item UID
+
+    double tlo(0);
+    double thi(0);
+    ItemStatus status = this->ReadIndexedTimestamp(lo, tlo);
+    if (status == ITEM_OK)
+    {
+      status = this->ReadIndexedTimestamp(hi, thi);
+    }
+    if (status == ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      continue;
+    }
+    else if (status != ITEM_OK)
+    {
+      return status;
+    }
+
+    // If the timestamp is slightly out of range then still accept it
+    // (due to errors in conversions there could be slight differences)
+    if (time < tlo - this->NegligibleTimeDifferenceSec)
+    {
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    else if (time > thi + this->NegligibleTimeDifferenceSec)
+    {
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+
+    if (this->SearchItemUidFromTime(time, lo, hi, tlo, thi, uid) == ITEM_OK)
+    {
+      return ITEM_OK;
+    }
+    // an item was overwritten or modified during the search, retry
+  }
+
+  // The writer kept overwriting the searched items, the requested time is too old
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::ReadIndexedTimestamp(const BufferItemUidType uid, double& filteredTimestamp)
+{
+  const int bufferIndex = this->GetSlotIndexFromUid(uid);
+  if (!this->LockFreeReads)
+  {
+    // the caller must have locked the buffer
+    filteredTimestamp = this->FilteredTimestampIndex[bufferIndex] + this->LocalTimeOffsetSec;
+    return ITEM_OK;
+  }
+
+  // seqlock read, same as in ReadItemLockFree
+  const SlotState& slot = this->SlotStates[bufferIndex];
+  for (int attempt = 0; attempt < LOCK_FREE_READ_MAX_ATTEMPTS; ++attempt)
+  {
+    const BufferItemUidType sequence = this->LoadSlotSequenceForReading(slot, uid);
+    if (sequence != 2 * uid)
+    {
+      return (sequence / 2 > uid) ? ITEM_NOT_AVAILABLE_ANYMORE : ITEM_NOT_AVAILABLE_YET;
+    }
+    const double indexedTimestamp = this->FilteredTimestampIndex[bufferIndex];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+    {
+      continue;
     }
+    filteredTimestamp = indexedTimestamp + this->LocalTimeOffsetSec;
+    return ITEM_OK;
+  }
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
 
-    int mid = (lo + hi) / 2;
+//----------------------------------------------------------------------------
+// do a simple divide-and-conquer search for the item
+// that best matches the given timestamp
+ItemStatus vtkPlusTimestampedCircularBuffer::SearchItemUidFromTime(const double time, BufferItemUidType lo, BufferItemUidType hi, double tlo, double thi, BufferItemUidType& uid)
+{
+  ItemStatus status = ITEM_OK;
 
-    // This is a hot loop, therefore instead of calling this->GetTimeStamp(mid, tmid) we perform low-level operations to get the timestamp
-    int midBufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - mid);
-    if (midBufferIndex < 0)
+  // Consecutive lookups usually request the same or the next item (e.g., tool poses at each new video frame),
+  // so first narrow the range to the previously found item and its successor
+  const BufferItemUidType hint = this->TimeLookupHintUid.load(std::memory_order_relaxed);
+  for (BufferItemUidType probe = hint; probe <= hint + 1; ++probe)
+  {
+    if (probe <= lo || probe >= hi)
+    {
+      continue;
+    }
+    double tprobe(0);
+    if ((status = this->ReadIndexedTimestamp(probe, tprobe)) != ITEM_OK)
     {
-      midBufferIndex += this->BufferItemContainer.size();
+      return status;
     }
-    double tmid = this->BufferItemContainer[midBufferIndex].GetFilteredTimestamp(this->LocalTimeOffsetSec);
+    if (time < tprobe)
+    {
+      hi = probe;
+      thi = tprobe;
+      break;
+    }
+    lo = probe;
+    tlo = tprobe;
+  }
 
+  while (hi - lo > 1)
+  {
+    BufferItemUidType mid = lo + (hi - lo) / 2;
+    double tmid(0);
+    if ((status = this->ReadIndexedTimestamp(mid, tmid)) != ITEM_OK)
+    {
+      return status;
+    }
     if (time < tmid)
     {
       hi = mid;
@@ -392,6 +1035,9 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double tim
     }
   }
 
+  uid = (time - tlo > thi - time) ? hi : lo;
+  this->TimeLookupHintUid.store(lo, std::memory_order_relaxed);
+  return ITEM_OK;
 }
 
 //----------------------------------------------------------------------------
@@ -399,6 +1045,7 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
 {
   buffer->Lock();
   this->Lock();
+  this->BeginSlotStorageChange();
   this->WritePointer = buffer->WritePointer;
   this->NumberOfItems = buffer->NumberOfItems;
   this->CurrentTimeStamp = buffer->CurrentTimeStamp;
@@ -410,8 +1057,17 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
   this->FilterContainersOldestIndex = buffer->FilterContainersOldestIndex;
   this->FilterContainerTimestampVector = buffer->FilterContainerTimestampVector;
   this->FilterContainerIndexVector = buffer->FilterContainerIndexVector;
+  this->FilterSumIndex = buffer->FilterSumIndex;
+  this->FilterSumTimestamp = buffer->FilterSumTimestamp;
+  this->FilterSumIndexSquared = buffer->FilterSumIndexSquared;
+  this->FilterSumIndexTimestamp = buffer->FilterSumIndexTimestamp;
+  this->FilterSumsReferenceIndex = buffer->FilterSumsReferenceIndex;
+  this->FilterSumsReferenceTimestamp = buffer->FilterSumsReferenceTimestamp;
+  this->FilterItemsSinceSumsRecomputed = buffer->FilterItemsSinceSumsRecomputed;
 
   this->BufferItemContainer = buffer->BufferItemContainer;
+  this->ResetSlotStates();
+  this->EndSlotStorageChange();
   this->Unlock();
   buffer->Unlock();
 }
@@ -424,6 +1080,9 @@ void vtkPlusTimestampedCircularBuffer::Clear()
   this->NumberOfItems = 0;
   this->CurrentTimeStamp = 0;
   this->LatestItemUid = 0;
+  this->ItemReserved = false;
+  this->RestoredItemUid = 0;
+  this->ResetSlotStates();
   this->Unlock();
 }
 
@@ -524,8 +1183,41 @@ double vtkPlusTimestampedCircularBuffer::GetFrameRate(bool ideal /*=false*/, dou
 }
 
 //----------------------------------------------------------------------------
-// for accurate timing of the frame: an exponential moving average
-// is computed to smooth out the jitter in the times that are returned by the system clock:
+void vtkPlusTimestampedCircularBuffer::RecomputeFilterSums()
+{
+  this->FilterSumIndex = 0;
+  this->FilterSumTimestamp = 0;
+  this->FilterSumIndexSquared = 0;
+  this->FilterSumIndexTimestamp = 0;
+  this->FilterItemsSinceSumsRecomputed = 0;
+  if (this->FilterContainersNumberOfValidElements == 0)
+  {
+    this->FilterSumsReferenceIndex = 0;
+    this->FilterSumsReferenceTimestamp = 0;
+    return;
+  }
+
+  // Use the latest item as reference
+  const unsigned int containerSize = this->FilterContainerIndexVector.size();
+  const unsigned int latestIndex = (this->FilterContainersOldestIndex + containerSize - 1) % containerSize;
+  this->FilterSumsReferenceIndex = this->FilterContainerIndexVector(latestIndex);
+  this->FilterSumsReferenceTimestamp = this->FilterContainerTimestampVector(latestIndex);
+
+  for (unsigned int i = 0; i < this->FilterContainersNumberOfValidElements; ++i)
+  {
+    const unsigned int containerIndex = (latestIndex + containerSize - i) % containerSize;
+    const double x = this->FilterContainerIndexVector(containerIndex) - this->FilterSumsReferenceIndex;
+    const double y = this->FilterContainerTimestampVector(containerIndex) - this->FilterSumsReferenceTimestamp;
+    this->FilterSumIndex += x;
+    this->FilterSumTimestamp += y;
+    this->FilterSumIndexSquared += x * x;
+    this->FilterSumIndexTimestamp += x * y;
+  }
+}
+
+//----------------------------------------------------------------------------
+// for accurate timing of the frame: a line is fitted to the frame indexes and timestamps of the last items
+// to smooth out the jitter in the times that are returned by the system clock:
 PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid)
 {
   this->Lock();
@@ -539,11 +1231,24 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     this->FilterContainerTimestampVector.set_size(this->AveragedItemsForFiltering);
     this->FilterContainersOldestIndex = 0;
     this->FilterContainersNumberOfValidElements = 0;
+    this->RecomputeFilterSums();
   }
 
   // We store the last AveragedItemsForFiltering unfiltered timestamp and item indexes, because these are used for computing the filtered timestamp.
+  // Running sums of the stored values are updated as well, so that the line can be fitted without iterating through all the stored values.
   if (this->AveragedItemsForFiltering > 1)
   {
+    if (this->FilterContainersNumberOfValidElements == this->AveragedItemsForFiltering)
+    {
+      // remove the oldest item from the sums, it is overwritten now
+      const double oldestX = this->FilterContainerIndexVector(this->FilterContainersOldestIndex) - this->FilterSumsReferenceIndex;
+      const double oldestY = this->FilterContainerTimestampVector(this->FilterContainersOldestIndex) - this->FilterSumsReferenceTimestamp;
+      this->FilterSumIndex -= oldestX;
+      this->FilterSumTimestamp -= oldestY;
+      this->FilterSumIndexSquared -= oldestX * oldestX;
+      this->FilterSumIndexTimestamp -= oldestX * oldestY;
+    }
+
     this->FilterContainerIndexVector(this->FilterContainersOldestIndex) = itemIndex;
     this->FilterContainerTimestampVector[this->FilterContainersOldestIndex] = inUnfilteredTimestamp;
     this->FilterContainersNumberOfValidElements++;
@@ -558,6 +1263,23 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     {
       this->FilterContainersOldestIndex = 0;
     }
+
+    this->FilterItemsSinceSumsRecomputed++;
+    if (this->FilterContainersNumberOfValidElements == 1 || this->FilterItemsSinceSumsRecomputed >= this->AveragedItemsForFiltering)
+    {
+      // Once in every AveragedItemsForFiltering items the sums are recomputed relative to the latest item,
+      // so that rounding errors do not accumulate and the values stay small (amortized constant time)
+      this->RecomputeFilterSums();
+    }
+    else
+    {
+      const double newX = itemIndex - this->FilterSumsReferenceIndex;
+      const double newY = inUnfilteredTimestamp - this->FilterSumsReferenceTimestamp;
+      this->FilterSumIndex += newX;
+      this->FilterSumTimestamp += newY;
+      this->FilterSumIndexSquared += newX * newX;
+      this->FilterSumIndexTimestamp += newX * newY;
+    }
   }
 
   // If we don't have enough unfiltered timestamps or we don't want to use afiltering then just use the unfiltered timestamps
@@ -590,21 +1312,21 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   //   a = sum( (x(i)-xMean) * (y(i)-yMean) ) / sum( (x(i)-xMean) * (x(i)-xMean) )
   //   b = yMean - a*xMean
   //
+  // The sums are computed from running sums of x, y, x*x, x*y, which are maintained as items are added:
+  //   sum( (x(i)-xMean) * (y(i)-yMean) ) = sum(x*y) - n*xMean*yMean
+  //   sum( (x(i)-xMean) * (x(i)-xMean) ) = sum(x*x) - n*xMean*xMean
+  // x and y values are relative to a reference item, which keeps them small and so the subtractions accurate.
+  //
 
-  double xMean = this->FilterContainerIndexVector.mean();
-  double yMean = this->FilterContainerTimestampVector.mean();
-  double covarianceXY = 0;
-  double varianceX = 0;
-  for (int i = this->FilterContainerTimestampVector.size() - 1; i >= 0; i--)
-  {
-    double xiMinusXmean = (this->FilterContainerIndexVector(i) - xMean);
-    covarianceXY += xiMinusXmean * (this->FilterContainerTimestampVector(i) - yMean);
-    varianceX += xiMinusXmean * xiMinusXmean;
-  }
+  const double n = this->FilterContainersNumberOfValidElements;
+  double xMean = this->FilterSumIndex / n;
+  double yMean = this->FilterSumTimestamp / n;
+  double covarianceXY = this->FilterSumIndexTimestamp - n * xMean * yMean;
+  double varianceX = this->FilterSumIndexSquared - n * xMean * xMean;
   double a = covarianceXY / varianceX;
   double b = yMean - a * xMean;
 
-  outFilteredTimestamp = a * itemIndex + b;
+  outFilteredTimestamp = this->FilterSumsReferenceTimestamp + a * (itemIndex - this->FilterSumsReferenceIndex) + b;
 
   if (this->TimeStampLogging)
   {
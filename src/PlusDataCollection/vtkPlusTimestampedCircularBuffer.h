@@ -9,8 +9,12 @@
 
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
+#include "vtkPlusDataCollectionExport.h"
 #include "vtkObject.h"
+#include <atomic>
 #include <deque>
+#include <functional>
+#include <vector>
 
 #include "vnl/vnl_matrix.h"
 #include "vnl/vnl_vector.h"
@@ -32,9 +36,18 @@ enum ItemStatus { ITEM_OK, ITEM_NOT_AVAILABLE_YET, ITEM_NOT_AVAILABLE_ANYMORE, I
   \class vtkPlusTimestampedCircularBuffer
   \brief This class stores an fixed number of timestamped items.
   It provides element retrieval based on timestamp, temporal filtering and interpolation, etc.
+
+  By default all readers and the writer are serialized by the buffer mutex. If LockFreeReads is enabled
+  then the buffer is used as a single-producer/multiple-consumer ring: the writer (the acquisition thread)
+  still takes the mutex, but readers do not. Each slot has a sequence number that encodes the UID of the item
+  that it contains and whether the item is being written (seqlock style). Readers use it to detect items that
+  were overwritten or modified while they were read, and report ITEM_NOT_AVAILABLE_ANYMORE in that case.
+
+  Time lookups do not access the items: the filtered timestamps are also stored in a contiguous array
+  (one element per slot), which keeps the binary search in the cache even for large buffers.
   \ingroup PlusLibCommon
 */
-class vtkPlusTimestampedCircularBuffer: public vtkObject
+class vtkPlusDataCollectionExport vtkPlusTimestampedCircularBuffer: public vtkObject
 {
 public:
   static vtkPlusTimestampedCircularBuffer* New();
@@ -43,6 +56,7 @@ public:
   /*!
    Set/Get the size of the buffer, i.e. the maximum number of
    video frames that it will hold.  The default is 30.
+   Lock-free readers get ITEM_NOT_AVAILABLE_YET while the buffer is being resized.
   */
   virtual PlusStatus SetBufferSize( int n );
   virtual inline int GetBufferSize() { return this->BufferItemContainer.size(); };
@@ -64,6 +78,10 @@ public:
   /*! Get the most recent frame UID that is already in the buffer */
   virtual BufferItemUidType GetLatestItemUidInBuffer()
   {
+    if ( this->LockFreeReads )
+    {
+      return this->PublishedLatestItemUid.load( std::memory_order_acquire );
+    }
     this->Lock();
     BufferItemUidType latestUid = this->LatestItemUid;
     this->Unlock();
@@ -73,6 +91,11 @@ public:
   /*! Get the oldest frame UID in the buffer  */
   virtual BufferItemUidType GetOldestItemUidInBuffer()
   {
+    if ( this->LockFreeReads )
+    {
+      BufferItemUidType latestUid = this->PublishedLatestItemUid.load( std::memory_order_acquire );
+      return latestUid - ( this->PublishedNumberOfItems.load( std::memory_order_acquire ) - 1 );
+    }
     this->Lock();
     // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
     BufferItemUidType oldestUid = this->LatestItemUid - ( this->NumberOfItems - 1 );
@@ -88,6 +111,20 @@ public:
 
   virtual ItemStatus GetOldestTimeStamp( double& timestamp )
   {
+    if ( this->LockFreeReads )
+    {
+      // The oldest item may be overwritten at any moment, in that case retry with the new oldest item
+      ItemStatus status = ITEM_UNKNOWN_ERROR;
+      for ( int attempt = 0; attempt < 3; ++attempt )
+      {
+        status = this->GetTimeStamp( this->GetOldestItemUidInBuffer(), timestamp );
+        if ( status != ITEM_NOT_AVAILABLE_ANYMORE )
+        {
+          break;
+        }
+      }
+      return status;
+    }
     // The oldest item may be removed from the buffer at any moment
     // therefore we need to retrieve its UID and timestamp within a single lock
     this->Lock();
@@ -154,6 +191,68 @@ public:
   */
   inline void Unlock() { this->Mutex->Unlock(); };
 
+  /*!
+    Scoped lock for readers that need several buffer accesses to be consistent (e.g., UID lookup then item copy).
+    It locks the buffer in the default mode and does nothing if LockFreeReads is enabled, as then
+    readers rely on the slot sequence numbers and must not block the writer.
+  */
+  class ReadGuard
+  {
+  public:
+    ReadGuard( vtkPlusTimestampedCircularBuffer* buffer )
+      : Buffer( buffer->GetLockFreeReads() ? NULL : buffer )
+    {
+      if ( this->Buffer != NULL )
+      {
+        this->Buffer->Lock();
+      }
+    }
+    ~ReadGuard()
+    {
+      if ( this->Buffer != NULL )
+      {
+        this->Buffer->Unlock();
+      }
+    }
+  private:
+    ReadGuard( const ReadGuard& );
+    void operator=( const ReadGuard& );
+    vtkPlusTimestampedCircularBuffer* Buffer;
+  };
+
+  /*!
+    Enable lock-free single-producer/multiple-consumer mode (see class description).
+    It may only be changed while the buffer is not accessed from other threads (e.g., before acquisition starts).
+  */
+  virtual void SetLockFreeReads( bool enable );
+  vtkGetMacro( LockFreeReads, bool );
+  vtkBooleanMacro( LockFreeReads, bool );
+
+  /*!
+    Wait until lock-free readers leave the buffer and keep new ones out until EndSlotStorageChange is called
+    (they get ITEM_NOT_AVAILABLE_YET meanwhile). It must be called before changes that move or reallocate slots,
+    such as resizing the buffer or reallocating the frames. Calls may be nested. The caller must have locked the buffer.
+  */
+  void BeginSlotStorageChange();
+  void EndSlotStorageChange();
+
+  /*!
+    Set a function that receives each item that is removed from the full buffer, right before it is overwritten
+    (e.g., to move the item to a spill file). The function is called while the buffer is locked and must not modify the item.
+    An empty function disables the notification. The caller must have locked the buffer.
+  */
+  void SetItemRemovedCallback( const std::function<void( StreamBufferItem& )>& callback ) { this->ItemRemovedCallback = callback; }
+
+  /*!
+    Get read access to the item with the specified UID. The returned pointer is valid until
+    ReleaseItemForReading is called with the same UID, and the item is guaranteed not to be modified until then.
+    In the default mode the buffer is locked until the item is released. In LockFreeReads mode the buffer is not locked,
+    only the slot is pinned: the writer waits for the release only if it has to overwrite this very slot (i.e., the reader holds the oldest item).
+    ReleaseItemForReading must only be called if the status is ITEM_OK.
+  */
+  virtual ItemStatus AcquireItemForReading( const BufferItemUidType uid, StreamBufferItem*& itemPtr );
+  virtual void ReleaseItemForReading( const BufferItemUidType uid );
+
   /*!
     Get next writable buffer object
     INTERNAL USE ONLY! Need to lock buffer until we use the buffer index
@@ -166,8 +265,65 @@ public:
   */
   virtual ItemStatus GetBufferItemPointerFromUid( const BufferItemUidType uid, StreamBufferItem*& itemPtr );
 
+  /*!
+    Reserve the slot for the next item. The caller must have locked the buffer and must call CommitNewItem
+    after it has filled the item at bufferIndex (before releasing the lock).
+  */
   virtual PlusStatus PrepareForNewItem( const double timestamp, BufferItemUidType& newFrameUid, int& bufferIndex );
 
+  /*!
+    Reserve the slot for the next item before its timestamp is known, so that it can be filled without locking the buffer.
+    The item that is currently stored in the slot (the oldest item, if the buffer is full) is removed from the buffer.
+    No other item can be added until ReleaseReservedItem is called; then PrepareForNewItem returns the reserved slot.
+    The caller must have locked the buffer.
+  */
+  virtual PlusStatus ReserveNewItem( int& bufferIndex );
+
+  /*!
+    Release the slot reserved by ReserveNewItem. The caller must have locked the buffer.
+    \param restoreRemovedItem If true then the item that was removed from the slot by ReserveNewItem is added back to the buffer.
+      Only allowed if the slot content has not been modified since it was reserved.
+  */
+  virtual void ReleaseReservedItem( bool restoreRemovedItem = false );
+
+  /*! Returns true if a slot is reserved by ReserveNewItem */
+  vtkGetMacro( ItemReserved, bool );
+
+  /*! Number of items that were removed from the buffer to make room for a new item. Can be called from any thread. */
+  unsigned long long GetNumberOfOverwrittenItems() const
+  {
+    return this->NumberOfOverwrittenItems.load( std::memory_order_relaxed );
+  }
+
+  /*! Number of items that were not added because their timestamp was not newer than the latest item's. Can be called from any thread. */
+  unsigned long long GetNumberOfRejectedItems() const
+  {
+    return this->NumberOfRejectedItems.load( std::memory_order_relaxed );
+  }
+
+  /*! Make the item that was filled after PrepareForNewItem visible for lock-free readers. The caller must have locked the buffer. */
+  virtual void CommitNewItem( const BufferItemUidType uid, const int bufferIndex );
+
+  /*!
+    Undo PrepareForNewItem if the item could not be filled (it must be called instead of CommitNewItem).
+    The slot may already be partially overwritten, so if the buffer was full then the oldest item remains removed
+    from the buffer. The caller must have locked the buffer.
+  */
+  virtual void CancelNewItem( const BufferItemUidType uid, const int bufferIndex );
+
+  /*!
+    Mark an already committed item as being modified (the caller must have locked the buffer).
+    Lock-free readers will not access the item until CommitNewItem is called for it again.
+  */
+  virtual ItemStatus ReopenItemForWriting( const BufferItemUidType uid, StreamBufferItem*& itemPtr, int& bufferIndex );
+
+  /*!
+    Modify a committed item in place and publish it again, e.g., to swap in data that was prepared outside the buffer lock.
+    Lock-free readers that request the item meanwhile wait for the update instead of reporting the item as unavailable,
+    so updateItem must return quickly. The caller must have locked the buffer.
+  */
+  virtual ItemStatus UpdateCommittedItem( const BufferItemUidType uid, const std::function<void( StreamBufferItem& )>& updateItem );
+
   /*!
     Create filtered and unfiltered timestamp for accurate timing of the buffer item.
     The timing may be inaccurate because the timestamp is attached to the item when Plus receives it
@@ -180,6 +336,11 @@ public:
   */
   virtual PlusStatus CreateFilteredTimeStampForItem( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid );
 
+  /*! Set the maximum allowed difference between the filtered and unfiltered timestamp (in seconds), see CreateFilteredTimeStampForItem */
+  vtkSetMacro( MaxAllowedFilteringTimeDifference, double );
+  /*! Get the maximum allowed difference between the filtered and unfiltered timestamp (in seconds) */
+  vtkGetMacro( MaxAllowedFilteringTimeDifference, double );
+
   /*! Add values to the timestamp report. If reporting is not enabled then no values will be added. This should only be called if an item is added without calling CreateFilteredTimeStampForItem. */
   void AddToTimeStampReport( unsigned long itemIndex, double unfilteredTimestamp, double filteredTimestamp );
 
@@ -210,6 +371,108 @@ protected:
   vtkPlusTimestampedCircularBuffer();
   ~vtkPlusTimestampedCircularBuffer();
 
+  /*!
+    Per-slot state for lock-free reads.
+    Sequence is 2*uid if the slot contains the committed item uid, 2*uid+1 while the item uid is being written.
+    Readers is the number of readers that currently copy data out of the slot.
+  */
+  struct SlotState
+  {
+    SlotState() : Sequence( 0 ), Readers( 0 ) {}
+    std::atomic<BufferItemUidType> Sequence;
+    std::atomic<int> Readers;
+  };
+
+  /*! Compute slot index from UID without using WritePointer and LatestItemUid (which are protected by the mutex) */
+  inline int GetSlotIndexFromUid( const BufferItemUidType uid ) const
+  {
+    return static_cast<int>( ( uid + this->SlotIndexOffset ) % this->SlotStates.size() );
+  }
+
+  /*! Mark the slot as being written and wait until readers that pinned it are done. The caller must have locked the buffer. */
+  void BeginSlotWrite( const int bufferIndex, const BufferItemUidType uid );
+
+  /*! Count the oldest item in the slot as overwritten and pass it to ItemRemovedCallback. The caller must have locked the buffer. */
+  void RemoveItemFromSlot( const int bufferIndex );
+
+  /*!
+    Get the sequence number of a slot for a lock-free read of item uid. If the item is being updated in place
+    (see UpdateCommittedItem) then it waits a short while for the update to complete.
+  */
+  BufferItemUidType LoadSlotSequenceForReading( const SlotState& slot, const BufferItemUidType uid ) const;
+
+  /*!
+    Register a lock-free reader. Returns false if the slot storage is being changed, then the reader must not access the slots.
+    LeaveLockFreeRead must be called if (and only if) it returned true.
+  */
+  bool EnterLockFreeRead();
+  void LeaveLockFreeRead();
+
+  /*! Scoped EnterLockFreeRead/LeaveLockFreeRead */
+  class LockFreeReadScope
+  {
+  public:
+    LockFreeReadScope( vtkPlusTimestampedCircularBuffer* buffer )
+      : Buffer( buffer )
+      , Entered( buffer->EnterLockFreeRead() )
+    {
+    }
+    ~LockFreeReadScope()
+    {
+      if ( this->Entered )
+      {
+        this->Buffer->LeaveLockFreeRead();
+      }
+    }
+    bool IsEntered() const { return this->Entered; }
+  private:
+    LockFreeReadScope( const LockFreeReadScope& );
+    void operator=( const LockFreeReadScope& );
+    vtkPlusTimestampedCircularBuffer* Buffer;
+    bool Entered;
+  };
+
+  /*!
+    Rebuild slot sequence numbers, published UIDs and the timestamp index from the current buffer content.
+    Must be called after any operation that changes the mapping between UIDs and slots. The caller must have locked the buffer.
+  */
+  void ResetSlotStates();
+
+  /*!
+    Compute the running sums of the timestamp filter from the filter containers, relative to the most recently added item.
+    The caller must have locked the buffer.
+  */
+  void RecomputeFilterSums();
+
+  /*! Check if the item is among the published (committed) items, without locking the buffer */
+  ItemStatus GetPublishedItemStatus( const BufferItemUidType uid );
+
+  /*!
+    Read timestamps and index of an item without locking the buffer (seqlock read).
+    Any of the output pointers may be NULL. Returns ITEM_NOT_AVAILABLE_ANYMORE if the slot was overwritten during the read.
+  */
+  ItemStatus ReadItemLockFree( const BufferItemUidType uid, double* filteredTimestamp, double* unfilteredTimestamp, unsigned long* index );
+
+  /*! GetLatestItemHasValid...Data implementation for LockFreeReads mode */
+  bool GetLatestItemHasValidDataLockFree( bool ( StreamBufferItem::*hasValidDataMethod )() const );
+
+  /*! GetItemUidFromTime implementation for LockFreeReads mode */
+  ItemStatus GetItemUidFromTimeLockFree( const double time, BufferItemUidType& uid );
+
+  /*!
+    Get the filtered timestamp (including the local time offset) of an item from the timestamp index.
+    In the default mode the caller must have locked the buffer and the item must be in the buffer.
+    In LockFreeReads mode returns ITEM_NOT_AVAILABLE_ANYMORE if the slot was overwritten during the read.
+  */
+  ItemStatus ReadIndexedTimestamp( const BufferItemUidType uid, double& filteredTimestamp );
+
+  /*!
+    Find the item that is closest to time between items lo and hi (tlo <= time <= thi) in the timestamp index.
+    Items that are close to the previously found item are checked first.
+    Returns the status of the failed read if an item could not be read (only in LockFreeReads mode).
+  */
+  ItemStatus SearchItemUidFromTime( const double time, BufferItemUidType lo, BufferItemUidType hi, double tlo, double thi, BufferItemUidType& uid );
+
 protected:
   vtkIGSIORecursiveCriticalSection* Mutex;
 
@@ -220,6 +483,9 @@ protected:
 
   double CurrentTimeStamp;
 
+  /*! Value of CurrentTimeStamp before the last PrepareForNewItem call, restored by CancelNewItem */
+  double PreviousTimeStamp;
+
   /*! Time offset of the buffer in seconds */
   double LocalTimeOffsetSec;
 
@@ -243,6 +509,20 @@ protected:
   /*! Number of valid elements in the frame index and timestamp containers (maximum can be equal to AveragedItemsForFiltering) */
   unsigned int FilterContainersNumberOfValidElements;
 
+  /*!
+    Running sums of the frame indexes and timestamps in the filter containers, used for fitting the line in constant time.
+    Values are summed relative to a reference frame index and timestamp to preserve numerical precision.
+  */
+  double FilterSumIndex;
+  double FilterSumTimestamp;
+  double FilterSumIndexSquared;
+  double FilterSumIndexTimestamp;
+  double FilterSumsReferenceIndex;
+  double FilterSumsReferenceTimestamp;
+
+  /*! Number of items added since the running sums were computed from the containers (they are recomputed periodically to avoid accumulating rounding errors) */
+  unsigned int FilterItemsSinceSumsRecomputed;
+
   /*! Number of averaged items used for filtering - read from config files */
   unsigned int AveragedItemsForFiltering;
 
@@ -276,6 +556,53 @@ protected:
   */
   double NegligibleTimeDifferenceSec;
 
+  /*! If enabled, readers do not lock the buffer but use the slot sequence numbers to detect overwritten items */
+  bool LockFreeReads;
+
+  /*! Slot states for lock-free reads, one for each item in BufferItemContainer */
+  std::vector<SlotState> SlotStates;
+
+  /*! Slot index of item uid is (uid + SlotIndexOffset) % buffer size. Only changes when the buffer is resized or cleared. */
+  BufferItemUidType SlotIndexOffset;
+
+  /*! Latest committed item UID and number of items, for lock-free readers */
+  std::atomic<BufferItemUidType> PublishedLatestItemUid;
+  std::atomic<int> PublishedNumberOfItems;
+
+  /*! Number of lock-free readers that may access the slots */
+  std::atomic<int> ActiveLockFreeReaders;
+
+  /*! True while slots are moved or reallocated (see BeginSlotStorageChange) */
+  std::atomic<bool> SlotStorageChanging;
+
+  /*! Nesting depth of BeginSlotStorageChange calls (protected by the mutex) */
+  int SlotStorageChangeDepth;
+
+  /*! True while the slot at WritePointer is reserved for an item that is being filled outside the buffer lock */
+  bool ItemReserved;
+
+  /*! UID of the item that was removed from the buffer when the slot was reserved (0 if the slot was empty) */
+  BufferItemUidType ReservedSlotRemovedItemUid;
+
+  /*! UID of the item that was restored by ReleaseReservedItem. It has already been passed to ItemRemovedCallback. */
+  BufferItemUidType RestoredItemUid;
+
+  /*!
+    Filtered timestamp (without local time offset) of the item in each slot, the same as in BufferItemContainer.
+    Updated in CommitNewItem, so it is consistent with the slot sequence number for lock-free readers.
+  */
+  std::vector<double> FilteredTimestampIndex;
+
+  /*! UID of the item found by the previous time lookup, used as a starting point for the next one */
+  std::atomic<BufferItemUidType> TimeLookupHintUid;
+
+  /*! Item counters for monitoring, not reset by Clear() */
+  std::atomic<unsigned long long> NumberOfOverwrittenItems;
+  std::atomic<unsigned long long> NumberOfRejectedItems;
+
+  /*! Receives the items that are removed from the buffer (optional) */
+  std::function<void( StreamBufferItem& )> ItemRemovedCallback;
+
 private:
   vtkPlusTimestampedCircularBuffer( const vtkPlusTimestampedCircularBuffer& );
   void operator=( const vtkPlusTimestampedCircularBuffer& );
@@ -5,6 +5,7 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
 
 #include "igsioTrackedFrame.h"
 #include "igsioVideoFrame.h"
@@ -14,6 +15,7 @@ See License.txt for details.
 #include "vtkObjectFactory.h"
 #include "vtkPlusIgtlMessageCommon.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
@@ -515,12 +517,23 @@ int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& client
       parameters["deadlineMode"] = videoStream.EncodeVideoParameters.DeadlineMode;
     }
 
+    double encodingStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
     if (vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, trackedFrame, *matrix, videoStream.FrameConverter, videoStream.EncodeVideoParameters.FourCC, parameters) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
       numberOfErrors++;
       continue;
     }
+    double encodingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - encodingStartTime;
+
+    // Metric lookup is negligible compared to the encoding time
+    PlusMetric::LabelMapType encoderLabels;
+    encoderLabels["stream"] = videoStream.Name;
+    encoderLabels["codec"] = videoStream.EncodeVideoParameters.FourCC;
+    PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+    registry->GetMetric("plus_video_encoding_seconds_total", "Time spent with encoding video frames", PlusMetric::METRIC_COUNTER, encoderLabels)->Add(encodingTimeSec);
+    registry->GetMetric("plus_video_encoded_frames_total", "Number of encoded video frames", PlusMetric::METRIC_COUNTER, encoderLabels)->Add(1);
+
     igtlMessages.push_back(videoMessage.GetPointer());
   }
   return numberOfErrors;
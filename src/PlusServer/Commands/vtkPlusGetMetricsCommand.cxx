@@ -0,0 +1,100 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+#include "vtkPlusGetMetricsCommand.h"
+
+namespace
+{
+  static const std::string GET_METRICS_CMD = "GetMetrics";
+}
+
+vtkStandardNewMacro(vtkPlusGetMetricsCommand);
+
+//----------------------------------------------------------------------------
+vtkPlusGetMetricsCommand::vtkPlusGetMetricsCommand()
+  : Prefix("")
+{
+  // It handles only one command, set its name by default
+  this->SetName(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetMetricsCommand::~vtkPlusGetMetricsCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Prefix: " << this->Prefix << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (Superclass::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->Prefix.clear();
+  if (aConfig->GetAttribute("Prefix") != NULL)
+  {
+    this->Prefix = aConfig->GetAttribute("Prefix");
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::WriteConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (Superclass::WriteConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!this->Prefix.empty())
+  {
+    aConfig->SetAttribute("Prefix", this->Prefix.c_str());
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetMetricsCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_METRICS_CMD))
+  {
+    desc += GET_METRICS_CMD;
+    desc += ": Get the current value of all metrics in Prometheus text format. Attributes: Prefix: optional, only metrics with names starting with this string are returned.";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::SetNameToGetMetrics()
+{
+  this->SetName(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::Execute()
+{
+  LOG_DEBUG("vtkPlusGetMetricsCommand::Execute: " << (!this->Name.empty() ? this->Name : "(undefined)")
+            << ", prefix: " << (this->Prefix.empty() ? "(none)" : this->Prefix));
+  this->QueueCommandResponse(PLUS_SUCCESS, PlusMetricsRegistry::GetInstance()->GetMetricsAsPrometheusText(this->Prefix));
+  return PLUS_SUCCESS;
+}
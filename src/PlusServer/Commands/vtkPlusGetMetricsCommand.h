@@ -0,0 +1,65 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusGetMetricsCommand_h
+#define __vtkPlusGetMetricsCommand_h
+
+#include "vtkPlusServerExport.h"
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusGetMetricsCommand
+  \brief This command returns the current values of all metrics (acquisition rates, buffer fill levels, dropped items,
+  client send rates, encoding times, etc.) in Prometheus text format
+
+  The optional Prefix attribute limits the response to the metrics that have a name starting with the prefix
+  (for example, Prefix="plus_buffer_").
+
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusGetMetricsCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusGetMetricsCommand* New();
+  vtkTypeMacro(vtkPlusGetMetricsCommand, vtkPlusCommand);
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Read command parameters from XML */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Write command parameters to XML */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  void SetNameToGetMetrics();
+
+  /*! If not empty then only those metrics are returned that have a name starting with this prefix */
+  vtkGetStdStringMacro(Prefix);
+  vtkSetStdStringMacro(Prefix);
+
+protected:
+  vtkPlusGetMetricsCommand();
+  virtual ~vtkPlusGetMetricsCommand();
+
+protected:
+  std::string Prefix;
+
+private:
+  vtkPlusGetMetricsCommand(const vtkPlusGetMetricsCommand&);
+  void operator=(const vtkPlusGetMetricsCommand&);
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusGetMetricsCommandTest.cxx
+  \brief Tests the GetMetrics command and the buffer metrics that it reports.
+
+  Items are added to buffers that have an owner data source and to temporary buffers that do not have one.
+  Only the owned buffers may be reported, each with its own device and source labels. The GetMetrics command
+  is configured from XML (with and without a name prefix) and executed, its response must contain the matching metrics only.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusCommandResponse.h"
+#include "vtkPlusGetMetricsCommand.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <sstream>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool Contains(const std::string& text, const std::string& expected)
+  {
+    return text.find(expected) != std::string::npos;
+  }
+
+  //----------------------------------------------------------------------------
+  int CountLinesStartingWith(const std::string& text, const std::string& expected)
+  {
+    int count(0);
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+      if (line.compare(0, expected.size(), expected) == 0)
+      {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddTrackerItems(vtkPlusBuffer* buffer, int numberOfItems)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int i = 1; i <= numberOfItems; ++i)
+    {
+      const double timestamp = i * 0.01;
+      if (buffer->AddTimeStampedItem(matrix, TOOL_OK, i, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << i << " to buffer " << buffer->GetDescriptiveName());
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ExecuteGetMetrics(const std::string& commandXml, std::string& result)
+  {
+    vtkSmartPointer<vtkXMLDataElement> commandElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(commandXml.c_str()));
+    vtkSmartPointer<vtkPlusGetMetricsCommand> command = vtkSmartPointer<vtkPlusGetMetricsCommand>::New();
+    if (commandElement == NULL || command->ReadConfiguration(commandElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read command: " << commandXml);
+      return PLUS_FAIL;
+    }
+    if (command->Execute() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to execute command: " << commandXml);
+      return PLUS_FAIL;
+    }
+
+    PlusCommandResponseList responses;
+    command->PopCommandResponses(responses);
+    if (responses.size() != 1)
+    {
+      LOG_ERROR("Command " << commandXml << " returned " << responses.size() << " responses (expected: 1)");
+      return PLUS_FAIL;
+    }
+    vtkPlusCommandRTSCommandResponse* response = vtkPlusCommandRTSCommandResponse::SafeDownCast(responses.front());
+    if (response == NULL || response->GetStatus() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Command " << commandXml << " did not return a successful command response");
+      return PLUS_FAIL;
+    }
+    result = response->GetResultString();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestBufferMetrics()
+  {
+    // Buffers of two data sources of the same device and a temporary buffer (e.g., a local copy of a recording)
+    vtkSmartPointer<vtkPlusBuffer> toolBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    toolBuffer->SetDescriptiveName("MetricsTestBuffer");
+    toolBuffer->SetMetricsOwner("MetricsTestDevice", "Tool");
+    vtkSmartPointer<vtkPlusBuffer> stylusBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    stylusBuffer->SetDescriptiveName("MetricsTestBuffer");
+    stylusBuffer->SetMetricsOwner("MetricsTestDevice", "Stylus");
+    vtkSmartPointer<vtkPlusBuffer> temporaryBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    temporaryBuffer->SetDescriptiveName("MetricsTestBuffer");
+
+    if (AddTrackerItems(toolBuffer, 5) != PLUS_SUCCESS
+        || AddTrackerItems(stylusBuffer, 3) != PLUS_SUCCESS
+        || AddTrackerItems(temporaryBuffer, 7) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    std::string metrics = PlusMetricsRegistry::GetInstance()->GetMetricsAsPrometheusText("plus_buffer_items_total");
+    if (!Contains(metrics, "plus_buffer_items_total{device=\"MetricsTestDevice\",source=\"Tool\"} 5\n")
+        || !Contains(metrics, "plus_buffer_items_total{device=\"MetricsTestDevice\",source=\"Stylus\"} 3\n"))
+    {
+      LOG_ERROR("Buffer metrics: the items of the owned buffers are not reported separately:\n" << metrics);
+      return PLUS_FAIL;
+    }
+    if (CountLinesStartingWith(metrics, "plus_buffer_items_total{") != 2 || Contains(metrics, "MetricsTestBuffer"))
+    {
+      LOG_ERROR("Buffer metrics: the items of the temporary buffer are reported:\n" << metrics);
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Buffer metrics: buffers are reported by their owner data source");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestGetMetricsCommand()
+  {
+    PlusMetricsRegistry::GetInstance()->GetMetric("plus_test_command_total", "Command test", PlusMetric::METRIC_COUNTER, "device", "MetricsTestDevice")->Set(42);
+
+    std::string allMetrics;
+    if (ExecuteGetMetrics("<Command Name=\"GetMetrics\" />", allMetrics) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (!Contains(allMetrics, "plus_test_command_total{device=\"MetricsTestDevice\"} 42\n") || !Contains(allMetrics, "plus_buffer_items_total{"))
+    {
+      LOG_ERROR("GetMetrics command: not all metrics are returned without a prefix:\n" << allMetrics);
+      return PLUS_FAIL;
+    }
+
+    std::string bufferMetrics;
+    if (ExecuteGetMetrics("<Command Name=\"GetMetrics\" Prefix=\"plus_buffer_\" />", bufferMetrics) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (!Contains(bufferMetrics, "# TYPE plus_buffer_items_total counter\n") || Contains(bufferMetrics, "plus_test_command_total"))
+    {
+      LOG_ERROR("GetMetrics command: the prefix is not applied:\n" << bufferMetrics);
+      return PLUS_FAIL;
+    }
+
+    // The prefix must be written to the configuration, so that the command can be sent by a client
+    vtkSmartPointer<vtkPlusGetMetricsCommand> command = vtkSmartPointer<vtkPlusGetMetricsCommand>::New();
+    command->SetPrefix("plus_buffer_");
+    vtkSmartPointer<vtkXMLDataElement> commandElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    if (command->WriteConfiguration(commandElement) != PLUS_SUCCESS
+        || commandElement->GetAttribute("Prefix") == NULL || std::string(commandElement->GetAttribute("Prefix")) != "plus_buffer_")
+    {
+      LOG_ERROR("GetMetrics command: the prefix is not written to the command configuration");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("GetMetrics command: metrics are returned with and without prefix");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  if (TestBufferMetrics() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestGetMetricsCommand() != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_INFO("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -12,6 +12,8 @@ happens between two threads. In real life, it happens between two programs.
 */
 
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "PlusMetricsRegistry.h"
 #include "igsioCommon.h"
 #include "vtkNew.h"
 #include "vtkPlusDataCollector.h"
@@ -45,6 +47,9 @@ int main(int argc, char** argv)
   std::string testingConfigFileName;
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
   double runTimeSec = 0.0;
+  std::string latencyTraceFileName;
+  std::string metricsFileName;
+  double metricsFileUpdatePeriodSec = 1.0;
 
   const int numOfTestClientsToConnect = 5; // only if testing is enabled S
 
@@ -55,6 +60,9 @@ int main(int argc, char** argv)
   args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Name of the input configuration file.");
   args.AddArgument("--running-time", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &runTimeSec, "Server running time period in seconds. If the parameter is not defined or 0 then the server runs infinitely.");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--latency-trace-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &latencyTraceFileName, "If specified then per-frame latency is traced from the device to the network socket and written to this file in Chrome trace JSON format at exit.");
+  args.AddArgument("--metrics-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &metricsFileName, "If specified then the current metrics (acquisition rates, buffer fill levels, client send rates, etc.) are written to this file in Prometheus text format periodically (e.g., for node exporter textfile collector).");
+  args.AddArgument("--metrics-file-update-period", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &metricsFileUpdatePeriodSec, "Time between updates of the metrics file in seconds. Default: 1.0.");
 
   if (!args.Parse())
   {
@@ -80,6 +88,11 @@ int main(int argc, char** argv)
 
   LOG_INFO("Logging at level " << vtkPlusLogger::Instance()->GetLogLevel() << " (" << vtkPlusLogger::Instance()->GetLogLevelString() << ") to file: " << vtkPlusLogger::Instance()->GetLogFileName());
 
+  if (!latencyTraceFileName.empty())
+  {
+    PlusLatencyTracer::GetInstance()->SetEnabled(true);
+  }
+
   // Read main configuration file
   vtkNew<vtkPlusDataCollector> dataCollector;
   if (dataCollector->ReadConfiguration(inputConfigFileName) != PLUS_SUCCESS)
@@ -157,12 +170,18 @@ int main(int argc, char** argv)
 
   // Run server until requested
   const double commandQueuePollIntervalSec = 0.010;
+  double lastMetricsFileUpdateTime = 0.0;
   while ((neverStop || (vtkIGSIOAccurateTimer::GetSystemTime() < startTime + runTimeSec)) && !stopRequested)
   {
     for (std::vector<vtkPlusOpenIGTLinkServer*>::iterator it = serverList.begin(); it != serverList.end(); ++it)
     {
       (*it)->ProcessPendingCommands();
     }
+    if (!metricsFileName.empty() && vtkIGSIOAccurateTimer::GetSystemTime() - lastMetricsFileUpdateTime >= metricsFileUpdatePeriodSec)
+    {
+      PlusMetricsRegistry::GetInstance()->WritePrometheusTextFile(metricsFileName);
+      lastMetricsFileUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    }
 #if _WIN32
     // Check if received message that requested process termination (non-Windows systems always use signals).
     // Need to do it before processing messages.
@@ -177,6 +196,18 @@ int main(int argc, char** argv)
     (*it)->Stop();
   }
 
+  if (!latencyTraceFileName.empty())
+  {
+    PlusLatencyTracer::GetInstance()->SetEnabled(false);
+    LOG_INFO(PlusLatencyTracer::GetInstance()->GetStatisticsAsString());
+    PlusLatencyTracer::GetInstance()->WriteChromeTrace(latencyTraceFileName);
+  }
+
+  if (!metricsFileName.empty())
+  {
+    PlusMetricsRegistry::GetInstance()->WritePrometheusTextFile(metricsFileName);
+  }
+
   LOG_INFO("Shutdown successful.");
 
   return EXIT_SUCCESS;
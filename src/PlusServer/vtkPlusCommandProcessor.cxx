@@ -27,6 +27,7 @@ See License.txt for details.
 #endif
 
 #include "vtkPlusAddRecordingDeviceCommand.h"
+#include "vtkPlusGetMetricsCommand.h"
 #include "vtkPlusGetPolydataCommand.h"
 #include "vtkPlusGetTransformCommand.h"
 #include "vtkPlusGetUsParameterCommand.h"
@@ -52,13 +53,14 @@ vtkStandardNewMacro(vtkPlusCommandProcessor);
 //----------------------------------------------------------------------------
 vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   : PlusServer(NULL)
-  , Threader(vtkSmartPointer<vtkMultiThreader>::New())
   , Mutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , CommandExecutionActive(std::make_pair(false, false))
-  , CommandExecutionThreadId(-1)
+  , CommandExecutionActive(false)
+  , CommandExecutionScheduled(false)
+  , CommandExecutionTasks()
 {
   // Register default commands
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetImageCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusGetMetricsCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetPolydataCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetTransformCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusReconstructVolumeCommand>::New());
@@ -88,6 +90,7 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
 //----------------------------------------------------------------------------
 vtkPlusCommandProcessor::~vtkPlusCommandProcessor()
 {
+  Stop();
   SetPlusServer(NULL);
 }
 
@@ -105,10 +108,12 @@ void vtkPlusCommandProcessor::PrintSelf(ostream& os, vtkIndent indent)
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommandProcessor::Start()
 {
-  if (this->CommandExecutionThreadId < 0)
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+  if (!this->CommandExecutionActive)
   {
-    this->CommandExecutionActive.first = true;
-    this->CommandExecutionThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&CommandExecutionThread, this);
+    this->CommandExecutionActive = true;
+    // Execute the commands that were queued before starting
+    this->ScheduleCommandExecution();
   }
   return PLUS_SUCCESS;
 }
@@ -116,47 +121,43 @@ PlusStatus vtkPlusCommandProcessor::Start()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommandProcessor::Stop()
 {
-  // Stop the command execution thread
-  if (this->CommandExecutionThreadId >= 0)
   {
-    this->CommandExecutionActive.first = false;
-    while (this->CommandExecutionActive.second)
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    if (!this->CommandExecutionActive)
     {
-      // Wait until the thread stops
-      vtkIGSIOAccurateTimer::Delay(0.2);
+      return PLUS_SUCCESS;
     }
-    this->CommandExecutionThreadId = -1;
+    this->CommandExecutionActive = false;
   }
 
-  LOG_DEBUG("Command execution thread stopped");
+  // Wait for the completion of the command execution task (no new task is submitted after CommandExecutionActive is cleared)
+  this->CommandExecutionTasks.Wait();
+
+  LOG_DEBUG("Command execution stopped");
 
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-void* vtkPlusCommandProcessor::CommandExecutionThread(vtkMultiThreader::ThreadInfo* data)
+void vtkPlusCommandProcessor::ScheduleCommandExecution()
 {
-  vtkPlusCommandProcessor* self = (vtkPlusCommandProcessor*)(data->UserData);
-
-  self->CommandExecutionActive.second = true;
-
-  // Execute commands until a stop is requested
-  while (self->CommandExecutionActive.first)
+  if (!this->CommandExecutionActive || this->CommandExecutionScheduled || this->CommandQueue.empty())
   {
-    self->ExecuteCommands();
-    // no commands in the queue, wait a bit before checking again
-    const double commandQueuePollIntervalSec = 0.010;
-#ifdef _WIN32
-    Sleep(commandQueuePollIntervalSec * 1000);
-#else
-    usleep(commandQueuePollIntervalSec * 1000000);
-#endif
+    return;
   }
+  this->CommandExecutionScheduled = true;
+  this->CommandExecutionTasks.Submit([this]() { this->ExecuteScheduledCommands(); });
+}
 
-  // Close thread
-  self->CommandExecutionThreadId = -1;
-  self->CommandExecutionActive.second = false;
-  return NULL;
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::ExecuteScheduledCommands()
+{
+  this->ExecuteCommands();
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+  this->CommandExecutionScheduled = false;
+  // Commands may have been queued after ExecuteCommands found the queue empty
+  this->ScheduleCommandExecution();
 }
 
 //----------------------------------------------------------------------------
@@ -188,6 +189,11 @@ int vtkPlusCommandProcessor::ExecuteCommands()
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
       cmd->PopCommandResponses(this->CommandResponseQueue);
     }
+    if (this->PlusServer != NULL)
+    {
+      // send the responses without waiting for the next frame
+      this->PlusServer->WakeUpDataSender();
+    }
 
     numberOfExecutedCommands++;
   }
@@ -294,6 +300,7 @@ PlusStatus vtkPlusCommandProcessor::QueueCommand(bool respondUsingIGTLCommand, u
   // Add command to the execution queue
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
   this->CommandQueue.push_back(cmd);
+  this->ScheduleCommandExecution();
 
   return PLUS_SUCCESS;
 }
@@ -317,8 +324,14 @@ PlusStatus vtkPlusCommandProcessor::QueueStringResponse(PlusStatus status, const
   response->SetStatus(status);
 
   // Add response to the command response queue
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-  this->CommandResponseQueue.push_back(response);
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    this->CommandResponseQueue.push_back(response);
+  }
+  if (this->PlusServer != NULL)
+  {
+    this->PlusServer->WakeUpDataSender();
+  }
 
   return PLUS_SUCCESS;
 }
@@ -335,8 +348,14 @@ PlusStatus vtkPlusCommandProcessor::QueueCommandResponse(PlusStatus status, cons
   response->SetStatus(status);
 
   // Add response to the command response queue
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-  this->CommandResponseQueue.push_back(response);
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    this->CommandResponseQueue.push_back(response);
+  }
+  if (this->PlusServer != NULL)
+  {
+    this->PlusServer->WakeUpDataSender();
+  }
 
   return PLUS_SUCCESS;
 }
@@ -354,6 +373,7 @@ PlusStatus vtkPlusCommandProcessor::QueueGetImageMetaData(unsigned int clientId,
     // Add command to the execution queue
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
     this->CommandQueue.push_back(cmdGetImage);
+    this->ScheduleCommandExecution();
   }
   return PLUS_SUCCESS;
 }
@@ -371,6 +391,7 @@ PlusStatus vtkPlusCommandProcessor::QueueGetImage(unsigned int clientId, const s
     // Add command to the execution queue
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
     this->CommandQueue.push_back(cmdGetImage);
+    this->ScheduleCommandExecution();
   }
   return PLUS_SUCCESS;
 }
@@ -388,6 +409,6 @@ void vtkPlusCommandProcessor::PopCommandResponses(PlusCommandResponseList& respo
 //------------------------------------------------------------------------------
 bool vtkPlusCommandProcessor::IsRunning()
 {
-  return this->CommandExecutionActive.second;
+  return this->CommandExecutionActive;
 }
 
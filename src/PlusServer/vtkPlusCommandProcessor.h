@@ -9,7 +9,7 @@
 
 #include "vtkPlusServerExport.h"
 
-#include "vtkMultiThreader.h"
+#include "PlusThreadPool.h"
 #include "vtkObject.h"
 #include "vtkPlusCommand.h"
 #include "vtkPlusCommandResponse.h"
@@ -23,7 +23,10 @@ class vtkMatrix4x4;
   \class vtkPlusCommandProcessor
   \brief Creates a PlusCommand from a string.
   If the commands are to be executed on the main thread then call ExecuteCommands() periodically from the main thread.
-  If the commands are to be executed on a separate thread (to allow background processing, but maybe requiring more synchronization) call Start() to start an internal processing thread.
+  If the commands are to be executed in the background (to allow background processing, but maybe requiring more synchronization) call Start(),
+  then queued commands are executed by the application-wide PlusThreadPool (one command at a time, in the order they were queued).
+  Commands may run for a long time (e.g., reconstructing a volume), so only one command execution task is submitted at a time
+  and it occupies at most one worker thread.
   Probably one of the processing models would be enough, but at this point it's not clear which one is better.
   TODO: keep only one method and remove the other approach completely once the processing model decision is finalized.
   \ingroup PlusLibPlusServer
@@ -41,13 +44,13 @@ public:
   */
   int ExecuteCommands();
 
-  /*! Start thread for processing the commands in the queue. Must be called from the main thread. */
+  /*! Start processing the commands in the queue in the command execution thread. Must be called from the main thread. */
   virtual PlusStatus Start();
 
-  /*! Stop command processing. Must be called from the main thread. */
+  /*! Stop command processing. Waits for the completion of the command that is being executed. Must be called from the main thread. */
   virtual PlusStatus Stop();
 
-  /*! Returns true if the command processing thread is running. Can be called from any thread. */
+  /*! Returns true if background command processing is started. Can be called from any thread. */
   virtual bool IsRunning();
 
   /*!
@@ -94,8 +97,11 @@ public:
 protected:
   vtkPlusCommand* CreatePlusCommand(const std::string& commandName, const std::string& commandStr, const igtl::MessageBase::MetaDataMap& metaData);
 
-  /*! Thread for client connection handling */
-  static void* CommandExecutionThread(vtkMultiThreader::ThreadInfo* data);
+  /*! Submit a command execution task to the command execution pool if there are queued commands and no task is submitted yet. Mutex must be locked by the caller. */
+  void ScheduleCommandExecution();
+
+  /*! Command execution pool task that executes the queued commands */
+  void ExecuteScheduledCommands();
 
   vtkPlusCommandProcessor();
   virtual ~vtkPlusCommandProcessor();
@@ -104,17 +110,17 @@ private:
   /*! Link to the server that owns this command processor */
   vtkPlusOpenIGTLinkServer* PlusServer;
 
-  /*! vtkMultiThreader instance for controlling threads */
-  vtkSmartPointer<vtkMultiThreader> Threader;
-
   /*! Mutex instance for safe data access */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> Mutex;
 
-  // Active flag for threads (first: request, second: respond )
-  std::pair<bool, bool> CommandExecutionActive;
+  /*! Commands are executed in the thread pool when queued (set by Start) */
+  bool CommandExecutionActive;
+
+  /*! A command execution task is submitted to the thread pool and not completed yet */
+  bool CommandExecutionScheduled;
 
-  // Thread identifier
-  int CommandExecutionThreadId;
+  /*! Submitted command execution task in the application-wide pool, allows waiting for its completion */
+  PlusThreadPool::TaskGroup CommandExecutionTasks;
 
   /*! Map command names and the New() static methods of vtkPlusCommand classes */
   std::map<std::string, vtkPlusCommand*> RegisteredCommands;
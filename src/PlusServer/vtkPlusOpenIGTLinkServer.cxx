@@ -7,7 +7,12 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
+#include "PlusLatencyTracer.h"
+#include "PlusMetricsRegistry.h"
+#include "PlusChannelReadCursor.h"
 #include "PlusConfigure.h"
+#include "PlusNewItemNotifier.h"
+#include "PlusThreadPool.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusCommand.h"
@@ -51,23 +56,18 @@ See License.txt for details.
 #endif
 
 // STL includes
+#include <algorithm>
 #include <fstream>
+#include <memory>
 #include <streambuf>
 
 namespace
 {
   const double DELAY_ON_SENDING_ERROR_SEC = 0.02;
-  const double DELAY_ON_NO_NEW_FRAMES_SEC = 0.005;
   const int NUMBER_OF_RECENT_COMMAND_IDS_STORED = 10;
   const int IGTL_EMPTY_DATA_SIZE = -1;
   const double SERVER_START_CHECK_DELAY_SEC = 2.0;
   const double SERVER_START_CHECK_DELAY_INTERVAL_SEC = 0.05;
-
-  //----------------------------------------------------------------------------
-  // If a frame cannot be retrieved from the device buffers (because it was overwritten by new frames)
-  // then we skip a SAMPLING_SKIPPING_MARGIN_SEC long period to allow the application to catch up.
-  // This time should be long enough to comfortably retrieve a frame from the buffer.
-  const double SAMPLING_SKIPPING_MARGIN_SEC = 0.1;
 }
 
 //----------------------------------------------------------------------------
@@ -92,9 +92,11 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , DataSenderThreadId(-1)
   , IgtlMessageFactory(vtkSmartPointer<vtkPlusIgtlMessageFactory>::New())
   , IgtlClientsMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , LastSentTrackedFrameTimestamp(0)
+  , ClientSendPool(NULL)
+  , MaxNumberOfClientSendThreads(4)
+  , BroadcastCursor(NULL)
   , MaxTimeSpentWithProcessingMs(50)
-  , LastProcessingTimePerFrameMs(-1)
+  , DataSenderNotifier(new PlusNewItemNotifier())
   , SendValidTransformsOnly(true)
   , DefaultClientSendTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
   , DefaultClientReceiveTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
@@ -119,11 +121,17 @@ vtkPlusOpenIGTLinkServer::~vtkPlusOpenIGTLinkServer()
   this->SetTransformRepository(NULL);
   this->SetDataCollector(NULL);
   this->SetConfigFilename(NULL);
+  delete this->DataSenderNotifier;
+  this->DataSenderNotifier = NULL;
+  delete this->ClientSendPool;
+  this->ClientSendPool = NULL;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient(int clientId, igtl::MessageBase::Pointer message)
 {
+  // the metric is owned by the registry, so it can be updated even if the client disconnects meanwhile
+  PlusMetric* sendQueueDepthMetric(NULL);
   bool found(false);
   {
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
@@ -131,6 +139,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient(int clientId,
     {
       if (clientIterator->ClientId == clientId)
       {
+        sendQueueDepthMetric = clientIterator->SendQueueDepthMetric;
         found = true;
         break;
       }
@@ -143,8 +152,15 @@ PlusStatus vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient(int clientId,
     return PLUS_FAIL;
   }
 
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> mutexGuardedLock(this->MessageResponseQueueMutex);
-  this->MessageResponseQueue[clientId].push_back(message);
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> mutexGuardedLock(this->MessageResponseQueueMutex);
+    this->MessageResponseQueue[clientId].push_back(message);
+    if (sendQueueDepthMetric != NULL)
+    {
+      sendQueueDepthMetric->Add(1);
+    }
+  }
+  this->WakeUpDataSender();
 
   return PLUS_SUCCESS;
 }
@@ -214,6 +230,20 @@ PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
     LOG_DEBUG("ConnectionReceiverThread stopped");
   }
 
+  // Stop data sender thread
+  if (this->DataSenderThreadId >= 0)
+  {
+    this->DataSenderActive.Request = false;
+    this->WakeUpDataSender();
+    while (this->DataSenderActive.Respond)
+    {
+      // Wait until the thread stops
+      vtkIGSIOAccurateTimer::DelayWithEventProcessing(0.2);
+    }
+    this->DataSenderThreadId = -1;
+    LOG_DEBUG("DataSenderThread stopped");
+  }
+
   // Disconnect clients (stop receiving thread, close socket)
   std::vector< int > clientIds;
   {
@@ -261,6 +291,7 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
       ClientData newClient;
       self->IgtlClients.push_back(newClient);
       self->NewClientConnected = true;
+      self->WakeUpDataSender();
 
       ClientData* client = &(self->IgtlClients.back());   // get a reference to the client data that is stored in the list
       client->ClientId = self->ClientIdCounter;
@@ -271,6 +302,16 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
       client->ClientInfo = self->DefaultClientInfo;
       client->Server = self;
 
+      PlusMetric::LabelMapType clientLabels;
+      clientLabels["server_port"] = igsioCommon::ToString<int>(self->ListeningPort);
+      clientLabels["client"] = igsioCommon::ToString<int>(client->ClientId);
+      PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+      client->SentBytesMetric = registry->GetMetric("plus_client_sent_bytes_total", "Number of bytes sent to the client", PlusMetric::METRIC_COUNTER, clientLabels);
+      client->SentMessagesMetric = registry->GetMetric("plus_client_sent_messages_total", "Number of messages sent to the client", PlusMetric::METRIC_COUNTER, clientLabels);
+      client->SendRateMetric = registry->GetMetric("plus_client_send_rate_bytes_per_second", "Number of bytes sent to the client per second", PlusMetric::METRIC_GAUGE, clientLabels);
+      client->SendRateMeter.SetGauge(client->SendRateMetric);
+      client->SendQueueDepthMetric = registry->GetMetric("plus_client_send_queue_depth", "Number of messages that are waiting to be sent to the client", PlusMetric::METRIC_GAUGE, clientLabels);
+
       // Setup vtkIGSIOFrameConverters for each stream
       for (std::vector<PlusIgtlClientInfo::ImageStream>::iterator imageStreamIterator = client->ClientInfo.ImageStreams.begin();
         imageStreamIterator != client->ClientInfo.ImageStreams.end(); ++imageStreamIterator)
@@ -328,6 +369,8 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
   if (self->DataCollector->GetDevices(aCollection) != PLUS_SUCCESS || aCollection.size() == 0)
   {
     LOG_ERROR("Unable to retrieve devices. Check configuration and connection.");
+    self->DataSenderThreadId = -1;
+    self->DataSenderActive.Respond = false;
     return NULL;
   }
 
@@ -349,6 +392,8 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
       // the user explicitly requested a specific channel, but none was found by that name
       // this is an error
       LOG_ERROR("Unable to start data sending. OutputChannelId not found: " << self->GetOutputChannelId());
+      self->DataSenderThreadId = -1;
+      self->DataSenderActive.Respond = false;
       return NULL;
     }
     // the user did not specify any channel, so just use the first channel that can be found in any device
@@ -372,9 +417,19 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
   self->BroadcastChannel = aChannel;
   if (self->BroadcastChannel)
   {
-    self->BroadcastChannel->GetMostRecentTimestamp(self->LastSentTrackedFrameTimestamp);
+    // Start sending from the most recent item
+    std::ostringstream consumerName;
+    consumerName << "OpenIGTLink server (port " << self->ListeningPort << ")";
+    self->BroadcastCursor = self->BroadcastChannel->CreateReadCursor(consumerName.str());
+    // Get notified when a new item is added to the channel, so that it can be sent without delay
+    self->BroadcastChannel->AddNewItemNotifier(self->DataSenderNotifier);
   }
 
+  std::string serverPort = igsioCommon::ToString<int>(self->ListeningPort);
+  PlusMetricsRegistry* registry = PlusMetricsRegistry::GetInstance();
+  PlusMetric* connectedClientsMetric = registry->GetMetric("plus_server_connected_clients", "Number of clients connected to the server", PlusMetric::METRIC_GAUGE, "server_port", serverPort);
+  PlusMetric* pendingFramesMetric = registry->GetMetric("plus_server_pending_frames", "Number of acquired frames that are waiting to be sent to the clients", PlusMetric::METRIC_GAUGE, "server_port", serverPort);
+
   double elapsedTimeSinceLastPacketSentSec = 0;
   while (self->ConnectionActive.Request && self->DataSenderActive.Request)
   {
@@ -385,12 +440,17 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
       {
         clientsConnected = true;
       }
+      connectedClientsMetric->Set(self->IgtlClients.size());
     }
     if (!clientsConnected)
     {
-      // No client connected, wait for a while
-      vtkIGSIOAccurateTimer::Delay(0.2);
-      self->LastSentTrackedFrameTimestamp = 0; // next time start sending from the most recent timestamp
+      pendingFramesMetric->Set(0);
+      // No client connected, wait for a while (a new client connection wakes up the thread)
+      self->DataSenderNotifier->WaitForNewItem(0.2);
+      if (self->BroadcastCursor != NULL)
+      {
+        self->BroadcastCursor->Reset(); // next time start sending from the most recent item
+      }
       continue;
     }
 
@@ -406,6 +466,18 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
 
     // Send image/tracking/string data
     SendLatestFramesToClients(*self, elapsedTimeSinceLastPacketSentSec);
+    if (self->BroadcastCursor != NULL)
+    {
+      pendingFramesMetric->Set(self->BroadcastCursor->GetNumberOfUnreadItems());
+    }
+  }
+  connectedClientsMetric->Set(0);
+  pendingFramesMetric->Set(0);
+  if (self->BroadcastChannel)
+  {
+    self->BroadcastChannel->RemoveNewItemNotifier(self->DataSenderNotifier);
+    self->BroadcastChannel->DeleteReadCursor(self->BroadcastCursor);
+    self->BroadcastCursor = NULL;
   }
   // Close thread
   self->DataSenderThreadId = -1;
@@ -419,15 +491,9 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
   vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  // Acquire tracked frames since last acquisition (minimum 1 frame)
-  if (self.LastProcessingTimePerFrameMs < 1)
-  {
-    // if processing was less than 1ms/frame then assume it was 1ms (1000FPS processing speed) to avoid division by zero
-    self.LastProcessingTimePerFrameMs = 1;
-  }
-  int numberOfFramesToGet = std::max(self.MaxTimeSpentWithProcessingMs / self.LastProcessingTimePerFrameMs, 1);
-  // Maximize the number of frames to send
-  numberOfFramesToGet = std::min(numberOfFramesToGet, self.MaxNumberOfIgtlMessagesToSend);
+  // Acquire all the tracked frames since last acquisition (the thread is woken up for each new item,
+  // so usually there is only one), limit the number to not block the response sending for too long
+  int numberOfFramesToGet = std::max(self.MaxNumberOfIgtlMessagesToSend, 1);
 
   if (self.BroadcastChannel != NULL)
   {
@@ -440,27 +506,20 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
         LOG_DYNAMIC("No data is broadcasted, as no data is available yet.", self.GracePeriodLogLevel);
       }
     }
-    else
+    else if (self.BroadcastCursor != NULL)
     {
-      double oldestDataTimestamp = 0;
-      if (self.BroadcastChannel->GetOldestTimestamp(oldestDataTimestamp) == PLUS_SUCCESS)
-      {
-        if (self.LastSentTrackedFrameTimestamp < oldestDataTimestamp)
-        {
-          LOG_INFO("OpenIGTLink broadcasting started. No data was available between " << self.LastSentTrackedFrameTimestamp << "-" << oldestDataTimestamp << "sec, therefore no data were broadcasted during this time period.");
-          self.LastSentTrackedFrameTimestamp = oldestDataTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
-        }
-        static vtkIGSIOLogHelper logHelper(60.0, 500000);
-        CUSTOM_RETURN_WITH_FAIL_IF(self.BroadcastChannel->GetTrackedFrameList(self.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet) != PLUS_SUCCESS,
-                                   "Failed to get tracked frame list from data collector (last recorded timestamp: " << std::fixed << self.LastSentTrackedFrameTimestamp);
-      }
+      // If more items were acquired than what can be sent then only the latest ones are sent
+      static vtkIGSIOLogHelper logHelper(60.0, 500000);
+      CUSTOM_RETURN_WITH_FAIL_IF(self.BroadcastCursor->ReadNextTrackedFrames(trackedFrameList, numberOfFramesToGet, true) != PLUS_SUCCESS,
+                                 "Failed to get tracked frame list from data collector (last sent timestamp: " << std::fixed << self.BroadcastCursor->GetLastReadTimestamp() << ")");
     }
   }
 
   // There is no new frame in the buffer
   if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
   {
-    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
+    // Wait until a new item is added to the channel (or a response is queued), but not longer than needed for the next keep-alive
+    self.DataSenderNotifier->WaitForNewItem(std::max(self.KeepAliveIntervalSec - elapsedTimeSinceLastPacketSentSec, 0.0));
     elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
 
     // Send keep alive packet to clients
@@ -474,21 +533,21 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
     return PLUS_FAIL;
   }
 
-  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  const unsigned int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  for (unsigned int i = 0; i < numberOfFrames; ++i)
   {
+    if (self.MaxTimeSpentWithProcessingMs > 0 && i < numberOfFrames - 1
+        && (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0 > self.MaxTimeSpentWithProcessingMs)
+    {
+      // Sending takes too long, skip to the latest frame so that clients get the current state and responses are not delayed
+      LOG_DEBUG("Maximum processing time (" << self.MaxTimeSpentWithProcessingMs << " ms) is exceeded, " << numberOfFrames - 1 - i << " frames are not sent");
+      i = numberOfFrames - 1;
+    }
     // Send tracked frame
     self.SendTrackedFrame(*trackedFrameList->GetTrackedFrame(i));
     elapsedTimeSinceLastPacketSentSec = 0;
   }
 
-  // Compute time spent with processing one frame in this round
-  double computationTimeMs = (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0;
-
-  // Update last processing time if new tracked frames have been acquired
-  if (trackedFrameList->GetNumberOfTrackedFrames() > 0)
-  {
-    self.LastProcessingTimePerFrameMs = computationTimeMs / trackedFrameList->GetNumberOfTrackedFrames();
-  }
   return PLUS_SUCCESS;
 }
 
@@ -502,12 +561,14 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
     {
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
       igtl::ClientSocket::Pointer clientSocket = NULL;
+      PlusMetric* sendQueueDepthMetric(NULL);
 
       for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
       {
         if (clientIterator->ClientId == it->first)
         {
           clientSocket = clientIterator->ClientSocket;
+          sendQueueDepthMetric = clientIterator->SendQueueDepthMetric;
           break;
         }
       }
@@ -520,6 +581,10 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
       for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = it->second.begin(); messageIt != it->second.end(); ++messageIt)
       {
         clientSocket->Send((*messageIt)->GetBufferPointer(), (*messageIt)->GetBufferSize());
+        if (sendQueueDepthMetric != NULL)
+        {
+          sendQueueDepthMetric->Add(-1);
+        }
       }
     }
     self.MessageResponseQueue.clear();
@@ -1044,42 +1109,93 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
     }
     this->NewClientConnected = false;
 
-    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    // Create IGT messages for each client. With multiple clients the messages are packed (and the images encoded) in parallel
+    // on the application-wide pool. Packing updates the transform repository and the TRACKEDFRAME message type modifies
+    // the tracked frame, so each client gets its own copy of these.
+    const int numberOfClients = this->IgtlClients.size();
+    std::vector< std::vector<igtl::MessageBase::Pointer> > clientMessages(numberOfClients);
+    std::vector< vtkSmartPointer<vtkIGSIOTransformRepository> > clientTransformRepositories(numberOfClients);
+    std::vector< std::unique_ptr<igsioTrackedFrame> > clientTrackedFrames(numberOfClients);
+    PlusThreadPool::TaskGroup packTasks;
+    int clientIndex = 0;
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator, ++clientIndex)
     {
-      igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
-
-      // Create IGT messages
-      std::vector<igtl::MessageBase::Pointer> igtlMessages;
-      std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator;
-
-      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+      ClientData* client = &(*clientIterator);
+      vtkIGSIOTransformRepository* transformRepository = this->TransformRepository;
+      igsioTrackedFrame* clientTrackedFrame = &trackedFrame;
+      if (numberOfClients > 1)
       {
-        LOG_WARNING("Failed to pack all IGT messages");
+        if (this->TransformRepository != NULL)
+        {
+          clientTransformRepositories[clientIndex] = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+          clientTransformRepositories[clientIndex]->DeepCopy(this->TransformRepository, false);
+          transformRepository = clientTransformRepositories[clientIndex];
+        }
+        const std::vector<std::string>& messageTypes = client->ClientInfo.IgtlMessageTypes;
+        if (std::find(messageTypes.begin(), messageTypes.end(), "TRACKEDFRAME") != messageTypes.end())
+        {
+          clientTrackedFrames[clientIndex].reset(new igsioTrackedFrame(trackedFrame));
+          clientTrackedFrame = clientTrackedFrames[clientIndex].get();
+        }
       }
-
-      // Send all messages to a client
-      for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+      std::vector<igtl::MessageBase::Pointer>* igtlMessages = &clientMessages[clientIndex];
+      PlusThreadPool::TaskType packTask = [this, client, igtlMessages, clientTrackedFrame, transformRepository, timestampSystem]()
       {
-        igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
-        if (igtlMessage.IsNull())
+        if (this->IgtlMessageFactory->PackMessages(client->ClientId, client->ClientInfo, *igtlMessages, *clientTrackedFrame, this->SendValidTransformsOnly, transformRepository) != PLUS_SUCCESS)
         {
-          continue;
+          LOG_WARNING("Failed to pack all IGT messages");
         }
-
-        int retValue = 0;
-        RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-        if (retValue == 0)
+        // one trace point for each client, as the messages of each client are packed separately
+        PLUS_TRACE_LATENCY(STAGE_MESSAGE_PACK, timestampSystem);
+      };
+      if (numberOfClients > 1)
+      {
+        packTasks.Submit(packTask);
+      }
+      else
+      {
+        packTask();
+      }
+    }
+    packTasks.Wait();
+
+    // Send the messages to the clients in parallel, so that a slow client does not delay sending to the others
+    this->UpdateClientSendPool(numberOfClients);
+    std::vector<char> clientDisconnected(numberOfClients, 0);
+    PlusThreadPool::TaskGroup sendTasks(this->ClientSendPool);
+    clientIndex = 0;
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator, ++clientIndex)
+    {
+      ClientData* client = &(*clientIterator);
+      const std::vector<igtl::MessageBase::Pointer>* igtlMessages = &clientMessages[clientIndex];
+      char* disconnected = &clientDisconnected[clientIndex];
+      double timestamp = trackedFrame.GetTimestamp();
+      PlusThreadPool::TaskType sendTask = [this, client, igtlMessages, disconnected, timestamp, timestampSystem]()
+      {
+        *disconnected = (this->SendMessagesToClient(*client, *igtlMessages, timestamp) != PLUS_SUCCESS);
+        if (!*disconnected)
         {
-          disconnectedClientIds.push_back(clientIterator->ClientId);
-          igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
-          igtlMessage->GetTimeStamp(ts);
-          LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
-                   << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
-          break;
+          // one trace point for each client when its messages are sent, so a slow client shows up in the statistics
+          PLUS_TRACE_LATENCY(STAGE_SOCKET_SEND, timestampSystem);
         }
+      };
+      if (numberOfClients > 1)
+      {
+        sendTasks.Submit(sendTask);
+      }
+      else
+      {
+        sendTask();
+      }
+    }
+    sendTasks.Wait();
 
-        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
-        clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+    clientIndex = 0;
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator, ++clientIndex)
+    {
+      if (clientDisconnected[clientIndex])
+      {
+        disconnectedClientIds.push_back(clientIterator->ClientId);
       }
     }
   }
@@ -1096,6 +1212,99 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateClientSendPool(int numberOfClients)
+{
+  if (numberOfClients <= 1)
+  {
+    // a single client is served by the data sender thread, no need to keep idle threads around
+    if (this->ClientSendPool != NULL)
+    {
+      LOG_DEBUG("Client send thread pool statistics: " << this->ClientSendPool->GetStatisticsAsString());
+      delete this->ClientSendPool;
+      this->ClientSendPool = NULL;
+    }
+    return;
+  }
+
+  // If there are more clients than threads then the clients share the threads (one task for each client)
+  unsigned int numberOfThreads = static_cast<unsigned int>(std::min(numberOfClients, std::max(this->MaxNumberOfClientSendThreads, 1)));
+  if (this->ClientSendPool == NULL)
+  {
+    this->ClientSendPool = new PlusThreadPool(numberOfThreads);
+  }
+  else if (this->ClientSendPool->GetNumberOfThreads() != numberOfThreads)
+  {
+    // the number of clients changes rarely, so threads are stopped and started only when a client connects or disconnects
+    this->ClientSendPool->SetNumberOfThreads(numberOfThreads);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendMessagesToClient(ClientData& client, const std::vector<igtl::MessageBase::Pointer>& igtlMessages, double timestamp)
+{
+  double sentBytes = 0;
+  double sentMessages = 0;
+  PlusStatus status = PLUS_SUCCESS;
+
+  // A client that cannot receive the data fast enough blocks in Send, so its queue depth stays high while the others are served
+  double numberOfQueuedMessages = 0;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+  {
+    if (igtlMessageIterator->IsNotNull())
+    {
+      numberOfQueuedMessages++;
+    }
+  }
+  if (client.SendQueueDepthMetric != NULL)
+  {
+    client.SendQueueDepthMetric->Add(numberOfQueuedMessages);
+  }
+
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+  {
+    igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
+    if (igtlMessage.IsNull())
+    {
+      continue;
+    }
+
+    int retValue = 0;
+    RETRY_UNTIL_TRUE((retValue = client.ClientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+    if (retValue == 0)
+    {
+      igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+      igtlMessage->GetTimeStamp(ts);
+      LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
+               << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
+      status = PLUS_FAIL;
+      break;
+    }
+    sentBytes += igtlMessage->GetBufferSize();
+    sentMessages++;
+    if (client.SendQueueDepthMetric != NULL)
+    {
+      client.SendQueueDepthMetric->Add(-1);
+    }
+
+    // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
+    client.ClientInfo.SetLastTDATASentTimeStamp(timestamp);
+  }
+
+  if (client.SendQueueDepthMetric != NULL && sentMessages < numberOfQueuedMessages)
+  {
+    // the client is disconnected, the remaining messages are not sent
+    client.SendQueueDepthMetric->Add(sentMessages - numberOfQueuedMessages);
+  }
+  if (client.SentBytesMetric != NULL)
+  {
+    client.SentBytesMetric->Add(sentBytes);
+    client.SentMessagesMetric->Add(sentMessages);
+    client.SendRateMeter.Add(sentBytes, vtkIGSIOAccurateTimer::GetSystemTime());
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
 {
@@ -1174,6 +1383,7 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
 #endif
         clientIterator->ClientSocket->CloseSocket();
       }
+      PlusMetricsRegistry::GetInstance()->RemoveMetrics("client", igsioCommon::ToString<int>(clientId));
       this->IgtlClients.erase(clientIterator);
       break;
     }
@@ -1263,6 +1473,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MissingInputGracePeriodSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaxTimeSpentWithProcessingMs, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfIgtlMessagesToSend, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfClientSendThreads, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfRetryAttempts, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, DelayBetweenRetryAttemptsSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, KeepAliveIntervalSec, serverElement);
@@ -1299,6 +1510,12 @@ int vtkPlusOpenIGTLinkServer::ProcessPendingCommands()
   return this->PlusCommandProcessor->ExecuteCommands();
 }
 
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::WakeUpDataSender()
+{
+  this->DataSenderNotifier->Notify();
+}
+
 //------------------------------------------------------------------------------
 bool vtkPlusOpenIGTLinkServer::HasGracePeriodExpired()
 {
@@ -1345,6 +1562,12 @@ PlusStatus vtkPlusOpenIGTLinkServer::Stop()
 
   SetTransformRepository(NULL);
 
+  LOG_INFO("Thread pool statistics: " << PlusThreadPool::GetInstance()->GetStatisticsAsString());
+  if (this->ClientSendPool != NULL)
+  {
+    LOG_INFO("Client send thread pool statistics: " << this->ClientSendPool->GetStatisticsAsString());
+  }
+
   return status;
 }
 
@@ -10,6 +10,7 @@
 // Local includes
 #include "vtkPlusServerExport.h"
 #include "PlusIgtlClientInfo.h"
+#include "PlusMetricsRegistry.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusIgtlMessageFactory.h"
 #include "vtkIGSIOTransformRepository.h"
@@ -32,6 +33,9 @@
 #include <igtlServerSocket.h>
 
 //class igsioTrackedFrame; 
+class PlusChannelReadCursor;
+class PlusNewItemNotifier;
+class PlusThreadPool;
 class vtkPlusDataCollector;
 class vtkPlusOpenIGTLinkServer;
 class vtkPlusChannel;
@@ -48,6 +52,10 @@ struct ClientData
     , DataReceiverActive(std::make_pair(false, false))
     , DataReceiverThreadId(-1)
     , Server(NULL)
+    , SentBytesMetric(NULL)
+    , SentMessagesMetric(NULL)
+    , SendRateMetric(NULL)
+    , SendQueueDepthMetric(NULL)
   {
   }
 
@@ -68,6 +76,15 @@ struct ClientData
   PlusIgtlClientInfo ClientInfo;
 
   vtkPlusOpenIGTLinkServer* Server;
+
+  /// Send statistics of the client (owned by PlusMetricsRegistry)
+  PlusMetric* SentBytesMetric;
+  PlusMetric* SentMessagesMetric;
+  PlusMetric* SendRateMetric;
+  PlusMetricRateMeter SendRateMeter;
+
+  /// Number of messages (packed data messages and replies) that are not written to the client socket yet (owned by PlusMetricsRegistry)
+  PlusMetric* SendQueueDepthMetric;
 };
 
 /*!
@@ -114,6 +131,10 @@ public:
   vtkSetMacro(MissingInputGracePeriodSec, double);
   vtkGetMacroConst(MissingInputGracePeriodSec, double);
 
+  /*!
+    Maximum time spent with sending one batch of frames (in milliseconds). If sending the frames that were acquired since the last batch
+    takes longer then the remaining older frames are skipped and only the latest one is sent, so that command responses are not delayed.
+  */
   vtkSetMacro(MaxTimeSpentWithProcessingMs, double);
   vtkGetMacroConst(MaxTimeSpentWithProcessingMs, double);
 
@@ -159,6 +180,9 @@ public:
   */
   int ProcessPendingCommands();
 
+  /*! Wake up the data sender thread, so that it sends queued responses without waiting for new frames or the next keep-alive */
+  void WakeUpDataSender();
+
 protected:
   vtkPlusOpenIGTLinkServer();
   virtual ~vtkPlusOpenIGTLinkServer();
@@ -187,6 +211,18 @@ protected:
   /*! Tracked frame interface, sends the selected message type and data to all clients */
   virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame);
 
+  /*!
+    Create, resize or delete ClientSendPool for the current number of clients.
+    The pool only exists while more than one client is connected and it has at most MaxNumberOfClientSendThreads threads.
+  */
+  void UpdateClientSendPool(int numberOfClients);
+
+  /*!
+    Send packed messages to a client. Called from ClientSendPool tasks, one client is handled by one task at a time.
+    \return PLUS_FAIL if the client is disconnected
+  */
+  PlusStatus SendMessagesToClient(ClientData& client, const std::vector<igtl::MessageBase::Pointer>& igtlMessages, double timestamp);
+
   /*! Converts a command response to an OpenIGTLink message that can be sent to the client */
   igtl::MessageBase::Pointer CreateIgtlMessageFromCommandResponse(vtkPlusCommandResponse* response);
 
@@ -207,6 +243,9 @@ protected:
   vtkSetMacro(MaxNumberOfIgtlMessagesToSend, int);
   vtkGetMacroConst(MaxNumberOfIgtlMessagesToSend, int);
 
+  vtkSetMacro(MaxNumberOfClientSendThreads, int);
+  vtkGetMacroConst(MaxNumberOfClientSendThreads, int);
+
   vtkSetMacro(NumberOfRetryAttempts, int);
   vtkGetMacroConst(NumberOfRetryAttempts, int);
 
@@ -279,14 +318,28 @@ private:
   /*! Mutex instance for accessing client data list */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> IgtlClientsMutex;
 
-  /*! Last sent tracked frame timestamp */
-  double LastSentTrackedFrameTimestamp;
+  /*!
+    Threads that send the messages to the clients in parallel. Sending blocks until the client receives the data
+    (or the send timeout elapses), so it does not use the application-wide pool; packing the messages does.
+    Only exists while more than one client is connected, has one thread for each client up to MaxNumberOfClientSendThreads.
+    Owned by the server, used by the data sender thread only.
+  */
+  PlusThreadPool* ClientSendPool;
 
-  /*! Maximum time spent with processing (getting tracked frames, sending messages) per second (in milliseconds) */
-  int MaxTimeSpentWithProcessingMs;
+  /*! Maximum number of threads that send messages to the clients in parallel */
+  int MaxNumberOfClientSendThreads;
 
-  /*! Time needed to process one frame in the latest recording round (in milliseconds) */
-  int LastProcessingTimePerFrameMs;
+  /*! Position of the data sender thread in the broadcast channel (created and deleted by the data sender thread) */
+  PlusChannelReadCursor* BroadcastCursor;
+
+  /*! Maximum time spent with sending one batch of frames (in milliseconds), not limited if not positive */
+  double MaxTimeSpentWithProcessingMs;
+
+  /*!
+    Wakes up the data sender thread when a new item is added to the broadcast channel,
+    a response is queued or a client connects. Owned by the server.
+  */
+  PlusNewItemNotifier* DataSenderNotifier;
 
   /*! Whether or not the server should send invalid transforms through the IGT Link */
   bool SendValidTransformsOnly;